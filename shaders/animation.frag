@@ -34,9 +34,9 @@ float shadow_calc(vec4 pos, vec3 normal){
 void main()
 {
 
-  vec3 norm     = texture(normal_map, TexCoord).rgb;
-
-  norm = normalize(norm * 2.0 - 1.0);
+  // z is rebuilt from x and y so two channel (BC5) normal maps work the same as full ones
+  vec2 norm_xy  = texture(normal_map, TexCoord).rg * 2.0 - 1.0;
+  vec3 norm     = vec3(norm_xy, sqrt(max(1.0 - dot(norm_xy, norm_xy), 0.0)));
 
 
   vec3 lightDir = normalize(TangentLightPos - TangentFragPos);
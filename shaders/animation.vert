@@ -6,7 +6,6 @@ layout (location = 2) in vec3 aNormal;
 layout (location = 3) in vec4 weight;
 layout (location = 4) in ivec4 indices;
 layout (location = 5) in vec3 tangent;
-layout (location = 6) in vec3 bitangent;
 
 const int MAX_JOINTS = 100;
 
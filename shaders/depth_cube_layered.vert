@@ -0,0 +1,21 @@
+#version 450 core
+#extension GL_ARB_shader_viewport_layer_array : enable
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aTexCoord;
+layout (location = 2) in vec3 aNormal;
+
+uniform mat4 model;
+uniform mat4 shadowMatrices[6];
+
+out vec4 FragPos;
+
+// one instance per cube face, the renderer only picks this path when the extension exists
+void main()
+{
+  FragPos     = vec4(aPos, 1.0) * model;
+  gl_Position = FragPos * shadowMatrices[gl_InstanceID];
+#ifdef GL_ARB_shader_viewport_layer_array
+  gl_Layer    = gl_InstanceID;
+#endif
+}
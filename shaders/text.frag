@@ -1,12 +1,15 @@
 #version 450 core
 
 
-uniform vec4 color;
+in vec2 TexCoord;
+in vec4 Color;
+
+uniform sampler2D atlas;
 out vec4 FragColor;
 
 
 void main()
 {
-  FragColor = color;
+  FragColor = vec4(Color.rgb, Color.a * texture(atlas, TexCoord).r);
 
 }
@@ -148,7 +148,7 @@ bool parse_animation_file(AnimationModel* model, const char* filename, const cha
 
   Buffer buffer = {};
 
-  if (!sta_read_file(&buffer, filename))
+  if (!sta_map_file(&buffer, filename))
   {
     return false;
   }
@@ -303,12 +303,11 @@ bool parse_animation_file(AnimationModel* model, const char* filename, const cha
     }
   }
 
+  sta_unmap_file(&buffer);
+
   if (animation_mapping_location)
   {
-    buffer       = {};
-    buffer.index = 0;
-
-    if (!sta_read_file(&buffer, animation_mapping_location))
+    if (!sta_map_file(&buffer, animation_mapping_location))
     {
       return false;
     }
@@ -338,6 +337,7 @@ bool parse_animation_file(AnimationModel* model, const char* filename, const cha
       }
       buffer.skip_whitespace();
     }
+    sta_unmap_file(&buffer);
   }
   else
   {
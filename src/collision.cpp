@@ -604,3 +604,710 @@ void triangulate_earclipping(Triangle* triangles, u32& triangle_count, Vector2**
     tot += v_counts[i] - 2;
   }
 }
+
+// Ear clipping over a doubly linked ring like earcut, holes are bridged into the outer ring
+// left to right and for larger polygons the ear test only visits vertices whose z-order
+// (morton) code falls inside the candidate triangle's bounding box
+struct EarcutNode
+{
+  EarcutNode* prev;
+  EarcutNode* next;
+  EarcutNode* prev_z;
+  EarcutNode* next_z;
+  f32         x, y;
+  u32         z;
+  u32         i;
+  bool        steiner;
+};
+
+struct Earcut
+{
+  EarcutNode* nodes;
+  u32         node_count;
+  u32         node_capacity;
+  f32         min_x, min_y;
+  f32         inv_size;
+  Triangle*   triangles;
+  u32         triangle_count;
+  u32         triangle_capacity;
+};
+
+// polygons below this many vertices are cheaper to clip without the z-order index
+#define EARCUT_HASH_THRESHOLD 80
+
+static inline f32 earcut_area(EarcutNode* p, EarcutNode* q, EarcutNode* r)
+{
+  return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+}
+
+static inline bool earcut_equals(EarcutNode* a, EarcutNode* b)
+{
+  return a->x == b->x && a->y == b->y;
+}
+
+static inline bool earcut_point_in_triangle(f32 ax, f32 ay, f32 bx, f32 by, f32 cx, f32 cy, f32 px, f32 py)
+{
+  return (cx - px) * (ay - py) - (ax - px) * (cy - py) >= 0 && (ax - px) * (by - py) - (bx - px) * (ay - py) >= 0 && (bx - px) * (cy - py) - (cx - px) * (by - py) >= 0;
+}
+
+static inline i32 earcut_sign(f32 v)
+{
+  return v > 0 ? 1 : v < 0 ? -1 : 0;
+}
+
+static inline bool earcut_on_segment(EarcutNode* p, EarcutNode* q, EarcutNode* r)
+{
+  return q->x <= MAX(p->x, r->x) && q->x >= MIN(p->x, r->x) && q->y <= MAX(p->y, r->y) && q->y >= MIN(p->y, r->y);
+}
+
+static bool earcut_intersects(EarcutNode* p1, EarcutNode* q1, EarcutNode* p2, EarcutNode* q2)
+{
+  i32 o1 = earcut_sign(earcut_area(p1, q1, p2));
+  i32 o2 = earcut_sign(earcut_area(p1, q1, q2));
+  i32 o3 = earcut_sign(earcut_area(p2, q2, p1));
+  i32 o4 = earcut_sign(earcut_area(p2, q2, q1));
+
+  if (o1 != o2 && o3 != o4)
+  {
+    return true;
+  }
+  // collinear cases
+  return (o1 == 0 && earcut_on_segment(p1, p2, q1)) || (o2 == 0 && earcut_on_segment(p1, q2, q1)) || (o3 == 0 && earcut_on_segment(p2, p1, q2)) ||
+         (o4 == 0 && earcut_on_segment(p2, q1, q2));
+}
+
+static bool earcut_intersects_polygon(EarcutNode* a, EarcutNode* b)
+{
+  EarcutNode* p = a;
+  do
+  {
+    if (p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i && earcut_intersects(p, p->next, a, b))
+    {
+      return true;
+    }
+    p = p->next;
+  } while (p != a);
+  return false;
+}
+
+static bool earcut_locally_inside(EarcutNode* a, EarcutNode* b)
+{
+  if (earcut_area(a->prev, a, a->next) < 0)
+  {
+    return earcut_area(a, b, a->next) >= 0 && earcut_area(a, a->prev, b) >= 0;
+  }
+  return earcut_area(a, b, a->prev) < 0 || earcut_area(a, a->next, b) < 0;
+}
+
+static bool earcut_middle_inside(EarcutNode* a, EarcutNode* b)
+{
+  EarcutNode* p      = a;
+  bool        inside = false;
+  f32         px     = (a->x + b->x) / 2;
+  f32         py     = (a->y + b->y) / 2;
+  do
+  {
+    if (((p->y > py) != (p->next->y > py)) && p->next->y != p->y && (px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x))
+    {
+      inside = !inside;
+    }
+    p = p->next;
+  } while (p != a);
+  return inside;
+}
+
+static bool earcut_is_valid_diagonal(EarcutNode* a, EarcutNode* b)
+{
+  if (a->next->i == b->i || a->prev->i == b->i || earcut_intersects_polygon(a, b))
+  {
+    return false;
+  }
+  bool visible = earcut_locally_inside(a, b) && earcut_locally_inside(b, a) && earcut_middle_inside(a, b);
+  if (visible && (earcut_area(a->prev, a, b->prev) != 0 || earcut_area(a, b->prev, b) != 0))
+  {
+    return true;
+  }
+  // zero length diagonal between two convex corners
+  return earcut_equals(a, b) && earcut_area(a->prev, a, a->next) > 0 && earcut_area(b->prev, b, b->next) > 0;
+}
+
+static EarcutNode* earcut_new_node(Earcut* earcut, u32 i, f32 x, f32 y)
+{
+  assert(earcut->node_count < earcut->node_capacity && "Ran out of earcut nodes?");
+  EarcutNode* p = &earcut->nodes[earcut->node_count++];
+  *p            = {};
+  p->x          = x;
+  p->y          = y;
+  p->i          = i;
+  return p;
+}
+
+static EarcutNode* earcut_insert_node(Earcut* earcut, u32 i, f32 x, f32 y, EarcutNode* last)
+{
+  EarcutNode* p = earcut_new_node(earcut, i, x, y);
+  if (!last)
+  {
+    p->prev = p;
+    p->next = p;
+  }
+  else
+  {
+    p->next          = last->next;
+    p->prev          = last;
+    last->next->prev = p;
+    last->next       = p;
+  }
+  return p;
+}
+
+static void earcut_remove_node(EarcutNode* p)
+{
+  p->next->prev = p->prev;
+  p->prev->next = p->next;
+  if (p->prev_z)
+  {
+    p->prev_z->next_z = p->next_z;
+  }
+  if (p->next_z)
+  {
+    p->next_z->prev_z = p->prev_z;
+  }
+}
+
+// Links a to b with two new nodes so the ring is cut in two, returns the copy of b on the other side
+static EarcutNode* earcut_split_polygon(Earcut* earcut, EarcutNode* a, EarcutNode* b)
+{
+  EarcutNode* a2 = earcut_new_node(earcut, a->i, a->x, a->y);
+  EarcutNode* b2 = earcut_new_node(earcut, b->i, b->x, b->y);
+  EarcutNode* an = a->next;
+  EarcutNode* bp = b->prev;
+
+  a->next        = b;
+  b->prev        = a;
+  a2->next       = an;
+  an->prev       = a2;
+  b2->next       = a2;
+  a2->prev       = b2;
+  bp->next       = b2;
+  b2->prev       = bp;
+  return b2;
+}
+
+// Ring in counter clockwise order whatever way the points came in
+static EarcutNode* earcut_linked_list(Earcut* earcut, Vector2* points, u32 count, u32 start_index, bool counter_clockwise)
+{
+  f32 sum = 0;
+  for (u32 i = 0, j = count - 1; i < count; j = i++)
+  {
+    sum += (points[j].x - points[i].x) * (points[i].y + points[j].y);
+  }
+
+  EarcutNode* last = 0;
+  if (counter_clockwise == (sum > 0))
+  {
+    for (u32 i = 0; i < count; i++)
+    {
+      last = earcut_insert_node(earcut, start_index + i, points[i].x, points[i].y, last);
+    }
+  }
+  else
+  {
+    for (i32 i = count - 1; i >= 0; i--)
+    {
+      last = earcut_insert_node(earcut, start_index + i, points[i].x, points[i].y, last);
+    }
+  }
+
+  if (last && earcut_equals(last, last->next))
+  {
+    earcut_remove_node(last);
+    last = last->next;
+  }
+  return last;
+}
+
+// Drops duplicate and collinear points between start and end
+static EarcutNode* earcut_filter_points(EarcutNode* start, EarcutNode* end)
+{
+  if (!start)
+  {
+    return start;
+  }
+  if (!end)
+  {
+    end = start;
+  }
+
+  EarcutNode* p = start;
+  bool        again;
+  do
+  {
+    again = false;
+    if (!p->steiner && (earcut_equals(p, p->next) || earcut_area(p->prev, p, p->next) == 0))
+    {
+      earcut_remove_node(p);
+      p = end = p->prev;
+      if (p == p->next)
+      {
+        break;
+      }
+      again = true;
+    }
+    else
+    {
+      p = p->next;
+    }
+  } while (again || p != end);
+
+  return end;
+}
+
+static u32 earcut_z_order(Earcut* earcut, f32 x, f32 y)
+{
+  u32 ix = (u32)((x - earcut->min_x) * earcut->inv_size);
+  u32 iy = (u32)((y - earcut->min_y) * earcut->inv_size);
+
+  ix     = (ix | (ix << 8)) & 0x00FF00FF;
+  ix     = (ix | (ix << 4)) & 0x0F0F0F0F;
+  ix     = (ix | (ix << 2)) & 0x33333333;
+  ix     = (ix | (ix << 1)) & 0x55555555;
+
+  iy     = (iy | (iy << 8)) & 0x00FF00FF;
+  iy     = (iy | (iy << 4)) & 0x0F0F0F0F;
+  iy     = (iy | (iy << 2)) & 0x33333333;
+  iy     = (iy | (iy << 1)) & 0x55555555;
+
+  return ix | (iy << 1);
+}
+
+// Bottom up merge sort of the z list, no extra memory and O(n log n)
+static EarcutNode* earcut_sort_linked(EarcutNode* list)
+{
+  u32 in_size = 1;
+  u32 merges;
+  do
+  {
+    EarcutNode* p    = list;
+    EarcutNode* tail = 0;
+    list             = 0;
+    merges           = 0;
+
+    while (p)
+    {
+      merges++;
+      EarcutNode* q      = p;
+      u32         p_size = 0;
+      for (u32 i = 0; i < in_size && q; i++)
+      {
+        p_size++;
+        q = q->next_z;
+      }
+      u32 q_size = in_size;
+
+      while (p_size > 0 || (q_size > 0 && q))
+      {
+        EarcutNode* e;
+        if (p_size != 0 && (q_size == 0 || !q || p->z <= q->z))
+        {
+          e = p;
+          p = p->next_z;
+          p_size--;
+        }
+        else
+        {
+          e = q;
+          q = q->next_z;
+          q_size--;
+        }
+
+        if (tail)
+        {
+          tail->next_z = e;
+        }
+        else
+        {
+          list = e;
+        }
+        e->prev_z = tail;
+        tail      = e;
+      }
+      p = q;
+    }
+    tail->next_z = 0;
+    in_size *= 2;
+  } while (merges > 1);
+
+  return list;
+}
+
+static void earcut_index_curve(Earcut* earcut, EarcutNode* start)
+{
+  EarcutNode* p = start;
+  do
+  {
+    p->z      = earcut_z_order(earcut, p->x, p->y);
+    p->prev_z = p->prev;
+    p->next_z = p->next;
+    p         = p->next;
+  } while (p != start);
+
+  p->prev_z->next_z = 0;
+  p->prev_z         = 0;
+  earcut_sort_linked(p);
+}
+
+static bool earcut_is_ear(EarcutNode* ear)
+{
+  EarcutNode* a = ear->prev;
+  EarcutNode* b = ear;
+  EarcutNode* c = ear->next;
+  if (earcut_area(a, b, c) >= 0)
+  {
+    // reflex
+    return false;
+  }
+
+  for (EarcutNode* p = ear->next->next; p != ear->prev; p = p->next)
+  {
+    if (earcut_point_in_triangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) && earcut_area(p->prev, p, p->next) >= 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static inline bool earcut_blocks_ear(EarcutNode* ear, EarcutNode* p)
+{
+  EarcutNode* a = ear->prev;
+  EarcutNode* c = ear->next;
+  return p != a && p != c && earcut_point_in_triangle(a->x, a->y, ear->x, ear->y, c->x, c->y, p->x, p->y) && earcut_area(p->prev, p, p->next) >= 0;
+}
+
+// Same test but only walks the z list in both directions while the codes stay inside the triangle's box
+static bool earcut_is_ear_hashed(Earcut* earcut, EarcutNode* ear)
+{
+  EarcutNode* a = ear->prev;
+  EarcutNode* b = ear;
+  EarcutNode* c = ear->next;
+  if (earcut_area(a, b, c) >= 0)
+  {
+    return false;
+  }
+
+  f32         min_x = MIN(MIN(a->x, b->x), c->x);
+  f32         min_y = MIN(MIN(a->y, b->y), c->y);
+  f32         max_x = MAX(MAX(a->x, b->x), c->x);
+  f32         max_y = MAX(MAX(a->y, b->y), c->y);
+  u32         min_z = earcut_z_order(earcut, min_x, min_y);
+  u32         max_z = earcut_z_order(earcut, max_x, max_y);
+
+  EarcutNode* p     = ear->prev_z;
+  EarcutNode* n     = ear->next_z;
+  while (p && p->z >= min_z && n && n->z <= max_z)
+  {
+    if (earcut_blocks_ear(ear, p))
+    {
+      return false;
+    }
+    p = p->prev_z;
+    if (earcut_blocks_ear(ear, n))
+    {
+      return false;
+    }
+    n = n->next_z;
+  }
+  while (p && p->z >= min_z)
+  {
+    if (earcut_blocks_ear(ear, p))
+    {
+      return false;
+    }
+    p = p->prev_z;
+  }
+  while (n && n->z <= max_z)
+  {
+    if (earcut_blocks_ear(ear, n))
+    {
+      return false;
+    }
+    n = n->next_z;
+  }
+  return true;
+}
+
+// Triangles come out clockwise like everything else in here
+static inline void earcut_add_triangle(Earcut* earcut, EarcutNode* a, EarcutNode* b, EarcutNode* c)
+{
+  assert(earcut->triangle_count < earcut->triangle_capacity && "Too many triangles?");
+  earcut->triangles[earcut->triangle_count++] = Triangle(Vector2(c->x, c->y), Vector2(b->x, b->y), Vector2(a->x, a->y));
+}
+
+// Clips the small self intersections filtering can leave behind, abcd where ab and cd cross becomes the triangle abd
+static EarcutNode* earcut_cure_local_intersections(Earcut* earcut, EarcutNode* start)
+{
+  EarcutNode* p = start;
+  do
+  {
+    EarcutNode* a = p->prev;
+    EarcutNode* b = p->next->next;
+    if (!earcut_equals(a, b) && earcut_intersects(a, p, p->next, b) && earcut_locally_inside(a, b) && earcut_locally_inside(b, a))
+    {
+      earcut_add_triangle(earcut, a, p, b);
+      earcut_remove_node(p);
+      earcut_remove_node(p->next);
+      p = start = b;
+    }
+    p = p->next;
+  } while (p != start);
+
+  return earcut_filter_points(p, 0);
+}
+
+static void earcut_linked(Earcut* earcut, EarcutNode* ear, u32 pass);
+
+// Last resort, cut the ring along any valid diagonal and clip both halves
+static void earcut_split(Earcut* earcut, EarcutNode* start)
+{
+  EarcutNode* a = start;
+  do
+  {
+    for (EarcutNode* b = a->next->next; b != a->prev; b = b->next)
+    {
+      if (a->i != b->i && earcut_is_valid_diagonal(a, b))
+      {
+        EarcutNode* c = earcut_split_polygon(earcut, a, b);
+        a             = earcut_filter_points(a, a->next);
+        c             = earcut_filter_points(c, c->next);
+        earcut_linked(earcut, a, 0);
+        earcut_linked(earcut, c, 0);
+        return;
+      }
+    }
+    a = a->next;
+  } while (a != start);
+}
+
+static void earcut_linked(Earcut* earcut, EarcutNode* ear, u32 pass)
+{
+  if (!ear)
+  {
+    return;
+  }
+  if (pass == 0 && earcut->inv_size != 0)
+  {
+    earcut_index_curve(earcut, ear);
+  }
+
+  EarcutNode* stop = ear;
+  while (ear->prev != ear->next)
+  {
+    EarcutNode* prev = ear->prev;
+    EarcutNode* next = ear->next;
+
+    if (earcut->inv_size != 0 ? earcut_is_ear_hashed(earcut, ear) : earcut_is_ear(ear))
+    {
+      earcut_add_triangle(earcut, prev, ear, next);
+      earcut_remove_node(ear);
+      // skipping the next vertex leads to fewer sliver triangles
+      ear  = next->next;
+      stop = next->next;
+      continue;
+    }
+
+    ear = next;
+    if (ear == stop)
+    {
+      // went all the way around without an ear, clean up and try harder
+      if (pass == 0)
+      {
+        earcut_linked(earcut, earcut_filter_points(ear, 0), 1);
+      }
+      else if (pass == 1)
+      {
+        earcut_linked(earcut, earcut_cure_local_intersections(earcut, earcut_filter_points(ear, 0)), 2);
+      }
+      else
+      {
+        earcut_split(earcut, ear);
+      }
+      break;
+    }
+  }
+}
+
+static EarcutNode* earcut_get_leftmost(EarcutNode* start)
+{
+  EarcutNode* p        = start;
+  EarcutNode* leftmost = start;
+  do
+  {
+    if (p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y))
+    {
+      leftmost = p;
+    }
+    p = p->next;
+  } while (p != start);
+  return leftmost;
+}
+
+static inline bool earcut_sector_contains_sector(EarcutNode* m, EarcutNode* p)
+{
+  return earcut_area(m->prev, m, p->prev) < 0 && earcut_area(p->next, m, m->next) < 0;
+}
+
+// Closest outer vertex to the left of the hole's leftmost point that it can see
+static EarcutNode* earcut_find_hole_bridge(EarcutNode* hole, EarcutNode* outer)
+{
+  EarcutNode* p  = outer;
+  f32         hx = hole->x;
+  f32         hy = hole->y;
+  f32         qx = -FLT_MAX;
+  EarcutNode* m  = 0;
+
+  // the nearest segment crossed by a ray going left from the hole
+  do
+  {
+    if (hy <= p->y && hy >= p->next->y && p->next->y != p->y)
+    {
+      f32 x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+      if (x <= hx && x > qx)
+      {
+        qx = x;
+        m  = p->x < p->next->x ? p : p->next;
+        if (x == hx)
+        {
+          // touches the hole vertex
+          return m;
+        }
+      }
+    }
+    p = p->next;
+  } while (p != outer);
+
+  if (!m)
+  {
+    return 0;
+  }
+
+  // reflex vertices inside the triangle between the hole, the crossing and m would block that bridge,
+  // the one making the smallest angle with the ray is visible instead
+  EarcutNode* stop    = m;
+  f32         mx      = m->x;
+  f32         my      = m->y;
+  f32         tan_min = FLT_MAX;
+  p                   = m;
+  do
+  {
+    if (hx >= p->x && p->x >= mx && hx != p->x && earcut_point_in_triangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, p->x, p->y))
+    {
+      f32 tan = std::abs(hy - p->y) / (hx - p->x);
+      if (earcut_locally_inside(p, hole) && (tan < tan_min || (tan == tan_min && (p->x > m->x || (p->x == m->x && earcut_sector_contains_sector(m, p))))))
+      {
+        m       = p;
+        tan_min = tan;
+      }
+    }
+    p = p->next;
+  } while (p != stop);
+
+  return m;
+}
+
+static inline int sort_earcut_nodes_x(const void* _a, const void* _b)
+{
+  f32 res = (*(EarcutNode**)_a)->x - (*(EarcutNode**)_b)->x;
+  return res < 0 ? -1 : res > 0 ? 1 : 0;
+}
+
+static EarcutNode* earcut_eliminate_holes(Earcut* earcut, EarcutNode* outer, Vector2** v_points, u32* point_count, u32 polygon_count)
+{
+  EarcutNode* queue[polygon_count];
+  u32         queue_count = 0;
+  u32         start_index = point_count[0];
+  for (u32 i = 1; i < polygon_count; i++)
+  {
+    EarcutNode* list = earcut_linked_list(earcut, v_points[i], point_count[i], start_index, false);
+    start_index += point_count[i];
+    if (!list)
+    {
+      continue;
+    }
+    if (list == list->next)
+    {
+      list->steiner = true;
+    }
+    queue[queue_count++] = earcut_get_leftmost(list);
+  }
+  qsort(queue, queue_count, sizeof(EarcutNode*), sort_earcut_nodes_x);
+
+  for (u32 i = 0; i < queue_count; i++)
+  {
+    EarcutNode* bridge = earcut_find_hole_bridge(queue[i], outer);
+    if (!bridge)
+    {
+      continue;
+    }
+    EarcutNode* bridge_reverse = earcut_split_polygon(earcut, bridge, queue[i]);
+    earcut_filter_points(bridge_reverse, bridge_reverse->next);
+    outer = earcut_filter_points(bridge, bridge->next);
+  }
+  return outer;
+}
+
+// v_points[0] is the outer ring and the rest are holes inside it, any winding.
+// Allocates the triangles, at most the total point count + 2 per hole - 2 of them
+void triangulate_polygon_with_holes(Triangle** out, u32& out_count, Vector2** v_points, u32* point_count, u32 polygon_count)
+{
+  u32 total_count = 0;
+  for (u32 i = 0; i < polygon_count; i++)
+  {
+    total_count += point_count[i];
+  }
+
+  Earcut earcut            = {};
+  // every bridge and every split adds two nodes, there are never more splits than triangles
+  earcut.node_capacity     = total_count * 3 + polygon_count * 2;
+  earcut.nodes             = sta_allocate_struct(EarcutNode, earcut.node_capacity);
+  earcut.triangle_capacity = total_count + polygon_count * 2;
+  earcut.triangles         = sta_allocate_struct(Triangle, earcut.triangle_capacity);
+
+  EarcutNode* outer        = earcut_linked_list(&earcut, v_points[0], point_count[0], 0, true);
+  if (outer && outer->next != outer->prev)
+  {
+    if (polygon_count > 1)
+    {
+      outer = earcut_eliminate_holes(&earcut, outer, v_points, point_count, polygon_count);
+    }
+
+    if (total_count > EARCUT_HASH_THRESHOLD)
+    {
+      f32 min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
+      for (u32 i = 0; i < point_count[0]; i++)
+      {
+        min_x = MIN(min_x, v_points[0][i].x);
+        min_y = MIN(min_y, v_points[0][i].y);
+        max_x = MAX(max_x, v_points[0][i].x);
+        max_y = MAX(max_y, v_points[0][i].y);
+      }
+      // codes are 15 bits per axis
+      f32 size       = MAX(max_x - min_x, max_y - min_y);
+      earcut.min_x    = min_x;
+      earcut.min_y    = min_y;
+      earcut.inv_size = size != 0 ? 32767.0f / size : 0;
+    }
+
+    earcut_linked(&earcut, outer, 0);
+  }
+
+  sta_deallocate(earcut.nodes, sizeof(EarcutNode) * earcut.node_capacity);
+  *out      = earcut.triangles;
+  out_count = earcut.triangle_count;
+}
+
+void triangulate_simple_via_ear_clipping(Triangle** out, u32& out_count, Vector2* v_points, u32 point_count)
+{
+  triangulate_polygon_with_holes(out, out_count, &v_points, &point_count, 1);
+}
+
+#undef EARCUT_HASH_THRESHOLD
@@ -60,6 +60,7 @@ public:
 };
 
 void triangulate_simple_via_ear_clipping(Triangle** out, u32& out_count, Vector2* v_points, u32 point_count);
+void triangulate_polygon_with_holes(Triangle** out, u32& out_count, Vector2** v_points, u32* point_count, u32 polygon_count);
 void create_simple_polygon_from_polygon_with_holes(Vector2** vertices, u32& out_count, Vector2** v_points, u32* point_count, u32 polygon_count);
 void triangulate_earclipping(Triangle* triangles, u32& triangle_count, Vector2** v_points, u32* v_counts, u32 count, u32 number_of_triangles);
 
@@ -1,4 +1,5 @@
 #include "common.h"
+#include <csignal>
 #include <cstdarg>
 #include <cstdlib>
 /*
@@ -179,31 +180,127 @@ void sta_pool_init(PoolAllocator* pool, void* buffer, u64 chunk_size, u64 count)
  =========================================
 */
 
-Profiler      profiler;
-u32           globalProfilerParentIndex = 0;
-ProfileAnchor globalProfileAnchors[4096];
+Profiler                            profiler;
+ProfileAnchor                       globalProfileAnchors[4096];
+FrameProfiler                       frameProfiler;
+// Gives the thread's slot back when it exits, worker threads come and go with every WorkQueue
+struct ProfilerThreadSlot
+{
+  ProfilerThread* thread;
+  // every slot was taken when this thread came along, it isn't recorded
+  bool            full;
+  ~ProfilerThreadSlot()
+  {
+    if (thread)
+    {
+      __atomic_store_n(&thread->inUse, false, __ATOMIC_RELEASE);
+    }
+  }
+};
+static thread_local ProfilerThreadSlot localProfilerThread;
+
+// First call on a thread registers it, taking over the slot of a thread that exited if there is one.
+// Past PROFILER_MAX_THREADS live threads the rest return 0 and aren't recorded
+ProfilerThread* getProfilerThread()
+{
+  ProfilerThreadSlot* slot = &localProfilerThread;
+  if (!slot->thread && !slot->full)
+  {
+    u32 threadCount = MIN(__atomic_load_n(&frameProfiler.threadCount, __ATOMIC_ACQUIRE), PROFILER_MAX_THREADS);
+    for (u32 i = 0; i < threadCount && !slot->thread; i++)
+    {
+      ProfilerThread* thread = __atomic_load_n(&frameProfiler.threads[i], __ATOMIC_ACQUIRE);
+      bool            inUse  = false;
+      if (thread && __atomic_compare_exchange_n(&thread->inUse, &inUse, true, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+      {
+        thread->parentIndex = 0;
+        thread->depth       = 0;
+        thread->name        = "worker";
+        slot->thread        = thread;
+      }
+    }
+    if (!slot->thread)
+    {
+      u32 id = __atomic_fetch_add(&frameProfiler.threadCount, 1, __ATOMIC_ACQ_REL);
+      if (id >= PROFILER_MAX_THREADS)
+      {
+        slot->full = true;
+        return 0;
+      }
+      ProfilerThread* thread = sta_allocate_struct(ProfilerThread, 1);
+      thread->id             = id;
+      thread->name           = id == 0 ? "main" : "worker";
+      thread->inUse          = true;
+      __atomic_store_n(&frameProfiler.threads[id], thread, __ATOMIC_RELEASE);
+      slot->thread = thread;
+    }
+  }
+  return slot->thread;
+}
+
+void setProfilerThreadName(const char* name)
+{
+  ProfilerThread* thread = getProfilerThread();
+  if (thread)
+  {
+    thread->name = name;
+  }
+}
 
-void          initProfileBlock(ProfileBlock* block, char const* label_, u32 index_, u64 byteCount)
+void initProfileBlock(ProfileBlock* block, char const* label_, u32 index_, u64 byteCount)
 {
-  block->parentIndex         = globalProfilerParentIndex;
+  ProfilerThread* thread     = getProfilerThread();
+  if (!thread)
+  {
+    return;
+  }
+  block->parentIndex         = thread->parentIndex;
 
   block->index               = index_;
   block->label               = label_;
 
-  ProfileAnchor* profile     = globalProfileAnchors + block->index;
+  ProfileAnchor* profile     = thread->anchors + block->index;
   block->oldElapsedInclusive = profile->elapsedInclusive;
   profile->processedByteCount += byteCount;
 
-  globalProfilerParentIndex = block->index;
-  block->startTime          = ReadCPUTimer();
+  thread->depth++;
+  thread->parentIndex = block->index;
+  block->startTime    = ReadCPUTimer();
 }
 void exitProfileBlock(ProfileBlock* block)
 {
-  u64 elapsed               = ReadCPUTimer() - block->startTime;
-  globalProfilerParentIndex = block->parentIndex;
+  u64             end     = ReadCPUTimer();
+  u64             elapsed = end - block->startTime;
+  ProfilerThread* thread  = getProfilerThread();
+  if (!thread)
+  {
+    return;
+  }
+  thread->parentIndex = block->parentIndex;
+  thread->depth--;
 
-  ProfileAnchor* parent     = globalProfileAnchors + block->parentIndex;
-  ProfileAnchor* profile    = globalProfileAnchors + block->index;
+  if (__atomic_load_n(&frameProfiler.recording, __ATOMIC_RELAXED))
+  {
+    u32 write = thread->eventWrite;
+    u32 read  = __atomic_load_n(&thread->eventRead, __ATOMIC_ACQUIRE);
+    if (write - read < PROFILER_THREAD_EVENT_CAPACITY)
+    {
+      ProfileEvent* event = &thread->events[write % PROFILER_THREAD_EVENT_CAPACITY];
+      event->label        = block->label;
+      event->start        = block->startTime;
+      event->end          = end;
+      event->depth        = thread->depth;
+      event->threadId     = thread->id;
+      __atomic_store_n(&thread->eventWrite, write + 1, __ATOMIC_RELEASE);
+    }
+    else
+    {
+      __atomic_fetch_add(&thread->droppedEvents, 1, __ATOMIC_RELAXED);
+    }
+  }
+
+  ProfileAnchor* parent  = thread->anchors + block->parentIndex;
+  ProfileAnchor* profile = thread->anchors + block->index;
 
   parent->elapsedExclusive -= elapsed;
   profile->elapsedExclusive += elapsed;
@@ -283,7 +380,128 @@ u64 EstimateCPUTimerFreq(void)
 
 void initProfiler()
 {
-  profiler.StartTSC = ReadCPUTimer();
+  profiler.StartTSC     = ReadCPUTimer();
+  frameProfiler.cpuFreq = EstimateCPUTimerFreq();
+  setProfilerThreadName("main");
+}
+
+void beginProfileFrame()
+{
+  __atomic_store_n(&frameProfiler.recording, !frameProfiler.paused, __ATOMIC_RELAXED);
+  if (frameProfiler.paused)
+  {
+    return;
+  }
+  ProfileFrame* frame   = &frameProfiler.frames[frameProfiler.frameCount % PROFILER_FRAME_COUNT];
+  frame->eventCount     = 0;
+  frame->droppedEvents  = 0;
+  frame->end            = 0;
+  frameProfiler.inFrame = true;
+  frame->start          = ReadCPUTimer();
+}
+
+// Moves whatever each thread finished since the last frame into this frame
+static void mergeProfilerThreads(ProfileFrame* frame)
+{
+  u32 threadCount = MIN(__atomic_load_n(&frameProfiler.threadCount, __ATOMIC_ACQUIRE), PROFILER_MAX_THREADS);
+  for (u32 i = 0; i < threadCount; i++)
+  {
+    ProfilerThread* thread = __atomic_load_n(&frameProfiler.threads[i], __ATOMIC_ACQUIRE);
+    if (!thread)
+    {
+      continue;
+    }
+    u32 read  = thread->eventRead;
+    u32 write = __atomic_load_n(&thread->eventWrite, __ATOMIC_ACQUIRE);
+    for (; read != write; read++)
+    {
+      if (frame->eventCount < PROFILER_MAX_FRAME_EVENTS)
+      {
+        frame->events[frame->eventCount++] = thread->events[read % PROFILER_THREAD_EVENT_CAPACITY];
+      }
+      else
+      {
+        frame->droppedEvents++;
+      }
+    }
+    __atomic_store_n(&thread->eventRead, read, __ATOMIC_RELEASE);
+    frame->droppedEvents += __atomic_exchange_n(&thread->droppedEvents, 0, __ATOMIC_RELAXED);
+  }
+}
+
+void endProfileFrame()
+{
+  if (!frameProfiler.inFrame)
+  {
+    return;
+  }
+  ProfileFrame* frame = &frameProfiler.frames[frameProfiler.frameCount % PROFILER_FRAME_COUNT];
+  frame->end          = ReadCPUTimer();
+  mergeProfilerThreads(frame);
+  frameProfiler.inFrame = false;
+  frameProfiler.frameCount++;
+}
+
+u32 getProfiledFrameCount()
+{
+  return MIN(frameProfiler.frameCount, PROFILER_FRAME_COUNT - 1);
+}
+
+// 0 is the last finished frame
+ProfileFrame* getProfiledFrame(u32 framesAgo)
+{
+  assert(framesAgo < getProfiledFrameCount() && "Frame isn't in the ring buffer anymore!");
+  return &frameProfiler.frames[(frameProfiler.frameCount - 1 - framesAgo) % PROFILER_FRAME_COUNT];
+}
+
+f64 profilerCyclesToMs(u64 cycles)
+{
+  if (frameProfiler.cpuFreq == 0)
+  {
+    frameProfiler.cpuFreq = EstimateCPUTimerFreq();
+  }
+  return 1000.0 * (f64)cycles / (f64)frameProfiler.cpuFreq;
+}
+
+// Writes the last frameCount frames in the chrome://tracing / Perfetto trace_event format
+bool exportChromeTrace(const char* filename, u32 frameCount)
+{
+  frameCount = MIN(frameCount, getProfiledFrameCount());
+  if (frameCount == 0)
+  {
+    return false;
+  }
+  FILE* file = fopen(filename, "w");
+  if (!file)
+  {
+    return false;
+  }
+
+  u64 base = getProfiledFrame(frameCount - 1)->start;
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (u32 i = 0; i < MIN(frameProfiler.threadCount, PROFILER_MAX_THREADS); i++)
+  {
+    ProfilerThread* thread = frameProfiler.threads[i];
+    if (thread)
+    {
+      fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}},\n", thread->id, thread->name, thread->id);
+    }
+  }
+  for (i32 i = frameCount - 1; i >= 0; i--)
+  {
+    ProfileFrame* frame = getProfiledFrame(i);
+    fprintf(file, "{\"name\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"dropped\":%u}}", profilerCyclesToMs(frame->start - base) * 1000.0,
+            profilerCyclesToMs(frame->end - frame->start) * 1000.0, frame->droppedEvents);
+    for (u32 j = 0; j < frame->eventCount; j++)
+    {
+      ProfileEvent* event = &frame->events[j];
+      fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", event->label, event->threadId,
+              profilerCyclesToMs(event->start - base) * 1000.0, profilerCyclesToMs(event->end - event->start) * 1000.0);
+    }
+    fprintf(file, i > 0 ? ",\n" : "\n");
+  }
+  fprintf(file, "]}\n");
+  return fclose(file) == 0;
 }
 
 void displayProfilingResult()
@@ -292,6 +510,23 @@ void displayProfilingResult()
   u64 totalElapsed = endTime - profiler.StartTSC;
   u64 cpuFreq      = EstimateCPUTimerFreq();
 
+  // inclusive time of blocks that ran on several threads can add up to more than the wall time
+  memset(globalProfileAnchors, 0, sizeof(globalProfileAnchors));
+  for (u32 i = 0; i < MIN(frameProfiler.threadCount, PROFILER_MAX_THREADS); i++)
+  {
+    ProfilerThread* thread = frameProfiler.threads[i];
+    for (u32 j = 0; thread && j < ArrayCount(globalProfileAnchors); j++)
+    {
+      ProfileAnchor* from = thread->anchors + j;
+      ProfileAnchor* to   = globalProfileAnchors + j;
+      to->elapsedExclusive += from->elapsedExclusive;
+      to->elapsedInclusive += from->elapsedInclusive;
+      to->hitCount += from->hitCount;
+      to->processedByteCount += from->processedByteCount;
+      to->label = from->label ? from->label : to->label;
+    }
+  }
+
   printf("\nTotal time: %0.4fms (CPU freq %lu)\n", 1000.0 * (f64)totalElapsed / (f64)cpuFreq, cpuFreq);
   for (u32 i = 0; i < ArrayCount(globalProfileAnchors); i++)
   {
@@ -312,30 +547,330 @@ void displayProfilingResult()
  =========================================
 */
 
-inline void Logger::send_log_message(const char* msg, const char* color, va_list args)
+#define LOG_THREAD_SLEEP_NS 500000
+
+enum LogArgType
 {
-  char buffer[512];
-  vsnprintf(buffer, ArrayCount(buffer), msg, args);
-  fprintf(stderr, "%s%s\n", color, buffer);
-  if (this->file_ptr)
+  LOG_ARG_NONE,
+  LOG_ARG_INT,
+  LOG_ARG_LONG,
+  LOG_ARG_DOUBLE,
+  LOG_ARG_STRING,
+  LOG_ARG_POINTER,
+  LOG_ARG_UNSUPPORTED,
+};
+
+struct LogSpec
+{
+  u32        length;
+  u32        stars;
+  bool       star_precision;
+  i32        precision;
+  LogArgType type;
+};
+
+static bool is_log_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+// Parses the conversion starting at the '%', both the producer and the log thread walk the format with it
+static LogSpec parse_log_spec(const char* s)
+{
+  LogSpec spec   = {};
+  spec.precision = -1;
+  u32 i          = 1;
+  while (s[i] == '-' || s[i] == '+' || s[i] == ' ' || s[i] == '#' || s[i] == '0')
+  {
+    i++;
+  }
+  if (s[i] == '*')
+  {
+    spec.stars++;
+    i++;
+  }
+  while (is_log_digit(s[i]))
+  {
+    i++;
+  }
+  if (s[i] == '.')
   {
+    i++;
+    spec.precision = 0;
+    if (s[i] == '*')
+    {
+      spec.stars++;
+      spec.star_precision = true;
+      i++;
+    }
+    while (is_log_digit(s[i]))
+    {
+      spec.precision = spec.precision * 10 + s[i++] - '0';
+    }
+  }
 
-    fprintf(this->file_ptr, "%s\n", buffer);
+  bool wide        = false;
+  bool long_double = false;
+  while (s[i] == 'h' || s[i] == 'l' || s[i] == 'j' || s[i] == 'z' || s[i] == 't' || s[i] == 'L')
+  {
+    wide |= s[i] != 'h' && s[i] != 'L';
+    long_double |= s[i] == 'L';
+    i++;
+  }
+
+  char c = s[i];
+  if (c)
+  {
+    i++;
+  }
+  spec.length = i;
+  switch (c)
+  {
+  case 'd':
+  case 'i':
+  case 'u':
+  case 'x':
+  case 'X':
+  case 'o':
+  case 'c':
+  {
+    spec.type = wide ? LOG_ARG_LONG : LOG_ARG_INT;
+    break;
+  }
+  case 'f':
+  case 'F':
+  case 'e':
+  case 'E':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A':
+  {
+    spec.type = long_double ? LOG_ARG_UNSUPPORTED : LOG_ARG_DOUBLE;
+    break;
   }
+  case 's':
+  {
+    spec.type = wide ? LOG_ARG_UNSUPPORTED : LOG_ARG_STRING;
+    break;
+  }
+  case 'p':
+  {
+    spec.type = LOG_ARG_POINTER;
+    break;
+  }
+  case '%':
+  {
+    spec.type = LOG_ARG_NONE;
+    break;
+  }
+  default:
+  {
+    spec.type = LOG_ARG_UNSUPPORTED;
+  }
+  }
+  return spec;
 }
+
+// Returns false if the message doesn't fit in a record, the caller formats it up front instead
+static bool pack_log_record(LogRecord* record, const char* msg, va_list args)
+{
+  va_list copy;
+  va_copy(copy, args);
+  record->arg_count    = 0;
+  record->string_bytes = 0;
+  bool fits            = true;
+  for (const char* s = msg; *s && fits; s++)
+  {
+    if (*s != '%')
+    {
+      continue;
+    }
+    LogSpec spec = parse_log_spec(s);
+    s += spec.length - 1;
+    if (spec.type == LOG_ARG_UNSUPPORTED || record->arg_count + spec.stars + 1 > LOG_RECORD_MAX_ARGS)
+    {
+      fits = false;
+      break;
+    }
+
+    i32 precision = spec.precision;
+    for (u32 i = 0; i < spec.stars; i++)
+    {
+      i32 value                         = va_arg(copy, int);
+      record->args[record->arg_count++] = (u64)(i64)value;
+      precision                         = spec.star_precision && i == spec.stars - 1 ? value : precision;
+    }
+    switch (spec.type)
+    {
+    case LOG_ARG_INT:
+    {
+      record->args[record->arg_count++] = (u64)(i64)va_arg(copy, int);
+      break;
+    }
+    case LOG_ARG_LONG:
+    {
+      record->args[record->arg_count++] = va_arg(copy, unsigned long long);
+      break;
+    }
+    case LOG_ARG_DOUBLE:
+    {
+      f64 value = va_arg(copy, double);
+      memcpy(&record->args[record->arg_count++], &value, sizeof(f64));
+      break;
+    }
+    case LOG_ARG_POINTER:
+    {
+      record->args[record->arg_count++] = (u64)va_arg(copy, void*);
+      break;
+    }
+    case LOG_ARG_STRING:
+    {
+      const char* string = va_arg(copy, const char*);
+      string             = string ? string : "(null)";
+      u32 length         = precision >= 0 ? strnlen(string, precision) : strlen(string);
+      if (record->string_bytes + length + 1 > LOG_RECORD_STRING_BYTES)
+      {
+        fits = false;
+        break;
+      }
+      memcpy(&record->strings[record->string_bytes], string, length);
+      record->strings[record->string_bytes + length] = '\0';
+      record->args[record->arg_count++]              = record->string_bytes;
+      record->string_bytes += length + 1;
+      break;
+    }
+    default:
+    {
+      break;
+    }
+    }
+  }
+  va_end(copy);
+  return fits;
+}
+
+static u32 format_log_record(char* out, u32 capacity, LogRecord* record)
+{
+  if (!record->format)
+  {
+    return MIN(snprintf(out, capacity, "%s", record->strings), (i32)capacity - 1);
+  }
+
+  u32 length = 0;
+  u32 arg    = 0;
+  for (const char* s = record->format; *s && length + 1 < capacity;)
+  {
+    if (*s != '%')
+    {
+      out[length++] = *s++;
+      continue;
+    }
+    LogSpec spec = parse_log_spec(s);
+    if (spec.type == LOG_ARG_NONE)
+    {
+      out[length++] = '%';
+      s += spec.length;
+      continue;
+    }
+
+    // stars are replaced by the packed width/precision so every conversion takes a single argument
+    char spec_format[48];
+    u32  spec_length = 0;
+    for (u32 i = 0; i < spec.length && spec_length + 12 < ArrayCount(spec_format); i++)
+    {
+      if (s[i] == '*')
+      {
+        spec_length += snprintf(&spec_format[spec_length], ArrayCount(spec_format) - spec_length, "%d", (i32)record->args[arg++]);
+      }
+      else
+      {
+        spec_format[spec_length++] = s[i];
+      }
+    }
+    spec_format[spec_length] = '\0';
+    s += spec.length;
+
+    u64 value     = record->args[arg++];
+    u32 remaining = capacity - length;
+    i32 written   = 0;
+    switch (spec.type)
+    {
+    case LOG_ARG_INT:
+    {
+      written = snprintf(&out[length], remaining, spec_format, (i32)value);
+      break;
+    }
+    case LOG_ARG_LONG:
+    {
+      written = snprintf(&out[length], remaining, spec_format, (unsigned long long)value);
+      break;
+    }
+    case LOG_ARG_DOUBLE:
+    {
+      f64 d;
+      memcpy(&d, &value, sizeof(f64));
+      written = snprintf(&out[length], remaining, spec_format, d);
+      break;
+    }
+    case LOG_ARG_STRING:
+    {
+      written = snprintf(&out[length], remaining, spec_format, &record->strings[value]);
+      break;
+    }
+    case LOG_ARG_POINTER:
+    {
+      written = snprintf(&out[length], remaining, spec_format, (void*)value);
+      break;
+    }
+    default:
+    {
+      break;
+    }
+    }
+    length += CLAMP(written, 0, (i32)remaining - 1);
+  }
+  out[length] = '\0';
+  return length;
+}
+
+static const char* get_logging_level_color(LoggingLevel level)
+{
+  const char* levels[LOGGING_LEVEL_COUNT] = {
+      ANSI_COLOR_GREEN,
+      ANSI_COLOR_YELLOW,
+      ANSI_COLOR_RED,
+  };
+  assert(LOGGING_LEVEL_COUNT == 3 && "Need to fill in the color for the logging level!");
+  return levels[level];
+}
+
+void Logger::write_log_message(LoggingLevel level, const char* msg)
+{
+  fprintf(stderr, "%s%s\n" ANSI_COLOR_RESET, get_logging_level_color(level), msg);
+  if (this->file_ptr)
+  {
+    fprintf(this->file_ptr, "%s\n", msg);
+  }
+}
+
 void Logger::info(const char* msg, ...)
 {
+#if LOGGING_COMPILE_LEVEL <= 0
   va_list args;
   va_start(args, msg);
   this->log(LOGGING_LEVEL_INFO, msg, args);
   va_end(args);
+#endif
 }
 void Logger::warning(const char* msg, ...)
 {
+#if LOGGING_COMPILE_LEVEL <= 1
   va_list args;
   va_start(args, msg);
   this->log(LOGGING_LEVEL_WARNING, msg, args);
   va_end(args);
+#endif
 }
 void Logger::error(const char* msg, ...)
 {
@@ -356,17 +891,79 @@ bool Logger::destroy_log_to_file()
 {
   return fclose(this->file_ptr);
 }
+
+bool parse_logging_level(LoggingLevel* level, const char* name)
+{
+  const char* names[LOGGING_LEVEL_COUNT] = {"info", "warning", "error"};
+  for (u32 i = 0; i < LOGGING_LEVEL_COUNT; i++)
+  {
+    if (compare_strings(name, names[i]))
+    {
+      *level = (LoggingLevel)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Until start_async the message is formatted and written on the calling thread,
+// after it the caller only claims a record and copies its arguments
 void Logger::log(LoggingLevel level, const char* msg, va_list args)
 {
-  const char* levels[LOGGING_LEVEL_COUNT] = {
-      ANSI_COLOR_GREEN,
-      ANSI_COLOR_YELLOW,
-      ANSI_COLOR_RED,
-  };
-  assert(LOGGING_LEVEL_COUNT == 3 && "Need to fill in the color for the logging level!");
-  this->send_log_message(msg, levels[level], args);
-  fprintf(stderr, ANSI_COLOR_RESET);
+  if (level < this->level)
+  {
+    return;
+  }
+  if (!__atomic_load_n(&this->async, __ATOMIC_ACQUIRE))
+  {
+    char buffer[512];
+    vsnprintf(buffer, ArrayCount(buffer), msg, args);
+    this->write_log_message(level, buffer);
+    return;
+  }
+
+  LogRing*   ring     = this->ring;
+  u64        position = __atomic_load_n(&ring->write, __ATOMIC_RELAXED);
+  LogRecord* record;
+  while (true)
+  {
+    record       = &ring->records[position % LOG_RING_CAPACITY];
+    u64 sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+    i64 diff     = (i64)(sequence - position);
+    if (diff == 0)
+    {
+      if (__atomic_compare_exchange_n(&ring->write, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      // the log thread hasn't gotten to this record yet, only errors are worth waiting for
+      if (level != LOGGING_LEVEL_ERROR)
+      {
+        __atomic_fetch_add(&this->dropped, 1, __ATOMIC_RELAXED);
+        return;
+      }
+      sta_sleep_ns(LOG_THREAD_SLEEP_NS / 10);
+      position = __atomic_load_n(&ring->write, __ATOMIC_RELAXED);
+    }
+    else
+    {
+      position = __atomic_load_n(&ring->write, __ATOMIC_RELAXED);
+    }
+  }
+
+  record->level  = level;
+  record->format = msg;
+  if (!pack_log_record(record, msg, args))
+  {
+    record->format = 0;
+    vsnprintf(record->strings, LOG_RECORD_STRING_BYTES, msg, args);
+  }
+  __atomic_store_n(&record->sequence, position + 1, __ATOMIC_RELEASE);
 }
+
 void Logger::log(LoggingLevel level, const char* msg, ...)
 {
   va_list args;
@@ -375,6 +972,146 @@ void Logger::log(LoggingLevel level, const char* msg, ...)
   va_end(args);
 }
 
+// Only called from the log thread, every record that is ready gets written with a single write to stderr
+u32 Logger::drain()
+{
+  LogRing* ring = this->ring;
+  char     batch[8192];
+  u32      batch_length = 0;
+  u32      count        = 0;
+
+  u64      dropped      = __atomic_load_n(&this->dropped, __ATOMIC_RELAXED);
+  if (dropped != this->reported_dropped)
+  {
+    batch_length += snprintf(batch, ArrayCount(batch), ANSI_COLOR_YELLOW "Dropped %lu log messages, the log ring was full\n" ANSI_COLOR_RESET, dropped - this->reported_dropped);
+    this->reported_dropped = dropped;
+  }
+
+  u64 position = ring->read;
+  while (true)
+  {
+    LogRecord* record = &ring->records[position % LOG_RING_CAPACITY];
+    if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) != position + 1)
+    {
+      break;
+    }
+    char message[512];
+    u32  length = format_log_record(message, ArrayCount(message), record);
+    if (this->file_ptr)
+    {
+      fprintf(this->file_ptr, "%s\n", message);
+    }
+
+    const char* color = get_logging_level_color((LoggingLevel)record->level);
+    u32         size  = strlen(color) + length + 1 + strlen(ANSI_COLOR_RESET);
+    if (batch_length + size > ArrayCount(batch))
+    {
+      fwrite(batch, 1, batch_length, stderr);
+      batch_length = 0;
+    }
+    batch_length += snprintf(&batch[batch_length], ArrayCount(batch) - batch_length, "%s%s\n" ANSI_COLOR_RESET, color, message);
+
+    __atomic_store_n(&record->sequence, position + LOG_RING_CAPACITY, __ATOMIC_RELEASE);
+    position++;
+    count++;
+  }
+  if (batch_length)
+  {
+    fwrite(batch, 1, batch_length, stderr);
+  }
+  __atomic_store_n(&ring->read, position, __ATOMIC_RELEASE);
+  return count;
+}
+
+static void* run_log_thread(void* data)
+{
+  Logger* logger = (Logger*)data;
+  while (__atomic_load_n(&logger->running, __ATOMIC_ACQUIRE))
+  {
+    if (logger->drain() == 0)
+    {
+      sta_sleep_ns(LOG_THREAD_SLEEP_NS);
+    }
+  }
+  logger->drain();
+  return 0;
+}
+
+static Logger* async_logger = 0;
+
+static void stop_async_logger()
+{
+  async_logger->stop_async();
+}
+
+// Give the log thread a chance to write whatever came before the failed assert
+static void flush_logger_on_abort(int signal_number)
+{
+  async_logger->flush();
+  signal(signal_number, SIG_DFL);
+}
+
+bool Logger::start_async()
+{
+  if (this->async)
+  {
+    return true;
+  }
+  if (!this->ring)
+  {
+    this->ring = sta_allocate_struct(LogRing, 1);
+  }
+  this->ring->write = 0;
+  this->ring->read  = 0;
+  for (u32 i = 0; i < LOG_RING_CAPACITY; i++)
+  {
+    this->ring->records[i].sequence = i;
+  }
+  this->running = true;
+  if (!sta_create_thread(&this->thread, run_log_thread, this))
+  {
+    this->running = false;
+    this->error("Failed to start the log thread, logging stays synchronous");
+    return false;
+  }
+  __atomic_store_n(&this->async, true, __ATOMIC_RELEASE);
+
+  if (!async_logger)
+  {
+    atexit(stop_async_logger);
+    signal(SIGABRT, flush_logger_on_abort);
+  }
+  async_logger = this;
+  return true;
+}
+
+// Messages from other threads that race with the stop can be lost
+void Logger::stop_async()
+{
+  if (!this->async)
+  {
+    return;
+  }
+  __atomic_store_n(&this->async, false, __ATOMIC_RELEASE);
+  __atomic_store_n(&this->running, false, __ATOMIC_RELEASE);
+  sta_join_thread(this->thread);
+}
+
+// Waits for the log thread to write everything logged before the call, gives up after a second
+void Logger::flush()
+{
+  if (!__atomic_load_n(&this->async, __ATOMIC_ACQUIRE))
+  {
+    return;
+  }
+  u64 target   = __atomic_load_n(&this->ring->write, __ATOMIC_ACQUIRE);
+  u64 deadline = sta_read_monotonic_ns() + 1000000000ull;
+  while ((i64)(__atomic_load_n(&this->ring->read, __ATOMIC_ACQUIRE) - target) < 0 && sta_read_monotonic_ns() < deadline)
+  {
+    sta_sleep_ns(LOG_THREAD_SLEEP_NS / 10);
+  }
+}
+
 bool compare_float(f32 a, f32 b)
 {
   const float EPSILON = 0.00001f;
@@ -401,3 +1138,34 @@ double random_double_range(double min, double max)
 {
   return min + (max - min) * random_double();
 }
+
+void Random::seed(u64 seed)
+{
+  u64 z = seed + 0x9E3779B97F4A7C15ull;
+  z     = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z     = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  z     = z ^ (z >> 31);
+  // xorshift gets stuck at 0
+  this->state = z ? z : 0x9E3779B97F4A7C15ull;
+}
+
+u64 Random::next_u64()
+{
+  u64 x = this->state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  this->state = x;
+  return x * 0x2545F4914F6CDD1Dull;
+}
+
+f64 Random::next_double()
+{
+  // top 53 bits -> [0, 1)
+  return (this->next_u64() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+f64 Random::range(f64 min, f64 max)
+{
+  return min + (max - min) * this->next_double();
+}
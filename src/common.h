@@ -133,8 +133,8 @@ struct ProfileAnchor
 };
 typedef struct ProfileAnchor ProfileAnchor;
 
+// Merged from every thread by displayProfilingResult
 extern ProfileAnchor         globalProfileAnchors[4096];
-extern u32                   globalProfilerParentIndex;
 
 struct ProfileBlock
 {
@@ -150,20 +150,91 @@ void                        exitProfileBlock(ProfileBlock* block);
 
 #define NameConcat2(A, B) A##B
 #define NameConcat(A, B)  NameConcat2(A, B)
-#define TimeBandwidth(Name, ByteCount)                                                                                                                                                                 \
+#define TimeLabeledBandwidth(Name, Label, ByteCount)                                                                                                                                                   \
   ProfileBlock Name;                                                                                                                                                                                   \
-  initProfileBlock(&Name, "Name", __COUNTER__ + 1, ByteCount);
-#define ExitBlock(Name)              exitProfileBlock(&Name)
-#define TimeBlock(Name)              TimeBandwidth(Name, 0)
-#define ProfilerEndOfCompilationUnit static_assert(__COUNTER__ < ArrayCount(GlobalProfilerAnchors), "Number of profile points exceeds size of profiler::Anchors array")
-#define TimeFunction                 TimeBlock(__func__)
+  initProfileBlock(&Name, Label, __COUNTER__ + 1, ByteCount);
+#define TimeBandwidth(Name, ByteCount) TimeLabeledBandwidth(Name, #Name, ByteCount)
+#define ExitBlock(Name)                exitProfileBlock(&Name)
+#define TimeBlock(Name)                TimeBandwidth(Name, 0)
+#define ProfilerEndOfCompilationUnit   static_assert(__COUNTER__ < ArrayCount(globalProfileAnchors), "Number of profile points exceeds size of profiler::Anchors array")
+// Needs ExitFunction before every return
+#define TimeFunction                   TimeLabeledBandwidth(functionBlock, __func__, 0)
+#define ExitFunction                   ExitBlock(functionBlock)
 
 #else
 
+#define TimeBandwidth(Name, ByteCount)
 #define TimeBlock(blockName)
+#define ExitBlock(blockName)
 #define TimeFunction
+#define ExitFunction
 #endif
 
+// Every exited block is also stored as an event in the current frame, the last PROFILER_FRAME_COUNT frames are kept
+#define PROFILER_FRAME_COUNT           128
+#define PROFILER_MAX_FRAME_EVENTS      1024
+#define PROFILER_MAX_THREADS           16
+#define PROFILER_THREAD_EVENT_CAPACITY 4096
+
+struct ProfileEvent
+{
+  char const* label;
+  u64         start;
+  u64         end;
+  u32         depth;
+  u32         threadId;
+};
+
+// Owned by one thread, only the single producer/consumer ring is touched by the main thread
+struct ProfilerThread
+{
+  ProfileAnchor anchors[4096];
+  u32           parentIndex;
+  u32           depth;
+  u32           id;
+  const char*   name;
+  // cleared when the thread exits, the next new thread takes the slot over
+  bool          inUse;
+
+  ProfileEvent  events[PROFILER_THREAD_EVENT_CAPACITY];
+  u32           eventWrite;
+  u32           eventRead;
+  u32           droppedEvents;
+};
+
+struct ProfileFrame
+{
+  u64          start;
+  u64          end;
+  u32          eventCount;
+  u32          droppedEvents;
+  ProfileEvent events[PROFILER_MAX_FRAME_EVENTS];
+};
+
+struct FrameProfiler
+{
+  ProfileFrame    frames[PROFILER_FRAME_COUNT];
+  // total number of frames ended, frames[frameCount % PROFILER_FRAME_COUNT] is the one being recorded
+  u64             frameCount;
+  // set while frames are being recorded, threads drop their events otherwise
+  bool            recording;
+  bool            inFrame;
+  bool            paused;
+  u64             cpuFreq;
+  ProfilerThread* threads[PROFILER_MAX_THREADS];
+  u32             threadCount;
+};
+
+extern FrameProfiler frameProfiler;
+ProfilerThread*      getProfilerThread();
+void                 setProfilerThreadName(const char* name);
+void                 beginProfileFrame();
+void                 endProfileFrame();
+u32                  getProfiledFrameCount();
+ProfileFrame*        getProfiledFrame(u32 framesAgo);
+f64                  profilerCyclesToMs(u64 cycles);
+bool                 exportChromeTrace(const char* filename, u32 frameCount);
+
 enum LoggingLevel
 {
   LOGGING_LEVEL_INFO,
@@ -173,9 +244,49 @@ enum LoggingLevel
 };
 typedef enum LoggingLevel LoggingLevel;
 
+// Levels below this are compiled out of Logger::info/warning, 0 info, 1 warning, 2 error
+#ifndef LOGGING_COMPILE_LEVEL
+#define LOGGING_COMPILE_LEVEL 0
+#endif
+
+#define LOG_RING_CAPACITY       1024
+#define LOG_RECORD_MAX_ARGS     10
+#define LOG_RECORD_STRING_BYTES 408
+
+// Arguments are packed as raw 64 bit values and formatted later by the log thread,
+// %s arguments are copied into strings since the caller's buffer might not live that long.
+// A null format means strings already holds the formatted message
+struct LogRecord
+{
+  u64         sequence;
+  const char* format;
+  u8          level;
+  u8          arg_count;
+  u16         string_bytes;
+  u64         args[LOG_RECORD_MAX_ARGS];
+  char        strings[LOG_RECORD_STRING_BYTES];
+};
+
+// Bounded multi producer queue, every record carries the position it is ready for so writers
+// only contend on the write index and the single reader never takes a lock
+struct LogRing
+{
+  LogRecord    records[LOG_RING_CAPACITY];
+  alignas(64) u64 write;
+  alignas(64) u64 read;
+};
+
 struct Logger
 {
-  FILE* file_ptr;
+  FILE*         file_ptr;
+  LoggingLevel  level;
+  LogRing*      ring;
+  bool          async;
+  bool          running;
+  unsigned long thread;
+  // messages lost because the ring was full
+  u64           dropped;
+  u64           reported_dropped;
 
 public:
   Logger()
@@ -183,16 +294,21 @@ public:
   }
   bool init_log_to_file(const char* filename);
   bool destroy_log_to_file();
+  bool start_async();
+  void stop_async();
+  void flush();
   void log(LoggingLevel level, const char* msg, ...);
   void info(const char* msg, ...);
   void warning(const char* msg, ...);
   void error(const char* msg, ...);
   void log(LoggingLevel level, const char* msg, va_list args);
+  u32  drain();
 
 private:
-  inline void send_log_message(const char* msg, const char* color, va_list args);
+  void write_log_message(LoggingLevel level, const char* msg);
 };
 typedef struct Logger Logger;
+bool parse_logging_level(LoggingLevel* level, const char* name);
 
 struct StringArray
 {
@@ -233,4 +349,16 @@ u32 sta_hash_string_fnv(String* s);
 double random_double();
 double random_double_range(double min, double max);;
 
+// xorshift64* seeded through splitmix64, same seed gives the same sequence on every platform
+struct Random
+{
+  u64 state;
+
+public:
+  void seed(u64 seed);
+  u64  next_u64();
+  f64  next_double();
+  f64  range(f64 min, f64 max);
+};
+
 #endif
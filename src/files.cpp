@@ -35,26 +35,158 @@ char* Buffer::parse_string()
 
   return s;
 }
-int Buffer::parse_int()
+/*
+  Numeric tokens are scanned 8 bytes at a time whenever the whole word is inside the buffer,
+  buffers without a length (Buffer(char*)) always take the byte at a time path
+*/
+
+// index of the first byte in chunk that isn't '0'-'9', 8 if they all are.
+// Borrows and carries only move towards later bytes so the first flagged byte is always exact
+static inline u32 count_leading_digits_swar(u64 chunk)
 {
-  if (this->is_out_of_bounds())
+  u64 t          = chunk - 0x3030303030303030ull;
+  u64 non_digits = ((t + 0x7676767676767676ull) | t) & 0x8080808080808080ull;
+  return non_digits ? __builtin_ctzll(non_digits) >> 3 : 8;
+}
+
+// the 8 ascii digits in chunk as a number, the first digit is the lowest byte
+static inline u32 parse_eight_digits_swar(u64 chunk)
+{
+  chunk -= 0x3030303030303030ull;
+  chunk = (chunk * 10) + (chunk >> 8);
+  chunk = (((chunk & 0x000000FF000000FFull) * 0x000F424000000064ull) + (((chunk >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull)) >> 32;
+  return (u32)chunk;
+}
+
+// 0x80 in every byte of v that is zero, no false positives
+static inline u64 zero_bytes_swar(u64 v)
+{
+  return ~(((v & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full) | v | 0x7F7F7F7F7F7F7F7Full);
+}
+
+static inline bool is_digit_char(char c)
+{
+  return (u8)(c - '0') < 10;
+}
+
+static inline bool is_whitespace_char(char c)
+{
+  return c == ' ' || c == '\n' || c == '\t';
+}
+
+static const u64 powers_of_ten_u64[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+// Every power here is exact as a double
+static const f64 powers_of_ten_f64[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Accumulates a run of digits into value, returns how many there were
+static inline u32 parse_digits(Buffer* buffer, u64* value)
+{
+  u32 count = 0;
+  while (buffer->index + 8 <= buffer->len)
   {
-    assert(0 && "Out of bounds!");
+    u64 chunk;
+    memcpy(&chunk, buffer->current_address(), sizeof(u64));
+    u32 digits = count_leading_digits_swar(chunk);
+    if (digits == 0)
+    {
+      return count;
+    }
+    if (digits < 8)
+    {
+      // pad the front with '0' so the 8 digit kernel can be reused
+      chunk = (chunk << (8 * (8 - digits))) | (0x3030303030303030ull >> (8 * digits));
+    }
+    *value = *value * powers_of_ten_u64[digits] + parse_eight_digits_swar(chunk);
+    count += digits;
+    buffer->index += digits;
+    if (digits < 8)
+    {
+      return count;
+    }
   }
+  while (is_digit_char(buffer->current_char()))
+  {
+    *value = *value * 10 + (buffer->current_char() - '0');
+    count++;
+    buffer->advance();
+  }
+  return count;
+}
+
+static inline i32 parse_int_token(Buffer* buffer)
+{
   bool sign = false;
-  if (this->current_char() == '-')
+  if (buffer->current_char() == '-')
   {
-    this->advance();
+    buffer->advance();
     sign = true;
   }
   u64 value = 0;
-  while (isdigit(this->current_char()))
+  (void)parse_digits(buffer, &value);
+  return sign ? -value : value;
+}
+
+// The digits are gathered into an integer mantissa and a base 10 exponent. When both fit
+// a double exactly a single multiply/divide by a power of ten is correctly rounded, and
+// since a double has more than 2 * 24 + 2 bits rounding that again to a float is as well.
+// Anything else (more than 19 digits or a large exponent) goes through strtof
+static float parse_float_token(Buffer* buffer)
+{
+  u64  start = buffer->index;
+  bool sign  = false;
+  if (buffer->current_char() == '-')
   {
-    value *= 10;
-    value += this->current_char() - '0';
-    this->advance();
+    buffer->advance();
+    sign = true;
   }
-  return sign ? -value : value;
+
+  u64 mantissa    = 0;
+  u32 digit_count = parse_digits(buffer, &mantissa);
+  i64 exponent    = 0;
+  if (buffer->current_char() == '.')
+  {
+    buffer->advance();
+    u32 fraction_digits = parse_digits(buffer, &mantissa);
+    digit_count += fraction_digits;
+    exponent -= fraction_digits;
+  }
+
+  if (buffer->current_char() == 'e' || buffer->current_char() == 'E')
+  {
+    buffer->advance();
+    bool sign_exp = false;
+    if (buffer->current_char() == '-' || buffer->current_char() == '+')
+    {
+      sign_exp = buffer->current_char() == '-';
+      buffer->advance();
+    }
+    u64 exp = 0;
+    while (is_digit_char(buffer->current_char()))
+    {
+      exp = MIN(exp * 10 + (buffer->current_char() - '0'), 100000);
+      buffer->advance();
+    }
+    exponent += sign_exp ? -(i64)exp : (i64)exp;
+  }
+
+  if (digit_count <= 19 && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)
+  {
+    f64 value = (f64)mantissa;
+    value     = exponent < 0 ? value / powers_of_ten_f64[-exponent] : value * powers_of_ten_f64[exponent];
+    return sign ? -(f32)value : (f32)value;
+  }
+  return strtof(&buffer->buffer[start], 0);
+}
+
+int Buffer::parse_int()
+{
+  if (this->is_out_of_bounds())
+  {
+    assert(0 && "Out of bounds!");
+  }
+  return parse_int_token(this);
 }
 
 int parse_int_from_string(const char* s)
@@ -71,20 +203,7 @@ int parse_int_from_string(Buffer* buffer)
   {
     assert(0 && "Out of bounds!");
   }
-  bool sign = false;
-  if (CURRENT_CHAR(buffer) == '-')
-  {
-    ADVANCE(buffer);
-    sign = true;
-  }
-  u64 value = 0;
-  while (isdigit(CURRENT_CHAR(buffer)))
-  {
-    value *= 10;
-    value += CURRENT_CHAR(buffer) - '0';
-    ADVANCE(buffer);
-  }
-  return sign ? -value : value;
+  return parse_int_token(buffer);
 }
 void Buffer::parse_float_array(f32* array, u64 count)
 {
@@ -153,63 +272,7 @@ void Buffer::parse_vector3_array(Vector3* array, u64 count)
 
 float Buffer::parse_float()
 {
-  bool sign = false;
-  if (this->current_char() == '-')
-  {
-    this->advance();
-    sign = true;
-  }
-  float value = 0;
-  while (isdigit(this->current_char()))
-  {
-    value *= 10;
-    value += this->current_char() - '0';
-    this->advance();
-  }
-
-  float decimal       = 0.0f;
-  int   decimal_count = 0;
-  if (this->current_char() == '.')
-  {
-    this->advance();
-    while (isdigit(this->current_char()))
-    {
-      decimal_count++;
-      decimal += (this->current_char() - '0') / pow(10, decimal_count);
-      this->advance();
-    }
-  }
-
-  value += decimal;
-  if (this->current_char() == 'e' || this->current_char() == 'E')
-  {
-    this->advance();
-    bool sign_exp = false;
-    if (this->current_char() == '-')
-    {
-      this->advance();
-      sign_exp = true;
-    }
-    u32 exp = (this->current_char() - '0');
-    this->advance();
-    while (isdigit(this->current_char()))
-    {
-      exp *= 10;
-      exp += this->current_char() - '0';
-      this->advance();
-    }
-
-    if (sign_exp)
-    {
-      value /= pow(10, exp);
-    }
-    else
-    {
-      value *= pow(10, exp);
-    }
-  }
-
-  return sign ? -value : value;
+  return parse_float_token(this);
 }
 float parse_float_from_string(char* s)
 {
@@ -218,63 +281,7 @@ float parse_float_from_string(char* s)
 }
 float parse_float_from_string(Buffer* buffer)
 {
-  bool sign = false;
-  if (CURRENT_CHAR(buffer) == '-')
-  {
-    ADVANCE(buffer);
-    sign = true;
-  }
-  float value = 0;
-  while (isdigit(CURRENT_CHAR(buffer)))
-  {
-    value *= 10;
-    value += CURRENT_CHAR(buffer) - '0';
-    ADVANCE(buffer);
-  }
-
-  float decimal       = 0.0f;
-  int   decimal_count = 0;
-  if (CURRENT_CHAR(buffer) == '.')
-  {
-    ADVANCE(buffer);
-    while (isdigit(CURRENT_CHAR(buffer)))
-    {
-      decimal_count++;
-      decimal += (CURRENT_CHAR(buffer) - '0') / pow(10, decimal_count);
-      ADVANCE(buffer);
-    }
-  }
-
-  value += decimal;
-  if (CURRENT_CHAR(buffer) == 'e' || CURRENT_CHAR(buffer) == 'E')
-  {
-    ADVANCE(buffer);
-    bool sign_exp = false;
-    if (CURRENT_CHAR(buffer) == '-')
-    {
-      ADVANCE(buffer);
-      sign_exp = true;
-    }
-    u32 exp = (CURRENT_CHAR(buffer) - '0');
-    ADVANCE(buffer);
-    while (isdigit(CURRENT_CHAR(buffer)))
-    {
-      exp *= 10;
-      exp += CURRENT_CHAR(buffer) - '0';
-      ADVANCE(buffer);
-    }
-
-    if (sign_exp)
-    {
-      value /= pow(10, exp);
-    }
-    else
-    {
-      value *= pow(10, exp);
-    }
-  }
-
-  return sign ? -value : value;
+  return parse_float_token(buffer);
 }
 
 bool match(Buffer* buffer, char target)
@@ -292,15 +299,32 @@ bool consume(Buffer* buffer, char target)
 }
 void Buffer::skip_whitespace()
 {
-  while (!this->is_out_of_bounds() && (this->match(' ') || this->match('\n') || this->match('\t')))
-  {
-    this->advance();
-  }
+  ::skip_whitespace(this);
 }
 
+// Most runs are a single separator so the first byte is checked on its own,
+// longer ones (indentation, blank lines) are skipped 8 bytes at a time
 void skip_whitespace(Buffer* buffer)
 {
-  SKIP(buffer, !buffer->is_out_of_bounds() && (match(buffer, ' ') || match(buffer, '\n') || match(buffer, '\t')));
+  if (buffer->is_out_of_bounds() || !is_whitespace_char(buffer->current_char()))
+  {
+    return;
+  }
+  buffer->advance();
+  while (buffer->index + 8 <= buffer->len)
+  {
+    u64 chunk;
+    memcpy(&chunk, buffer->current_address(), sizeof(u64));
+    u64 whitespace = zero_bytes_swar(chunk ^ 0x2020202020202020ull) | zero_bytes_swar(chunk ^ 0x0A0A0A0A0A0A0A0Aull) | zero_bytes_swar(chunk ^ 0x0909090909090909ull);
+    u64 other      = ~whitespace & 0x8080808080808080ull;
+    if (other)
+    {
+      buffer->index += __builtin_ctzll(other) >> 3;
+      return;
+    }
+    buffer->index += 8;
+  }
+  SKIP(buffer, !buffer->is_out_of_bounds() && is_whitespace_char(buffer->current_char()));
 }
 
 void sta_targa_save_to_file(TargaImage* image, const char* filename)
@@ -451,175 +475,571 @@ bool sta_read_file(Arena* arena, Buffer* string, const char* fileName)
     sta_arena_pop(arena, fileSize + 1);
     return false;
   }
-
-  return true;
+
+  return true;
+}
+bool sta_map_file(Buffer* buffer, const char* filename)
+{
+  u64   size;
+  void* memory = sta_map_file_memory(filename, (unsigned long long*)&size);
+  if (!memory)
+  {
+    return false;
+  }
+  buffer->buffer = (char*)memory;
+  buffer->len    = size;
+  buffer->index  = 0;
+  return true;
+}
+
+void sta_unmap_file(Buffer* buffer)
+{
+  sta_unmap_file_memory(buffer->buffer, buffer->len);
+  buffer->buffer = 0;
+  buffer->len    = 0;
+  buffer->index  = 0;
+}
+
+// Targa stores pixels as BGR(A), these write RGBA straight into the image
+
+static inline u32 targa_bgr_to_rgba(const u8* bgr)
+{
+  return (u32)bgr[2] | ((u32)bgr[1] << 8) | ((u32)bgr[0] << 16) | 0xFF000000;
+}
+
+static inline u32 targa_bgra_to_rgba(u32 bgra)
+{
+  return (bgra & 0xFF00FF00) | ((bgra >> 16) & 0xFF) | ((bgra & 0xFF) << 16);
+}
+
+// Reads a 4 byte word per pixel so all but the last one skip the byte by byte loads
+static void targa_expand_bgr(u32* output, const u8* input, u64 count)
+{
+  u64 i = 0;
+  for (; i + 1 < count; i++)
+  {
+    u32 word;
+    memcpy(&word, &input[i * 3], sizeof(u32));
+    output[i] = ((word >> 16) & 0xFF) | (word & 0xFF00) | ((word & 0xFF) << 16) | 0xFF000000;
+  }
+  for (; i < count; i++)
+  {
+    output[i] = targa_bgr_to_rgba(&input[i * 3]);
+  }
+}
+
+static void targa_expand_bgra(u32* output, const u8* input, u64 count)
+{
+  for (u64 i = 0; i < count; i++)
+  {
+    u32 word;
+    memcpy(&word, &input[i * 4], sizeof(u32));
+    output[i] = targa_bgra_to_rgba(word);
+  }
+}
+
+static inline void targa_fill(u32* output, u32 pixel, u64 count)
+{
+  for (u64 i = 0; i < count; i++)
+  {
+    output[i] = pixel;
+  }
+}
+
+// Packets are clamped to the image so a broken run can't write past it, running out of input fails instead
+static bool targa_decode_rle(u32* output, u64 pixel_count, Buffer* file, u32 bytes_per_pixel)
+{
+  const u8* input   = (const u8*)file->buffer;
+  u64       index   = file->index;
+  u64       length  = file->len;
+  u64       written = 0;
+  while (written < pixel_count)
+  {
+    if (index >= length)
+    {
+      return false;
+    }
+    u8  header = input[index++];
+    u64 count  = MIN((u64)(header & 0x7F) + 1, pixel_count - written);
+    if (header & 0x80)
+    {
+      if (index + bytes_per_pixel > length)
+      {
+        return false;
+      }
+      u32 pixel;
+      if (bytes_per_pixel == 3)
+      {
+        pixel = targa_bgr_to_rgba(&input[index]);
+      }
+      else
+      {
+        memcpy(&pixel, &input[index], sizeof(u32));
+        pixel = targa_bgra_to_rgba(pixel);
+      }
+      targa_fill(&output[written], pixel, count);
+      index += bytes_per_pixel;
+    }
+    else
+    {
+      u64 size = ((u64)(header & 0x7F) + 1) * bytes_per_pixel;
+      if (index + size > length)
+      {
+        return false;
+      }
+      if (bytes_per_pixel == 3)
+      {
+        targa_expand_bgr(&output[written], &input[index], count);
+      }
+      else
+      {
+        targa_expand_bgra(&output[written], &input[index], count);
+      }
+      index += size;
+    }
+    written += count;
+  }
+  file->index = index;
+  return true;
+}
+
+bool sta_targa_decode_rgba(TargaImage* image, Buffer* file)
+{
+  const int UNCOMPRESSED = 2;
+  const int RLE          = 10;
+
+  TargaHeader header;
+  if (file->len - file->index < sizeof(TargaHeader))
+  {
+    return false;
+  }
+  memcpy(&header, file->read(sizeof(TargaHeader)), sizeof(TargaHeader));
+
+  u32 bytes_per_pixel = header.imagePixelSize / 8;
+  u64 skip            = header.charactersInIdentificationField;
+  if (header.colorMapType != 0 || (bytes_per_pixel != 3 && bytes_per_pixel != 4) || (header.imageType != UNCOMPRESSED && header.imageType != RLE) ||
+      file->len - file->index < skip)
+  {
+    printf("ERROR: Can't parse targa type %d with %d bits per pixel\n", header.imageType, header.imagePixelSize);
+    return false;
+  }
+  file->index += skip;
+
+  image->width    = header.width;
+  image->height   = header.height;
+  image->bpp      = 32;
+  u64 pixel_count = (u64)image->width * image->height;
+  image->data     = (unsigned char*)sta_allocate(pixel_count * 4);
+  u32* pixels     = (u32*)image->data;
+
+  bool ok = true;
+  if (header.imageType == UNCOMPRESSED)
+  {
+    u64 size = pixel_count * bytes_per_pixel;
+    ok       = file->len - file->index >= size;
+    if (ok)
+    {
+      const u8* input = (const u8*)file->read(size);
+      if (bytes_per_pixel == 3)
+      {
+        targa_expand_bgr(pixels, input, pixel_count);
+      }
+      else
+      {
+        targa_expand_bgra(pixels, input, pixel_count);
+      }
+    }
+  }
+  else
+  {
+    ok = targa_decode_rle(pixels, pixel_count, file, bytes_per_pixel);
+  }
+
+  if (!ok)
+  {
+    printf("ERROR: Targa data ends early\n");
+    sta_deallocate(image->data, pixel_count * 4);
+    image->data = 0;
+  }
+  return ok;
+}
+
+bool sta_targa_read_from_file_rgba(TargaImage* image, const char* filename)
+{
+  Buffer file;
+  if (!sta_map_file(&file, filename))
+  {
+    printf("ERROR: file doesn't exist %s\n", filename);
+    return false;
+  }
+  bool ok = sta_targa_decode_rgba(image, &file);
+  sta_unmap_file(&file);
+
+  return ok;
+}
+
+void sta_targa_read_job(void* data)
+{
+  TimeFunction;
+  TargaLoad* load = (TargaLoad*)data;
+  load->ok        = sta_targa_read_from_file_rgba(&load->image, load->location);
+  __atomic_store_n(&load->done, true, __ATOMIC_RELEASE);
+  ExitFunction;
+}
+
+void sta_cooked_texture_location(char* output, u32 output_size, const char* location)
+{
+  u32 length = strlen(location);
+  u32 dot    = length;
+  for (u32 i = length; i > 0; i--)
+  {
+    if (location[i - 1] == '.')
+    {
+      dot = i - 1;
+      break;
+    }
+    if (location[i - 1] == '/')
+    {
+      break;
+    }
+  }
+  snprintf(output, output_size, "%.*s.stex", dot, location);
+}
+
+static u16 rgb_to_565(i32 r, i32 g, i32 b)
+{
+  return (u16)((((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255));
+}
+
+static void rgb_from_565(u16 color, i32* rgb)
+{
+  i32 r  = (color >> 11) & 31;
+  i32 g  = (color >> 5) & 63;
+  i32 b  = color & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Bounding box fit, the box is inset a bit and its diagonal flipped to follow how green and blue move with red
+static void encode_bc1_block(u8* output, u8* pixels)
+{
+  i32 min[3] = {255, 255, 255}, max[3] = {0, 0, 0};
+  for (u32 i = 0; i < 16; i++)
+  {
+    for (u32 c = 0; c < 3; c++)
+    {
+      min[c] = MIN(min[c], pixels[i * 4 + c]);
+      max[c] = MAX(max[c], pixels[i * 4 + c]);
+    }
+  }
+
+  i32 covariance[3] = {0, 0, 0};
+  for (u32 i = 0; i < 16; i++)
+  {
+    i32 r = pixels[i * 4 + 0] * 2 - (min[0] + max[0]);
+    covariance[1] += r * (pixels[i * 4 + 1] * 2 - (min[1] + max[1]));
+    covariance[2] += r * (pixels[i * 4 + 2] * 2 - (min[2] + max[2]));
+  }
+  for (u32 c = 0; c < 3; c++)
+  {
+    i32 inset = (max[c] - min[c]) / 16;
+    min[c] += inset;
+    max[c] -= inset;
+  }
+  for (u32 c = 1; c < 3; c++)
+  {
+    if (covariance[c] < 0)
+    {
+      i32 tmp = min[c];
+      min[c]  = max[c];
+      max[c]  = tmp;
+    }
+  }
+
+  u16 color0 = rgb_to_565(max[0], max[1], max[2]);
+  u16 color1 = rgb_to_565(min[0], min[1], min[2]);
+  if (color0 < color1)
+  {
+    u16 tmp = color0;
+    color0  = color1;
+    color1  = tmp;
+  }
+
+  u32 indices = 0;
+  if (color0 != color1)
+  {
+    i32 palette[4][3];
+    rgb_from_565(color0, palette[0]);
+    rgb_from_565(color1, palette[1]);
+    for (u32 c = 0; c < 3; c++)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    for (u32 i = 0; i < 16; i++)
+    {
+      u32 best = 0, best_distance = ~0u;
+      for (u32 j = 0; j < 4; j++)
+      {
+        i32 dr       = pixels[i * 4 + 0] - palette[j][0];
+        i32 dg       = pixels[i * 4 + 1] - palette[j][1];
+        i32 db       = pixels[i * 4 + 2] - palette[j][2];
+        u32 distance = dr * dr + dg * dg + db * db;
+        if (distance < best_distance)
+        {
+          best          = j;
+          best_distance = distance;
+        }
+      }
+      indices |= best << (i * 2);
+    }
+  }
+
+  memcpy(&output[0], &color0, sizeof(u16));
+  memcpy(&output[2], &color1, sizeof(u16));
+  memcpy(&output[4], &indices, sizeof(u32));
+}
+
+// Single channel block, the channel is read at every stride'th byte
+static void encode_bc4_block(u8* output, u8* values, u32 stride)
+{
+  i32 min = 255, max = 0;
+  for (u32 i = 0; i < 16; i++)
+  {
+    min = MIN(min, values[i * stride]);
+    max = MAX(max, values[i * stride]);
+  }
+  output[0]   = max;
+  output[1]   = min;
+  u64 indices = 0;
+  if (max != min)
+  {
+    // max > min selects the mode with 6 interpolated values
+    i32 palette[8] = {max, min};
+    for (u32 i = 1; i < 7; i++)
+    {
+      palette[i + 1] = ((7 - i) * max + i * min) / 7;
+    }
+    for (u32 i = 0; i < 16; i++)
+    {
+      u64 best          = 0;
+      i32 best_distance = 256;
+      for (u32 j = 0; j < 8; j++)
+      {
+        i32 distance = ABS(values[i * stride] - palette[j]);
+        if (distance < best_distance)
+        {
+          best          = j;
+          best_distance = distance;
+        }
+      }
+      indices |= best << (i * 3);
+    }
+  }
+  for (u32 i = 0; i < 6; i++)
+  {
+    output[2 + i] = (indices >> (i * 8)) & 0xFF;
+  }
+}
+
+static u32 cooked_block_size(CookedTextureFormat format)
+{
+  return format == COOKED_TEXTURE_BC1 ? 8 : 16;
+}
+
+static u32 compress_mip(u8* output, u8* data, u32 width, u32 height, CookedTextureFormat format)
+{
+  u8* block = output;
+  for (u32 block_y = 0; block_y < height; block_y += 4)
+  {
+    for (u32 block_x = 0; block_x < width; block_x += 4)
+    {
+      // the edge pixels are repeated for mips that aren't a multiple of 4
+      u8 pixels[16 * 4];
+      for (u32 y = 0; y < 4; y++)
+      {
+        for (u32 x = 0; x < 4; x++)
+        {
+          u32 source_x = MIN(block_x + x, width - 1);
+          u32 source_y = MIN(block_y + y, height - 1);
+          memcpy(&pixels[(y * 4 + x) * 4], &data[(source_y * width + source_x) * 4], 4);
+        }
+      }
+
+      switch (format)
+      {
+      case COOKED_TEXTURE_BC1:
+      {
+        encode_bc1_block(block, pixels);
+        break;
+      }
+      case COOKED_TEXTURE_BC3:
+      {
+        encode_bc4_block(block, &pixels[3], 4);
+        encode_bc1_block(block + 8, pixels);
+        break;
+      }
+      case COOKED_TEXTURE_BC5:
+      {
+        encode_bc4_block(block, &pixels[0], 4);
+        encode_bc4_block(block + 8, &pixels[1], 4);
+        break;
+      }
+      }
+      block += cooked_block_size(format);
+    }
+  }
+  return block - output;
 }
-static inline void read_safe(void* target, u64 size, FILE* ptr)
+
+// 2x2 box filter, odd edges just repeat the last row/column
+static void downsample_rgba(u8* output, u8* data, u32 width, u32 height)
 {
-  u64 read = fread(target, 1, size, ptr);
-  if (read != size)
+  u32 mip_width  = MAX(width / 2, 1);
+  u32 mip_height = MAX(height / 2, 1);
+  for (u32 y = 0; y < mip_height; y++)
   {
-    printf("Didn't read correctly? :) %ld %ld\n", read, size);
-    exit(1);
+    for (u32 x = 0; x < mip_width; x++)
+    {
+      u32 x0 = MIN(x * 2, width - 1), x1 = MIN(x * 2 + 1, width - 1);
+      u32 y0 = MIN(y * 2, height - 1), y1 = MIN(y * 2 + 1, height - 1);
+      for (u32 c = 0; c < 4; c++)
+      {
+        u32 sum = data[(y0 * width + x0) * 4 + c] + data[(y0 * width + x1) * 4 + c] + data[(y1 * width + x0) * 4 + c] + data[(y1 * width + x1) * 4 + c];
+        output[(y * mip_width + x) * 4 + c] = (sum + 2) / 4;
+      }
+    }
   }
 }
 
-bool sta_targa_read_from_file_rgba(TargaImage* image, const char* filename)
+bool sta_cook_texture(const char* input_filename, const char* output_filename, bool normal_map)
 {
-
-  TargaHeader   targa_file_header;
-  FILE*         file_ptr;
-  unsigned long image_size;
-  const int     RGB          = 24;
-  const int     RGBA         = 32;
-  const int     UNCOMPRESSED = 2;
-  const int     RLE          = 10;
-
-  file_ptr                   = fopen(filename, "rb");
-  if (file_ptr == NULL)
+  TargaImage image = {};
+  if (!sta_targa_read_from_file_rgba(&image, input_filename))
   {
-    printf("ERROR: file doesn't exist %s\n", filename);
     return false;
   }
+  u32                 width  = image.width;
+  u32                 height = image.height;
 
-  read_safe((void*)&targa_file_header, sizeof(TargaHeader), file_ptr);
-  image->width  = targa_file_header.width;
-  image->height = targa_file_header.height;
-  image->bpp    = targa_file_header.imagePixelSize;
-
-  if (targa_file_header.imageType == UNCOMPRESSED)
+  CookedTextureFormat format = COOKED_TEXTURE_BC1;
+  if (normal_map)
   {
-    image_size  = image->width * image->height * 4;
-    image->data = (unsigned char*)sta_allocate(image_size);
-    if (image->bpp == 24)
-    {
-      long size     = image->width * image->height * 3;
-      u8*  rgb_data = (u8*)sta_allocate(size);
-      read_safe((void*)rgb_data, size, file_ptr);
-      for (int i = 0; i < size / 3; i++)
-      {
-        image->data[i * 4 + 0] = rgb_data[i * 3 + 0];
-        image->data[i * 4 + 1] = rgb_data[i * 3 + 1];
-        image->data[i * 4 + 2] = rgb_data[i * 3 + 2];
-        image->data[i * 4 + 3] = 255;
-      }
-    }
-    else
-    {
-      read_safe((void*)image->data, image_size, file_ptr);
-    }
+    format = COOKED_TEXTURE_BC5;
   }
-  else if (targa_file_header.imageType == RLE)
+  else
   {
-    image_size  = image->width * image->height * 4;
-    u64 bpp     = 4;
-    image->data = (unsigned char*)sta_allocate(image_size);
-
-    if (targa_file_header.imagePixelSize == RGB)
+    for (u64 i = 0; i < (u64)width * height; i++)
     {
-      u64 imageIndex = 0;
-      u8  byte;
-      while (imageIndex < image_size)
+      if (image.data[i * 4 + 3] != 255)
       {
-        read_safe((void*)&byte, sizeof(u8), file_ptr);
-        u8* curr = &image->data[imageIndex];
-        if (byte >= 128)
-        {
-          u8 repeated = byte - 127;
-          u8 color[3];
-          read_safe((void*)&color, ArrayCount(color), file_ptr);
-
-          for (i32 j = 0; j < repeated; j++)
-          {
-            curr[j * bpp + 0] = color[0];
-            curr[j * bpp + 1] = color[1];
-            curr[j * bpp + 2] = color[2];
-            curr[j * bpp + 3] = 255;
-          }
-          imageIndex += repeated * 4;
-        }
-        else
-        {
-          u8 repeated = byte + 1;
-          for (i32 j = 0; j < repeated; j++)
-          {
-            u8 color[3];
-            read_safe((void*)&color, ArrayCount(color), file_ptr);
-
-            curr[j * bpp + 0] = color[0];
-            curr[j * bpp + 1] = color[1];
-            curr[j * bpp + 2] = color[2];
-            curr[j * bpp + 3] = 255;
-          }
-          imageIndex += repeated * 4;
-        }
+        format = COOKED_TEXTURE_BC3;
+        break;
       }
     }
-    else
+  }
+
+  CookedTextureHeader header = {};
+  header.magic               = COOKED_TEXTURE_MAGIC;
+  header.format              = format;
+  header.width               = width;
+  header.height              = height;
+
+  u64 payload_size = 0;
+  for (u32 mip_width = width, mip_height = height;; mip_width = MAX(mip_width / 2, 1), mip_height = MAX(mip_height / 2, 1))
+  {
+    payload_size += (u64)((mip_width + 3) / 4) * ((mip_height + 3) / 4) * cooked_block_size(format);
+    if (mip_width == 1 && mip_height == 1)
     {
-      u64 imageIndex = 0;
-      u8  byte;
-      while (imageIndex < image_size)
-      {
-        read_safe((void*)&byte, sizeof(u8), file_ptr);
-        u8* curr = &image->data[imageIndex];
-        if (byte >= 128)
-        {
-          u8 repeated = byte - 127;
-
-          u8 color[4];
-          read_safe((void*)&color, ArrayCount(color), file_ptr);
-
-          for (i32 j = 0; j < repeated; j++)
-          {
-            curr[j * bpp + 0] = color[0];
-            curr[j * bpp + 1] = color[1];
-            curr[j * bpp + 2] = color[2];
-            curr[j * bpp + 3] = color[3];
-          }
-          imageIndex += repeated * bpp;
-        }
-        else
-        {
-          u8 repeated = byte + 1;
-
-          for (i32 j = 0; j < repeated; j++)
-          {
-            u8 color[4];
-            read_safe((void*)&color, ArrayCount(color), file_ptr);
-
-            curr[j * bpp + 0] = color[0];
-            curr[j * bpp + 1] = color[1];
-            curr[j * bpp + 2] = color[2];
-            curr[j * bpp + 3] = color[3];
-          }
-          imageIndex += repeated * bpp;
-        }
-      }
+      break;
     }
   }
-  else
+
+  u8* payload    = sta_allocate_struct(u8, payload_size);
+  u8* mip        = image.data;
+  u8* next_mip   = sta_allocate_struct(u8, (u64)width * height * 4);
+  u32 offset     = sizeof(CookedTextureHeader);
+  u32 mip_width  = width;
+  u32 mip_height = height;
+  while (header.mip_count < COOKED_TEXTURE_MAX_MIPS)
   {
-    // ToDo fix this xD
-    assert(0 && "Can't parse this targa type");
+    u32 size                             = compress_mip(&payload[offset - sizeof(CookedTextureHeader)], mip, mip_width, mip_height, format);
+    header.mip_offsets[header.mip_count] = offset;
+    header.mip_sizes[header.mip_count]   = size;
+    header.mip_count++;
+    offset += size;
+    if (mip_width == 1 && mip_height == 1)
+    {
+      break;
+    }
+
+    downsample_rgba(next_mip, mip, mip_width, mip_height);
+    u8* tmp    = mip;
+    mip        = next_mip;
+    next_mip   = tmp;
+    mip_width  = MAX(mip_width / 2, 1);
+    mip_height = MAX(mip_height / 2, 1);
   }
+  sta_deallocate(next_mip, (u64)width * height * 4);
+  sta_deallocate(mip, (u64)width * height * 4);
 
-  // reminder that tga stores it as GBRA not RGBA
-  for (u64 idx = 0; idx < image->height * image->width * 4; idx += 4)
+  FILE* file_ptr = fopen(output_filename, "wb");
+  if (file_ptr == 0)
   {
-    unsigned char tmp    = image->data[idx];
-    image->data[idx]     = image->data[idx + 2];
-    image->data[idx + 2] = tmp;
+    sta_deallocate(payload, payload_size);
+    return false;
   }
-  image->bpp = RGBA;
+  u64  written = offset - sizeof(CookedTextureHeader);
+  bool ok      = fwrite(&header, sizeof(CookedTextureHeader), 1, file_ptr) == 1;
+  ok &= fwrite(payload, 1, written, file_ptr) == written;
+  ok &= fclose(file_ptr) == 0;
+  sta_deallocate(payload, payload_size);
 
-  if (fclose(file_ptr) != 0)
+  return ok;
+}
+
+bool sta_cooked_texture_read(CookedTexture* texture, const char* filename)
+{
+  if (!sta_read_file(&texture->file, filename))
   {
-    printf("Failed to close file\n");
     return false;
   }
+  texture->header             = (CookedTextureHeader*)texture->file.buffer;
+  CookedTextureHeader* header = texture->header;
+  bool ok = texture->file.len >= sizeof(CookedTextureHeader) && header->magic == COOKED_TEXTURE_MAGIC && header->format <= COOKED_TEXTURE_BC5 && header->mip_count > 0 &&
+            header->mip_count <= COOKED_TEXTURE_MAX_MIPS;
+  for (u32 i = 0; ok && i < header->mip_count; i++)
+  {
+    ok = (u64)header->mip_offsets[i] + header->mip_sizes[i] <= texture->file.len;
+  }
+  if (!ok)
+  {
+    sta_cooked_texture_free(texture);
+  }
+  return ok;
+}
 
-  return true;
+void sta_cooked_texture_free(CookedTexture* texture)
+{
+  sta_deallocate(texture->file.buffer, texture->file.len + 1);
+  texture->file.buffer = 0;
+  texture->header      = 0;
+}
+
+void sta_texture_read_job(void* data)
+{
+  TimeFunction;
+  TextureLoad* load = (TextureLoad*)data;
+  if (load->allow_compressed)
+  {
+    char cooked_location[512];
+    sta_cooked_texture_location(cooked_location, ArrayCount(cooked_location), load->location);
+    load->compressed = sta_cooked_texture_read(&load->cooked, cooked_location);
+  }
+  load->ok = load->compressed || sta_targa_read_from_file_rgba(&load->image, load->location);
+  __atomic_store_n(&load->done, true, __ATOMIC_RELEASE);
+  ExitFunction;
 }
 
 bool sta_targa_read_from_file(Arena* arena, TargaImage* image, const char* filename)
@@ -820,14 +1240,33 @@ bool sta_write_csv_to_file(CSV* csv, Buffer fileLocation)
   return fclose(filePtr) == 0;
 }
 
+bool JsonString::equals(const char* s)
+{
+  return strlen(s) == this->length && strncmp(s, this->buffer, this->length) == 0;
+}
+
+char* JsonString::copy()
+{
+  char* out         = (char*)malloc(sizeof(char) * (this->length + 1));
+  out[this->length] = '\0';
+  memcpy(out, this->buffer, this->length);
+  return out;
+}
+
 JsonValue* JsonObject::lookup_value(const char* key)
 {
-  u32 key_length = strlen(key);
-  for (u32 i = 0; i < this->size; i++)
+  if (this->size == 0)
+  {
+    return 0;
+  }
+  String string((char*)key, strlen(key));
+  u32    hash = sta_hash_string_fnv(&string);
+  for (u32 slot = hash & this->slot_mask; this->slots[slot] != 0; slot = (slot + 1) & this->slot_mask)
   {
-    if (key_length == strlen(this->keys[i]) && strncmp(key, this->keys[i], key_length) == 0)
+    u32 index = this->slots[slot] - 1;
+    if (this->hashes[index] == hash && this->keys[index].length == string.length && strncmp(key, this->keys[index].buffer, string.length) == 0)
     {
-      return &this->values[i];
+      return &this->values[index];
     }
   }
   return 0;
@@ -854,7 +1293,7 @@ static void serialize_json_object(JsonObject* object, FILE* filePtr)
   fwrite("{", 1, 1, filePtr);
   for (u32 i = 0; i < object->size; i++)
   {
-    fprintf(filePtr, "\"%s\":", object->keys[i]);
+    fprintf(filePtr, "\"%.*s\":", (i32)object->keys[i].length, object->keys[i].buffer);
     serialize_json_value(&object->values[i], filePtr);
     if (i != object->size - 1)
     {
@@ -902,7 +1341,7 @@ static void serialize_json_value(JsonValue* value, FILE* filePtr)
   }
   case JSON_STRING:
   {
-    fprintf(filePtr, "\"%s\"", value->string);
+    fprintf(filePtr, "\"%.*s\"", (i32)value->string.length, value->string.buffer);
     break;
   }
   default:
@@ -989,7 +1428,7 @@ void sta_json_debug_value(JsonValue* value)
   }
   case JSON_STRING:
   {
-    printf("\"%s\"", value->string);
+    printf("\"%.*s\"", (i32)value->string.length, value->string.buffer);
     break;
   }
   default:
@@ -1004,7 +1443,7 @@ void sta_json_debug_object(JsonObject* object)
   printf("{\n");
   for (u32 i = 0; i < object->size; i++)
   {
-    printf("\"%s\":", object->keys[i]);
+    printf("\"%.*s\":", (i32)object->keys[i].length, object->keys[i].buffer);
     sta_json_debug_value(&object->values[i]);
     if (i != object->size - 1)
     {
@@ -1028,73 +1467,120 @@ void sta_json_debug_array(JsonArray* arr)
   printf("]");
 }
 
-static inline void json_resize_object(JsonObject* obj)
+// Members of every open object/array wait on these stacks until it's closed,
+// they're then copied into the document in one exactly sized push
+struct JsonParser
 {
-  if (obj->cap == 0)
-  {
-    obj->cap    = 4;
-    obj->values = (JsonValue*)malloc(sizeof(JsonValue) * obj->cap);
-    obj->keys   = (char**)malloc(sizeof(char*) * obj->cap);
-  }
-  else if (obj->size >= obj->cap)
+  Json*       json;
+  Buffer*     buffer;
+  JsonValue*  values;
+  u32         value_count;
+  u32         value_capacity;
+  JsonString* keys;
+  u32         key_count;
+  u32         key_capacity;
+};
+
+static void* json_push(Json* json, u64 size)
+{
+  void* out = json->blocks ? (void*)json->blocks->arena.push(size) : 0;
+  if (!out)
   {
-    obj->cap *= 2;
-    obj->values = (JsonValue*)realloc(obj->values, obj->cap * sizeof(JsonValue));
-    obj->keys   = (char**)realloc(obj->keys, obj->cap * sizeof(char*));
+    // nodes start on the first aligned address after the header
+    u64        header_size = (sizeof(JsonBlock) + DEFAULT_ALIGNMENT - 1) & ~(DEFAULT_ALIGNMENT - 1);
+    u64        block_size  = MAX(JSON_BLOCK_SIZE, header_size + size + DEFAULT_ALIGNMENT);
+    JsonBlock* block       = (JsonBlock*)sta_allocate(block_size);
+    block->next            = json->blocks;
+    block->size            = block_size;
+    block->arena.memory    = (u64)block + header_size;
+    block->arena.maxSize   = block_size - header_size;
+    block->arena.ptr       = 0;
+    json->blocks           = block;
+    out                    = (void*)block->arena.push(size);
   }
+  return out;
+}
+
+static void json_push_value(JsonParser* parser, JsonValue* value)
+{
+  RESIZE_ARRAY(parser->values, JsonValue, parser->value_count, parser->value_capacity);
+  parser->values[parser->value_count++] = *value;
 }
 
-static bool json_parse_string(char** key, Buffer* buffer)
+static void json_push_key(JsonParser* parser, JsonString* key)
+{
+  RESIZE_ARRAY(parser->keys, JsonString, parser->key_count, parser->key_capacity);
+  parser->keys[parser->key_count++] = *key;
+}
+
+static bool json_parse_string(JsonString* string, Buffer* buffer)
 {
   ADVANCE(buffer);
   u64 start = buffer->index;
-  SKIP(buffer, !buffer->match('"'));
-  u64 len     = (buffer->index - start);
-
-  *key        = (char*)malloc(sizeof(char) * (1 + len));
-  (*key)[len] = '\0';
-  strncpy(*key, &buffer->buffer[start], len);
+  SKIP(buffer, !buffer->is_out_of_bounds() && !buffer->match('"'));
+  if (buffer->is_out_of_bounds())
+  {
+    return false;
+  }
+  string->buffer = &buffer->buffer[start];
+  string->length = buffer->index - start;
   ADVANCE(buffer);
   return true;
 }
 
-static bool json_parse_value(JsonValue* value, Buffer* buffer);
-static bool json_parse_array(JsonArray* arr, Buffer* buffer);
-
-static bool json_parse_key_value_pair(JsonObject* obj, Buffer* buffer)
+static void json_build_key_table(Json* json, JsonObject* obj)
 {
-  json_resize_object(obj);
-
-  json_parse_string(&obj->keys[obj->size], buffer);
-  skip_whitespace(buffer);
-
-  if (!consume(buffer, ':'))
+  u32 slot_count = 4;
+  while (slot_count < obj->size * 2)
   {
-    return false;
+    slot_count *= 2;
   }
-
-  bool res = json_parse_value(&obj->values[obj->size], buffer);
-  if (!res)
+  obj->hashes    = (u32*)json_push(json, sizeof(u32) * obj->size);
+  obj->slots     = (u32*)json_push(json, sizeof(u32) * slot_count);
+  obj->slot_mask = slot_count - 1;
+  for (u32 i = 0; i < obj->size; i++)
   {
-    return false;
+    String key(obj->keys[i].buffer, obj->keys[i].length);
+    u32    hash = sta_hash_string_fnv(&key);
+    u32    slot = hash & obj->slot_mask;
+    while (obj->slots[slot] != 0)
+    {
+      slot = (slot + 1) & obj->slot_mask;
+    }
+    obj->hashes[i]   = hash;
+    obj->slots[slot] = i + 1;
   }
-  obj->size++;
-
-  skip_whitespace(buffer);
-  return true;
 }
 
-static bool json_parse_object(JsonObject* obj, Buffer* buffer)
+static bool json_parse_value(JsonParser* parser, JsonValue* value);
+
+static bool json_parse_object(JsonParser* parser, JsonObject* obj)
 {
+  Buffer* buffer      = parser->buffer;
+  u32     first_key   = parser->key_count;
+  u32     first_value = parser->value_count;
   buffer->advance();
   skip_whitespace(buffer);
   while (!buffer->match('}'))
   {
-    bool res = json_parse_key_value_pair(obj, buffer);
-    if (!res)
+    JsonString key;
+    if (buffer->is_out_of_bounds() || !json_parse_string(&key, buffer))
+    {
+      return false;
+    }
+    skip_whitespace(buffer);
+    if (!consume(buffer, ':'))
+    {
+      return false;
+    }
+
+    JsonValue value;
+    if (!json_parse_value(parser, &value))
     {
       return false;
     }
+    json_push_key(parser, &key);
+    json_push_value(parser, &value);
 
     skip_whitespace(buffer);
     if (match(buffer, ','))
@@ -1105,52 +1591,62 @@ static bool json_parse_object(JsonObject* obj, Buffer* buffer)
     skip_whitespace(buffer);
   }
   buffer->advance();
-  return true;
-}
 
-static inline void json_resize_array(JsonArray* arr)
-{
-  if (arr->arraySize == 0)
-  {
-    arr->arrayCap = 4;
-    arr->values   = (JsonValue*)malloc(sizeof(JsonValue) * arr->arrayCap);
-  }
-  else if (arr->arraySize >= arr->arrayCap)
+  obj->size   = parser->value_count - first_value;
+  obj->keys   = 0;
+  obj->values = 0;
+  if (obj->size > 0)
   {
-    arr->arrayCap *= 2;
-    arr->values = (JsonValue*)realloc(arr->values, arr->arrayCap * sizeof(JsonValue));
+    obj->keys   = (JsonString*)json_push(parser->json, sizeof(JsonString) * obj->size);
+    obj->values = (JsonValue*)json_push(parser->json, sizeof(JsonValue) * obj->size);
+    memcpy(obj->keys, &parser->keys[first_key], sizeof(JsonString) * obj->size);
+    memcpy(obj->values, &parser->values[first_value], sizeof(JsonValue) * obj->size);
+    json_build_key_table(parser->json, obj);
   }
+  parser->key_count   = first_key;
+  parser->value_count = first_value;
+  return true;
 }
-static bool json_parse_array(JsonArray* arr, Buffer* buffer)
+
+static bool json_parse_array(JsonParser* parser, JsonArray* arr)
 {
+  Buffer* buffer      = parser->buffer;
+  u32     first_value = parser->value_count;
   ADVANCE(buffer);
   skip_whitespace(buffer);
-  bool res;
   while (!buffer->match(']'))
   {
-    json_resize_array(arr);
-    res = json_parse_value(&arr->values[arr->arraySize], buffer);
-    if (!res)
+    JsonValue value;
+    if (buffer->is_out_of_bounds() || !json_parse_value(parser, &value))
     {
       return false;
     }
-    arr->arraySize++;
+    json_push_value(parser, &value);
     skip_whitespace(buffer);
     (void)consume(buffer, ',');
   }
-
   ADVANCE(buffer);
 
+  arr->arraySize = parser->value_count - first_value;
+  arr->values    = 0;
+  if (arr->arraySize > 0)
+  {
+    arr->values = (JsonValue*)json_push(parser->json, sizeof(JsonValue) * arr->arraySize);
+    memcpy(arr->values, &parser->values[first_value], sizeof(JsonValue) * arr->arraySize);
+  }
+  parser->value_count = first_value;
   return true;
 }
+
 static bool json_parse_number(f32* number, Buffer* buffer)
 {
   *number = parse_float_from_string(buffer);
   return true;
 }
 
-static bool json_parse_value(JsonValue* value, Buffer* buffer)
+static bool json_parse_value(JsonParser* parser, JsonValue* value)
 {
+  Buffer* buffer = parser->buffer;
   skip_whitespace(buffer);
   if (isdigit(buffer->current_char()) || buffer->match('-'))
   {
@@ -1166,19 +1662,15 @@ static bool json_parse_value(JsonValue* value, Buffer* buffer)
   }
   case '{':
   {
-    value->type      = JSON_OBJECT;
-    value->obj       = (JsonObject*)malloc(sizeof(JsonObject));
-    value->obj->cap  = 0;
-    value->obj->size = 0;
-    return json_parse_object(value->obj, buffer);
+    value->type = JSON_OBJECT;
+    value->obj  = (JsonObject*)json_push(parser->json, sizeof(JsonObject));
+    return json_parse_object(parser, value->obj);
   }
   case '[':
   {
-    value->type           = JSON_ARRAY;
-    value->arr            = (JsonArray*)malloc(sizeof(JsonArray));
-    value->arr->arrayCap  = 0;
-    value->arr->arraySize = 0;
-    return json_parse_array(value->arr, buffer);
+    value->type = JSON_ARRAY;
+    value->arr  = (JsonArray*)json_push(parser->json, sizeof(JsonArray));
+    return json_parse_array(parser, value->arr);
   }
   case 't':
   {
@@ -1206,7 +1698,7 @@ static bool json_parse_value(JsonValue* value, Buffer* buffer)
   }
   case 'n':
   {
-    if (strncmp(&NEXT_CHAR(buffer), "ull", 3))
+    if (strncmp(&NEXT_CHAR(buffer), "ull", 3) == 0)
     {
       value->type = JSON_NULL;
       buffer->index += 4;
@@ -1223,8 +1715,19 @@ static bool json_parse_value(JsonValue* value, Buffer* buffer)
   }
 }
 
+// Strings are views into buffer so it has to outlive the document
 bool sta_json_deserialize_from_string(Buffer* buffer, Json* json)
 {
+  JsonParser parser     = {};
+  parser.json           = json;
+  parser.buffer         = buffer;
+  parser.value_capacity = 64;
+  parser.values         = sta_allocate_struct(JsonValue, parser.value_capacity);
+  parser.key_capacity   = 64;
+  parser.keys           = sta_allocate_struct(JsonString, parser.key_capacity);
+  json->blocks          = 0;
+  json->source          = Buffer();
+
   bool res;
   buffer->skip_whitespace();
   switch (buffer->current_char())
@@ -1232,37 +1735,54 @@ bool sta_json_deserialize_from_string(Buffer* buffer, Json* json)
   case '{':
   {
     json->headType = JSON_OBJECT;
-    json->obj.cap  = 0;
-    json->obj.size = 0;
-    res            = json_parse_object(&json->obj, buffer);
+    res            = json_parse_object(&parser, &json->obj);
     break;
   }
   case '[':
   {
-    json->headType        = JSON_ARRAY;
-    json->array.arrayCap  = 0;
-    json->array.arraySize = 0;
-    res                   = json_parse_array(&json->array, buffer);
+    json->headType = JSON_ARRAY;
+    res            = json_parse_array(&parser, &json->array);
     break;
   }
   default:
   {
     json->headType = JSON_VALUE;
-    res            = json_parse_value(&json->value, buffer);
+    res            = json_parse_value(&parser, &json->value);
     break;
   }
   }
+  sta_deallocate(parser.values, sizeof(JsonValue) * parser.value_capacity);
+  sta_deallocate(parser.keys, sizeof(JsonString) * parser.key_capacity);
 
   if (!res)
   {
+    sta_json_free(json);
     return false;
   }
-  if (buffer->index != buffer->len)
+  return true;
+}
+
+void sta_json_free(Json* json)
+{
+  JsonBlock* block = json->blocks;
+  while (block)
   {
-    // printf("Didn't reach eof after parsing first value? %ld %ld %.*s\n", buffer->index, buffer->len, (i32)(buffer->len - buffer->index), buffer->current_address());
-    // return true;
+    JsonBlock* next = block->next;
+    sta_deallocate(block, block->size);
+    block = next;
   }
-  return true;
+  json->blocks = 0;
+  if (json->source.buffer)
+  {
+    sta_unmap_file(&json->source);
+  }
+}
+
+char* sta_json_c_string(Json* json, JsonString* string)
+{
+  char* out = (char*)json_push(json, string->length + 1);
+  memcpy(out, string->buffer, string->length);
+  return out;
 }
 
 bool sta_json_deserialize_from_file(Arena* arena, Json* json, const char* filename)
@@ -1278,6 +1798,23 @@ bool sta_json_deserialize_from_file(Arena* arena, Json* json, const char* filena
   return sta_json_deserialize_from_string(&fileContent, json);
 }
 
+// The document keeps the file mapped since its strings point into it, sta_json_free unmaps it
+bool sta_json_deserialize_from_file(Json* json, const char* filename)
+{
+  Buffer file_content = {};
+  if (!sta_map_file(&file_content, filename))
+  {
+    return false;
+  }
+  if (!sta_json_deserialize_from_string(&file_content, json))
+  {
+    sta_unmap_file(&file_content);
+    return false;
+  }
+  json->source = file_content;
+  return true;
+}
+
 void sta_json_debug(Json* json)
 {
   switch (json->headType)
@@ -1413,28 +1950,29 @@ void init_wavefront_object(WavefrontObject* obj)
 }
 bool parse_wavefront_objects(WavefrontObject** _objs, u32& obj_count, u32& obj_capacity, const char* filename)
 {
-  FILE* filePtr;
-  char* line = NULL;
-  u64   len  = 0;
-  i64   read;
-
-  filePtr = fopen(filename, "r");
-  if (filePtr == NULL)
+  Buffer file = {};
+  if (!sta_map_file(&file, filename))
   {
     return false;
   }
-  obj_count               = 0;
-  obj_capacity            = 1;
-  *_objs                  = sta_allocate_struct(WavefrontObject, 1);
-  WavefrontObject* obj    = 0;
+  obj_count            = 0;
+  obj_capacity         = 1;
+  *_objs               = sta_allocate_struct(WavefrontObject, 1);
+  WavefrontObject* obj = 0;
 
-  Buffer           buffer = {};
-  while ((read = getline(&line, &len, filePtr)) != -1)
+  // every line is parsed in place as its own buffer, ending before the newline
+  while (!file.is_out_of_bounds())
   {
-    buffer.len           = strlen(line);
-    line[buffer.len - 1] = '\0';
-    buffer.buffer        = line;
-    buffer.index         = 0;
+    char* line = file.current_address();
+    char* end  = (char*)memchr(line, '\n', file.len - file.index);
+    u64   len  = end ? end - line : file.len - file.index;
+    file.advance(len + 1);
+
+    Buffer buffer(line, len);
+    if (len == 0)
+    {
+      continue;
+    }
     if (buffer.current_char() == 'v' && buffer.buffer[buffer.index + 1] == 't')
     {
       assert(obj && "Can't parse obj without name!");
@@ -1467,6 +2005,7 @@ bool parse_wavefront_objects(WavefrontObject** _objs, u32& obj_count, u32& obj_c
       strncpy(obj->name, buffer.current_address(), buffer.len - buffer.index);
     }
   }
+  sta_unmap_file(&file);
   return true;
 }
 
@@ -1519,6 +2058,26 @@ void change_obj_to_y_up(const char* filename, const char* outname)
   }
 }
 
+// Face corners that share the same (position, uv, normal) triple end up as one vertex
+static u32 find_or_add_obj_vertex(u32* slots, u32 slot_mask, WavefrontVertexData* keys, u32* vertex_count, WavefrontVertexData key)
+{
+  String key_string((char*)&key, sizeof(WavefrontVertexData));
+  u32    slot = sta_hash_string_fnv(&key_string) & slot_mask;
+  while (slots[slot] != 0)
+  {
+    WavefrontVertexData* other = &keys[slots[slot] - 1];
+    if (other->vertex_idx == key.vertex_idx && other->texture_idx == key.texture_idx && other->normal_idx == key.normal_idx)
+    {
+      return slots[slot] - 1;
+    }
+    slot = (slot + 1) & slot_mask;
+  }
+  u32 index   = (*vertex_count)++;
+  keys[index] = key;
+  slots[slot] = index + 1;
+  return index;
+}
+
 bool sta_parse_wavefront_object_from_file(ModelData* model, const char* filename)
 {
   WavefrontObject* objs;
@@ -1529,47 +2088,58 @@ bool sta_parse_wavefront_object_from_file(ModelData* model, const char* filename
     return false;
   }
 
+  u64 corner_count = 0;
+  for (u32 i = 0; i < obj_count; i++)
+  {
+    corner_count += objs[i].face_count * objs[i].faces[0].count;
+  }
+
+  u32 slot_count = 16;
+  while (slot_count < corner_count * 2)
+  {
+    slot_count *= 2;
+  }
+  u32*                 slots        = sta_allocate_struct(u32, slot_count);
+  WavefrontVertexData* keys         = sta_allocate_struct(WavefrontVertexData, corner_count);
+  VertexData*          vertices     = sta_allocate_struct(VertexData, corner_count);
+  u32                  vertex_count = 0;
+
+  model->index_count = corner_count;
+  model->indices     = sta_allocate_struct(u32, corner_count);
+
   float low = FLT_MAX, high = -FLT_MAX;
-  model->vertex_count  = 0;
-  u32 prev_index_count = 0, prev_vertex_count = 0, prev_normal_count = 0, prev_uv_count = 0;
+  u32   prev_index_count = 0, prev_vertex_count = 0, prev_normal_count = 0, prev_uv_count = 0;
   for (u32 i = 0; i < obj_count; i++)
   {
     WavefrontObject obj = objs[i];
-    prev_index_count += model->vertex_count;
-    model->vertex_count += obj.face_count * obj.faces[0].count;
-    if (prev_index_count == 0)
-    {
-      model->indices  = (u32*)sta_allocate(sizeof(u32) * model->vertex_count);
-      model->vertices = (VertexData*)sta_allocate(sizeof(VertexData) * model->vertex_count);
-    }
-    else
-    {
-      model->indices  = (u32*)sta_reallocate(model->indices, sizeof(u32) * prev_index_count, sizeof(u32) * model->vertex_count);
-      model->vertices = (VertexData*)sta_reallocate(model->vertices, sizeof(VertexData) * prev_index_count, sizeof(VertexData) * model->vertex_count);
-    }
-
     for (u64 i = 0; i < obj.face_count; i++)
     {
       WavefrontFace* face = &obj.faces[i];
       for (u64 j = 0; j < face->count; j++)
       {
-        u64 index                     = i * face->count + j + prev_index_count;
-        model->indices[index]         = index;
-        WavefrontVertexData data      = face->vertices[j];
-
-        Vector4             v         = obj.vertices[data.vertex_idx - 1 - prev_vertex_count];
-        low                           = MIN(MIN(MIN(low, v.x), v.y), v.z);
-        high                          = MAX(MAX(MAX(high, v.x), v.y), v.z);
+        WavefrontVertexData data         = face->vertices[j];
+        u32                 prev         = vertex_count;
+        u32                 vertex_index = find_or_add_obj_vertex(slots, slot_count - 1, keys, &vertex_count, data);
+        model->indices[prev_index_count + i * face->count + j] = vertex_index;
+        if (vertex_index != prev)
+        {
+          continue;
+        }
 
-        model->vertices[index].vertex = cast_vec4_to_vec3(obj.vertices[data.vertex_idx - 1 - prev_vertex_count]);
-        model->vertices[index].uv     = cast_vec3_to_vec2(obj.texture_coordinates[data.texture_idx - 1 - prev_uv_count]);
-        model->vertices[index].uv.y   = -model->vertices[index].uv.y;
+        VertexData* vertex = &vertices[vertex_index];
+        Vector4     v      = obj.vertices[data.vertex_idx - 1 - prev_vertex_count];
+        low                = MIN(MIN(MIN(low, v.x), v.y), v.z);
+        high               = MAX(MAX(MAX(high, v.x), v.y), v.z);
 
-        model->vertices[index].normal = obj.normals[data.normal_idx - 1 - prev_normal_count];
+        vertex->vertex     = cast_vec4_to_vec3(v);
+        vertex->uv         = cast_vec3_to_vec2(obj.texture_coordinates[data.texture_idx - 1 - prev_uv_count]);
+        vertex->uv.y       = -vertex->uv.y;
+        vertex->normal     = obj.normals[data.normal_idx - 1 - prev_normal_count];
       }
       // ToDo fix leak
       // sta_deallocate(obj.faces[i].vertices, sizeof(WavefrontVertexData) * obj.faces[i].count);
     }
+    prev_index_count += obj.face_count * obj.faces[0].count;
     prev_normal_count += obj.normal_count;
     prev_vertex_count += obj.vertex_count;
     prev_uv_count += obj.texture_coordinate_count;
@@ -1579,6 +2149,13 @@ bool sta_parse_wavefront_object_from_file(ModelData* model, const char* filename
     sta_deallocate(obj.faces, sizeof(WavefrontFace) * obj.face_capacity);
     sta_deallocate(obj.normals, sizeof(Vector3) * obj.normal_capacity);
   }
+  sta_deallocate(slots, sizeof(u32) * slot_count);
+  sta_deallocate(keys, sizeof(WavefrontVertexData) * corner_count);
+
+  model->vertex_count = vertex_count;
+  model->vertices     = sta_allocate_struct(VertexData, vertex_count);
+  memcpy(model->vertices, vertices, sizeof(VertexData) * vertex_count);
+  sta_deallocate(vertices, sizeof(VertexData) * corner_count);
 
   float diff = high - low;
   for (unsigned int i = 0; i < model->vertex_count; i++)
@@ -1602,6 +2179,191 @@ bool sta_parse_wavefront_object_from_file(ModelData* model, const char* filename
   return true;
 }
 
+static f32 vertex_cache_miss_ratio(u32* indices, u64 index_count, u64 vertex_count)
+{
+  // time + 1 of when the vertex went into the FIFO, 0 if it never did
+  u64* inserted_at = sta_allocate_struct(u64, vertex_count);
+  u64  misses      = 0;
+  for (u64 i = 0; i < index_count; i++)
+  {
+    u32 vertex = indices[i];
+    if (inserted_at[vertex] == 0 || misses - inserted_at[vertex] >= VERTEX_CACHE_SIZE)
+    {
+      misses++;
+      inserted_at[vertex] = misses;
+    }
+  }
+  sta_deallocate(inserted_at, sizeof(u64) * vertex_count);
+
+  return index_count < 3 ? 0.0f : (f32)misses / (f32)(index_count / 3);
+}
+
+// Favours the vertices that were just used and the ones with few triangles left,
+// so lone triangles are cleared out before they fall out of the cache
+static f32 vertex_cache_score(i32 cache_position, u32 remaining_triangles)
+{
+  if (remaining_triangles == 0)
+  {
+    return -1.0f;
+  }
+
+  f32 score = 0.0f;
+  if (cache_position >= 0)
+  {
+    if (cache_position < 3)
+    {
+      score = 0.75f;
+    }
+    else
+    {
+      score = powf(1.0f - (f32)(cache_position - 3) / (f32)(VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+  }
+
+  return score + 2.0f * powf((f32)remaining_triangles, -0.5f);
+}
+
+void sta_optimize_vertex_cache(u32* indices, u64 index_count, u64 vertex_count, f32* acmr_before, f32* acmr_after)
+{
+  *acmr_before = vertex_cache_miss_ratio(indices, index_count, vertex_count);
+  *acmr_after  = *acmr_before;
+  if (index_count < 3 || index_count % 3 != 0)
+  {
+    return;
+  }
+
+  u64  triangle_count   = index_count / 3;
+  u32* remaining        = sta_allocate_struct(u32, vertex_count);
+  u32* offsets          = sta_allocate_struct(u32, vertex_count + 1);
+  u32* vertex_triangles = sta_allocate_struct(u32, index_count);
+  i32* cache_position   = sta_allocate_struct(i32, vertex_count);
+  f32* vertex_score     = sta_allocate_struct(f32, vertex_count);
+  f32* triangle_score   = sta_allocate_struct(f32, triangle_count);
+  u8*  emitted          = sta_allocate_struct(u8, triangle_count);
+  u32* output           = sta_allocate_struct(u32, index_count);
+
+  for (u64 i = 0; i < index_count; i++)
+  {
+    remaining[indices[i]]++;
+  }
+  for (u64 i = 0; i < vertex_count; i++)
+  {
+    offsets[i + 1] = offsets[i] + remaining[i];
+  }
+  // cache_position doubles as the fill cursor of every vertex's triangle list
+  for (u64 i = 0; i < index_count; i++)
+  {
+    u32 vertex                                                 = indices[i];
+    vertex_triangles[offsets[vertex] + cache_position[vertex]] = i / 3;
+    cache_position[vertex]++;
+  }
+  for (u64 i = 0; i < vertex_count; i++)
+  {
+    cache_position[i] = -1;
+    vertex_score[i]   = vertex_cache_score(-1, remaining[i]);
+  }
+
+  i64 best       = -1;
+  f32 best_score = -1.0f;
+  for (u64 i = 0; i < triangle_count; i++)
+  {
+    u32* triangle     = &indices[i * 3];
+    triangle_score[i] = vertex_score[triangle[0]] + vertex_score[triangle[1]] + vertex_score[triangle[2]];
+    if (triangle_score[i] > best_score)
+    {
+      best       = i;
+      best_score = triangle_score[i];
+    }
+  }
+
+  u32 cache[VERTEX_CACHE_SIZE + 3];
+  u32 cache_count    = 0;
+  u64 next_unemitted = 0;
+  for (u64 emitted_count = 0; emitted_count < triangle_count; emitted_count++)
+  {
+    // nothing left touching the cache, just continue with the first triangle left
+    if (best < 0)
+    {
+      while (emitted[next_unemitted])
+      {
+        next_unemitted++;
+      }
+      best = next_unemitted;
+    }
+
+    emitted[best] = true;
+    u32* triangle = &indices[best * 3];
+    memcpy(&output[emitted_count * 3], triangle, sizeof(u32) * 3);
+
+    u32 next_cache[VERTEX_CACHE_SIZE + 3];
+    u32 next_cache_count = 0;
+    for (u32 i = 0; i < 3; i++)
+    {
+      u32  vertex    = triangle[i];
+      u32* triangles = &vertex_triangles[offsets[vertex]];
+      for (u32 j = 0; j < remaining[vertex]; j++)
+      {
+        if (triangles[j] == best)
+        {
+          triangles[j] = triangles[remaining[vertex] - 1];
+          break;
+        }
+      }
+      remaining[vertex]--;
+      next_cache[next_cache_count++] = vertex;
+    }
+    for (u32 i = 0; i < cache_count; i++)
+    {
+      u32 vertex = cache[i];
+      if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+      {
+        next_cache[next_cache_count++] = vertex;
+      }
+    }
+
+    cache_count = MIN(next_cache_count, VERTEX_CACHE_SIZE);
+    for (u32 i = 0; i < next_cache_count; i++)
+    {
+      u32 vertex             = next_cache[i];
+      cache_position[vertex] = i < cache_count ? (i32)i : -1;
+      vertex_score[vertex]   = vertex_cache_score(cache_position[vertex], remaining[vertex]);
+    }
+
+    // only triangles around the vertices that moved can have changed score
+    best       = -1;
+    best_score = -1.0f;
+    for (u32 i = 0; i < next_cache_count; i++)
+    {
+      u32  vertex    = next_cache[i];
+      u32* triangles = &vertex_triangles[offsets[vertex]];
+      for (u32 j = 0; j < remaining[vertex]; j++)
+      {
+        u32  t            = triangles[j];
+        u32* other        = &indices[t * 3];
+        triangle_score[t] = vertex_score[other[0]] + vertex_score[other[1]] + vertex_score[other[2]];
+        if (triangle_score[t] > best_score)
+        {
+          best       = t;
+          best_score = triangle_score[t];
+        }
+      }
+    }
+    memcpy(cache, next_cache, sizeof(u32) * cache_count);
+  }
+  memcpy(indices, output, sizeof(u32) * index_count);
+
+  sta_deallocate(remaining, sizeof(u32) * vertex_count);
+  sta_deallocate(offsets, sizeof(u32) * (vertex_count + 1));
+  sta_deallocate(vertex_triangles, sizeof(u32) * index_count);
+  sta_deallocate(cache_position, sizeof(i32) * vertex_count);
+  sta_deallocate(vertex_score, sizeof(f32) * vertex_count);
+  sta_deallocate(triangle_score, sizeof(f32) * triangle_count);
+  sta_deallocate(emitted, sizeof(u8) * triangle_count);
+  sta_deallocate(output, sizeof(u32) * index_count);
+
+  *acmr_after = vertex_cache_miss_ratio(indices, index_count, vertex_count);
+}
+
 bool convert_obj_to_model(const char* input_filename, const char* output_filename)
 {
   ModelData model = {};
@@ -1612,10 +2374,11 @@ bool convert_obj_to_model(const char* input_filename, const char* output_filenam
     return false;
   }
 
-  fprintf(file_ptr, "%ld\n", model.vertex_count);
-  for (u64 i = 0; i < model.vertex_count; i++)
+  // the .model format is unindexed, one vertex per corner
+  fprintf(file_ptr, "%ld\n", model.index_count);
+  for (u64 i = 0; i < model.index_count; i++)
   {
-    VertexData vertex_data = model.vertices[i];
+    VertexData vertex_data = model.vertices[model.indices[i]];
     Vector3    vertex      = vertex_data.vertex;
     fprintf(file_ptr, "%lf %lf %lf ", vertex.x, vertex.y, vertex.z);
 
@@ -1624,7 +2387,7 @@ bool convert_obj_to_model(const char* input_filename, const char* output_filenam
 
     Vector3 normal = vertex_data.normal;
     fprintf(file_ptr, "%lf %lf %lf", normal.x, normal.y, normal.z);
-    if (i < model.vertex_count - 1)
+    if (i < model.index_count - 1)
     {
       fprintf(file_ptr, "\n");
     }
@@ -84,11 +84,14 @@ struct VertexData
   Vector3 normal;
 };
 
+#define VERTEX_CACHE_SIZE 32
+
 struct ModelData
 {
   VertexData* vertices;
   u32*        indices;
   u64         vertex_count;
+  u64         index_count;
 };
 
 struct TargaImage
@@ -100,6 +103,57 @@ struct TargaImage
 typedef struct TargaImage TargaImage;
 typedef struct TargaImage Image;
 
+// Decoded on a worker by sta_targa_read_job, image and ok are only valid once done is set
+struct TargaLoad
+{
+  const char* location;
+  TargaImage  image;
+  bool        ok;
+  bool        done;
+};
+
+enum CookedTextureFormat
+{
+  COOKED_TEXTURE_BC1,
+  COOKED_TEXTURE_BC3,
+  // two channel, for normal maps where z is rebuilt in the shader
+  COOKED_TEXTURE_BC5,
+};
+
+// "STX1"
+#define COOKED_TEXTURE_MAGIC    0x31585453
+#define COOKED_TEXTURE_MAX_MIPS 16
+
+// Header of a .stex file, every mip level down to 1x1 follows it as raw compressed blocks
+struct CookedTextureHeader
+{
+  u32 magic;
+  u32 format;
+  u32 width;
+  u32 height;
+  u32 mip_count;
+  u32 mip_offsets[COOKED_TEXTURE_MAX_MIPS];
+  u32 mip_sizes[COOKED_TEXTURE_MAX_MIPS];
+};
+
+struct CookedTexture
+{
+  CookedTextureHeader* header;
+  Buffer               file;
+};
+
+// Reads the cooked .stex next to the targa if there is one (and compressed is allowed), decodes the targa otherwise
+struct TextureLoad
+{
+  const char*   location;
+  TargaImage    image;
+  CookedTexture cooked;
+  bool          allow_compressed;
+  bool          compressed;
+  bool          ok;
+  bool          done;
+};
+
 struct TargaHeader
 {
   union
@@ -154,6 +208,18 @@ struct JsonValue;
 struct JsonObject;
 struct JsonArray;
 
+// View into the source the document was parsed from, not null terminated
+struct JsonString
+{
+  char* buffer;
+  u32   length;
+
+public:
+  bool  equals(const char* s);
+  // null terminated copy that outlives the document
+  char* copy();
+};
+
 struct JsonValue
 {
 public:
@@ -163,12 +229,14 @@ public:
     struct JsonObject* obj;
     struct JsonArray*  arr;
     bool               b;
-    char*              string;
+    JsonString         string;
     float              number;
   };
 };
 typedef struct JsonValue JsonValue;
 
+// Keys are hashed into an open addressed table when the object is closed,
+// slots hold the key index + 1 and 0 means empty
 struct JsonObject
 {
 public:
@@ -176,25 +244,35 @@ public:
   {
     for (u32 i = 0; i < size; i++)
     {
-      printf("%s\n", keys[i]);
+      printf("%.*s\n", (i32)keys[i].length, keys[i].buffer);
     }
   }
-  JsonValue* lookup_value(const char* key);
-  char**     keys;
-  JsonValue* values;
-  u64        size;
-  u64        cap;
+  JsonValue*  lookup_value(const char* key);
+  JsonString* keys;
+  JsonValue*  values;
+  u32*        hashes;
+  u32*        slots;
+  u32         slot_mask;
+  u64         size;
 };
 typedef struct JsonObject JsonObject;
 
 struct JsonArray
 {
   uint32_t   arraySize;
-  uint32_t   arrayCap;
   JsonValue* values;
 };
 typedef struct JsonArray JsonArray;
 
+// Every node of a document lives in these, a new block is chained on once the current one is full
+#define JSON_BLOCK_SIZE (64 * 1024)
+struct JsonBlock
+{
+  JsonBlock* next;
+  u64        size;
+  Arena      arena;
+};
+
 struct Json
 {
   JsonType headType;
@@ -204,6 +282,9 @@ struct Json
     JsonObject obj;
     JsonArray  array;
   };
+  JsonBlock* blocks;
+  // only set when the document mapped its own file, the strings point into it
+  Buffer     source;
 };
 typedef struct Json Json;
 
@@ -305,6 +386,9 @@ void  sta_xml_write_to_file(XML* xml, const char* filename);
 
 bool  sta_json_deserialize_from_string(Buffer* buffer, Json* json);
 bool  sta_json_deserialize_from_file(Arena* arena, Json* json, const char* filename);
+bool  sta_json_deserialize_from_file(Json* json, const char* filename);
+void  sta_json_free(Json* json);
+char* sta_json_c_string(Json* json, JsonString* string);
 bool  sta_json_serialize_to_file(Json* json, const char* filename);
 void  sta_json_debug(Json* json);
 void  sta_json_debug_object(JsonObject* object);
@@ -320,12 +404,28 @@ void  sta_targa_save_to_file(TargaImage* image, const char* filename);
 bool  sta_ppm_write_to_file(const char* filename, u8* data, u64 width, u64 height);
 void  sta_draw_rect_to_image(u8* data, u64 image_width, u64 x, u64 y, u64 width, u64 height, u8 r, u8 g, u8 b, u8 a);
 bool  sta_targa_read_from_file_rgba(TargaImage* image, const char* filename);
+// Decodes an uncompressed or RLE 24/32 bit targa in memory into RGBA
+bool  sta_targa_decode_rgba(TargaImage* image, Buffer* file);
+void  sta_targa_read_job(void* data);
+void  sta_texture_read_job(void* data);
+// Replaces the extension of location with .stex
+void  sta_cooked_texture_location(char* output, u32 output_size, const char* location);
+bool  sta_cook_texture(const char* input_filename, const char* output_filename, bool normal_map);
+bool  sta_cooked_texture_read(CookedTexture* texture, const char* filename);
+void  sta_cooked_texture_free(CookedTexture* texture);
 bool  sta_targa_read_from_file(Arena* arena, TargaImage* image, const char* filename);
 bool  sta_read_file(Arena* arena, Buffer* string, const char* fileName);
 bool  sta_read_file(Buffer* buffer, const char* fileName);
+// Read only view straight over the file, the byte at buffer->len is always 0.
+// Anything that keeps pointers into it has to keep it mapped
+bool  sta_map_file(Buffer* buffer, const char* filename);
+void  sta_unmap_file(Buffer* buffer);
 bool  sta_append_to_file(const char* filename, const char* message);
 
 bool  sta_parse_wavefront_object_from_file(ModelData* model, const char* filename);
+// Reorders the triangles of an indexed triangle list for the post transform vertex cache (Forsyth),
+// returns the average cache miss ratio before and after for a FIFO cache of VERTEX_CACHE_SIZE
+void  sta_optimize_vertex_cache(u32* indices, u64 index_count, u64 vertex_count, f32* acmr_before, f32* acmr_after);
 bool  sta_convert_obj_to_model(const char* input_filename, const char* output_filename);
 void change_obj_to_y_up(const char* filename, const char* outname);
 
@@ -118,8 +118,11 @@ static void read_simple_glyph(Glyph* glyph, Buffer* buffer, int n)
     // skip instructions
     buffer->advance(read_u16(buffer));
 
-    u16 number_of_points = simple->end_pts_of_contours[simple->n - 1] + 1;
-    u8* flags            = (u8*)sta_allocate_struct(u8, number_of_points);
+    u16 number_of_points  = simple->end_pts_of_contours[simple->n - 1] + 1;
+    // coordinates and flags share one allocation, the flags are reduced to the on curve bit once read
+    simple->x_coordinates = (i16*)sta_allocate(sizeof(i16) * number_of_points * 2 + number_of_points);
+    simple->y_coordinates = &simple->x_coordinates[number_of_points];
+    u8* flags             = (u8*)&simple->y_coordinates[number_of_points];
     for (u32 i = 0; i < number_of_points; i++)
     {
       u8 flag  = buffer->advance();
@@ -135,16 +138,18 @@ static void read_simple_glyph(Glyph* glyph, Buffer* buffer, int n)
         assert(i <= number_of_points && "Repeated past the end?");
       }
     }
-    simple->x_coordinates = (i16*)sta_allocate_struct(i16, number_of_points * 2);
-    simple->y_coordinates = &simple->x_coordinates[number_of_points];
-
     read_coordinates(simple->x_coordinates, flags, number_of_points, buffer, true);
     read_coordinates(simple->y_coordinates, flags, number_of_points, buffer, false);
 
+    for (u32 i = 0; i < number_of_points; i++)
+    {
+      flags[i] &= 1;
+    }
+    simple->on_curve = flags;
+
     if (should_be_compound(glyph))
     {
     }
-    sta_deallocate(flags, number_of_points);
   }
 }
 
@@ -182,12 +187,22 @@ static void get_all_glyph_locations(Table* tables, char* buf, u32** glyph_locati
 
 Glyph AFont::get_glyph(u32 code)
 {
-  for (u32 i = 0; i < this->glyph_count; i++)
+  u32 low = 0, high = this->char_code_count;
+  while (low < high)
   {
-    if (this->char_codes[i] == code)
+    u32 mid = low + (high - low) / 2;
+    if (this->char_codes[mid] < code)
     {
-      return this->glyphs[this->glyph_indices[i]];
+      low = mid + 1;
     }
+    else
+    {
+      high = mid;
+    }
+  }
+  if (low < this->char_code_count && this->char_codes[low] == code && this->glyph_indices[low] < this->glyph_count)
+  {
+    return this->glyphs[this->glyph_indices[low]];
   }
   return this->glyphs[0];
 }
@@ -325,10 +340,18 @@ static void parse_all_glyphs(char* buf, Glyph** glyphs, u32* glyph_locations, u3
   *glyphs = g;
 }
 
+static int compare_char_code_pairs(const void* _a, const void* _b)
+{
+  u64 a = *(u64*)_a;
+  u64 b = *(u64*)_b;
+  return a < b ? -1 : a > b ? 1 : 0;
+}
+
 void parse_mapping(char* buf, AFont* font, Table* cmap_table)
 {
   Buffer buffer(buf + cmap_table->offset);
-  cmap_table->cmap                      = (TableCmap*)buffer.current_address();
+  cmap_table->cmap                      = (TableCmap*)sta_allocate_struct(TableCmap, 1);
+  *cmap_table->cmap                     = *(TableCmap*)buffer.current_address();
   cmap_table->cmap->version             = swap_u16(cmap_table->cmap->version);
   cmap_table->cmap->number_of_subtables = swap_u16(cmap_table->cmap->number_of_subtables);
   buffer.advance(sizeof(TableCmap));
@@ -362,8 +385,7 @@ void parse_mapping(char* buf, AFont* font, Table* cmap_table)
   u16 format   = read_u16(&buffer);
 
   assert((format == 4 || format == 12) && "Can't parse this font format");
-  font->char_codes    = (u32*)sta_allocate_struct(u32, font->glyph_count);
-  font->glyph_indices = (u32*)sta_allocate_struct(u32, font->glyph_count);
+  u32 read_indices = 0;
 
   if (format == 4)
   {
@@ -398,7 +420,14 @@ void parse_mapping(char* buf, AFont* font, Table* cmap_table)
       id_range[i] = read_u16(&buffer);
     }
 
-    u32 read_indices = 0;
+    u32 code_count = 0;
+    for (u32 i = 0; i < seg_count && start_codes[i] != UINT16_MAX; i++)
+    {
+      code_count += end_codes[i] - start_codes[i] + 1;
+    }
+    font->char_codes    = (u32*)sta_allocate_struct(u32, code_count);
+    font->glyph_indices = (u32*)sta_allocate_struct(u32, code_count);
+
     for (u32 i = 0; i < seg_count; i++)
     {
       u16 start_code = start_codes[i];
@@ -409,18 +438,18 @@ void parse_mapping(char* buf, AFont* font, Table* cmap_table)
         break;
       }
 
-      for (; start_code <= end_code; start_code++)
+      for (u32 code = start_code; code <= end_code; code++)
       {
         u32 glyph_index;
         if (id_offset[i] == 0)
         {
-          glyph_index = (start_code + id_delta[i]) % (UINT16_MAX + 1);
+          glyph_index = (code + id_delta[i]) % (UINT16_MAX + 1);
         }
         else
         {
           u32 current_idx                = buffer.index;
           i32 range_offset_location      = id_range[i] + id_offset[i];
-          i32 glyph_index_array_location = 2 * (start_code - start_codes[i]) + range_offset_location;
+          i32 glyph_index_array_location = 2 * (code - start_codes[i]) + range_offset_location;
 
           buffer.index                   = glyph_index_array_location;
           glyph_index                    = read_u16(&buffer);
@@ -434,7 +463,7 @@ void parse_mapping(char* buf, AFont* font, Table* cmap_table)
         }
 
         font->glyph_indices[read_indices] = glyph_index;
-        font->char_codes[read_indices++]  = start_code;
+        font->char_codes[read_indices++]  = code;
       }
     }
   }
@@ -443,9 +472,21 @@ void parse_mapping(char* buf, AFont* font, Table* cmap_table)
   {
     buffer.advance(sizeof(u16) + sizeof(u32) * 2);
 
-    u32 n_groups     = read_u32(&buffer);
+    u32 n_groups    = read_u32(&buffer);
+
+    u32 groups_start = buffer.index;
+    u32 code_count   = 0;
+    for (u32 i = 0; i < n_groups; i++)
+    {
+      u32 start_char_code = read_u32(&buffer);
+      u32 end_char_code   = read_u32(&buffer);
+      (void)read_u32(&buffer);
+      code_count += end_char_code - start_char_code + 1;
+    }
+    font->char_codes    = (u32*)sta_allocate_struct(u32, code_count);
+    font->glyph_indices = (u32*)sta_allocate_struct(u32, code_count);
+    buffer.index        = groups_start;
 
-    u32 read_indices = 0;
     for (u32 i = 0; i < n_groups; i++)
     {
       u32 start_char_code  = read_u32(&buffer);
@@ -457,10 +498,24 @@ void parse_mapping(char* buf, AFont* font, Table* cmap_table)
         font->char_codes[read_indices]    = start_char_code + j;
         font->glyph_indices[read_indices] = start_glyph_code + j;
         read_indices++;
-        assert(read_indices <= font->glyph_count && "Read more then count?");
       }
     }
   }
+  font->char_code_count = read_indices;
+
+  // segments and groups are usually already in order, but nothing requires it
+  u64* pairs = (u64*)sta_allocate_struct(u64, read_indices);
+  for (u32 i = 0; i < read_indices; i++)
+  {
+    pairs[i] = ((u64)font->char_codes[i] << 32) | font->glyph_indices[i];
+  }
+  qsort(pairs, read_indices, sizeof(u64), compare_char_code_pairs);
+  for (u32 i = 0; i < read_indices; i++)
+  {
+    font->char_codes[i]    = pairs[i] >> 32;
+    font->glyph_indices[i] = pairs[i] & 0xFFFFFFFF;
+  }
+  sta_deallocate(pairs, sizeof(u64) * read_indices);
 }
 
 static void read_table_hhea(Table* table, u32 offset, char* buf)
@@ -495,6 +550,11 @@ static void parse_advance_widths(AFont* font, Table* hhea, Table* hmtx, char* bu
     metrics[i].left_side_bearing  = read_u16(&buffer);
     font->glyphs[i].advance_width = metrics[i].advance_width;
   }
+  // glyphs past the long metrics share the advance of the last one
+  for (u32 i = number_of_metrics; i < font->glyph_count && number_of_metrics > 0; i++)
+  {
+    font->glyphs[i].advance_width = metrics[number_of_metrics - 1].advance_width;
+  }
 }
 
 TableDirectory TableDirectory::read(Buffer* buffer)
@@ -505,16 +565,16 @@ TableDirectory TableDirectory::read(Buffer* buffer)
   return directory;
 }
 
-void AFont::parse_ttf(const char* filename)
+bool AFont::parse_ttf(const char* filename)
 {
 
   Table  tables[DUMMY_TABLE_TYPE];
   Buffer buffer = {};
-  bool   result = sta_read_file(&buffer, filename);
+  bool   result = sta_map_file(&buffer, filename);
   if (!result)
   {
     printf("Couldn find file %s\n", filename);
-    return;
+    return false;
   }
   TableDirectory directory = TableDirectory::read(&buffer);
 
@@ -548,7 +608,8 @@ void AFont::parse_ttf(const char* filename)
     {
       Table* table = &tables[TABLE_MAXP];
       table->type  = TABLE_MAXP;
-      table->maxp  = (TableMaxp*)&buffer.buffer[record.offset];
+      table->maxp  = (TableMaxp*)sta_allocate_struct(TableMaxp, 1);
+      *table->maxp = *(TableMaxp*)&buffer.buffer[record.offset];
       table->maxp->swap_endianess();
     }
     else if (record.match_tag("loca"))
@@ -584,7 +645,391 @@ void AFont::parse_ttf(const char* filename)
   parse_all_glyphs(buffer.buffer, &this->glyphs, glyph_locations, this->glyph_count);
   parse_advance_widths(this, &tables[TABLE_HHEA], &tables[TABLE_HMTX], buffer.buffer);
   parse_mapping(buffer.buffer, this, &tables[TABLE_CMAP]);
+  this->ascent   = tables[TABLE_HHEA].hhea->ascent;
+  this->descent  = tables[TABLE_HHEA].hhea->descent;
+  this->line_gap = tables[TABLE_HHEA].hhea->line_gap;
+  sta_unmap_file(&buffer);
+  return true;
+}
+
+// Edges of the flattened outline in bitmap space, y0 < y1 and winding is which way the original went
+struct GlyphEdge
+{
+  f32 x0, y0;
+  f32 x1, y1;
+  i32 winding;
+};
+
+struct GlyphEdges
+{
+  GlyphEdge* edges;
+  u32        count;
+  u32        capacity;
+  f32        scale;
+  f32        offset_x, offset_y;
+};
+
+#define GLYPH_SUBSAMPLES  4
+#define GLYPH_ATLAS_PAD   1
+#define GLYPH_MAX_SEGMENTS 16
+
+static void add_glyph_edge(GlyphEdges* edges, f32 x0, f32 y0, f32 x1, f32 y1)
+{
+  if (y0 == y1)
+  {
+    return;
+  }
+  RESIZE_ARRAY(edges->edges, GlyphEdge, edges->count, edges->capacity);
+  GlyphEdge* edge = &edges->edges[edges->count++];
+  if (y0 < y1)
+  {
+    *edge = {x0, y0, x1, y1, 1};
+  }
+  else
+  {
+    *edge = {x1, y1, x0, y0, -1};
+  }
+}
+
+static void add_glyph_quadratic(GlyphEdges* edges, f32 x0, f32 y0, f32 cx, f32 cy, f32 x1, f32 y1)
+{
+  // enough segments that each one is about two pixels long
+  f32 length   = sqrtf((cx - x0) * (cx - x0) + (cy - y0) * (cy - y0)) + sqrtf((x1 - cx) * (x1 - cx) + (y1 - cy) * (y1 - cy));
+  u32 segments = CLAMP((u32)(length * 0.5f) + 1, 1, GLYPH_MAX_SEGMENTS);
+
+  f32 prev_x = x0, prev_y = y0;
+  for (u32 i = 1; i <= segments; i++)
+  {
+    f32 t = i / (f32)segments;
+    f32 u = 1.0f - t;
+    f32 x = u * u * x0 + 2 * u * t * cx + t * t * x1;
+    f32 y = u * u * y0 + 2 * u * t * cy + t * t * y1;
+    add_glyph_edge(edges, prev_x, prev_y, x, y);
+    prev_x = x;
+    prev_y = y;
+  }
+}
+
+// Walks every contour, consecutive off curve points have an implied on curve point between them
+static void flatten_glyph(GlyphEdges* edges, Glyph* glyph)
+{
+  if (!glyph->s)
+  {
+    for (u32 i = 0; i < glyph->compound.glyph_count; i++)
+    {
+      flatten_glyph(edges, &glyph->compound.glyphs[i]);
+    }
+    return;
+  }
+
+  SimpleGlyph* simple = &glyph->simple;
+  u32          start  = 0;
+  for (u32 contour = 0; contour < simple->n; contour++)
+  {
+    u32 end   = simple->end_pts_of_contours[contour];
+    u32 count = end - start + 1;
+
+    f32 xs[count], ys[count];
+    u32 first_on_curve = count;
+    for (u32 i = 0; i < count; i++)
+    {
+      xs[i] = simple->x_coordinates[start + i] * edges->scale - edges->offset_x;
+      ys[i] = edges->offset_y - simple->y_coordinates[start + i] * edges->scale;
+      if (first_on_curve == count && simple->on_curve[start + i])
+      {
+        first_on_curve = i;
+      }
+    }
+
+    f32 start_x, start_y;
+    u32 first;
+    if (first_on_curve == count)
+    {
+      start_x = (xs[count - 1] + xs[0]) * 0.5f;
+      start_y = (ys[count - 1] + ys[0]) * 0.5f;
+      first   = 0;
+    }
+    else
+    {
+      start_x = xs[first_on_curve];
+      start_y = ys[first_on_curve];
+      first   = first_on_curve + 1;
+    }
+
+    f32  x = start_x, y = start_y;
+    f32  control_x = 0, control_y = 0;
+    bool has_control = false;
+    for (u32 step = 0; step < count; step++)
+    {
+      u32 i = (first + step) % count;
+      if (first_on_curve != count && i == first_on_curve)
+      {
+        break;
+      }
+      if (simple->on_curve[start + i])
+      {
+        if (has_control)
+        {
+          add_glyph_quadratic(edges, x, y, control_x, control_y, xs[i], ys[i]);
+        }
+        else
+        {
+          add_glyph_edge(edges, x, y, xs[i], ys[i]);
+        }
+        x           = xs[i];
+        y           = ys[i];
+        has_control = false;
+      }
+      else
+      {
+        if (has_control)
+        {
+          f32 mid_x = (control_x + xs[i]) * 0.5f;
+          f32 mid_y = (control_y + ys[i]) * 0.5f;
+          add_glyph_quadratic(edges, x, y, control_x, control_y, mid_x, mid_y);
+          x = mid_x;
+          y = mid_y;
+        }
+        control_x   = xs[i];
+        control_y   = ys[i];
+        has_control = true;
+      }
+    }
+    if (has_control)
+    {
+      add_glyph_quadratic(edges, x, y, control_x, control_y, start_x, start_y);
+    }
+    else
+    {
+      add_glyph_edge(edges, x, y, start_x, start_y);
+    }
+
+    start = end + 1;
+  }
+}
+
+static void glyph_bounds(Glyph* glyph, i32* min_x, i32* min_y, i32* max_x, i32* max_y)
+{
+  if (!glyph->s)
+  {
+    for (u32 i = 0; i < glyph->compound.glyph_count; i++)
+    {
+      glyph_bounds(&glyph->compound.glyphs[i], min_x, min_y, max_x, max_y);
+    }
+    return;
+  }
+  SimpleGlyph* simple = &glyph->simple;
+  if (simple->n == 0)
+  {
+    return;
+  }
+  for (u32 i = 0; i <= simple->end_pts_of_contours[simple->n - 1]; i++)
+  {
+    *min_x = MIN(*min_x, simple->x_coordinates[i]);
+    *max_x = MAX(*max_x, simple->x_coordinates[i]);
+    *min_y = MIN(*min_y, simple->y_coordinates[i]);
+    *max_y = MAX(*max_y, simple->y_coordinates[i]);
+  }
+}
+
+// Non zero winding scanline fill, every pixel row is sampled at GLYPH_SUBSAMPLES heights
+// and the spans add their exact horizontal coverage so edges come out antialiased
+static void rasterize_glyph_edges(GlyphEdges* edges, u8* out, u32 stride, u32 width, u32 height)
+{
+  f32 coverage[width + 1];
+  f32 crossings[edges->count];
+  i32 windings[edges->count];
+  f32 weight = 1.0f / GLYPH_SUBSAMPLES;
+
+  for (u32 row = 0; row < height; row++)
+  {
+    memset(coverage, 0, sizeof(f32) * (width + 1));
+    for (u32 sample = 0; sample < GLYPH_SUBSAMPLES; sample++)
+    {
+      f32 y              = row + (sample + 0.5f) * weight;
+      u32 crossing_count = 0;
+      for (u32 i = 0; i < edges->count; i++)
+      {
+        GlyphEdge* edge = &edges->edges[i];
+        if (y < edge->y0 || y >= edge->y1)
+        {
+          continue;
+        }
+        f32 x = edge->x0 + (y - edge->y0) * (edge->x1 - edge->x0) / (edge->y1 - edge->y0);
+
+        // few crossings per line, insertion sort keeps them ordered by x
+        u32 j = crossing_count++;
+        while (j > 0 && crossings[j - 1] > x)
+        {
+          crossings[j] = crossings[j - 1];
+          windings[j]  = windings[j - 1];
+          j--;
+        }
+        crossings[j] = x;
+        windings[j]  = edge->winding;
+      }
+
+      i32 winding = 0;
+      for (u32 i = 0; i + 1 < crossing_count; i++)
+      {
+        winding += windings[i];
+        if (winding == 0)
+        {
+          continue;
+        }
+        f32 x0 = CLAMP(crossings[i], 0.0f, (f32)width);
+        f32 x1 = CLAMP(crossings[i + 1], 0.0f, (f32)width);
+        if (x1 <= x0)
+        {
+          continue;
+        }
+        u32 first = (u32)x0;
+        u32 last  = (u32)x1;
+        if (first == last)
+        {
+          coverage[first] += (x1 - x0) * weight;
+          continue;
+        }
+        coverage[first] += (first + 1 - x0) * weight;
+        for (u32 x = first + 1; x < last; x++)
+        {
+          coverage[x] += weight;
+        }
+        coverage[last] += (x1 - last) * weight;
+      }
+    }
+
+    u8* line = &out[row * stride];
+    for (u32 x = 0; x < width; x++)
+    {
+      line[x] = (u8)(MIN(coverage[x], 1.0f) * 255.0f + 0.5f);
+    }
+  }
+}
+
+void sta_glyph_atlas_init(GlyphAtlas* atlas, u32 width, u32 height)
+{
+  atlas->width          = width;
+  atlas->height         = height;
+  atlas->pixels         = (u8*)sta_allocate(width * height);
+  atlas->shelf_x        = 0;
+  atlas->shelf_y        = 0;
+  atlas->shelf_height   = 0;
+  atlas->entry_count    = 0;
+  atlas->entry_capacity = 256;
+  atlas->entries        = sta_allocate_struct(GlyphAtlasEntry, atlas->entry_capacity);
+  atlas->dirty_min_y    = height;
+  atlas->dirty_max_y    = 0;
+  atlas->full           = false;
+}
+
+static GlyphAtlasEntry* find_glyph_atlas_slot(GlyphAtlasEntry* entries, u32 capacity, u32 code, u32 pixel_size)
+{
+  u32    key[2] = {code, pixel_size};
+  String key_string((char*)key, sizeof(key));
+  u32    slot = sta_hash_string_fnv(&key_string) & (capacity - 1);
+  while (entries[slot].used && (entries[slot].code != code || entries[slot].pixel_size != pixel_size))
+  {
+    slot = (slot + 1) & (capacity - 1);
+  }
+  return &entries[slot];
+}
+
+static void grow_glyph_atlas_entries(GlyphAtlas* atlas)
+{
+  u32              capacity = atlas->entry_capacity * 2;
+  GlyphAtlasEntry* entries  = sta_allocate_struct(GlyphAtlasEntry, capacity);
+  for (u32 i = 0; i < atlas->entry_capacity; i++)
+  {
+    GlyphAtlasEntry* entry = &atlas->entries[i];
+    if (entry->used)
+    {
+      *find_glyph_atlas_slot(entries, capacity, entry->code, entry->pixel_size) = *entry;
+    }
+  }
+  sta_deallocate(atlas->entries, sizeof(GlyphAtlasEntry) * atlas->entry_capacity);
+  atlas->entries        = entries;
+  atlas->entry_capacity = capacity;
+}
+
+// Only a miss rasterizes, every later lookup of the same code and size is a probe into the table
+GlyphAtlasEntry* sta_glyph_atlas_get(GlyphAtlas* atlas, AFont* font, u32 code, u32 pixel_size)
+{
+  GlyphAtlasEntry* entry = find_glyph_atlas_slot(atlas->entries, atlas->entry_capacity, code, pixel_size);
+  if (entry->used)
+  {
+    return entry;
+  }
+
+  if ((atlas->entry_count + 1) * 2 > atlas->entry_capacity)
+  {
+    grow_glyph_atlas_entries(atlas);
+    entry = find_glyph_atlas_slot(atlas->entries, atlas->entry_capacity, code, pixel_size);
+  }
+  atlas->entry_count++;
+
+  Glyph glyph       = font->get_glyph(code);
+  f32   scale       = pixel_size * font->scale;
+  *entry            = {};
+  entry->code       = code;
+  entry->pixel_size = pixel_size;
+  entry->advance    = glyph.advance_width * scale;
+  entry->used       = true;
+
+  i32 min_x = INT32_MAX, min_y = INT32_MAX, max_x = INT32_MIN, max_y = INT32_MIN;
+  glyph_bounds(&glyph, &min_x, &min_y, &max_x, &max_y);
+  if (min_x > max_x || atlas->full)
+  {
+    return entry;
+  }
+
+  i32 left   = (i32)floorf(min_x * scale);
+  i32 right  = (i32)ceilf(max_x * scale);
+  i32 top    = (i32)floorf(-max_y * scale);
+  i32 bottom = (i32)ceilf(-min_y * scale);
+  u32 width  = MAX(right - left, 1);
+  u32 height = MAX(bottom - top, 1);
+
+  if (atlas->shelf_x + width + GLYPH_ATLAS_PAD > atlas->width)
+  {
+    atlas->shelf_x = 0;
+    atlas->shelf_y += atlas->shelf_height;
+    atlas->shelf_height = 0;
+  }
+  if (width + GLYPH_ATLAS_PAD > atlas->width || atlas->shelf_y + height + GLYPH_ATLAS_PAD > atlas->height)
+  {
+    atlas->full = true;
+    return entry;
+  }
+
+  entry->x         = atlas->shelf_x;
+  entry->y         = atlas->shelf_y;
+  entry->w         = width;
+  entry->h         = height;
+  entry->bearing_x = left;
+  entry->bearing_y = top;
+  atlas->shelf_x += width + GLYPH_ATLAS_PAD;
+  atlas->shelf_height = MAX(atlas->shelf_height, height + GLYPH_ATLAS_PAD);
+
+  GlyphEdges edges = {};
+  edges.capacity   = 64;
+  edges.edges      = sta_allocate_struct(GlyphEdge, edges.capacity);
+  edges.scale      = scale;
+  edges.offset_x   = left;
+  edges.offset_y   = -top;
+  flatten_glyph(&edges, &glyph);
+  rasterize_glyph_edges(&edges, &atlas->pixels[entry->y * atlas->width + entry->x], atlas->width, width, height);
+  sta_deallocate(edges.edges, sizeof(GlyphEdge) * edges.capacity);
+
+  atlas->dirty_min_y = MIN(atlas->dirty_min_y, entry->y);
+  atlas->dirty_max_y = MAX(atlas->dirty_max_y, (u32)entry->y + height);
+
+  return entry;
 }
 
+#undef GLYPH_MAX_SEGMENTS
+#undef GLYPH_ATLAS_PAD
+#undef GLYPH_SUBSAMPLES
+
 #undef REPEAT
 #undef BIT_IS_SET
@@ -89,6 +89,8 @@ struct SimpleGlyph
   u16  n;
   i16* x_coordinates;
   i16* y_coordinates;
+  // 1 if the point is on the outline, 0 if it's the control point of a quadratic
+  u8*  on_curve;
 };
 
 struct Glyph;
@@ -248,13 +250,50 @@ struct Table
 struct AFont
 {
 public:
-  void   parse_ttf(const char* filename);
+  bool   parse_ttf(const char* filename);
   Glyph  get_glyph(u32 code);
+  // sorted by code so get_glyph can binary search them
   u32*   char_codes;
   u32*   glyph_indices;
+  u32    char_code_count;
   Glyph* glyphs;
   f32    scale;
   u32    glyph_count;
+  i16    ascent;
+  i16    descent;
+  i16    line_gap;
 };
 
+struct GlyphAtlasEntry
+{
+  u32  code;
+  u32  pixel_size;
+  // position in the atlas, w/h 0 for glyphs without an outline
+  u16  x, y;
+  u16  w, h;
+  // offset from the pen position to the top left of the bitmap, y grows down
+  i16  bearing_x, bearing_y;
+  f32  advance;
+  bool used;
+};
+
+// Coverage of every glyph rasterized so far, packed into shelves of one R8 texture.
+// Entries are keyed by (code, pixel size) in an open addressed table, rows that changed since
+// the last upload are tracked so only those are sent to the GPU
+struct GlyphAtlas
+{
+  u8*              pixels;
+  u32              width, height;
+  u32              shelf_x, shelf_y, shelf_height;
+  GlyphAtlasEntry* entries;
+  u32              entry_count;
+  u32              entry_capacity;
+  u32              dirty_min_y, dirty_max_y;
+  // set once a glyph didn't fit, those glyphs are skipped instead of evicting
+  bool             full;
+};
+
+void             sta_glyph_atlas_init(GlyphAtlas* atlas, u32 width, u32 height);
+GlyphAtlasEntry* sta_glyph_atlas_get(GlyphAtlas* atlas, AFont* font, u32 code, u32 pixel_size);
+
 #endif
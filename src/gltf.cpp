@@ -29,25 +29,25 @@ static void parse_buffer_views(GLTF_Chunk* binary_chunk, GLTF_BufferView** views
   *views = buffer_views;
 }
 
-static void parse_accessor_type(GLTF_AccessorType* type, char* type_str)
+static void parse_accessor_type(GLTF_AccessorType* type, JsonString* type_str)
 {
-  if (strlen(type_str) == 4 && strncmp(type_str, "VEC4", 4) == 0)
+  if (type_str->equals("VEC4"))
   {
     *type = ACCESSOR_TYPE_VEC4;
   }
-  else if (strlen(type_str) == 4 && strncmp(type_str, "VEC3", 4) == 0)
+  else if (type_str->equals("VEC3"))
   {
     *type = ACCESSOR_TYPE_VEC3;
   }
-  else if (strlen(type_str) == 4 && strncmp(type_str, "VEC2", 4) == 0)
+  else if (type_str->equals("VEC2"))
   {
     *type = ACCESSOR_TYPE_VEC2;
   }
-  else if (strlen(type_str) == 4 && strncmp(type_str, "MAT4", 4) == 0)
+  else if (type_str->equals("MAT4"))
   {
     *type = ACCESSOR_TYPE_MAT4;
   }
-  else if (strlen(type_str) == 6 && strncmp(type_str, "SCALAR", 6) == 0)
+  else if (type_str->equals("SCALAR"))
   {
     *type = ACCESSOR_TYPE_SCALAR;
   }
@@ -70,23 +70,23 @@ static void parse_accessors(GLTF_Accessor** accessors, u32& count, JsonValue* ac
     accessor->buffer_view_index = accessor_obj->lookup_value("bufferView")->number;
     accessor->type              = (GLTF_AccessorType)accessor_obj->lookup_value("componentType")->number;
     accessor->count             = accessor_obj->lookup_value("count")->number;
-    parse_accessor_type(&accessor->type, accessor_obj->lookup_value("type")->string);
+    parse_accessor_type(&accessor->type, &accessor_obj->lookup_value("type")->string);
   }
 
   *accessors = acc;
 }
 
-static inline GLTF_ChannelTargetPath get_channel_target_path(char* path)
+static inline GLTF_ChannelTargetPath get_channel_target_path(JsonString* path)
 {
-  if (strlen(path) == 5 && strncmp(path, "scale", 5) == 0)
+  if (path->equals("scale"))
   {
     return CHANNEL_TARGET_PATH_SCALE;
   }
-  else if (strlen(path) == strlen("rotation") && strncmp(path, "rotation", strlen("rotation")) == 0)
+  else if (path->equals("rotation"))
   {
     return CHANNEL_TARGET_PATH_ROTATION;
   }
-  else if (strlen(path) == strlen("translation") && strncmp(path, "translation", strlen("translation")) == 0)
+  else if (path->equals("translation"))
   {
     return CHANNEL_TARGET_PATH_TRANSLATION;
   }
@@ -200,7 +200,7 @@ static void parse_skeleton(Skeleton* skeleton, JsonValue* skins, u32** node_inde
 
     JsonObject* node_object                  = json_nodes->arr->values[node_index].obj;
 
-    joint->m_name                            = node_object->lookup_value("name")->string;
+    joint->m_name                            = node_object->lookup_value("name")->string.copy();
   }
 
   for (u32 i = 0; i < joints_array->arraySize; i++)
@@ -296,7 +296,7 @@ static void parse_animations(AnimationModel* model, Skeleton* skeleton, JsonValu
   for (u32 i = 0; i < model->animation_count; i++)
   {
     JsonObject* animation_obj = animations_array->values[i].obj;
-    model->animations[i].name = animation_obj->lookup_value("name")->string;
+    model->animations[i].name = animation_obj->lookup_value("name")->string.copy();
 
     JsonArray* channels       = animation_obj->lookup_value("channels")->arr;
     JsonArray* samplers       = animation_obj->lookup_value("samplers")->arr;
@@ -348,7 +348,7 @@ static void parse_animations(AnimationModel* model, Skeleton* skeleton, JsonValu
       GLTF_Accessor          output_accessor      = accessors[(u32)sampler->lookup_value("output")->number];
       f32*                   output_buffer        = (f32*)buffer_views[output_accessor.buffer_view_index].buffer;
 
-      GLTF_ChannelTargetPath path                 = get_channel_target_path(target->lookup_value("path")->string);
+      GLTF_ChannelTargetPath path                 = get_channel_target_path(&target->lookup_value("path")->string);
 
       AnimationDataNode*     joint_animation_data = &animation_data[joint_index];
 
@@ -452,7 +452,7 @@ bool gltf_parse(AnimationModel* model, const char* filename)
 {
 
   Buffer buffer = {};
-  if (!sta_read_file(&buffer, filename))
+  if (!sta_map_file(&buffer, filename))
   {
     printf("Couldn't find file '%s'", filename);
     return false;
@@ -470,6 +470,7 @@ bool gltf_parse(AnimationModel* model, const char* filename)
   if (!result)
   {
     printf("Failed to deserialize json!\n");
+    sta_unmap_file(&buffer);
     return false;
   }
   sta_json_serialize_to_file(&json_data, "full.json");
@@ -504,6 +505,8 @@ bool gltf_parse(AnimationModel* model, const char* filename)
   parse_mesh(model, accessors, meshes, buffer_views);
 
   parse_animations(model, skeleton, animations, accessors, buffer_views, node_index_to_joint_index);
+  sta_json_free(&json_data);
+  sta_unmap_file(&buffer);
 
   return true;
 }
@@ -164,6 +164,11 @@ static inline u32 convert_sdl_to_mouse_key(u8 button)
   return -1;
 }
 
+void InputState::clear_transient_events()
+{
+  clear_input(this);
+}
+
 void InputState::update()
 {
   // clear from previous frame
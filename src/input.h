@@ -71,6 +71,7 @@ public:
   u32            event_count;
 
   void           update();
+  void           clear_transient_events();
   u32            add_sequence(InputEvent* events, u32 event_count);
   bool           check_sequence(u32 id);
   bool           should_quit();
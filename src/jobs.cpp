@@ -0,0 +1,113 @@
+#include "jobs.h"
+
+static void* run_work_queue_thread(void* data)
+{
+  WorkQueue* queue = (WorkQueue*)data;
+  while (__atomic_load_n(&queue->running, __ATOMIC_ACQUIRE))
+  {
+    if (!queue->do_next_entry())
+    {
+      sta_wait_semaphore(queue->semaphore);
+    }
+  }
+  return 0;
+}
+
+// Leaves a core for the thread that pushes the work
+u32 get_worker_thread_count()
+{
+  u32 processors = sta_get_processor_count();
+  return CLAMP(processors - 1, 1, WORK_QUEUE_MAX_THREADS);
+}
+
+bool WorkQueue::init(u32 thread_count)
+{
+  this->next_write       = 0;
+  this->next_read        = 0;
+  this->completion_goal  = 0;
+  this->completion_count = 0;
+  this->thread_count     = 0;
+  this->running          = true;
+  this->semaphore        = sta_create_semaphore(0);
+  for (u32 i = 0; i < MIN(thread_count, WORK_QUEUE_MAX_THREADS); i++)
+  {
+    if (!sta_create_thread(&this->threads[i], run_work_queue_thread, this))
+    {
+      logger.error("Failed to start worker thread %u", i);
+      this->destroy();
+      return false;
+    }
+    this->thread_count++;
+  }
+  return true;
+}
+
+// Workers finish the entry they are on, anything still queued is dropped
+void WorkQueue::destroy()
+{
+  if (!this->semaphore)
+  {
+    return;
+  }
+  __atomic_store_n(&this->running, false, __ATOMIC_RELEASE);
+  sta_post_semaphore(this->semaphore, this->thread_count);
+  for (u32 i = 0; i < this->thread_count; i++)
+  {
+    sta_join_thread(this->threads[i]);
+  }
+  this->thread_count = 0;
+  sta_destroy_semaphore(this->semaphore);
+  this->semaphore = 0;
+}
+
+void WorkQueue::push(WorkFunction function, void* data)
+{
+  // an entry can only be reused once the work it held is done, help out until there is room
+  while (this->next_write - __atomic_load_n(&this->completion_count, __ATOMIC_ACQUIRE) >= WORK_QUEUE_CAPACITY)
+  {
+    if (!this->do_next_entry())
+    {
+      sta_sleep_ns(10000);
+    }
+  }
+  WorkEntry* entry = &this->entries[this->next_write % WORK_QUEUE_CAPACITY];
+  entry->function  = function;
+  entry->data      = data;
+  this->completion_goal++;
+  __atomic_store_n(&this->next_write, this->next_write + 1, __ATOMIC_RELEASE);
+  sta_post_semaphore(this->semaphore, 1);
+}
+
+// Returns false if there was nothing to take
+bool WorkQueue::do_next_entry()
+{
+  u32 read = __atomic_load_n(&this->next_read, __ATOMIC_ACQUIRE);
+  if (read == __atomic_load_n(&this->next_write, __ATOMIC_ACQUIRE))
+  {
+    return false;
+  }
+  // copied before taking it, once taken the entry can be overwritten as soon as later ones complete
+  WorkEntry entry = this->entries[read % WORK_QUEUE_CAPACITY];
+  if (__atomic_compare_exchange_n(&this->next_read, &read, read + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+  {
+    entry.function(entry.data);
+    __atomic_fetch_add(&this->completion_count, 1, __ATOMIC_RELEASE);
+  }
+  return true;
+}
+
+bool WorkQueue::is_complete()
+{
+  return __atomic_load_n(&this->completion_count, __ATOMIC_ACQUIRE) == this->completion_goal;
+}
+
+void WorkQueue::complete_all()
+{
+  while (!this->is_complete())
+  {
+    if (!this->do_next_entry())
+    {
+      sta_sleep_ns(10000);
+    }
+  }
+}
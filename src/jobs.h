@@ -0,0 +1,42 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "common.h"
+
+typedef void (*WorkFunction)(void* data);
+
+struct WorkEntry
+{
+  WorkFunction function;
+  void*        data;
+};
+
+#define WORK_QUEUE_CAPACITY    256
+#define WORK_QUEUE_MAX_THREADS 8
+
+// Entries are pushed from a single thread and taken in order by the workers,
+// the pushing thread can help out with do_next_entry while it waits
+struct WorkQueue
+{
+  WorkEntry     entries[WORK_QUEUE_CAPACITY];
+  u32           next_write;
+  u32           next_read;
+  u32           completion_goal;
+  u32           completion_count;
+  void*         semaphore;
+  unsigned long threads[WORK_QUEUE_MAX_THREADS];
+  u32           thread_count;
+  bool          running;
+
+public:
+  bool init(u32 thread_count);
+  void destroy();
+  void push(WorkFunction function, void* data);
+  bool do_next_entry();
+  bool is_complete();
+  void complete_all();
+};
+
+u32 get_worker_thread_count();
+
+#endif
@@ -26,8 +26,11 @@
 #include "shader.h"
 #include "animation.h"
 #include "collision.h"
+#include "navmesh.h"
 #include "input.h"
+#include "jobs.h"
 #include "renderer.h"
+#include "replay.h"
 
 #define IMGUI_IMPL_OPENGL_LOADER_CUSTOM
 #define IMGUI_DEFINE_MATH_OPERATORS
@@ -39,6 +42,7 @@ Logger logger;
 #include "font.cpp"
 #include "shader.cpp"
 #include "collision.cpp"
+#include "navmesh.cpp"
 
 #include "../libs/imgui/backends/imgui_impl_opengl3.cpp"
 #include "../libs/imgui/backends/imgui_impl_sdl2.cpp"
@@ -50,6 +54,8 @@ Logger logger;
 #include "files.cpp"
 #include "animation.cpp"
 #include "input.cpp"
+#include "replay.cpp"
+#include "jobs.cpp"
 #include "renderer.cpp"
 #include "gltf.cpp"
 
@@ -129,6 +135,7 @@ enum EntityType
 struct Entity
 {
   Vector2           position;
+  Vector2           previous_position;
   f32               r;
   f32               angle;
   Vector2           velocity;
@@ -162,6 +169,14 @@ struct GameState
   u32                 entity_count;
   bool                no_spawn;
   bool                god;
+  bool                navmesh_paths;
+  bool                hierarchical_paths;
+  bool                no_crowd;
+  u32                 wave;
+  u32                 enemies_spawned;
+  Random              rng;
+  u64                 seed;
+  u32                 interpolated_entity_count;
   AnimationController animation_controllers[50];
   u32                 animation_controller_count;
 };
@@ -375,19 +390,140 @@ EntityRenderData* get_render_data_by_name(const char* name)
   assert(!"Couldn't find render data!");
 }
 
-bool load_models_from_files(const char* file_location)
+struct ModelLoad
 {
+  Model* model;
+  char*  location;
+  // .anim bone name mapping, optional
+  char*  mapping;
+  bool   done;
+};
+
+#define MAX_BUFFER_ATTRIBUTES 16
+struct BufferLoad
+{
+  u32              model_index;
+  BufferAttributes attributes[MAX_BUFFER_ATTRIBUTES];
+  u32              attribute_count;
+};
 
-  Buffer buffer = {};
-  if (!sta_read_file(&buffer, file_location))
+ModelLoad*  model_loads;
+BufferLoad* buffer_loads;
+u32         buffers_uploaded;
+
+// Runs on a worker, only touches its own model
+void load_model(void* data)
+{
+  ModelLoad*          load           = (ModelLoad*)data;
+  Model*              model          = load->model;
+  const char*         model_name     = model->name;
+  char*               model_location = load->location;
+  ModelFileExtensions extension      = get_model_file_extension(model_location);
+  switch (extension)
   {
-    return false;
+  case MODEL_FILE_OBJ:
+  {
+    ModelData model_data = {};
+    if (!sta_parse_wavefront_object_from_file(&model_data, model_location))
+    {
+      logger.error("Failed to parse obj from '%s'", model_location);
+    };
+
+    f32 acmr_before, acmr_after;
+    sta_optimize_vertex_cache(model_data.indices, model_data.index_count, model_data.vertex_count, &acmr_before, &acmr_after);
+    logger.info("Indexed '%s': %lu corners, %lu vertices, ACMR %.2f -> %.2f", model_name, model_data.index_count, model_data.vertex_count, acmr_before, acmr_after);
+
+    model->index_count  = model_data.index_count;
+    model->vertex_count = model_data.vertex_count;
+    model->vertices     = sta_allocate_struct(Vector3, model_data.vertex_count);
+    for (u32 j = 0; j < model_data.vertex_count; j++)
+    {
+      model->vertices[j] = model_data.vertices[j].vertex;
+    }
+    model->indices          = model_data.indices;
+    model->animation_data   = 0;
+    model->vertex_data      = (void*)model_data.vertices;
+    model->vertex_data_size = sizeof(VertexData);
+    break;
+  }
+  case MODEL_FILE_GLB:
+  {
+    AnimationModel model_data = {};
+    if (!gltf_parse(&model_data, model_location))
+    {
+      logger.error("Failed to read glb from '%s'", model_location);
+    }
+    model->indices          = model_data.indices;
+    model->index_count      = model_data.index_count;
+    model->vertex_count     = model_data.vertex_count;
+    model->vertex_data_size = sizeof(SkinnedVertex);
+    model->vertex_data      = (void*)model_data.vertices;
+    model->vertices         = sta_allocate_struct(Vector3, model_data.vertex_count);
+
+    for (u32 j = 0; j < model_data.vertex_count; j++)
+    {
+      model->vertices[j] = model_data.vertices[j].position;
+    }
+    model->animation_data           = (AnimationData*)sta_allocate_struct(AnimationData, 1);
+    model->animation_data->skeleton = model_data.skeleton;
+    // ToDo this should change once you fixed the parser
+    model->animation_data->animation_count = 1;
+    model->animation_data->animations      = (Animation*)sta_allocate_struct(Animation, model->animation_data->animation_count);
+    model->animation_data->animations      = model_data.animations;
+    model->animation_data->animation_count = model_data.animation_count;
+    break;
+  }
+  case MODEL_FILE_ANIM:
+  {
+    AnimationModel model_data = {};
+    if (!parse_animation_file(&model_data, model_location, load->mapping))
+    {
+      logger.error("Failed to read anim from '%s'", model_location);
+      return;
+    }
+    model->indices          = model_data.indices;
+    model->index_count      = model_data.index_count;
+    model->vertex_count     = model_data.vertex_count;
+    model->vertex_data_size = sizeof(SkinnedVertex);
+    model->vertex_data      = (void*)model_data.vertices;
+    model->vertices         = sta_allocate_struct(Vector3, model_data.vertex_count);
+
+    for (u32 j = 0; j < model_data.vertex_count; j++)
+    {
+      model->vertices[j] = model_data.vertices[j].position;
+    }
+    model->animation_data           = (AnimationData*)sta_allocate_struct(AnimationData, 1);
+    model->animation_data->skeleton = model_data.skeleton;
+    // ToDo if we free the memory :)
+    model->animation_data->animations      = model_data.animations;
+    model->animation_data->animation_count = model_data.animation_count;
+    break;
+  }
+  case MODEL_FILE_UNKNOWN:
+  {
+    assert(!"Unknown model!");
+  }
   }
+  logger.info("Loaded %s from '%s'", model_name, model_location);
+}
+
+void load_model_job(void* data)
+{
+  TimeFunction;
+  load_model(data);
+  __atomic_store_n(&((ModelLoad*)data)->done, true, __ATOMIC_RELEASE);
+  ExitFunction;
+}
+
+// Names are filled in right away so buffers can look their model up before it is parsed
+bool load_models_from_files(const char* file_location, WorkQueue* queue)
+{
+
   Json json = {};
-  if (!sta_json_deserialize_from_string(&buffer, &json))
+  if (!sta_json_deserialize_from_file(&json, file_location))
   {
     return false;
-  };
+  }
   assert(json.headType == JSON_OBJECT && "Expected head to be object");
   JsonObject* head       = &json.obj;
 
@@ -396,117 +532,30 @@ bool load_models_from_files(const char* file_location)
   game_state.model_count = count;
 
   game_state.models      = sta_allocate_struct(Model, game_state.model_count);
+  model_loads            = sta_allocate_struct(ModelLoad, game_state.model_count);
   logger.info("Found %d models", game_state.model_count);
   for (u32 i = 0; i < game_state.model_count; i++)
   {
-    // ToDo free the loaded memory?
-    JsonObject*         json_data      = head->values[i].obj;
-    char*               model_name     = head->keys[i];
-    char*               model_location = json_data->lookup_value("location")->string;
-    ModelFileExtensions extension      = get_model_file_extension(model_location);
-    Model*              model          = &game_state.models[i];
-    model->name                        = model_name;
-    switch (extension)
-    {
-    case MODEL_FILE_OBJ:
-    {
-      ModelData model_data = {};
-      if (!sta_parse_wavefront_object_from_file(&model_data, model_location))
-      {
-        logger.error("Failed to parse obj from '%s'", model_location);
-      };
-
-      model->index_count  = model_data.vertex_count;
-      model->vertex_count = model_data.vertex_count;
-      model->vertices     = sta_allocate_struct(Vector3, model_data.vertex_count);
-      for (u32 j = 0; j < model_data.vertex_count; j++)
-      {
-        model->vertices[j] = model_data.vertices[j].vertex;
-      }
-      model->indices          = model_data.indices;
-      model->animation_data   = 0;
-      model->vertex_data      = (void*)model_data.vertices;
-      model->vertex_data_size = sizeof(VertexData);
-      break;
-    }
-    case MODEL_FILE_GLB:
-    {
-      AnimationModel model_data = {};
-      if (!gltf_parse(&model_data, model_location))
-      {
-        logger.error("Failed to read glb from '%s'", model_location);
-      }
-      model->indices          = model_data.indices;
-      model->index_count      = model_data.index_count;
-      model->vertex_count     = model_data.vertex_count;
-      model->vertex_data_size = sizeof(SkinnedVertex);
-      model->vertex_data      = (void*)model_data.vertices;
-      model->vertices         = sta_allocate_struct(Vector3, model_data.vertex_count);
-
-      for (u32 j = 0; j < model_data.vertex_count; j++)
-      {
-        model->vertices[j] = model_data.vertices[j].position;
-      }
-      model->animation_data           = (AnimationData*)sta_allocate_struct(AnimationData, 1);
-      model->animation_data->skeleton = model_data.skeleton;
-      // ToDo this should change once you fixed the parser
-      model->animation_data->animation_count = 1;
-      model->animation_data->animations      = (Animation*)sta_allocate_struct(Animation, model->animation_data->animation_count);
-      model->animation_data->animations      = model_data.animations;
-      model->animation_data->animation_count = model_data.animation_count;
-      break;
-    }
-    case MODEL_FILE_ANIM:
-    {
-      AnimationModel model_data       = {};
-      JsonValue*     mapping_location = json_data->lookup_value("mapping");
-      char*          loc              = mapping_location ? mapping_location->string : 0;
-      if (!parse_animation_file(&model_data, model_location, loc))
-      {
-        logger.error("Failed to read anim from '%s'", model_location);
-        continue;
-      }
-      model->indices          = model_data.indices;
-      model->index_count      = model_data.index_count;
-      model->vertex_count     = model_data.vertex_count;
-      model->vertex_data_size = sizeof(SkinnedVertex);
-      model->vertex_data      = (void*)model_data.vertices;
-      model->vertices         = sta_allocate_struct(Vector3, model_data.vertex_count);
-
-      for (u32 j = 0; j < model_data.vertex_count; j++)
-      {
-        model->vertices[j] = model_data.vertices[j].position;
-      }
-      model->animation_data           = (AnimationData*)sta_allocate_struct(AnimationData, 1);
-      model->animation_data->skeleton = model_data.skeleton;
-      // ToDo if we free the memory :)
-      model->animation_data->animations      = model_data.animations;
-      model->animation_data->animation_count = model_data.animation_count;
-      break;
-    }
-    case MODEL_FILE_UNKNOWN:
-    {
-      assert(!"Unknown model!");
-    }
-    }
-    logger.info("Loaded %s from '%s'", model_name, model_location);
+    ModelLoad* load    = &model_loads[i];
+    JsonValue* mapping = head->values[i].obj->lookup_value("mapping");
+    load->model        = &game_state.models[i];
+    load->location     = head->values[i].obj->lookup_value("location")->string.copy();
+    load->mapping      = mapping ? mapping->string.copy() : 0;
+    load->model->name  = head->keys[i].copy();
+    queue->push(load_model_job, load);
   }
+  sta_json_free(&json);
   return true;
 }
 
 bool load_buffers_from_files(const char* file_location)
 {
 
-  Buffer buffer = {};
-  if (!sta_read_file(&buffer, file_location))
-  {
-    return false;
-  }
   Json json = {};
-  if (!sta_json_deserialize_from_string(&buffer, &json))
+  if (!sta_json_deserialize_from_file(&json, file_location))
   {
     return false;
-  };
+  }
   assert(json.headType == JSON_OBJECT && "Expected head to be object");
   JsonObject* head        = &json.obj;
 
@@ -514,27 +563,49 @@ bool load_buffers_from_files(const char* file_location)
 
   game_state.buffers      = (RenderBuffer*)sta_allocate_struct(RenderBuffer, count);
   game_state.buffer_count = count;
+  buffer_loads            = sta_allocate_struct(BufferLoad, count);
+  buffers_uploaded        = 0;
 
   for (u32 i = 0; i < count; i++)
   {
-    char*            model_name             = head->keys[i];
-    Model*           model                  = get_model_by_name(model_name);
-    JsonObject*      model_json             = head->values[i].obj;
-    JsonArray*       attributes_json        = model_json->lookup_value("attributes")->arr;
-    u32              buffer_attribute_count = attributes_json->arraySize;
-    BufferAttributes attributes[buffer_attribute_count];
+    char*       model_name             = head->keys[i].copy();
+    Model*      model                  = get_model_by_name(model_name);
+    JsonObject* model_json             = head->values[i].obj;
+    JsonArray*  attributes_json        = model_json->lookup_value("attributes")->arr;
+    u32         buffer_attribute_count = attributes_json->arraySize;
+    BufferLoad* load                   = &buffer_loads[i];
+    assert(buffer_attribute_count <= MAX_BUFFER_ATTRIBUTES && "Too many buffer attributes!");
+    load->model_index     = model - game_state.models;
+    load->attribute_count = buffer_attribute_count;
     for (u32 j = 0; j < buffer_attribute_count; j++)
     {
-      attributes[j].count = attributes_json->values[j].obj->lookup_value("count")->number;
-      attributes[j].type  = (BufferAttributeType)attributes_json->values[j].obj->lookup_value("type")->number;
+      load->attributes[j].count = attributes_json->values[j].obj->lookup_value("count")->number;
+      load->attributes[j].type  = (BufferAttributeType)attributes_json->values[j].obj->lookup_value("type")->number;
     }
     game_state.buffers[i].model_name = model_name;
-    game_state.buffers[i].buffer_id  = game_state.renderer.create_buffer_from_model(model, attributes, buffer_attribute_count);
-    logger.info("Loaded buffer '%s', id: %d", model_name, game_state.buffers[i].buffer_id);
   }
+  sta_json_free(&json);
   return true;
 }
 
+// Buffers are created in the order they are listed so their ids don't depend on which model finished first,
+// returns how many are still waiting on their model
+u32 upload_loaded_buffers()
+{
+  for (; buffers_uploaded < game_state.buffer_count; buffers_uploaded++)
+  {
+    BufferLoad* load = &buffer_loads[buffers_uploaded];
+    if (!__atomic_load_n(&model_loads[load->model_index].done, __ATOMIC_ACQUIRE))
+    {
+      return game_state.buffer_count - buffers_uploaded;
+    }
+    RenderBuffer* buffer = &game_state.buffers[buffers_uploaded];
+    buffer->buffer_id    = game_state.renderer.create_buffer_from_model(&game_state.models[load->model_index], load->attributes, load->attribute_count);
+    logger.info("Loaded buffer '%s', id: %d", buffer->model_name, buffer->buffer_id);
+  }
+  return 0;
+}
+
 u32 get_new_entity()
 {
   RESIZE_ARRAY(game_state.entities, Entity, game_state.entity_count, game_state.entity_capacity);
@@ -605,150 +676,58 @@ Vector2 closest_point_triangle(Triangle triangle, Vector2 p)
   return Vector2(x, y);
 }
 
-u32 get_tile_count_per_row()
-{
-  // 2.0f for the length of the thing divided by the radius *  aka 2.0f / (r * 2) == 1 /r
-  return 24;
-}
-
-f32 get_tile_size()
-{
-  return 2.0f / get_tile_count_per_row();
-}
+#define WALKABLE_CHUNK_SIZE    16
+#define DEFAULT_TILES_PER_ROW  24
 
-bool collides_with_static_geometry(Vector2& closest_point, Vector2 position, f32 r);
-struct Map
+// Walkability of a square of tiles, row major
+struct WalkableChunk
 {
-public:
-  Map()
-  {
-  }
-  u32*           indices;
-  Vector2*       vertices;
-  u32            index_count;
-  u32            vertex_count;
-  StaticGeometry static_geometry;
-  void           init_map(Model* model)
-  {
-    this->index_count    = model->vertex_count;
-    this->vertex_count   = model->vertex_count;
-    this->indices        = model->indices;
-    VertexData* vertices = (VertexData*)model->vertex_data;
-    this->vertices       = sta_allocate_struct(Vector2, vertex_count);
-    for (u32 i = 0; i < vertex_count; i++)
-    {
-      Vector3 v         = vertices[i].vertex;
-      this->vertices[i] = Vector2(v.x, v.y);
-    }
-  }
-
-  void get_tile_position(u8& tile_x, u8& tile_y, Vector2 position)
-  {
-    u32 tile_count = get_tile_count_per_row();
-
-    f32 px_n       = ((1.0f + position.x) * 0.5f);
-    f32 py_n       = ((1.0f + position.y) * 0.5f);
-    tile_x         = px_n * tile_count;
-    tile_y         = py_n * tile_count;
-  }
+  // distance from the tile's center to the closest static geometry, FLT_MAX if there is none
+  f32 clearance[WALKABLE_CHUNK_SIZE * WALKABLE_CHUNK_SIZE];
+  u64 on_floor[WALKABLE_CHUNK_SIZE * WALKABLE_CHUNK_SIZE / 64];
 };
-Map  map;
-bool collides_with_static_geometry(Vector2& closest_point, Vector2 position, f32 r)
-{
-  for (u32 i = 0; i < map.static_geometry.count; i++)
-  {
-    Model*   model    = &map.static_geometry.models[i];
-    f32      scale    = map.static_geometry.render_data[i].scale;
-    Vector3  pos      = map.static_geometry.position[i];
 
-    Vector3* vertices = model->vertices;
-    u32*     indices  = model->indices;
-    for (u32 j = 0; j < model->index_count; j += 3)
-    {
-      Triangle t;
-      t.points[0].x = vertices[indices[j]].x * scale + pos.x;
-      t.points[0].y = vertices[indices[j]].y * scale + pos.y;
-      t.points[1].x = vertices[indices[j + 1]].x * scale + pos.x;
-      t.points[1].y = vertices[indices[j + 1]].y * scale + pos.y;
-      t.points[2].x = vertices[indices[j + 2]].x * scale + pos.x;
-      t.points[2].y = vertices[indices[j + 2]].y * scale + pos.y;
-      closest_point = closest_point_triangle(t, position);
-      if (closest_point.sub(position).len() < r)
-      {
-        return true;
-      }
-    }
-  }
-  return false;
-}
-bool load_static_geometry_from_file(const char* filename)
+// Tiles the grid pathfinding works on, node ids are y * tiles_x + x
+struct MapGrid
 {
-  Buffer buffer = {};
-  if (!sta_read_file(&buffer, filename))
-  {
-    return false;
-  }
-  Json json = {};
-  if (!sta_json_deserialize_from_string(&buffer, &json))
-  {
-    return false;
-  };
-  assert(json.headType == JSON_OBJECT && "Expected head to be object");
-  JsonObject* head                = &json.obj;
-
-  map.static_geometry.count       = head->size;
-  map.static_geometry.position    = (Vector3*)sta_allocate_struct(Vector3, map.static_geometry.count);
-  map.static_geometry.models      = (Model*)sta_allocate_struct(Model, map.static_geometry.count);
-  map.static_geometry.render_data = (EntityRenderData*)sta_allocate_struct(EntityRenderData, map.static_geometry.count);
+  Vector2         min;
+  Vector2         max;
+  u32             tiles_x;
+  u32             tiles_y;
+  u32             chunks_x;
+  u32             chunks_y;
+  // chunks without any tile on the floor are never allocated and stay null
+  WalkableChunk** chunks;
 
-  logger.info("Found %d static geometry items", map.static_geometry.count);
-  for (u32 i = 0; i < map.static_geometry.count; i++)
+  u32             tile_count()
   {
-    map.static_geometry.render_data[i] = *get_render_data_by_name(head->keys[i]);
-    map.static_geometry.models[i]      = *get_model_by_name(head->values[i].obj->lookup_value("model")->string);
-    JsonArray* position_json           = head->values[i].obj->lookup_value("position")->arr;
-    map.static_geometry.position[i].x  = position_json->values[0].number;
-    map.static_geometry.position[i].y  = position_json->values[1].number;
-    map.static_geometry.position[i].z  = position_json->values[2].number;
-    logger.info("Item %d: '%s' at (%f, %f, %f)", i, map.static_geometry.render_data[i].name, map.static_geometry.position[i].x, map.static_geometry.position[i].y, map.static_geometry.position[i].z);
+    return tiles_x * tiles_y;
   }
-
-  return true;
-}
-
-bool load_map_from_file(const char* filename)
-{
-  Buffer buffer = {};
-  if (!sta_read_file(&buffer, filename))
+  Vector2 tile_size()
   {
-    return false;
+    return Vector2((max.x - min.x) / tiles_x, (max.y - min.y) / tiles_y);
   }
-  Json json = {};
-  if (!sta_json_deserialize_from_string(&buffer, &json))
+  // a tile can be stood on by something with radius r
+  bool is_walkable(u32 x, u32 y, f32 r)
   {
-    return false;
-  };
-  assert(json.headType == JSON_OBJECT && "Expected head to be object");
-  JsonObject* head  = &json.obj;
-
-  Model*      model = get_model_by_name(head->lookup_value("model")->string);
-  f32         scale = head->lookup_value("model")->number;
-  if (!load_static_geometry_from_file(head->lookup_value("static_geometry")->string))
-  {
-    logger.error("Failed to read static geometry data from '%s'", head->lookup_value("static_geometry")->string);
-    return false;
+    WalkableChunk* chunk = chunks[(y / WALKABLE_CHUNK_SIZE) * chunks_x + x / WALKABLE_CHUNK_SIZE];
+    if (!chunk)
+    {
+      return false;
+    }
+    u32 idx = (y % WALKABLE_CHUNK_SIZE) * WALKABLE_CHUNK_SIZE + x % WALKABLE_CHUNK_SIZE;
+    return (chunk->on_floor[idx / 64] & (1ULL << (idx % 64))) && !(chunk->clearance[idx] < r);
   }
-  map.init_map(model);
-  return true;
-}
+};
 
 struct HeapNode
 {
 public:
-  u16  distance;
-  u16* path;
-  u16  path_count;
-  u16  path_capacity;
+  u32 distance;
+  u32 path_count;
+  u32 node;
+  // index of the node this was reached from in GridSearch::expanded, -1 for the start
+  i32 parent;
 };
 
 struct Heap
@@ -774,11 +753,11 @@ public:
     heapify_up(node_count);
     node_count++;
   }
-  void heapify_down(u16 idx)
+  void heapify_down(u32 idx)
   {
 
-    u16 lIdx = left_child(idx);
-    u16 rIdx = right_child(idx);
+    u32 lIdx = left_child(idx);
+    u32 rIdx = right_child(idx);
 
     if (idx >= node_count || lIdx >= node_count)
     {
@@ -815,7 +794,7 @@ public:
       heapify_down(rIdx);
     }
   }
-  void heapify_up(u16 idx)
+  void heapify_up(u32 idx)
   {
     if (idx == 0)
     {
@@ -835,123 +814,439 @@ public:
       heapify_up(pIdx);
     }
   }
-  u16 left_child(u16 idx)
+  u32 left_child(u32 idx)
   {
     return 2 * idx + 1;
   }
-  u16 right_child(u16 idx)
+  u32 right_child(u32 idx)
   {
     return 2 * idx + 2;
   }
-  u16 parent(u16 idx)
+  u32 parent(u32 idx)
   {
     return (idx - 1) / 2;
   }
-  bool have_visited(HeapNode curr)
-  {
-    u16 position = curr.path[curr.path_count - 1];
-    for (u32 i = 0; i < visited_count; i++)
-    {
-      if (visited[i] == position)
-      {
-        distances[i] = MIN(distances[i], curr.distance + curr.path_count);
-        return distances[i] <= curr.distance + curr.path_count;
-      }
-    }
-    if (visited_count >= visited_capacity)
-    {
-      visited_capacity *= 2;
-      visited   = (u16*)realloc(visited, sizeof(u16) * visited_capacity);
-      distances = (u32*)realloc(distances, sizeof(u32) * visited_capacity);
-    }
-    visited[visited_count]     = position;
-    distances[visited_count++] = curr.path_count + curr.distance;
-    return false;
-  }
   HeapNode* nodes;
-  u16*      visited;
-  u32*      distances;
-  u32       visited_count;
-  u32       visited_capacity;
   u32       node_count;
   u32       node_capacity;
 };
-struct Path
+
+enum PathSearchStatus
 {
-  u16* path;
-  u32  path_count;
+  PATH_SEARCH_RUNNING,
+  PATH_SEARCH_FOUND,
+  PATH_SEARCH_FAILED
 };
 
-bool is_out_of_map_bounds(Vector2 position, f32 r)
-{
-  for (u32 i = 0; i < map.vertex_count - 2; i += 3)
-  {
-    Triangle t;
-    t.points[0].x = map.vertices[map.indices[i]].x;
-    t.points[0].y = map.vertices[map.indices[i]].y;
-    t.points[1].x = map.vertices[map.indices[i + 1]].x;
-    t.points[1].y = map.vertices[map.indices[i + 1]].y;
-    t.points[2].x = map.vertices[map.indices[i + 2]].x;
-    t.points[2].y = map.vertices[map.indices[i + 2]].y;
-    if (point_in_triangle_2d(t, Point2(position.x, position.y)))
-    {
-      return false;
-    }
-  }
-  return true;
-}
-bool is_out_of_map_bounds(Vector2& closest_point, Vector2 position, f32 r)
-{
-  f32 distance = FLT_MAX;
-  for (u32 i = 0; i < map.vertex_count - 2; i += 3)
-  {
-    Triangle t;
-    t.points[0].x = map.vertices[map.indices[i]].x;
-    t.points[0].y = map.vertices[map.indices[i]].y;
-    t.points[1].x = map.vertices[map.indices[i + 1]].x;
-    t.points[1].y = map.vertices[map.indices[i + 1]].y;
-    t.points[2].x = map.vertices[map.indices[i + 2]].x;
-    t.points[2].y = map.vertices[map.indices[i + 2]].y;
-    Vector2 cp    = closest_point_triangle(t, position);
-    f32     len   = cp.sub(position).len();
-    if (len < r)
-    {
-      return false;
-    }
-    if (len < distance)
-    {
-      closest_point = cp;
-      distance      = len;
-    }
-  }
-  return true;
-}
-f32 tile_position_to_game(i16 x)
+// State of one grid search, kept between steps so a search can be spread over several updates.
+// A tile counts as visited when its generation matches the search's so nothing is cleared between
+// searches. Every tile is expanded at most once so expanded never needs more than a slot per tile
+struct GridSearch
 {
-  u32 count = get_tile_count_per_row();
-  return (x + 0.5f) / (f32)count * 2.0f - 1.0f;
-}
-f32 tile_position_to_game2(i16 x)
+  Heap    heap;
+  u32*    generations;
+  u32     generation;
+  u32*    expanded_nodes;
+  i32*    expanded_parents;
+  u32     expanded_count;
+  Vector2 needle;
+  Vector2 source;
+  f32     r;
+  u32     needle_x;
+  u32     needle_y;
+};
+
+void init_grid_search(GridSearch* search, MapGrid* grid)
 {
-  u32 count = get_tile_count_per_row();
-  return x / (f32)count * 2.0f - 1.0f;
+  search->heap.node_count    = 0;
+  search->heap.node_capacity = 64;
+  search->heap.nodes         = (HeapNode*)malloc(sizeof(HeapNode) * search->heap.node_capacity);
+  search->generations        = sta_allocate_struct(u32, grid->tile_count());
+  search->generation         = 0;
+  search->expanded_nodes     = sta_allocate_struct(u32, grid->tile_count());
+  search->expanded_parents   = sta_allocate_struct(i32, grid->tile_count());
+  search->expanded_count     = 0;
 }
 
-bool IntersectSegmentTriangle(Vector3 q, Vector3 p, Triangle3D triangle, float& u, float& v, float& w, float& t)
-{
-  Vector3 ab = triangle.points[1].sub(triangle.points[0]);
-  Vector3 ac = triangle.points[2].sub(triangle.points[0]);
-  Vector3 qp = p.sub(q);
+#define HPA_CLUSTER_SIZE       WALKABLE_CHUNK_SIZE
+// a run of open tiles along a cluster border wider than this gets a node at both ends instead of one in the middle
+#define HPA_MAX_ENTRANCE_WIDTH 6
+// grids at least this many clusters across in both directions use the hierarchical search without --hpa
+#define HPA_DEFAULT_CLUSTERS   4
 
-  Vector3 n  = ab.cross(ac);
+struct HpaEdge
+{
+  u32 target;
+  u32 cost;
+};
 
-  float   d  = qp.dot(n);
+// Abstract graph over the grid for things with radius r. The grid is split into clusters of
+// HPA_CLUSTER_SIZE tiles a side and every opening between two neighbouring clusters puts a node on
+// the tile at either side of it. Nodes in the same cluster are connected by the length of the shortest
+// path between them that stays inside the cluster, costs are in tile steps like the grid search
+struct HpaGraph
+{
+  f32      r;
+  u32      clusters_x;
+  u32      clusters_y;
+  u32*     node_tiles;
+  u32      node_count;
+  // nodes are sorted by cluster, cluster c has cluster_offsets[c]..cluster_offsets[c + 1]
+  u32*     cluster_offsets;
+  u32      max_cluster_nodes;
+  // node n has edges[edge_offsets[n]..edge_offsets[n + 1]]
+  u32*     edge_offsets;
+  HpaEdge* edges;
+  u32      edge_count;
+};
 
-  Vector3 ap = p.sub(triangle.points[0]);
-  t          = ap.dot(n);
+// Scratch for one hierarchical query, big enough for every graph of the map. The start and goal
+// are the two node ids after the graph's own
+struct HpaQuery
+{
+  Heap     heap;
+  u32*     costs;
+  u32*     parents;
+  u32*     generations;
+  u32*     closed;
+  u32      generation;
+  u32      node_capacity;
+  // steps from the start to the nodes in its cluster and from the nodes in the goal's cluster to the goal
+  u32*     start_costs;
+  u32*     goal_costs;
+  // breadth first search inside one cluster, indexed by the tile's position in the cluster
+  u32*     cluster_steps;
+  u32*     cluster_parents;
+  u32*     cluster_queue;
+  u32*     abstract_nodes;
+  // tiles and nodes the last query expanded
+  u32      expanded;
+};
 
-  Vector3 e  = qp.cross(ap);
-  v          = ac.dot(e);
+bool collides_with_static_geometry(Vector2& closest_point, Vector2 position, f32 r);
+void build_walkable_grid(MapGrid* grid);
+void      build_hpa_graph(HpaGraph* graph, MapGrid* grid, f32 r);
+void      init_hpa_query(HpaQuery* query, HpaGraph* graphs, u32 graph_count);
+HpaGraph* get_hpa_graph(f32 r);
+struct Map
+{
+public:
+  Map()
+  {
+  }
+  u32*           indices;
+  Vector2*       vertices;
+  u32            index_count;
+  u32            vertex_count;
+  StaticGeometry static_geometry;
+  MapGrid        grid;
+  NavMesh        navmesh;
+  NavMeshQuery   navmesh_query;
+  GridSearch     grid_search;
+  // one per enemy radius
+  HpaGraph*      hpa_graphs;
+  u32            hpa_graph_count;
+  HpaQuery       hpa_query;
+  void           init_map(Model* model)
+  {
+    this->index_count    = model->index_count;
+    this->vertex_count   = model->vertex_count;
+    this->indices        = model->indices;
+    VertexData* vertices = (VertexData*)model->vertex_data;
+    this->vertices       = sta_allocate_struct(Vector2, vertex_count);
+    for (u32 i = 0; i < vertex_count; i++)
+    {
+      Vector3 v         = vertices[i].vertex;
+      this->vertices[i] = Vector2(v.x, v.y);
+    }
+  }
+
+  void get_tile_position(u32& tile_x, u32& tile_y, Vector2 position)
+  {
+    f32 px_n = (position.x - grid.min.x) / (grid.max.x - grid.min.x);
+    f32 py_n = (position.y - grid.min.y) / (grid.max.y - grid.min.y);
+    tile_x   = CLAMP((i32)(px_n * grid.tiles_x), 0, (i32)grid.tiles_x - 1);
+    tile_y   = CLAMP((i32)(py_n * grid.tiles_y), 0, (i32)grid.tiles_y - 1);
+  }
+};
+Map  map;
+bool collides_with_static_geometry(Vector2& closest_point, Vector2 position, f32 r)
+{
+  for (u32 i = 0; i < map.static_geometry.count; i++)
+  {
+    Model*   model    = &map.static_geometry.models[i];
+    f32      scale    = map.static_geometry.render_data[i].scale;
+    Vector3  pos      = map.static_geometry.position[i];
+
+    Vector3* vertices = model->vertices;
+    u32*     indices  = model->indices;
+    for (u32 j = 0; j < model->index_count; j += 3)
+    {
+      Triangle t;
+      t.points[0].x = vertices[indices[j]].x * scale + pos.x;
+      t.points[0].y = vertices[indices[j]].y * scale + pos.y;
+      t.points[1].x = vertices[indices[j + 1]].x * scale + pos.x;
+      t.points[1].y = vertices[indices[j + 1]].y * scale + pos.y;
+      t.points[2].x = vertices[indices[j + 2]].x * scale + pos.x;
+      t.points[2].y = vertices[indices[j + 2]].y * scale + pos.y;
+      closest_point = closest_point_triangle(t, position);
+      if (closest_point.sub(position).len() < r)
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+// distance to the closest static geometry, FLT_MAX if there is none
+f32 static_geometry_clearance(Vector2 position)
+{
+  f32 clearance = FLT_MAX;
+  for (u32 i = 0; i < map.static_geometry.count; i++)
+  {
+    Model*   model    = &map.static_geometry.models[i];
+    f32      scale    = map.static_geometry.render_data[i].scale;
+    Vector3  pos      = map.static_geometry.position[i];
+
+    Vector3* vertices = model->vertices;
+    u32*     indices  = model->indices;
+    for (u32 j = 0; j < model->index_count; j += 3)
+    {
+      Triangle t;
+      t.points[0].x = vertices[indices[j]].x * scale + pos.x;
+      t.points[0].y = vertices[indices[j]].y * scale + pos.y;
+      t.points[1].x = vertices[indices[j + 1]].x * scale + pos.x;
+      t.points[1].y = vertices[indices[j + 1]].y * scale + pos.y;
+      t.points[2].x = vertices[indices[j + 2]].x * scale + pos.x;
+      t.points[2].y = vertices[indices[j + 2]].y * scale + pos.y;
+      clearance     = MIN(clearance, closest_point_triangle(t, position).sub(position).len());
+    }
+  }
+  return clearance;
+}
+bool load_static_geometry_from_file(const char* filename)
+{
+  Json json = {};
+  if (!sta_json_deserialize_from_file(&json, filename))
+  {
+    return false;
+  }
+  assert(json.headType == JSON_OBJECT && "Expected head to be object");
+  JsonObject* head                = &json.obj;
+
+  map.static_geometry.count       = head->size;
+  map.static_geometry.position    = (Vector3*)sta_allocate_struct(Vector3, map.static_geometry.count);
+  map.static_geometry.models      = (Model*)sta_allocate_struct(Model, map.static_geometry.count);
+  map.static_geometry.render_data = (EntityRenderData*)sta_allocate_struct(EntityRenderData, map.static_geometry.count);
+
+  logger.info("Found %d static geometry items", map.static_geometry.count);
+  for (u32 i = 0; i < map.static_geometry.count; i++)
+  {
+    map.static_geometry.render_data[i] = *get_render_data_by_name(sta_json_c_string(&json, &head->keys[i]));
+    map.static_geometry.models[i]      = *get_model_by_name(sta_json_c_string(&json, &head->values[i].obj->lookup_value("model")->string));
+    JsonArray* position_json           = head->values[i].obj->lookup_value("position")->arr;
+    map.static_geometry.position[i].x  = position_json->values[0].number;
+    map.static_geometry.position[i].y  = position_json->values[1].number;
+    map.static_geometry.position[i].z  = position_json->values[2].number;
+    logger.info("Item %d: '%s' at (%f, %f, %f)", i, map.static_geometry.render_data[i].name, map.static_geometry.position[i].x, map.static_geometry.position[i].y, map.static_geometry.position[i].z);
+  }
+  sta_json_free(&json);
+
+  return true;
+}
+
+bool load_map_from_file(const char* filename)
+{
+  Json json = {};
+  if (!sta_json_deserialize_from_file(&json, filename))
+  {
+    return false;
+  }
+  assert(json.headType == JSON_OBJECT && "Expected head to be object");
+  JsonObject* head  = &json.obj;
+
+  Model*      model                    = get_model_by_name(sta_json_c_string(&json, &head->lookup_value("model")->string));
+  f32         scale                    = head->lookup_value("model")->number;
+  char*       static_geometry_location = sta_json_c_string(&json, &head->lookup_value("static_geometry")->string);
+  if (!load_static_geometry_from_file(static_geometry_location))
+  {
+    logger.error("Failed to read static geometry data from '%s'", static_geometry_location);
+    sta_json_free(&json);
+    return false;
+  }
+  map.init_map(model);
+
+  // "grid": {"extents": [min_x, min_y, max_x, max_y], "tiles": [x, y]}, defaults to the floor's bounds
+  MapGrid*   grid      = &map.grid;
+  JsonValue* grid_json = head->lookup_value("grid");
+  JsonValue* extents   = grid_json ? grid_json->obj->lookup_value("extents") : 0;
+  JsonValue* tiles     = grid_json ? grid_json->obj->lookup_value("tiles") : 0;
+  if (extents && extents->arr->arraySize == 4)
+  {
+    grid->min = Vector2(extents->arr->values[0].number, extents->arr->values[1].number);
+    grid->max = Vector2(extents->arr->values[2].number, extents->arr->values[3].number);
+  }
+  else
+  {
+    grid->min = map.vertices[0];
+    grid->max = map.vertices[0];
+    for (u32 i = 1; i < map.vertex_count; i++)
+    {
+      grid->min = Vector2(MIN(grid->min.x, map.vertices[i].x), MIN(grid->min.y, map.vertices[i].y));
+      grid->max = Vector2(MAX(grid->max.x, map.vertices[i].x), MAX(grid->max.y, map.vertices[i].y));
+    }
+  }
+  grid->tiles_x = tiles && tiles->arr->arraySize == 2 ? (u32)tiles->arr->values[0].number : DEFAULT_TILES_PER_ROW;
+  grid->tiles_y = tiles && tiles->arr->arraySize == 2 ? (u32)tiles->arr->values[1].number : DEFAULT_TILES_PER_ROW;
+  sta_json_free(&json);
+  if (grid->tiles_x == 0 || grid->tiles_y == 0 || grid->max.x <= grid->min.x || grid->max.y <= grid->min.y)
+  {
+    logger.error("Invalid grid in '%s', %dx%d tiles", filename, grid->tiles_x, grid->tiles_y);
+    return false;
+  }
+  build_walkable_grid(grid);
+  init_grid_search(&map.grid_search, grid);
+  logger.info("Map grid is %dx%d tiles over (%f, %f) to (%f, %f)", grid->tiles_x, grid->tiles_y, grid->min.x, grid->min.y, grid->max.x, grid->max.y);
+
+  // walkability depends on the radius, so every enemy size gets its own cluster graph
+  u64 hpa_start       = sta_read_monotonic_ns();
+  map.hpa_graphs      = sta_allocate_struct(HpaGraph, MAX(enemy_data_count, 1));
+  map.hpa_graph_count = 0;
+  for (u32 i = 0; i < enemy_data_count; i++)
+  {
+    if (!get_hpa_graph(enemy_data[i].radius))
+    {
+      build_hpa_graph(&map.hpa_graphs[map.hpa_graph_count++], grid, enemy_data[i].radius);
+    }
+  }
+  init_hpa_query(&map.hpa_query, map.hpa_graphs, map.hpa_graph_count);
+  if (map.hpa_graph_count > 0 && map.hpa_graphs[0].clusters_x >= HPA_DEFAULT_CLUSTERS && map.hpa_graphs[0].clusters_y >= HPA_DEFAULT_CLUSTERS)
+  {
+    game_state.hierarchical_paths = true;
+  }
+  logger.info("Built %d cluster graphs in %.1f ms, hierarchical paths are %s", map.hpa_graph_count, (sta_read_monotonic_ns() - hpa_start) / 1000000.0, game_state.hierarchical_paths ? "on" : "off");
+
+  // footprints of the static geometry on the floor plane, their hulls get cut out of the mesh
+  Vector2** obstacles       = sta_allocate_struct(Vector2*, map.static_geometry.count);
+  u32*      obstacle_counts = sta_allocate_struct(u32, map.static_geometry.count);
+  for (u32 i = 0; i < map.static_geometry.count; i++)
+  {
+    Model*  geometry   = &map.static_geometry.models[i];
+    f32     scale      = map.static_geometry.render_data[i].scale;
+    Vector3 position   = map.static_geometry.position[i];
+    obstacles[i]       = sta_allocate_struct(Vector2, geometry->vertex_count);
+    obstacle_counts[i] = geometry->vertex_count;
+    for (u32 j = 0; j < geometry->vertex_count; j++)
+    {
+      obstacles[i][j] = Vector2(geometry->vertices[j].x * scale + position.x, geometry->vertices[j].y * scale + position.y);
+    }
+  }
+  bool built = build_navmesh(&map.navmesh, map.vertices, map.indices, map.index_count, obstacles, obstacle_counts, map.static_geometry.count);
+  for (u32 i = 0; i < map.static_geometry.count; i++)
+  {
+    sta_deallocate(obstacles[i], sizeof(Vector2) * obstacle_counts[i]);
+  }
+  sta_deallocate(obstacles, sizeof(Vector2*) * map.static_geometry.count);
+  sta_deallocate(obstacle_counts, sizeof(u32) * map.static_geometry.count);
+  if (!built)
+  {
+    // only --navmesh needs it, the grid search gets by without
+    if (game_state.navmesh_paths)
+    {
+      logger.error("Failed to build navmesh from '%s'", filename);
+      return false;
+    }
+    logger.warning("Failed to build navmesh from '%s', navmesh paths are off", filename);
+    map.navmesh = {};
+    return true;
+  }
+  init_navmesh_query(&map.navmesh_query, &map.navmesh);
+  logger.info("Built navmesh with %d triangles, skipped %d obstacles", map.navmesh.triangle_count, map.navmesh.skipped_obstacles);
+  if (map.navmesh.skipped_obstacles > 0)
+  {
+    logger.warning("Static geometry not fully on the floor isn't cut out of the navmesh");
+  }
+  return true;
+}
+
+// Points to walk through in game space, the first one is where the search started from
+struct Path
+{
+  Vector2* points;
+  u32      point_count;
+  u32      point_capacity;
+};
+
+bool is_out_of_map_bounds(Vector2 position, f32 r)
+{
+  for (u32 i = 0; i < map.index_count - 2; i += 3)
+  {
+    Triangle t;
+    t.points[0].x = map.vertices[map.indices[i]].x;
+    t.points[0].y = map.vertices[map.indices[i]].y;
+    t.points[1].x = map.vertices[map.indices[i + 1]].x;
+    t.points[1].y = map.vertices[map.indices[i + 1]].y;
+    t.points[2].x = map.vertices[map.indices[i + 2]].x;
+    t.points[2].y = map.vertices[map.indices[i + 2]].y;
+    if (point_in_triangle_2d(t, Point2(position.x, position.y)))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+bool is_out_of_map_bounds(Vector2& closest_point, Vector2 position, f32 r)
+{
+  f32 distance = FLT_MAX;
+  for (u32 i = 0; i < map.index_count - 2; i += 3)
+  {
+    Triangle t;
+    t.points[0].x = map.vertices[map.indices[i]].x;
+    t.points[0].y = map.vertices[map.indices[i]].y;
+    t.points[1].x = map.vertices[map.indices[i + 1]].x;
+    t.points[1].y = map.vertices[map.indices[i + 1]].y;
+    t.points[2].x = map.vertices[map.indices[i + 2]].x;
+    t.points[2].y = map.vertices[map.indices[i + 2]].y;
+    Vector2 cp    = closest_point_triangle(t, position);
+    f32     len   = cp.sub(position).len();
+    if (len < r)
+    {
+      return false;
+    }
+    if (len < distance)
+    {
+      closest_point = cp;
+      distance      = len;
+    }
+  }
+  return true;
+}
+Vector2 tile_position_to_game(u32 x, u32 y)
+{
+  MapGrid* grid = &map.grid;
+  return Vector2((x + 0.5f) / (f32)grid->tiles_x * (grid->max.x - grid->min.x) + grid->min.x, (y + 0.5f) / (f32)grid->tiles_y * (grid->max.y - grid->min.y) + grid->min.y);
+}
+Vector2 tile_position_to_game2(u32 x, u32 y)
+{
+  MapGrid* grid = &map.grid;
+  return Vector2(x / (f32)grid->tiles_x * (grid->max.x - grid->min.x) + grid->min.x, y / (f32)grid->tiles_y * (grid->max.y - grid->min.y) + grid->min.y);
+}
+
+bool IntersectSegmentTriangle(Vector3 q, Vector3 p, Triangle3D triangle, float& u, float& v, float& w, float& t)
+{
+  Vector3 ab = triangle.points[1].sub(triangle.points[0]);
+  Vector3 ac = triangle.points[2].sub(triangle.points[0]);
+  Vector3 qp = p.sub(q);
+
+  Vector3 n  = ab.cross(ac);
+
+  float   d  = qp.dot(n);
+
+  Vector3 ap = p.sub(triangle.points[0]);
+  t          = ap.dot(n);
+
+  Vector3 e  = qp.cross(ap);
+  v          = ac.dot(e);
 
   w          = -ab.dot(e);
   bool out   = true;
@@ -1004,73 +1299,116 @@ bool Test2DSegmentSegment(Vector2 a, Vector2 b, Vector2 c, Vector2 d)
   return false;
 }
 
-bool is_tile_in_map(u8 x, u8 y, f32 r)
+void build_walkable_grid(MapGrid* grid)
 {
-  f32     xs = tile_position_to_game(x);
-  f32     ys = tile_position_to_game(y);
-
-  Vector2 v0(xs, ys);
+  grid->chunks_x      = (grid->tiles_x + WALKABLE_CHUNK_SIZE - 1) / WALKABLE_CHUNK_SIZE;
+  grid->chunks_y      = (grid->tiles_y + WALKABLE_CHUNK_SIZE - 1) / WALKABLE_CHUNK_SIZE;
+  grid->chunks        = sta_allocate_struct(WalkableChunk*, grid->chunks_x * grid->chunks_y);
+  u32 allocated_count = 0;
+  for (u32 y = 0; y < grid->tiles_y; y++)
+  {
+    for (u32 x = 0; x < grid->tiles_x; x++)
+    {
+      Vector2 center = tile_position_to_game(x, y);
+      if (is_out_of_map_bounds(center, 0))
+      {
+        continue;
+      }
+      WalkableChunk** chunk = &grid->chunks[(y / WALKABLE_CHUNK_SIZE) * grid->chunks_x + x / WALKABLE_CHUNK_SIZE];
+      if (!*chunk)
+      {
+        *chunk = sta_allocate_struct(WalkableChunk, 1);
+        allocated_count++;
+      }
+      u32 idx = (y % WALKABLE_CHUNK_SIZE) * WALKABLE_CHUNK_SIZE + x % WALKABLE_CHUNK_SIZE;
+      (*chunk)->on_floor[idx / 64] |= 1ULL << (idx % 64);
+      (*chunk)->clearance[idx] = static_geometry_clearance(center);
+    }
+  }
+  logger.info("Allocated %d of %d walkability chunks", allocated_count, grid->chunks_x * grid->chunks_y);
+}
 
-  return !is_out_of_map_bounds(v0, r);
+void init_path(Path* path)
+{
+  // grows when a longer path comes along, the navmesh one is at most every triangle plus both ends
+  path->point_capacity = MAX(2 * (map.grid.tiles_x + map.grid.tiles_y), map.navmesh.triangle_count + 2);
+  path->points         = sta_allocate_struct(Vector2, path->point_capacity);
+  path->point_count    = 0;
 }
 
-void find_path(Path* path, Vector2 needle, Vector2 source, f32 r)
+void begin_path_search(GridSearch* search, Vector2 needle, Vector2 source, f32 r)
 {
+  MapGrid* grid = &map.grid;
+
   // get the tile position of both source and needle
-  u8 source_x, source_y;
-  u8 needle_x, needle_y;
+  u32      source_x, source_y;
   map.get_tile_position(source_x, source_y, source);
-  map.get_tile_position(needle_x, needle_y, needle);
+  map.get_tile_position(search->needle_x, search->needle_y, needle);
+  search->needle = needle;
+  search->source = source;
+  search->r      = r;
 
-  // init heap
-  Heap heap               = {};
-  heap.node_count         = 0;
-  heap.node_capacity      = 2;
-  heap.nodes              = (HeapNode*)malloc(sizeof(HeapNode) * heap.node_capacity);
+  search->generation++;
+  if (search->generation == 0)
+  {
+    memset(search->generations, 0, sizeof(u32) * grid->tile_count());
+    search->generation = 1;
+  }
+  search->expanded_count  = 0;
+  search->heap.node_count = 0;
 
   HeapNode init_node      = {};
-  init_node.path_capacity = 2;
   init_node.path_count    = 1;
-  init_node.path          = (u16*)malloc(sizeof(u16) * init_node.path_capacity);
-  init_node.path[0]       = (source_x << 8) | source_y;
+  init_node.node          = source_y * grid->tiles_x + source_x;
+  init_node.parent        = -1;
   // should include number of steps
-  init_node.distance = ABS((i16)(source_x - needle_x)) + ABS((i16)(source_y - needle_y));
-
-  heap.insert(init_node);
-
-  heap.visited_count    = 0;
-  heap.visited_capacity = 2;
-  heap.visited          = (u16*)malloc(sizeof(u16) * heap.visited_capacity);
-  heap.distances        = (u32*)malloc(sizeof(u32) * heap.visited_capacity);
-
-  u32 tile_count        = get_tile_count_per_row();
+  init_node.distance      = ABS((i32)(source_x - search->needle_x)) + ABS((i32)(source_y - search->needle_y));
+  search->heap.insert(init_node);
+}
 
-  path->path_count      = 0;
-  while (heap.node_count != 0)
-  {
-    HeapNode curr = heap.remove();
-    assert(curr.path_count <= curr.path_capacity && "How?");
-    u16 curr_pos = curr.path[curr.path_count - 1];
-    if (heap.have_visited(curr))
+// Expands at most budget tiles, what's left of the budget is written back. The path is only
+// touched once the search is done
+PathSearchStatus step_path_search(GridSearch* search, Path* path, u32& budget)
+{
+  MapGrid* grid        = &map.grid;
+  Heap*    heap        = &search->heap;
+  u32      needle_x    = search->needle_x;
+  u32      needle_y    = search->needle_y;
+  u32      needle_node = needle_y * grid->tiles_x + needle_x;
+  while (heap->node_count != 0)
+  {
+    if (budget == 0)
+    {
+      return PATH_SEARCH_RUNNING;
+    }
+    HeapNode curr = heap->remove();
+    // the first time a tile comes out of the heap is the cheapest way there
+    if (search->generations[curr.node] == search->generation)
     {
       continue;
     }
+    budget--;
+    search->generations[curr.node]                     = search->generation;
+    search->expanded_nodes[search->expanded_count]     = curr.node;
+    search->expanded_parents[search->expanded_count++] = curr.parent;
 
-    if (needle_x == (curr_pos >> 8) && (needle_y == (curr_pos & 0xFF)))
+    if (curr.node == needle_node)
     {
-      for (u32 i = 0; i < curr.path_count; i++)
+      if (curr.path_count > path->point_capacity)
       {
-        path->path[i] = curr.path[i];
+        sta_deallocate(path->points, sizeof(Vector2) * path->point_capacity);
+        path->point_capacity = MAX(curr.path_count, path->point_capacity * 2);
+        path->points         = sta_allocate_struct(Vector2, path->point_capacity);
       }
-      path->path_count = curr.path_count;
-      free(curr.path);
-      for (u32 i = 0; i < heap.node_count; i++)
+      i32 expanded = search->expanded_count - 1;
+      for (i32 i = curr.path_count - 1; i >= 0; i--)
       {
-        HeapNode curr = heap.nodes[i];
-        free(curr.path);
+        u32 node        = search->expanded_nodes[expanded];
+        path->points[i] = tile_position_to_game(node % grid->tiles_x, node / grid->tiles_x);
+        expanded        = search->expanded_parents[expanded];
       }
-      free(heap.nodes);
-      return;
+      path->point_count = curr.path_count;
+      return PATH_SEARCH_FOUND;
     }
     // add neighbours if needed
     i8 XY[8][2] = {
@@ -1083,52 +1421,507 @@ void find_path(Path* path, Vector2 needle, Vector2 source, f32 r)
         { 1, -1},
         {-1, -1},
     };
+    i32 curr_x = curr.node % grid->tiles_x;
+    i32 curr_y = curr.node / grid->tiles_x;
     for (u32 i = 0; i < 8; i++)
     {
-      i16  x         = (curr_pos >> 8) + XY[i][0];
-      i16  y         = (curr_pos & 0xFF) + XY[i][1];
-      u16  new_pos   = (x << 8) | y;
-      bool is_target = needle_x == x && needle_y == y;
+      i32  x         = curr_x + XY[i][0];
+      i32  y         = curr_y + XY[i][1];
+      bool is_target = (i32)needle_x == x && (i32)needle_y == y;
       if (!is_target)
       {
-        if (x < 0 || y < 0 || x >= (i16)tile_count || y >= (i16)tile_count)
+        if (x < 0 || y < 0 || x >= (i32)grid->tiles_x || y >= (i32)grid->tiles_y)
         {
           continue;
         }
-        Vector2 c;
-        if (!is_tile_in_map(x, y, r) || collides_with_static_geometry(c, Vector2(tile_position_to_game(x), tile_position_to_game(y)), r))
+        if (!grid->is_walkable(x, y, search->r))
         {
           continue;
         }
       }
-      HeapNode new_node      = {};
-      new_node.path          = (u16*)malloc(sizeof(u16) * curr.path_capacity);
-      new_node.path_capacity = curr.path_capacity;
-      for (u32 j = 0; j < curr.path_count; j++)
-      {
-        new_node.path[j] = curr.path[j];
-      }
-      new_node.distance = ABS((i16)(x - needle_x)) + ABS((i16)(y - needle_y));
-      // if so create new with same path and add the neighbour coordinates
-      new_node.path_count = curr.path_count;
-      if (new_node.path_count >= new_node.path_capacity)
-      {
-        new_node.path_capacity *= 2;
-        new_node.path = (u16*)realloc(new_node.path, sizeof(u16) * new_node.path_capacity);
-      }
-      new_node.path[new_node.path_count++] = new_pos;
-      assert(new_node.path_count <= tile_count * 4 && "Out of range for path!");
-      heap.insert(new_node);
+      HeapNode new_node   = {};
+      new_node.node       = y * grid->tiles_x + x;
+      new_node.parent     = search->expanded_count - 1;
+      new_node.distance   = ABS(x - (i32)needle_x) + ABS(y - (i32)needle_y);
+      new_node.path_count = curr.path_count + 1;
+      heap->insert(new_node);
     }
-    // free node memory :)
-    free(curr.path);
   }
 
-  logger.error("Didn't find a path to player from (%d, %d) to (%d, %d), (%f, %f), (%f, %f)", source_x, source_y, needle_x, needle_y, source.x, source.y, needle.x, needle.y);
+  Vector2 source = search->source;
+  Vector2 needle = search->needle;
+  logger.error("Didn't find a path to player from (%f, %f) to (%d, %d), (%f, %f)", source.x, source.y, needle_x, needle_y, needle.x, needle.y);
   assert(!"Didn't find a path to player!");
+  return PATH_SEARCH_FAILED;
 }
 
-bool sphere_sphere_collision(Sphere s0, Sphere s1)
+void find_path(Path* path, Vector2 needle, Vector2 source, f32 r)
+{
+  begin_path_search(&map.grid_search, needle, source, r);
+  u32 budget = ~0u;
+  step_path_search(&map.grid_search, path, budget);
+}
+
+// Grows the path keeping the points it already has
+void reserve_path(Path* path, u32 count)
+{
+  if (count > path->point_capacity)
+  {
+    u32      capacity = MAX(count, path->point_capacity * 2);
+    Vector2* points   = sta_allocate_struct(Vector2, capacity);
+    memcpy(points, path->points, sizeof(Vector2) * path->point_count);
+    sta_deallocate(path->points, sizeof(Vector2) * path->point_capacity);
+    path->points         = points;
+    path->point_capacity = capacity;
+  }
+}
+
+u32 hpa_tile_cluster(MapGrid* grid, HpaGraph* graph, u32 tile)
+{
+  return (tile / grid->tiles_x / HPA_CLUSTER_SIZE) * graph->clusters_x + (tile % grid->tiles_x) / HPA_CLUSTER_SIZE;
+}
+
+u32 hpa_cluster_index(MapGrid* grid, u32 tile)
+{
+  return ((tile / grid->tiles_x) % HPA_CLUSTER_SIZE) * HPA_CLUSTER_SIZE + (tile % grid->tiles_x) % HPA_CLUSTER_SIZE;
+}
+
+// Breadth first search from source that never leaves its cluster, steps and parents are indexed by
+// hpa_cluster_index and ~0u where nothing got to. Like the grid search the source and target don't
+// have to be walkable, pass ~0u for no target. Returns the number of tiles expanded
+u32 hpa_search_cluster(MapGrid* grid, u32 source, u32 target, f32 r, u32* steps, u32* parents, u32* queue)
+{
+  memset(steps, 0xff, sizeof(u32) * HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE);
+  i32 min_x                              = (source % grid->tiles_x) / HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE;
+  i32 min_y                              = (source / grid->tiles_x) / HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE;
+  i32 max_x                              = MIN(min_x + HPA_CLUSTER_SIZE, (i32)grid->tiles_x);
+  i32 max_y                              = MIN(min_y + HPA_CLUSTER_SIZE, (i32)grid->tiles_y);
+  u32 queue_start                        = 0;
+  u32 queue_end                          = 0;
+  steps[hpa_cluster_index(grid, source)] = 0;
+  queue[queue_end++]                     = source;
+  while (queue_start < queue_end)
+  {
+    u32 tile       = queue[queue_start++];
+    u32 tile_steps = steps[hpa_cluster_index(grid, tile)];
+    if (tile == target)
+    {
+      continue;
+    }
+    i32 tile_x = tile % grid->tiles_x;
+    i32 tile_y = tile / grid->tiles_x;
+    for (i32 y = MAX(tile_y - 1, min_y); y < MIN(tile_y + 2, max_y); y++)
+    {
+      for (i32 x = MAX(tile_x - 1, min_x); x < MIN(tile_x + 2, max_x); x++)
+      {
+        u32 neighbour = y * grid->tiles_x + x;
+        u32 idx       = hpa_cluster_index(grid, neighbour);
+        if (steps[idx] != ~0u || (neighbour != target && !grid->is_walkable(x, y, r)))
+        {
+          continue;
+        }
+        steps[idx]         = tile_steps + 1;
+        parents[idx]       = tile;
+        queue[queue_end++] = neighbour;
+      }
+    }
+  }
+  return queue_end;
+}
+
+struct HpaBuildEdge
+{
+  u32     source;
+  HpaEdge edge;
+};
+
+// Collects nodes and edges while the graph is built, tile_nodes has node + 1 for every tile that is one
+struct HpaBuilder
+{
+  u32*          tile_nodes;
+  u32*          node_tiles;
+  u32           node_count;
+  u32           node_capacity;
+  HpaBuildEdge* edges;
+  u32           edge_count;
+  u32           edge_capacity;
+};
+
+u32 hpa_builder_node(HpaBuilder* builder, u32 tile)
+{
+  if (builder->tile_nodes[tile] == 0)
+  {
+    RESIZE_ARRAY(builder->node_tiles, u32, builder->node_count, builder->node_capacity);
+    builder->node_tiles[builder->node_count++] = tile;
+    builder->tile_nodes[tile]                  = builder->node_count;
+  }
+  return builder->tile_nodes[tile] - 1;
+}
+
+void hpa_builder_edge(HpaBuilder* builder, u32 source, u32 target, u32 cost)
+{
+  RESIZE_ARRAY(builder->edges, HpaBuildEdge, builder->edge_count, builder->edge_capacity);
+  HpaBuildEdge* edge = &builder->edges[builder->edge_count++];
+  edge->source       = source;
+  edge->edge.target  = target;
+  edge->edge.cost    = cost;
+}
+
+// Open tiles first..last along a border, a_tile + i * step on one side faces b_tile + i * step on the other
+void hpa_add_entrance(HpaBuilder* builder, u32 a_tile, u32 b_tile, u32 step, u32 first, u32 last)
+{
+  u32 positions[2] = {(first + last) / 2, (first + last) / 2};
+  if (last - first + 1 > HPA_MAX_ENTRANCE_WIDTH)
+  {
+    positions[0] = first;
+    positions[1] = last;
+  }
+  for (u32 i = 0; i < (positions[0] == positions[1] ? 1u : 2u); i++)
+  {
+    u32 a = hpa_builder_node(builder, a_tile + positions[i] * step);
+    u32 b = hpa_builder_node(builder, b_tile + positions[i] * step);
+    hpa_builder_edge(builder, a, b, 1);
+    hpa_builder_edge(builder, b, a, 1);
+  }
+}
+
+// Walks the border between two clusters, a_tile and b_tile are the first pair of tiles facing each other
+void hpa_find_entrances(HpaBuilder* builder, MapGrid* grid, f32 r, u32 a_tile, u32 b_tile, u32 step, u32 length)
+{
+  i32 run_start = -1;
+  for (u32 i = 0; i <= length; i++)
+  {
+    bool open = false;
+    if (i < length)
+    {
+      u32 a = a_tile + i * step;
+      u32 b = b_tile + i * step;
+      open  = grid->is_walkable(a % grid->tiles_x, a / grid->tiles_x, r) && grid->is_walkable(b % grid->tiles_x, b / grid->tiles_x, r);
+    }
+    if (open && run_start < 0)
+    {
+      run_start = i;
+    }
+    else if (!open && run_start >= 0)
+    {
+      hpa_add_entrance(builder, a_tile, b_tile, step, run_start, i - 1);
+      run_start = -1;
+    }
+  }
+}
+
+void build_hpa_graph(HpaGraph* graph, MapGrid* grid, f32 r)
+{
+  graph->r              = r;
+  graph->clusters_x     = (grid->tiles_x + HPA_CLUSTER_SIZE - 1) / HPA_CLUSTER_SIZE;
+  graph->clusters_y     = (grid->tiles_y + HPA_CLUSTER_SIZE - 1) / HPA_CLUSTER_SIZE;
+  u32 cluster_count     = graph->clusters_x * graph->clusters_y;
+
+  HpaBuilder builder    = {};
+  builder.tile_nodes    = sta_allocate_struct(u32, grid->tile_count());
+  builder.node_capacity = 64;
+  builder.node_tiles    = sta_allocate_struct(u32, builder.node_capacity);
+  builder.edge_capacity = 256;
+  builder.edges         = sta_allocate_struct(HpaBuildEdge, builder.edge_capacity);
+  for (u32 cluster_y = 0; cluster_y < graph->clusters_y; cluster_y++)
+  {
+    for (u32 cluster_x = 0; cluster_x < graph->clusters_x; cluster_x++)
+    {
+      u32 min_x  = cluster_x * HPA_CLUSTER_SIZE;
+      u32 min_y  = cluster_y * HPA_CLUSTER_SIZE;
+      u32 width  = MIN(HPA_CLUSTER_SIZE, grid->tiles_x - min_x);
+      u32 height = MIN(HPA_CLUSTER_SIZE, grid->tiles_y - min_y);
+      if (cluster_x + 1 < graph->clusters_x)
+      {
+        u32 a = min_y * grid->tiles_x + min_x + width - 1;
+        hpa_find_entrances(&builder, grid, r, a, a + 1, grid->tiles_x, height);
+      }
+      if (cluster_y + 1 < graph->clusters_y)
+      {
+        u32 a = (min_y + height - 1) * grid->tiles_x + min_x;
+        hpa_find_entrances(&builder, grid, r, a, a + grid->tiles_x, 1, width);
+      }
+    }
+  }
+
+  // sort the nodes by cluster so a cluster's nodes are next to each other
+  graph->node_count        = builder.node_count;
+  graph->node_tiles        = sta_allocate_struct(u32, MAX(graph->node_count, 1));
+  graph->cluster_offsets   = sta_allocate_struct(u32, cluster_count + 1);
+  graph->max_cluster_nodes = 0;
+  u32* remap               = sta_allocate_struct(u32, MAX(graph->node_count, 1));
+  u32* cursors             = sta_allocate_struct(u32, cluster_count);
+  for (u32 i = 0; i < builder.node_count; i++)
+  {
+    graph->cluster_offsets[hpa_tile_cluster(grid, graph, builder.node_tiles[i]) + 1]++;
+  }
+  for (u32 i = 0; i < cluster_count; i++)
+  {
+    graph->max_cluster_nodes       = MAX(graph->max_cluster_nodes, graph->cluster_offsets[i + 1]);
+    graph->cluster_offsets[i + 1] += graph->cluster_offsets[i];
+    cursors[i]                     = graph->cluster_offsets[i];
+  }
+  for (u32 i = 0; i < builder.node_count; i++)
+  {
+    u32 node                = cursors[hpa_tile_cluster(grid, graph, builder.node_tiles[i])]++;
+    graph->node_tiles[node] = builder.node_tiles[i];
+    remap[i]                = node;
+  }
+  for (u32 i = 0; i < builder.edge_count; i++)
+  {
+    builder.edges[i].source      = remap[builder.edges[i].source];
+    builder.edges[i].edge.target = remap[builder.edges[i].edge.target];
+  }
+
+  // every node to every other node its cluster lets it get to
+  u32* steps   = sta_allocate_struct(u32, HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE);
+  u32* parents = sta_allocate_struct(u32, HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE);
+  u32* queue   = sta_allocate_struct(u32, HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE);
+  for (u32 cluster = 0; cluster < cluster_count; cluster++)
+  {
+    for (u32 a = graph->cluster_offsets[cluster]; a < graph->cluster_offsets[cluster + 1]; a++)
+    {
+      hpa_search_cluster(grid, graph->node_tiles[a], ~0u, r, steps, parents, queue);
+      for (u32 b = graph->cluster_offsets[cluster]; b < graph->cluster_offsets[cluster + 1]; b++)
+      {
+        u32 b_steps = steps[hpa_cluster_index(grid, graph->node_tiles[b])];
+        if (a != b && b_steps != ~0u)
+        {
+          hpa_builder_edge(&builder, a, b, b_steps);
+        }
+      }
+    }
+  }
+
+  graph->edge_count   = builder.edge_count;
+  graph->edge_offsets = sta_allocate_struct(u32, graph->node_count + 1);
+  graph->edges        = sta_allocate_struct(HpaEdge, MAX(graph->edge_count, 1));
+  for (u32 i = 0; i < builder.edge_count; i++)
+  {
+    graph->edge_offsets[builder.edges[i].source + 1]++;
+  }
+  for (u32 i = 0; i < graph->node_count; i++)
+  {
+    graph->edge_offsets[i + 1] += graph->edge_offsets[i];
+  }
+  u32* edge_cursors = sta_allocate_struct(u32, MAX(graph->node_count, 1));
+  memcpy(edge_cursors, graph->edge_offsets, sizeof(u32) * graph->node_count);
+  for (u32 i = 0; i < builder.edge_count; i++)
+  {
+    graph->edges[edge_cursors[builder.edges[i].source]++] = builder.edges[i].edge;
+  }
+
+  sta_deallocate(steps, sizeof(u32) * HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE);
+  sta_deallocate(parents, sizeof(u32) * HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE);
+  sta_deallocate(queue, sizeof(u32) * HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE);
+  sta_deallocate(cursors, sizeof(u32) * cluster_count);
+  sta_deallocate(edge_cursors, sizeof(u32) * MAX(graph->node_count, 1));
+  sta_deallocate(remap, sizeof(u32) * MAX(graph->node_count, 1));
+  sta_deallocate(builder.tile_nodes, sizeof(u32) * grid->tile_count());
+  sta_deallocate(builder.node_tiles, sizeof(u32) * builder.node_capacity);
+  sta_deallocate(builder.edges, sizeof(HpaBuildEdge) * builder.edge_capacity);
+}
+
+HpaGraph* get_hpa_graph(f32 r)
+{
+  for (u32 i = 0; i < map.hpa_graph_count; i++)
+  {
+    if (map.hpa_graphs[i].r == r)
+    {
+      return &map.hpa_graphs[i];
+    }
+  }
+  return 0;
+}
+
+void init_hpa_query(HpaQuery* query, HpaGraph* graphs, u32 graph_count)
+{
+  u32 node_count    = 0;
+  u32 cluster_nodes = 1;
+  for (u32 i = 0; i < graph_count; i++)
+  {
+    node_count    = MAX(node_count, graphs[i].node_count);
+    cluster_nodes = MAX(cluster_nodes, graphs[i].max_cluster_nodes);
+  }
+  query->heap.node_count    = 0;
+  query->heap.node_capacity = 64;
+  query->heap.nodes         = (HeapNode*)malloc(sizeof(HeapNode) * query->heap.node_capacity);
+  query->node_capacity      = node_count + 2;
+  query->costs              = sta_allocate_struct(u32, query->node_capacity);
+  query->parents            = sta_allocate_struct(u32, query->node_capacity);
+  query->generations        = sta_allocate_struct(u32, query->node_capacity);
+  query->closed             = sta_allocate_struct(u32, query->node_capacity);
+  query->generation         = 0;
+  query->start_costs        = sta_allocate_struct(u32, cluster_nodes);
+  query->goal_costs         = sta_allocate_struct(u32, cluster_nodes);
+  query->cluster_steps      = sta_allocate_struct(u32, HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE);
+  query->cluster_parents    = sta_allocate_struct(u32, HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE);
+  query->cluster_queue      = sta_allocate_struct(u32, HPA_CLUSTER_SIZE * HPA_CLUSTER_SIZE);
+  query->abstract_nodes     = sta_allocate_struct(u32, query->node_capacity);
+}
+
+// Appends the tiles after from up to to, from the last hpa_search_cluster that started at from
+void hpa_append_cluster_path(MapGrid* grid, HpaQuery* query, Path* path, u32 to)
+{
+  u32 steps = query->cluster_steps[hpa_cluster_index(grid, to)];
+  reserve_path(path, path->point_count + steps);
+  u32 tile = to;
+  for (u32 i = steps; i > 0; i--)
+  {
+    path->points[path->point_count + i - 1] = tile_position_to_game(tile % grid->tiles_x, tile / grid->tiles_x);
+    tile                                    = query->cluster_parents[hpa_cluster_index(grid, tile)];
+  }
+  path->point_count += steps;
+}
+
+void hpa_relax(HpaQuery* query, u32 node, u32 cost, u32 parent, u32 estimate)
+{
+  if (query->generations[node] == query->generation && query->costs[node] <= cost)
+  {
+    return;
+  }
+  query->generations[node] = query->generation;
+  query->costs[node]       = cost;
+  query->parents[node]     = parent;
+  HeapNode heap_node       = {};
+  heap_node.distance       = estimate;
+  heap_node.path_count     = cost;
+  heap_node.node           = node;
+  heap_node.parent         = -1;
+  query->heap.insert(heap_node);
+}
+
+// the grid search takes diagonal steps for the same cost as straight ones
+u32 hpa_estimate(MapGrid* grid, u32 tile, u32 needle_x, u32 needle_y)
+{
+  return MAX(ABS((i32)(tile % grid->tiles_x) - (i32)needle_x), ABS((i32)(tile / grid->tiles_x) - (i32)needle_y));
+}
+
+// Fills path with tile centers from source to needle like find_path, the first point is the source's
+// tile. Only the start of it is walked tile by tile, past a cluster's worth of steps it goes straight
+// from node to node since enemies search again long before they get that far. The path is left alone
+// and false returned if the graph has no way there
+bool hpa_find_path(HpaGraph* graph, HpaQuery* query, Path* path, Vector2 needle, Vector2 source)
+{
+  MapGrid* grid = &map.grid;
+  u32      source_x, source_y, needle_x, needle_y;
+  map.get_tile_position(source_x, source_y, source);
+  map.get_tile_position(needle_x, needle_y, needle);
+  u32 source_tile    = source_y * grid->tiles_x + source_x;
+  u32 needle_tile    = needle_y * grid->tiles_x + needle_x;
+  u32 source_cluster = hpa_tile_cluster(grid, graph, source_tile);
+  u32 needle_cluster = hpa_tile_cluster(grid, graph, needle_tile);
+  query->expanded    = 0;
+
+  // nothing to plan if the cluster has a way there on its own
+  if (source_cluster == needle_cluster)
+  {
+    query->expanded += hpa_search_cluster(grid, source_tile, needle_tile, graph->r, query->cluster_steps, query->cluster_parents, query->cluster_queue);
+    if (query->cluster_steps[hpa_cluster_index(grid, needle_tile)] != ~0u)
+    {
+      path->points[0]   = tile_position_to_game(source_x, source_y);
+      path->point_count = 1;
+      hpa_append_cluster_path(grid, query, path, needle_tile);
+      return true;
+    }
+  }
+
+  query->generation++;
+  if (query->generation == 0)
+  {
+    memset(query->generations, 0, sizeof(u32) * query->node_capacity);
+    memset(query->closed, 0, sizeof(u32) * query->node_capacity);
+    query->generation = 1;
+  }
+  query->heap.node_count = 0;
+  u32 start              = graph->node_count;
+  u32 goal               = graph->node_count + 1;
+  u32 source_first       = graph->cluster_offsets[source_cluster];
+  u32 needle_first       = graph->cluster_offsets[needle_cluster];
+
+  // the start and goal only connect to the nodes in their own cluster
+  query->expanded += hpa_search_cluster(grid, needle_tile, ~0u, graph->r, query->cluster_steps, query->cluster_parents, query->cluster_queue);
+  for (u32 node = needle_first; node < graph->cluster_offsets[needle_cluster + 1]; node++)
+  {
+    query->goal_costs[node - needle_first] = query->cluster_steps[hpa_cluster_index(grid, graph->node_tiles[node])];
+  }
+  query->expanded += hpa_search_cluster(grid, source_tile, ~0u, graph->r, query->cluster_steps, query->cluster_parents, query->cluster_queue);
+  for (u32 node = source_first; node < graph->cluster_offsets[source_cluster + 1]; node++)
+  {
+    u32 steps = query->cluster_steps[hpa_cluster_index(grid, graph->node_tiles[node])];
+    if (steps != ~0u)
+    {
+      hpa_relax(query, node, steps, start, hpa_estimate(grid, graph->node_tiles[node], needle_x, needle_y));
+    }
+  }
+
+  bool found = false;
+  while (query->heap.node_count != 0)
+  {
+    HeapNode curr = query->heap.remove();
+    // nodes get pushed again when a cheaper way there turns up, only the cheapest counts
+    if (query->closed[curr.node] == query->generation || curr.path_count != query->costs[curr.node])
+    {
+      continue;
+    }
+    query->closed[curr.node] = query->generation;
+    query->expanded++;
+    if (curr.node == goal)
+    {
+      found = true;
+      break;
+    }
+    for (u32 i = graph->edge_offsets[curr.node]; i < graph->edge_offsets[curr.node + 1]; i++)
+    {
+      HpaEdge edge = graph->edges[i];
+      hpa_relax(query, edge.target, curr.path_count + edge.cost, curr.node, hpa_estimate(grid, graph->node_tiles[edge.target], needle_x, needle_y));
+    }
+    if (hpa_tile_cluster(grid, graph, graph->node_tiles[curr.node]) == needle_cluster && query->goal_costs[curr.node - needle_first] != ~0u)
+    {
+      hpa_relax(query, goal, curr.path_count + query->goal_costs[curr.node - needle_first], curr.node, 0);
+    }
+  }
+  if (!found)
+  {
+    return false;
+  }
+
+  u32 abstract_count = 0;
+  for (u32 node = query->parents[goal]; node != start; node = query->parents[node])
+  {
+    query->abstract_nodes[abstract_count++] = node;
+  }
+  path->points[0]   = tile_position_to_game(source_x, source_y);
+  path->point_count = 1;
+  u32 from          = source_tile;
+  for (i32 i = abstract_count - 1; i >= -1; i--)
+  {
+    u32 to = i >= 0 ? graph->node_tiles[query->abstract_nodes[i]] : needle_tile;
+    if (to == from)
+    {
+      continue;
+    }
+    bool refined = false;
+    if (path->point_count <= HPA_CLUSTER_SIZE && hpa_tile_cluster(grid, graph, from) == hpa_tile_cluster(grid, graph, to))
+    {
+      query->expanded += hpa_search_cluster(grid, from, to, graph->r, query->cluster_steps, query->cluster_parents, query->cluster_queue);
+      if (query->cluster_steps[hpa_cluster_index(grid, to)] != ~0u)
+      {
+        hpa_append_cluster_path(grid, query, path, to);
+        refined = true;
+      }
+    }
+    if (!refined)
+    {
+      reserve_path(path, path->point_count + 1);
+      path->points[path->point_count++] = tile_position_to_game(to % grid->tiles_x, to / grid->tiles_x);
+    }
+    from = to;
+  }
+  return true;
+}
+
+bool sphere_sphere_collision(Sphere s0, Sphere s1)
 {
   f32 x_diff                           = ABS(s0.position.x - s1.position.x);
   f32 y_diff                           = ABS(s0.position.y - s1.position.y);
@@ -1160,8 +1953,8 @@ Vector2 get_random_position(f32 r)
   do
   {
 
-    f32 x              = random_double_range(-1.0, 1.0);
-    f32 y              = random_double_range(-1.0, 1.0);
+    f32 x              = game_state.rng.range(-1.0, 1.0);
+    f32 y              = game_state.rng.range(-1.0, 1.0);
 
     position           = Vector2(x, y);
 
@@ -1194,8 +1987,17 @@ struct Wave
 
 struct CommandFindPathData
 {
-  u32 enemy_idx;
-  u32 tick;
+  u32     enemy_idx;
+  u32     tick;
+  // what a worker searches from, taken on the main thread when the request is handed out
+  Vector2 source;
+  Vector2 target;
+  f32     r;
+  u32     sequence;
+  bool    found;
+  bool    cancelled;
+  // a worker's output, swapped with the enemy's path once it's applied
+  Path    result;
 };
 
 enum CommandType
@@ -1251,6 +2053,7 @@ struct CommandExplodePillarOfFlameData
 };
 
 void   add_command(CommandType type, void* data, u32 tick);
+void   cancel_path_requests(u32 enemy_idx);
 
 Enemy* enemies;
 u32    enemy_count;
@@ -1273,6 +2076,7 @@ i32    get_new_enemy()
 void spawn(EnemyType type, u32 tick)
 {
   u32 enemy_idx = get_new_enemy();
+  cancel_path_requests(enemy_idx);
   Enemy* enemy                  = &enemies[enemy_idx];
   enemy->entity                 = get_new_entity();
 
@@ -1286,11 +2090,9 @@ void spawn(EnemyType type, u32 tick)
   enemy->can_move               = true;
   enemy->cooldown               = data.cooldown;
   enemy->cooldown_timer         = 0;
-  if (!enemy->path.path)
+  if (!enemy->path.points)
   {
-    u32 tile_count         = get_tile_count_per_row();
-    enemy->path.path       = sta_allocate_struct(u16, tile_count * tile_count);
-    enemy->path.path_count = 0;
+    init_path(&enemy->path);
     CommandNode* cmd       = command_queue.head;
     CommandNode* prev      = 0;
     while (cmd)
@@ -1325,11 +2127,13 @@ void spawn(EnemyType type, u32 tick)
   entity->velocity    = Vector2(0, 0);
   entity->position    = get_random_position(entity->r);
   entity->hp          = enemy->initial_hp;
+  game_state.enemies_spawned++;
   logger.info("Spawning enemy at (%f, %f) %d", entity->position.x, entity->position.y, tick);
 
   CommandFindPathData* path_data = sta_allocate_struct(CommandFindPathData, 1);
   path_data->enemy_idx           = enemy_idx;
   path_data->tick                = tick;
+  init_path(&path_data->result);
 
   add_command(CMD_FIND_PATH, (void*)path_data, path_data->tick);
 }
@@ -1380,12 +2184,13 @@ void run_command_explode_pillar_of_flame(void* data)
 void run_command_update_wave(void* data, u32 tick)
 {
   CommandUpdateWave* update_data = (CommandUpdateWave*)data;
+  game_state.wave++;
   for (u32 i = 0; i < update_data->number_of_enemies; i++)
   {
     // get the spawn time between 0 - 10 sec
-    u32                    spawn_time = tick + random_double_range(0, 10) * 1000;
+    u32                    spawn_time = tick + game_state.rng.range(0, 10) * 1000;
     CommandSpawnEnemyData* data       = sta_allocate_struct(CommandSpawnEnemyData, 1);
-    data->type                        = (EnemyType)(u32)random_double_range(0, 2.99);
+    data->type                        = (EnemyType)(u32)game_state.rng.range(0, 2.99);
     add_command(CMD_SPAWN_ENEMY, data, spawn_time);
   }
   const f32 update_enemy_factor = 1.5;
@@ -1411,45 +2216,466 @@ void run_command_shoot_arrow(void* data)
   enemy->can_move                               = true;
 }
 
-void run_command_find_path(void* data)
+#define DEFAULT_PATH_BUDGET       512
+#define DEFAULT_PATH_THREADS      4
+#define PATH_RESULT_RING_CAPACITY WORK_QUEUE_CAPACITY
+
+// Search scratch for whichever thread runs a path job, taken with busy
+struct PathWorker
 {
-  const u32            next_tick = 75;
-  CommandFindPathData* path_data = (CommandFindPathData*)data;
-  Enemy*               enemy     = &enemies[path_data->enemy_idx];
-  enemy->path.path_count         = 0;
-  find_path(&enemy->path, game_state.entities[game_state.player.entity].position, game_state.entities[enemy->entity].position, game_state.entities[enemy->entity].r);
+  GridSearch   grid_search;
+  NavMeshQuery navmesh_query;
+  HpaQuery     hpa_query;
+  bool         busy;
+};
+
+struct PathResult
+{
+  u64                  sequence;
+  CommandFindPathData* request;
+};
+
+// Bounded multi producer queue like the log ring, nothing is ever in flight that there isn't room
+// for so workers never wait on the main thread
+struct PathResultRing
+{
+  PathResult results[PATH_RESULT_RING_CAPACITY];
+  alignas(64) u64 write;
+  alignas(64) u64 read;
+};
+
+// Path requests wait here until they're searched for, closest enemy to the player first.
+// With workers, every request handed out during an update is searched on the work queue and
+// applied at the start of the next update in the order it was handed out, so the simulation stays
+// deterministic no matter how the workers get scheduled. Without workers, the main thread gets
+// budget tile expansions per update and a search that doesn't finish keeps its state in
+// map.grid_search and picks up where it left off next update. Either way the enemy keeps walking
+// its old path until the new one is in. Counted in expansions rather than time so replays match
+struct PathScheduler
+{
+  u32                   budget;
+  CommandFindPathData** pending;
+  u32                   pending_count;
+  u32                   pending_capacity;
+  CommandFindPathData*  active;
+  u32                   coalesced;
+  u32                   completed;
+  u64                   cycles_max;
+  u64                   cycles_total;
+  u64                   run_count;
+
+  u32                   thread_count;
+  WorkQueue             queue;
+  PathWorker*           workers;
+  u32                   worker_count;
+  CommandFindPathData*  in_flight[PATH_RESULT_RING_CAPACITY];
+  u32                   in_flight_count;
+  u32                   next_sequence;
+  PathResultRing*       results;
+};
+PathScheduler path_scheduler;
+
+void          init_path_scheduler(u32 budget, u32 thread_count)
+{
+  path_scheduler.budget           = budget;
+  path_scheduler.thread_count     = thread_count;
+  path_scheduler.pending_count    = 0;
+  path_scheduler.pending_capacity = 16;
+  path_scheduler.pending          = sta_allocate_struct(CommandFindPathData*, path_scheduler.pending_capacity);
+  path_scheduler.active           = 0;
+  path_scheduler.in_flight_count  = 0;
+  path_scheduler.workers          = 0;
+  path_scheduler.worker_count     = 0;
+}
+
+// Needs the map, every worker gets its own scratch plus one for the main thread helping out
+bool start_path_workers()
+{
+  if (path_scheduler.thread_count == 0)
+  {
+    return true;
+  }
+  if (!path_scheduler.queue.init(path_scheduler.thread_count))
+  {
+    return false;
+  }
+  path_scheduler.worker_count = path_scheduler.queue.thread_count + 1;
+  path_scheduler.workers      = sta_allocate_struct(PathWorker, path_scheduler.worker_count);
+  for (u32 i = 0; i < path_scheduler.worker_count; i++)
+  {
+    init_grid_search(&path_scheduler.workers[i].grid_search, &map.grid);
+    if (map.navmesh.triangle_count > 0)
+    {
+      init_navmesh_query(&path_scheduler.workers[i].navmesh_query, &map.navmesh);
+    }
+    init_hpa_query(&path_scheduler.workers[i].hpa_query, map.hpa_graphs, map.hpa_graph_count);
+  }
+  path_scheduler.results = sta_allocate_struct(PathResultRing, 1);
+  logger.info("Searching paths on %u worker threads", path_scheduler.queue.thread_count);
+  return true;
+}
+
+bool is_enemy_alive(u32 enemy_idx)
+{
+  return enemy_idx < enemy_count && game_state.entities[enemies[enemy_idx].entity].hp > 0;
+}
+
+void free_path_request(CommandFindPathData* path_data)
+{
+  sta_deallocate(path_data->result.points, sizeof(Vector2) * path_data->result.point_capacity);
+  sta_deallocate(path_data, sizeof(CommandFindPathData));
+}
+
+void finish_path_request(CommandFindPathData* path_data)
+{
+  const u32 next_tick = 75;
+  path_scheduler.completed++;
   path_data->tick += next_tick;
   add_command(CMD_FIND_PATH, (void*)path_data, path_data->tick);
 }
 
-void run_command_stop_charge()
+// Requests for an enemy that's already waiting or being searched for are dropped, only one will
+// be rescheduled once it finishes
+void run_command_find_path(void* data)
 {
-  game_state.player.can_move = true;
+  CommandFindPathData* path_data = (CommandFindPathData*)data;
+  bool                 waiting   = path_scheduler.active && path_scheduler.active->enemy_idx == path_data->enemy_idx;
+  for (u32 i = 0; i < path_scheduler.pending_count && !waiting; i++)
+  {
+    waiting = path_scheduler.pending[i]->enemy_idx == path_data->enemy_idx;
+  }
+  for (u32 i = 0; i < path_scheduler.in_flight_count && !waiting; i++)
+  {
+    waiting = !path_scheduler.in_flight[i]->cancelled && path_scheduler.in_flight[i]->enemy_idx == path_data->enemy_idx;
+  }
+  if (waiting)
+  {
+    path_scheduler.coalesced++;
+    free_path_request(path_data);
+    return;
+  }
+  RESIZE_ARRAY(path_scheduler.pending, CommandFindPathData*, path_scheduler.pending_count, path_scheduler.pending_capacity);
+  path_scheduler.pending[path_scheduler.pending_count++] = path_data;
 }
 
-void run_commands(u32 ticks)
+// The slot is about to be reused, whatever was asked for the previous enemy is stale
+void cancel_path_requests(u32 enemy_idx)
 {
+  if (path_scheduler.active && path_scheduler.active->enemy_idx == enemy_idx)
+  {
+    free_path_request(path_scheduler.active);
+    path_scheduler.active = 0;
+  }
+  for (u32 i = 0; i < path_scheduler.pending_count; i++)
+  {
+    if (path_scheduler.pending[i]->enemy_idx == enemy_idx)
+    {
+      free_path_request(path_scheduler.pending[i]);
+      path_scheduler.pending[i--] = path_scheduler.pending[--path_scheduler.pending_count];
+    }
+  }
+  // a worker might be on it, it's freed once the result comes back
+  for (u32 i = 0; i < path_scheduler.in_flight_count; i++)
+  {
+    if (path_scheduler.in_flight[i]->enemy_idx == enemy_idx)
+    {
+      path_scheduler.in_flight[i]->cancelled = true;
+    }
+  }
+}
 
-  CommandNode* node = command_queue.head;
-  CommandNode* prev = 0;
-  while (node)
+// Closest enemy to the player goes first, dead ones are dropped on the way
+CommandFindPathData* take_next_path_request()
+{
+  Vector2 player  = game_state.entities[game_state.player.entity].position;
+  i32     best    = -1;
+  f32     closest = FLT_MAX;
+  for (u32 i = 0; i < path_scheduler.pending_count; i++)
   {
-    if (ticks > node->command.execute_tick)
+    u32 enemy_idx = path_scheduler.pending[i]->enemy_idx;
+    if (!is_enemy_alive(enemy_idx))
     {
-      switch (node->command.type)
-      {
-      case CMD_EXPLODE_PILLAR:
-      {
-        run_command_explode_pillar_of_flame(node->command.data);
-        break;
-      }
-      case CMD_SPAWN_ENEMY:
-      {
-        run_command_spawn_enemy(node->command.data, ticks);
-        break;
-      }
-      case CMD_LET_RANGED_MOVE_AFTER_SHOOTING:
-      {
+      free_path_request(path_scheduler.pending[i]);
+      path_scheduler.pending[i--] = path_scheduler.pending[--path_scheduler.pending_count];
+      continue;
+    }
+    f32 distance = game_state.entities[enemies[enemy_idx].entity].position.sub(player).len();
+    if (distance < closest)
+    {
+      best    = i;
+      closest = distance;
+    }
+  }
+  if (best < 0)
+  {
+    return 0;
+  }
+  CommandFindPathData* path_data   = path_scheduler.pending[best];
+  // keep the order of the rest so equally close requests are served first come first served
+  for (u32 i = best; i + 1 < path_scheduler.pending_count; i++)
+  {
+    path_scheduler.pending[i] = path_scheduler.pending[i + 1];
+  }
+  path_scheduler.pending_count--;
+  return path_data;
+}
+
+struct PathRequestOrder
+{
+  f32 distance;
+  u32 index;
+};
+
+static int compare_path_request_order(const void* _a, const void* _b)
+{
+  PathRequestOrder* a = (PathRequestOrder*)_a;
+  PathRequestOrder* b = (PathRequestOrder*)_b;
+  if (a->distance != b->distance)
+  {
+    return a->distance < b->distance ? -1 : 1;
+  }
+  return a->index < b->index ? -1 : a->index > b->index ? 1 : 0;
+}
+
+static int compare_path_results(const void* _a, const void* _b)
+{
+  CommandFindPathData* a = *(CommandFindPathData**)_a;
+  CommandFindPathData* b = *(CommandFindPathData**)_b;
+  return a->sequence < b->sequence ? -1 : a->sequence > b->sequence ? 1 : 0;
+}
+
+void run_path_job(void* data)
+{
+  CommandFindPathData* path_data = (CommandFindPathData*)data;
+  PathWorker*          worker    = 0;
+  while (!worker)
+  {
+    for (u32 i = 0; i < path_scheduler.worker_count && !worker; i++)
+    {
+      if (!__atomic_exchange_n(&path_scheduler.workers[i].busy, true, __ATOMIC_ACQUIRE))
+      {
+        worker = &path_scheduler.workers[i];
+      }
+    }
+  }
+
+  TimeBlock(path_job);
+  Path* result = &path_data->result;
+  if (game_state.navmesh_paths)
+  {
+    path_data->found = navmesh_find_path(&map.navmesh, &worker->navmesh_query, path_data->source, path_data->target, path_data->r, result->points, result->point_count, result->point_capacity);
+  }
+  else
+  {
+    HpaGraph* graph  = game_state.hierarchical_paths ? get_hpa_graph(path_data->r) : 0;
+    path_data->found = graph && hpa_find_path(graph, &worker->hpa_query, result, path_data->target, path_data->source);
+    if (!path_data->found)
+    {
+      u32 budget = ~0u;
+      begin_path_search(&worker->grid_search, path_data->target, path_data->source, path_data->r);
+      path_data->found = step_path_search(&worker->grid_search, result, budget) == PATH_SEARCH_FOUND;
+    }
+  }
+  __atomic_store_n(&worker->busy, false, __ATOMIC_RELEASE);
+  ExitBlock(path_job);
+
+  PathResultRing* ring                                           = path_scheduler.results;
+  u64             position                                       = __atomic_fetch_add(&ring->write, 1, __ATOMIC_RELAXED);
+  ring->results[position % PATH_RESULT_RING_CAPACITY].request    = path_data;
+  __atomic_store_n(&ring->results[position % PATH_RESULT_RING_CAPACITY].sequence, position + 1, __ATOMIC_RELEASE);
+}
+
+// Everything handed out last update is in by the time the workers are done with the queue,
+// normally that happened long ago and this only drains the ring
+void apply_path_results()
+{
+  path_scheduler.queue.complete_all();
+
+  PathResultRing*      ring = path_scheduler.results;
+  CommandFindPathData* done[PATH_RESULT_RING_CAPACITY];
+  u32                  done_count = 0;
+  while (true)
+  {
+    PathResult* result = &ring->results[ring->read % PATH_RESULT_RING_CAPACITY];
+    if (__atomic_load_n(&result->sequence, __ATOMIC_ACQUIRE) != ring->read + 1)
+    {
+      break;
+    }
+    done[done_count++] = result->request;
+    ring->read++;
+  }
+  assert(done_count == path_scheduler.in_flight_count && "Lost a path result?");
+  path_scheduler.in_flight_count = 0;
+
+  qsort(done, done_count, sizeof(CommandFindPathData*), compare_path_results);
+  for (u32 i = 0; i < done_count; i++)
+  {
+    CommandFindPathData* path_data = done[i];
+    if (path_data->cancelled || !is_enemy_alive(path_data->enemy_idx))
+    {
+      free_path_request(path_data);
+      continue;
+    }
+    if (path_data->found)
+    {
+      Enemy* enemy      = &enemies[path_data->enemy_idx];
+      Path   path       = enemy->path;
+      enemy->path       = path_data->result;
+      path_data->result = path;
+    }
+    finish_path_request(path_data);
+  }
+}
+
+void hand_out_path_requests()
+{
+  Vector2           player = game_state.entities[game_state.player.entity].position;
+  if (path_scheduler.pending_count == 0)
+  {
+    return;
+  }
+  PathRequestOrder* order  = sta_allocate_struct(PathRequestOrder, path_scheduler.pending_count);
+  u32               count  = 0;
+  for (u32 i = 0; i < path_scheduler.pending_count; i++)
+  {
+    CommandFindPathData* path_data = path_scheduler.pending[i];
+    if (!is_enemy_alive(path_data->enemy_idx))
+    {
+      free_path_request(path_data);
+      path_scheduler.pending[i] = 0;
+      continue;
+    }
+    order[count].distance = game_state.entities[enemies[path_data->enemy_idx].entity].position.sub(player).len();
+    order[count].index    = i;
+    count++;
+  }
+  qsort(order, count, sizeof(PathRequestOrder), compare_path_request_order);
+
+  u32 handed_out = MIN(count, PATH_RESULT_RING_CAPACITY);
+  for (u32 i = 0; i < handed_out; i++)
+  {
+    CommandFindPathData* path_data = path_scheduler.pending[order[i].index];
+    Entity*              entity    = &game_state.entities[enemies[path_data->enemy_idx].entity];
+    path_data->source              = entity->position;
+    path_data->target              = player;
+    path_data->r                   = entity->r;
+    path_data->sequence            = path_scheduler.next_sequence++;
+    path_data->found               = false;
+    path_data->cancelled           = false;
+    path_scheduler.in_flight[path_scheduler.in_flight_count++] = path_data;
+    path_scheduler.pending[order[i].index]                     = 0;
+    path_scheduler.queue.push(run_path_job, path_data);
+  }
+
+  // whatever didn't fit waits for the next update, still in the order it came in
+  u32 remaining = 0;
+  for (u32 i = 0; i < path_scheduler.pending_count; i++)
+  {
+    if (path_scheduler.pending[i])
+    {
+      path_scheduler.pending[remaining++] = path_scheduler.pending[i];
+    }
+  }
+  sta_deallocate(order, sizeof(PathRequestOrder) * path_scheduler.pending_count);
+  path_scheduler.pending_count = remaining;
+}
+
+void record_path_scheduler_cycles(u64 cycles)
+{
+  path_scheduler.run_count++;
+  path_scheduler.cycles_total += cycles;
+  path_scheduler.cycles_max = MAX(path_scheduler.cycles_max, cycles);
+}
+
+void run_path_scheduler()
+{
+  u64 start = ReadCPUTimer();
+  if (path_scheduler.workers)
+  {
+    apply_path_results();
+    hand_out_path_requests();
+    record_path_scheduler_cycles(ReadCPUTimer() - start);
+    return;
+  }
+
+  u32 budget = path_scheduler.budget;
+  while (budget > 0)
+  {
+    if (!path_scheduler.active)
+    {
+      CommandFindPathData* path_data = take_next_path_request();
+      if (!path_data)
+      {
+        break;
+      }
+      Enemy*  enemy  = &enemies[path_data->enemy_idx];
+      Entity* entity = &game_state.entities[enemy->entity];
+      Vector2 target = game_state.entities[game_state.player.entity].position;
+      if (game_state.navmesh_paths)
+      {
+        // a handful of triangles, not worth splitting up
+        enemy->path.point_count = 0;
+        navmesh_find_path(&map.navmesh, &map.navmesh_query, entity->position, target, entity->r, enemy->path.points, enemy->path.point_count, enemy->path.point_capacity);
+        budget--;
+        finish_path_request(path_data);
+        continue;
+      }
+      // a couple of clusters worth of tiles and a few hundred nodes at most, done in one go as well
+      HpaGraph* graph = game_state.hierarchical_paths ? get_hpa_graph(entity->r) : 0;
+      if (graph && hpa_find_path(graph, &map.hpa_query, &enemy->path, target, entity->position))
+      {
+        budget -= MIN(budget, map.hpa_query.expanded);
+        finish_path_request(path_data);
+        continue;
+      }
+      begin_path_search(&map.grid_search, target, entity->position, entity->r);
+      path_scheduler.active = path_data;
+    }
+
+    CommandFindPathData* path_data = path_scheduler.active;
+    if (!is_enemy_alive(path_data->enemy_idx))
+    {
+      free_path_request(path_data);
+      path_scheduler.active = 0;
+      continue;
+    }
+    if (step_path_search(&map.grid_search, &enemies[path_data->enemy_idx].path, budget) != PATH_SEARCH_RUNNING)
+    {
+      path_scheduler.active = 0;
+      finish_path_request(path_data);
+    }
+  }
+  record_path_scheduler_cycles(ReadCPUTimer() - start);
+}
+
+void run_command_stop_charge()
+{
+  game_state.player.can_move = true;
+}
+
+void run_commands(u32 ticks)
+{
+
+  CommandNode* node = command_queue.head;
+  CommandNode* prev = 0;
+  while (node)
+  {
+    if (ticks > node->command.execute_tick)
+    {
+      switch (node->command.type)
+      {
+      case CMD_EXPLODE_PILLAR:
+      {
+        run_command_explode_pillar_of_flame(node->command.data);
+        break;
+      }
+      case CMD_SPAWN_ENEMY:
+      {
+        run_command_spawn_enemy(node->command.data, ticks);
+        break;
+      }
+      case CMD_LET_RANGED_MOVE_AFTER_SHOOTING:
+      {
         run_command_shoot_arrow(node->command.data);
         break;
       }
@@ -2008,14 +3234,15 @@ void read_abilities(Ability* abilities)
 
 void handle_enemy_movement(Enemy* enemy, Vector2 target_position)
 {
-  Entity* entity     = &game_state.entities[enemy->entity];
-  u32     tile_count = get_tile_count_per_row();
+  Entity* entity = &game_state.entities[enemy->entity];
 
   // enemy->path.path_count = 0;
   // find_path(&enemy->path, target_position, entity->position);
 
-  Path path = enemy->path;
-  if (path.path_count == 1)
+  // standing still unless there's path left to walk, the crowd pass adds its push on top of this
+  entity->velocity = Vector2(0, 0);
+  Path path        = enemy->path;
+  if (path.point_count <= 1)
   {
     return;
   }
@@ -2026,11 +3253,15 @@ void handle_enemy_movement(Enemy* enemy, Vector2 target_position)
   f32     movement_remaining = enemy->ms;
   while (true)
   {
-    f32 x = tile_position_to_game(path.path[path_idx] >> 8);
-    f32 y = tile_position_to_game(path.path[path_idx] & 0xFF);
+    f32 x = path.points[path_idx].x;
+    f32 y = path.points[path_idx].y;
     path_idx++;
     if (compare_float(x, curr.x) && compare_float(y, curr.y))
     {
+      if (path_idx >= path.point_count)
+      {
+        break;
+      }
       continue;
     }
     Vector2 point(x, y);
@@ -2050,7 +3281,7 @@ void handle_enemy_movement(Enemy* enemy, Vector2 target_position)
     // convert current position to curr
     movement_remaining -= moved;
     curr = point;
-    if (path_idx >= path.path_count)
+    if (path_idx >= path.point_count)
     {
       break;
     }
@@ -2196,6 +3427,244 @@ void update_enemies(u32 tick_difference, u32 tick)
   }
 }
 
+// agents closer than this many times their radii added together push each other apart
+#define CROWD_SEPARATION_RANGE 1.25f
+// how much of the overlap with a neighbour turns into velocity away from it each update
+#define CROWD_STIFFNESS        0.25f
+
+// Boids style separation for enemies walking the same paths. The caller fills in one agent per
+// index and the velocities get adjusted in place, never faster than max_speed. Agents are binned
+// into a uniform grid with cells as big as the widest separation range, so only the 3x3 cells around
+// an agent can push it and a run is linear in the agent count. Fields are separate arrays and the
+// binned copies sit next to their cell mates, the neighbour loop only streams positions and radii
+struct Crowd
+{
+  f32* x;
+  f32* y;
+  f32* r;
+  f32* vx;
+  f32* vy;
+  f32* max_speed;
+  // whatever the caller needs to find the agent again, not read here
+  u32* owners;
+  u32  count;
+  u32  capacity;
+
+  // the agents sorted by cell, cell c has cell_offsets[c]..cell_offsets[c + 1] and sorted_ids maps back
+  f32* sorted_x;
+  f32* sorted_y;
+  f32* sorted_r;
+  u32* sorted_ids;
+  u32* cells;
+  u32* cell_offsets;
+  u32  cell_capacity;
+
+  // agents overlapping another one, counted before they get pushed
+  u64  overlaps_total;
+  u32  overlaps_max;
+  u64  cycles_total;
+  u64  cycles_max;
+  u64  run_count;
+};
+Crowd crowd;
+
+// Contents aren't kept, the crowd is filled in again every update
+void reserve_crowd(Crowd* crowd, u32 count)
+{
+  if (count <= crowd->capacity)
+  {
+    return;
+  }
+  if (crowd->capacity > 0)
+  {
+    sta_deallocate(crowd->x, sizeof(f32) * crowd->capacity * 9);
+    sta_deallocate(crowd->owners, sizeof(u32) * crowd->capacity);
+    sta_deallocate(crowd->sorted_ids, sizeof(u32) * crowd->capacity);
+    sta_deallocate(crowd->cells, sizeof(u32) * crowd->capacity);
+  }
+  crowd->capacity = MAX(count, MAX(crowd->capacity * 2, 16u));
+  // one block for every per agent array
+  f32* block        = (f32*)sta_allocate(sizeof(f32) * crowd->capacity * 9);
+  crowd->x          = block;
+  crowd->y          = block + crowd->capacity;
+  crowd->r          = block + crowd->capacity * 2;
+  crowd->vx         = block + crowd->capacity * 3;
+  crowd->vy         = block + crowd->capacity * 4;
+  crowd->max_speed  = block + crowd->capacity * 5;
+  crowd->sorted_x   = block + crowd->capacity * 6;
+  crowd->sorted_y   = block + crowd->capacity * 7;
+  crowd->sorted_r   = block + crowd->capacity * 8;
+  crowd->owners     = sta_allocate_struct(u32, crowd->capacity);
+  crowd->sorted_ids = sta_allocate_struct(u32, crowd->capacity);
+  crowd->cells      = sta_allocate_struct(u32, crowd->capacity);
+}
+
+void separate_crowd(Crowd* crowd)
+{
+  u32 count = crowd->count;
+  if (count == 0)
+  {
+    return;
+  }
+  f32 min_x = crowd->x[0], min_y = crowd->y[0], max_x = crowd->x[0], max_y = crowd->y[0], max_r = 0;
+  for (u32 i = 0; i < count; i++)
+  {
+    min_x = MIN(min_x, crowd->x[i]);
+    min_y = MIN(min_y, crowd->y[i]);
+    max_x = MAX(max_x, crowd->x[i]);
+    max_y = MAX(max_y, crowd->y[i]);
+    max_r = MAX(max_r, crowd->r[i]);
+  }
+  // a sparse crowd gets bigger cells so there are never more than about two per agent
+  f32 width      = max_x - min_x;
+  f32 height     = max_y - min_y;
+  f32 cell_size  = MAX(2 * max_r * CROWD_SEPARATION_RANGE, sqrtf(width * height / (2.0f * count)));
+  cell_size      = MAX(cell_size, 1e-6f);
+  u32 cells_x    = (u32)(width / cell_size) + 1;
+  u32 cells_y    = (u32)(height / cell_size) + 1;
+  u32 cell_count = cells_x * cells_y;
+  if (cell_count + 1 > crowd->cell_capacity)
+  {
+    if (crowd->cell_capacity > 0)
+    {
+      sta_deallocate(crowd->cell_offsets, sizeof(u32) * crowd->cell_capacity);
+    }
+    crowd->cell_capacity = MAX(cell_count + 1, crowd->cell_capacity * 2);
+    crowd->cell_offsets  = sta_allocate_struct(u32, crowd->cell_capacity);
+  }
+
+  // counting sort into cells, stable so the order only depends on the input
+  u32* offsets       = crowd->cell_offsets;
+  f32  inv_cell_size = 1.0f / cell_size;
+  memset(offsets, 0, sizeof(u32) * (cell_count + 1));
+  for (u32 i = 0; i < count; i++)
+  {
+    u32 cell_x      = MIN((u32)((crowd->x[i] - min_x) * inv_cell_size), cells_x - 1);
+    u32 cell_y      = MIN((u32)((crowd->y[i] - min_y) * inv_cell_size), cells_y - 1);
+    crowd->cells[i] = cell_y * cells_x + cell_x;
+    offsets[crowd->cells[i] + 1]++;
+  }
+  for (u32 i = 0; i < cell_count; i++)
+  {
+    offsets[i + 1] += offsets[i];
+  }
+  for (u32 i = 0; i < count; i++)
+  {
+    u32 slot                = offsets[crowd->cells[i]]++;
+    crowd->sorted_x[slot]   = crowd->x[i];
+    crowd->sorted_y[slot]   = crowd->y[i];
+    crowd->sorted_r[slot]   = crowd->r[i];
+    crowd->sorted_ids[slot] = i;
+  }
+  // the scatter moved every offset up to where the next cell starts
+  for (u32 i = cell_count; i > 0; i--)
+  {
+    offsets[i] = offsets[i - 1];
+  }
+  offsets[0] = 0;
+
+  u32 overlaps = 0;
+  for (u32 cell_y = 0; cell_y < cells_y; cell_y++)
+  {
+    for (u32 cell_x = 0; cell_x < cells_x; cell_x++)
+    {
+      u32 cell = cell_y * cells_x + cell_x;
+      for (u32 a = offsets[cell]; a < offsets[cell + 1]; a++)
+      {
+        f32  x           = crowd->sorted_x[a];
+        f32  y           = crowd->sorted_y[a];
+        f32  r           = crowd->sorted_r[a];
+        u32  id          = crowd->sorted_ids[a];
+        f32  push_x      = 0;
+        f32  push_y      = 0;
+        bool overlapping = false;
+        for (u32 y_neighbour = cell_y > 0 ? cell_y - 1 : 0; y_neighbour <= MIN(cell_y + 1, cells_y - 1); y_neighbour++)
+        {
+          u32 row = y_neighbour * cells_x;
+          u32 end = offsets[row + MIN(cell_x + 1, cells_x - 1) + 1];
+          for (u32 b = offsets[row + (cell_x > 0 ? cell_x - 1 : 0)]; b < end; b++)
+          {
+            f32 dx       = x - crowd->sorted_x[b];
+            f32 dy       = y - crowd->sorted_y[b];
+            f32 radii    = r + crowd->sorted_r[b];
+            f32 range    = radii * CROWD_SEPARATION_RANGE;
+            f32 distance = dx * dx + dy * dy;
+            if (b == a || distance >= range * range)
+            {
+              continue;
+            }
+            distance = sqrtf(distance);
+            overlapping |= distance < radii;
+            if (distance > 0)
+            {
+              push_x += dx / distance * (range - distance);
+              push_y += dy / distance * (range - distance);
+            }
+            else
+            {
+              // right on top of each other, split them along x by their order
+              push_x += id < crowd->sorted_ids[b] ? -range : range;
+            }
+          }
+        }
+        overlaps += overlapping;
+
+        f32 vx    = crowd->vx[id] + push_x * CROWD_STIFFNESS;
+        f32 vy    = crowd->vy[id] + push_y * CROWD_STIFFNESS;
+        f32 speed = sqrtf(vx * vx + vy * vy);
+        if (speed > crowd->max_speed[id])
+        {
+          f32 scale = speed > 0 ? crowd->max_speed[id] / speed : 0;
+          vx *= scale;
+          vy *= scale;
+        }
+        crowd->vx[id] = vx;
+        crowd->vy[id] = vy;
+      }
+    }
+  }
+  crowd->overlaps_total += overlaps;
+  crowd->overlaps_max = MAX(crowd->overlaps_max, overlaps);
+}
+
+// Runs after update_enemies has turned the paths into velocities, enemies standing still to shoot
+// push the others but don't move themselves
+void separate_enemies()
+{
+  u64 start = ReadCPUTimer();
+  reserve_crowd(&crowd, enemy_count);
+  crowd.count = 0;
+  for (u32 i = 0; i < enemy_count; i++)
+  {
+    Enemy*  enemy  = &enemies[i];
+    Entity* entity = &game_state.entities[enemy->entity];
+    if (!entity->visible || entity->hp <= 0)
+    {
+      continue;
+    }
+    u32 agent              = crowd.count++;
+    crowd.x[agent]         = entity->position.x;
+    crowd.y[agent]         = entity->position.y;
+    crowd.r[agent]         = entity->r;
+    crowd.vx[agent]        = entity->velocity.x;
+    crowd.vy[agent]        = entity->velocity.y;
+    crowd.max_speed[agent] = enemy->can_move ? enemy->ms : 0;
+    crowd.owners[agent]    = i;
+  }
+  separate_crowd(&crowd);
+  for (u32 agent = 0; agent < crowd.count; agent++)
+  {
+    Entity* entity     = &game_state.entities[enemies[crowd.owners[agent]].entity];
+    entity->velocity.x = crowd.vx[agent];
+    entity->velocity.y = crowd.vy[agent];
+  }
+
+  u64 cycles = ReadCPUTimer() - start;
+  crowd.run_count++;
+  crowd.cycles_total += cycles;
+  crowd.cycles_max = MAX(crowd.cycles_max, cycles);
+}
+
 void handle_collision(Entity* e1, Entity* e2)
 {
   if ((e1->type == ENTITY_ENEMY && e2->type == ENTITY_PLAYER_PROJECTILE) || (e1->type == ENTITY_PLAYER_PROJECTILE && e2->type == ENTITY_ENEMY))
@@ -2204,10 +3673,6 @@ void handle_collision(Entity* e1, Entity* e2)
     e1->hp = 0;
     e2->hp = 0;
   }
-  // ToDo physics sim?
-  if (e1->type == ENTITY_ENEMY && e2->type == ENTITY_ENEMY)
-  {
-  }
   if ((e1->type == ENTITY_ENEMY && e2->type == ENTITY_PLAYER) || (e1->type == ENTITY_PLAYER && e2->type == ENTITY_ENEMY))
   {
     if (!game_state.player.can_move)
@@ -2316,16 +3781,11 @@ void update_entities(Entity* entities, u32 entity_count, u32 tick_difference)
 
 bool load_enemies_from_file(const char* filename)
 {
-  Buffer buffer = {};
-  if (!sta_read_file(&buffer, filename))
-  {
-    return false;
-  }
   Json json = {};
-  if (!sta_json_deserialize_from_string(&buffer, &json))
+  if (!sta_json_deserialize_from_file(&json, filename))
   {
     return false;
-  };
+  }
 
   assert(json.headType == JSON_OBJECT && "Expected head to be object");
   JsonObject* head  = &json.obj;
@@ -2345,9 +3805,10 @@ bool load_enemies_from_file(const char* filename)
     data->cooldown         = json_data->lookup_value("cooldown")->number;
     data->ms               = json_data->lookup_value("movement_speed")->number;
 
-    data->render_data_name = head->keys[i];
+    data->render_data_name = head->keys[i].copy();
     logger.info("Found enemy %d: %d %f %s", data->type, data->hp, data->radius, data->render_data_name);
   }
+  sta_json_free(&json);
 
   return true;
 }
@@ -2356,11 +3817,12 @@ bool load_wave_from_file(Wave* wave, const char* filename)
 {
   Buffer      buffer = {};
   StringArray lines  = {};
-  if (!sta_read_file(&buffer, filename))
+  if (!sta_map_file(&buffer, filename))
   {
     return false;
   }
   split_buffer_by_newline(&lines, &buffer);
+  sta_unmap_file(&buffer);
 
   assert(lines.count > 1 && "Only one line in wave file?");
   wave->enemy_count = parse_int_from_string(lines.strings[0]);
@@ -2405,8 +3867,7 @@ bool load_wave_from_file(Wave* wave, const char* filename)
     entity->r                   = enemy_data.radius;
     entity->velocity            = Vector2(0, 0);
 
-    u32 tile_count              = get_tile_count_per_row();
-    enemy->path.path            = sta_allocate_struct(u16, tile_count * tile_count);
+    init_path(&enemy->path);
 
     CommandSpawnEnemyData* data = sta_allocate_struct(CommandSpawnEnemyData, 1);
     // data->enemy_index           = i;
@@ -2421,16 +3882,11 @@ bool load_wave_from_file(Wave* wave, const char* filename)
 bool load_entity_render_data_from_file(const char* file_location)
 {
 
-  Buffer buffer = {};
-  if (!sta_read_file(&buffer, file_location))
-  {
-    return false;
-  }
   Json json = {};
-  if (!sta_json_deserialize_from_string(&buffer, &json))
+  if (!sta_json_deserialize_from_file(&json, file_location))
   {
     return false;
-  };
+  }
   assert(json.headType == JSON_OBJECT && "Expected head to be object");
   JsonObject* head             = &json.obj;
 
@@ -2441,12 +3897,12 @@ bool load_entity_render_data_from_file(const char* file_location)
   for (u32 i = 0; i < count; i++)
   {
     EntityRenderData* data      = &game_state.render_data[i];
-    data->name                  = head->keys[i];
+    data->name                  = head->keys[i].copy();
     JsonObject* render_data_obj = head->values[i].obj;
     if (render_data_obj->lookup_value("animation"))
     {
-      Model*      model      = get_model_by_name(render_data_obj->lookup_value("animation")->string);
-      const char* normal_map = render_data_obj->lookup_value("normal_map")->string;
+      Model*      model      = get_model_by_name(sta_json_c_string(&json, &render_data_obj->lookup_value("animation")->string));
+      const char* normal_map = sta_json_c_string(&json, &render_data_obj->lookup_value("normal_map")->string);
       assert(model->animation_data && "No animation data for the model!");
       data->animation_controller = animation_controller_create(model->animation_data);
       data->normal_map           = game_state.renderer.get_texture(normal_map);
@@ -2456,10 +3912,10 @@ bool load_entity_render_data_from_file(const char* file_location)
       data->animation_controller = 0;
     }
 
-    const char* texture         = render_data_obj->lookup_value("texture")->string;
-    const char* shader          = render_data_obj->lookup_value("shader")->string;
+    const char* texture         = sta_json_c_string(&json, &render_data_obj->lookup_value("texture")->string);
+    const char* shader          = sta_json_c_string(&json, &render_data_obj->lookup_value("shader")->string);
     f32         scale           = render_data_obj->lookup_value("scale")->number;
-    const char* buffer_id       = render_data_obj->lookup_value("buffer")->string;
+    const char* buffer_id       = sta_json_c_string(&json, &render_data_obj->lookup_value("buffer")->string);
     JsonValue*  rotation_x_json = render_data_obj->lookup_value("rotation_x");
     if (rotation_x_json)
     {
@@ -2475,6 +3931,7 @@ bool load_entity_render_data_from_file(const char* file_location)
     data->buffer_id = get_buffer_by_name(buffer_id);
     logger.info("Loaded render data for '%s': texture: %s %d, shader: %s %d, scale: %f,  buffer: %s %d", data->name, texture, data->texture, shader, data->shader, scale, buffer_id, data->buffer_id);
   }
+  sta_json_free(&json);
 
   return true;
 }
@@ -2499,16 +3956,11 @@ Hero       get_hero_by_name(const char* name)
 
 bool load_hero_from_file(const char* file_location)
 {
-  Buffer buffer = {};
-  if (!sta_read_file(&buffer, file_location))
-  {
-    return false;
-  }
   Json json = {};
-  if (!sta_json_deserialize_from_string(&buffer, &json))
+  if (!sta_json_deserialize_from_file(&json, file_location))
   {
     return false;
-  };
+  }
   assert(json.headType == JSON_OBJECT && "Expected head to be object");
   JsonObject* head  = &json.obj;
 
@@ -2519,7 +3971,7 @@ bool load_hero_from_file(const char* file_location)
   logger.info("Found %d heroes", count);
   for (u32 i = 0; i < count; i++)
   {
-    char*      name          = head->keys[i];
+    char*      name          = head->keys[i].copy();
 
     JsonArray* ability_array = head->values[i].obj->lookup_value("abilities")->arr;
     u32        ability_count = ability_array->arraySize;
@@ -2527,7 +3979,7 @@ bool load_hero_from_file(const char* file_location)
     assert(ability_count < ArrayCount(hero->abilities) && "Too many abilities!!");
     for (u32 j = 0; j < ability_count; j++)
     {
-      hero->abilities[j] = get_ability_by_name(ability_array->values[j].string);
+      hero->abilities[j] = get_ability_by_name(sta_json_c_string(&json, &ability_array->values[j].string));
     }
     hero->damage_taken_cd      = 0;
     hero->can_take_damage_tick = 0;
@@ -2545,20 +3997,16 @@ bool load_hero_from_file(const char* file_location)
     entity->hp                 = hero_obj->lookup_value("hp")->number;
     entity->visible            = false;
   }
+  sta_json_free(&json);
   return true;
 }
 bool load_ability_from_file(const char* file_location)
 {
-  Buffer buffer = {};
-  if (!sta_read_file(&buffer, file_location))
-  {
-    return false;
-  }
   Json json = {};
-  if (!sta_json_deserialize_from_string(&buffer, &json))
+  if (!sta_json_deserialize_from_file(&json, file_location))
   {
     return false;
-  };
+  }
 
   assert(json.headType == JSON_OBJECT && "Expected head to be object");
   JsonObject* head  = &json.obj;
@@ -2569,7 +4017,7 @@ bool load_ability_from_file(const char* file_location)
   logger.info("Found %d abilities", count);
   for (u32 i = 0; i < count; i++)
   {
-    char* name                  = head->keys[i];
+    char* name                  = head->keys[i].copy();
     u32   use_ability_index     = head->values[i].obj->lookup_value("use_ptr_idx")->number;
     u32   cooldown              = head->values[i].obj->lookup_value("cooldown")->number;
     abilities[i].name           = name;
@@ -2577,10 +4025,13 @@ bool load_ability_from_file(const char* file_location)
     abilities[i].use_ability    = use_ability_function_ptrs[use_ability_index];
     abilities[i].cooldown       = 0;
   }
+  sta_json_free(&json);
   return true;
 }
 
-bool load_data()
+// File reads and parsing of models and textures run on the queue while the main thread compiles shaders,
+// the GL uploads are done here in order as the results come in
+bool load_assets(WorkQueue* queue)
 {
 
   const static char* enemy_data_location = "./data/formats/enemy.json";
@@ -2591,19 +4042,23 @@ bool load_data()
   }
 
   const static char* model_locations = "./data/formats/models.json";
-  if (!load_models_from_files(model_locations))
+  if (!load_models_from_files(model_locations, queue))
   {
     logger.error("Failed to read models from '%s'", model_locations);
     return false;
   }
 
   const static char* texture_locations = "./data/formats/textures.json";
-  if (!game_state.renderer.load_textures_from_files(texture_locations))
+  if (!game_state.renderer.queue_textures_from_files(texture_locations, queue))
   {
     logger.error("Failed to read textures from '%s'", texture_locations);
     return false;
   }
 
+  static TargaLoad noise_load = {};
+  noise_load.location         = "./data/textures/noise01.tga";
+  queue->push(sta_targa_read_job, &noise_load);
+
   const static char* shader_locations = "./data/formats/shader.json";
   if (!game_state.renderer.load_shaders_from_files(shader_locations))
   {
@@ -2618,12 +4073,20 @@ bool load_data()
     return false;
   }
 
-  const static char* noise_locations = "./data/textures/noise01.tga";
-  if (!sta_targa_read_from_file_rgba(&noise, noise_locations))
+  while (game_state.renderer.upload_loaded_textures() + upload_loaded_buffers() > 0)
+  {
+    if (!queue->do_next_entry())
+    {
+      sta_sleep_ns(100000);
+    }
+  }
+  queue->complete_all();
+  if (!noise_load.ok)
   {
-    logger.error("Failed to read noise from '%s'", noise_locations);
+    logger.error("Failed to read noise from '%s'", noise_load.location);
     return false;
   }
+  noise = noise_load.image;
 
   const static char* render_data_location = "./data/formats/render_data.json";
   if (!load_entity_render_data_from_file(render_data_location))
@@ -2652,6 +4115,21 @@ bool load_data()
   return true;
 }
 
+bool load_data()
+{
+  u64       start = sta_read_monotonic_ns();
+  WorkQueue queue;
+  if (!queue.init(get_worker_thread_count()))
+  {
+    return false;
+  }
+  u32  workers = queue.thread_count;
+  bool loaded  = load_assets(&queue);
+  queue.destroy();
+  logger.info("Loaded data in %.1f ms with %u workers", (sta_read_monotonic_ns() - start) / 1000000.0, workers);
+  return loaded && start_path_workers();
+}
+
 void init_player(Hero* player)
 {
 
@@ -2740,29 +4218,109 @@ void update_effects(u32 ticks)
   }
 }
 
-void update(Camera& camera, InputState* input_state, u32 game_running_ticks, u32 tick_difference)
-{
-
-  handle_abilities(camera, input_state, game_running_ticks);
-  handle_player_movement(camera, input_state, game_running_ticks);
-  run_commands(game_running_ticks);
-  update_entities(game_state.entities, game_state.entity_count, tick_difference);
-  update_effects(game_running_ticks);
-  update_enemies(tick_difference, game_running_ticks);
+#define SIMULATION_TIMESTEP_MS         16
+#define SIMULATION_TIMESTEP_NS         (SIMULATION_TIMESTEP_MS * 1000000ull)
+// after a stall (breakpoint, dragging the window) only catch up this many steps instead of spiraling
+#define MAX_SIMULATION_STEPS_PER_FRAME 5
 
-  update_animations(game_running_ticks);
+void seed_simulation(u64 seed)
+{
+  game_state.seed = seed;
+  game_state.rng.seed(seed);
 }
 
-inline bool handle_wave_over(Wave* wave)
+static inline void hash_bytes_fnv(u32* hash, const void* data, u64 size)
 {
-  u32 spawn_count = __builtin_popcountll(wave->spawn_count);
-  return spawn_count == wave->enemy_count && wave->enemies_alive == 0;
+  const u8* bytes = (const u8*)data;
+  for (u64 i = 0; i < size; i++)
+  {
+    *hash ^= bytes[i];
+    *hash *= 16777619;
+  }
 }
 
-void debug_render_depth_texture_cube(u32 texture)
+// FNV over everything the simulation owns, two runs with the same seed and input should always match
+u32 hash_simulation_state()
 {
+  u32 hash = 2166136261u;
+  for (u32 i = 0; i < game_state.entity_count; i++)
+  {
+    Entity* entity = &game_state.entities[i];
+    hash_bytes_fnv(&hash, &entity->position, sizeof(Vector2));
+    hash_bytes_fnv(&hash, &entity->velocity, sizeof(Vector2));
+    hash_bytes_fnv(&hash, &entity->angle, sizeof(f32));
+    hash_bytes_fnv(&hash, &entity->hp, sizeof(i32));
+    hash_bytes_fnv(&hash, &entity->visible, sizeof(bool));
+  }
+  hash_bytes_fnv(&hash, &game_state.score, sizeof(u32));
+  hash_bytes_fnv(&hash, &game_state.wave, sizeof(u32));
+  hash_bytes_fnv(&hash, &game_state.rng.state, sizeof(u64));
+  return hash;
+}
 
-  static u32    vao = 0, vbo = 0;
+void update(Camera& camera, InputState* input_state, u32 game_running_ticks, u32 tick_difference)
+{
+  // rendering interpolates from here to wherever this step ends up
+  for (u32 i = 0; i < game_state.entity_count; i++)
+  {
+    game_state.entities[i].previous_position = game_state.entities[i].position;
+  }
+  game_state.interpolated_entity_count = game_state.entity_count;
+
+  // zoom changes where the cursor lands on the map so it is part of the simulation
+  camera.z += input_state->mouse_wheel_direction * 0.1f;
+  camera.z = MAX(MIN(-1.5, camera.z), -4.5);
+
+  TimeBlock(abilities);
+  handle_abilities(camera, input_state, game_running_ticks);
+  ExitBlock(abilities);
+
+  TimeBlock(player_movement);
+  handle_player_movement(camera, input_state, game_running_ticks);
+  ExitBlock(player_movement);
+
+  TimeBlock(commands);
+  run_commands(game_running_ticks);
+  ExitBlock(commands);
+
+  TimeBlock(pathfinding);
+  run_path_scheduler();
+  ExitBlock(pathfinding);
+
+  TimeBlock(entities);
+  update_entities(game_state.entities, game_state.entity_count, tick_difference);
+  ExitBlock(entities);
+
+  TimeBlock(effects);
+  update_effects(game_running_ticks);
+  ExitBlock(effects);
+
+  TimeBlock(enemies);
+  update_enemies(tick_difference, game_running_ticks);
+  ExitBlock(enemies);
+
+  if (!game_state.no_crowd)
+  {
+    TimeBlock(separation);
+    separate_enemies();
+    ExitBlock(separation);
+  }
+
+  TimeBlock(animations);
+  update_animations(game_running_ticks);
+  ExitBlock(animations);
+}
+
+inline bool handle_wave_over(Wave* wave)
+{
+  u32 spawn_count = __builtin_popcountll(wave->spawn_count);
+  return spawn_count == wave->enemy_count && wave->enemies_alive == 0;
+}
+
+void debug_render_depth_texture_cube(u32 texture)
+{
+
+  static u32    vao = 0, vbo = 0;
   static f32    x = 0;
   static Shader q_shader;
 
@@ -2921,13 +4479,13 @@ void render_paths(Wave* wave)
   for (u32 i = 0; i < spawn_count; i++)
   {
     Path path = wave->enemies[i].path;
-    for (u32 j = 0; j < path.path_count - 1; j++)
+    for (u32 j = 0; j + 1 < path.point_count; j++)
     {
       f32 x1, y1, x2, y2;
-      x1 = tile_position_to_game(path.path[j] >> 8);
-      y1 = tile_position_to_game(path.path[j] & 0xFF);
-      x2 = tile_position_to_game(path.path[j + 1] >> 8);
-      y2 = tile_position_to_game(path.path[j + 1] & 0xFF);
+      x1 = path.points[j].x;
+      y1 = path.points[j].y;
+      x2 = path.points[j + 1].x;
+      y2 = path.points[j + 1].y;
 
       game_state.renderer.draw_circle(game_state.entities[wave->enemies[i].entity].position, game_state.entities[wave->enemies[i].entity].r, 1, RED, m, m);
       game_state.renderer.draw_line(x1, y1, x2, y2, 1, BLUE);
@@ -2937,18 +4495,18 @@ void render_paths(Wave* wave)
 
 void debug_render_map_grid()
 {
-  u32 tile_count = get_tile_count_per_row();
-  f32 tile_size  = get_tile_size();
-  for (u32 x = 0; x < tile_count; x++)
+  MapGrid* grid      = &map.grid;
+  Vector2  tile_size = grid->tile_size();
+  for (u32 x = 0; x < grid->tiles_x; x++)
   {
-    f32 x0 = tile_position_to_game2(x);
-    f32 x1 = x0 + tile_size;
-    for (u32 y = 0; y < tile_count; y++)
+    for (u32 y = 0; y < grid->tiles_y; y++)
     {
-      if (is_tile_in_map(x, y, tile_size))
+      if (grid->is_walkable(x, y, 0))
       {
-        f32 y0 = tile_position_to_game2(y);
-        f32 y1 = y0 + tile_size;
+        Vector2 p0 = tile_position_to_game2(x, y);
+        f32     x0 = p0.x, y0 = p0.y;
+        f32     x1 = x0 + tile_size.x;
+        f32     y1 = y0 + tile_size.y;
         game_state.renderer.draw_line(x0, y0, x0, y1, 1, BLUE);
         game_state.renderer.draw_line(x1, y0, x1, y1, 1, BLUE);
         game_state.renderer.draw_line(x0, y1, x1, y1, 1, BLUE);
@@ -3003,11 +4561,23 @@ void animation_test_bed(InputState input_state)
   }
 }
 
-void push_render_items(u32 map_buffer, u32 ticks, u32 map_texture)
+// Entities spawned during the last step have no previous position yet
+Vector3 get_interpolated_position(u32 entity_index, f32 alpha)
+{
+  Entity* entity = &game_state.entities[entity_index];
+  Vector3 current(entity->position.x, entity->position.y, 0.0f);
+  if (entity_index >= game_state.interpolated_entity_count)
+  {
+    return current;
+  }
+  return interpolate_translation(Vector3(entity->previous_position.x, entity->previous_position.y, 0.0f), current, alpha);
+}
+
+void push_render_items(u32 map_buffer, u32 ticks, u32 map_texture, f32 alpha)
 {
 
   Renderer* renderer = &game_state.renderer;
-  renderer->push_render_item_static(map_buffer, Mat44::identity(), map_texture);
+  renderer->push_render_item_static_caster(map_buffer, Mat44::identity(), map_texture);
 
   // load the static geometry that exists outside of the plane/map
   for (u32 i = 0; i < map.static_geometry.count; i++)
@@ -3018,143 +4588,969 @@ void push_render_items(u32 map_buffer, u32 ticks, u32 map_texture)
 
     Mat44             m           = Mat44::identity();
     m                             = m.scale(render_data->scale).translate(cube_pos);
-    renderer->push_render_item_static(render_data->buffer_id, m, render_data->texture);
+    renderer->push_render_item_static_caster(render_data->buffer_id, m, render_data->texture);
+  }
+
+  for (u32 i = 0; i < game_state.entity_count; i++)
+  {
+    Entity* entity = &game_state.entities[i];
+    if (entity->visible)
+    {
+      EntityRenderData* render_data = entity->render_data;
+      Mat44             m           = render_data->get_model_matrix();
+
+      m                             = m.rotate_z(RADIANS_TO_DEGREES(entity->angle) + 90);
+      m                             = m.translate(get_interpolated_position(i, alpha));
+      if (render_data->animation_controller)
+      {
+        renderer->push_render_item_animated(render_data->buffer_id, m, render_data->animation_controller->transforms, render_data->animation_controller->animation_data->skeleton.joint_count,
+                                            render_data->texture, render_data->normal_map);
+      }
+      else
+      {
+        renderer->push_render_item_static(render_data->buffer_id, m, render_data->texture);
+      }
+    }
+  }
+  EffectNode* node = effects.head;
+  EffectNode* prev = 0;
+  while (node)
+  {
+
+    Effect            effect      = node->effect;
+    EntityRenderData* render_data = &effect.render_data;
+    Mat44             m           = render_data->get_model_matrix();
+    m                             = m.rotate_z(RADIANS_TO_DEGREES(effect.angle) + 90);
+    m                             = m.translate(Vector3(effect.position.x, effect.position.y, 0.0f));
+    renderer->push_render_item_effect(render_data->buffer_id, m, render_data->texture);
+
+    node = node->next;
+  }
+}
+
+u32 load_cubemap()
+{
+  u32 texture_id;
+  glGenTextures(1, &texture_id);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
+
+  const char* image_names[6] = {
+      "./data/textures/red.tga", "./data/textures/green.tga", "./data/textures/black.tga", "./data/textures/white.tga", "./data/textures/blue.tga",
+  };
+
+  for (unsigned int i = 0; i < 6; i++)
+  {
+    TargaImage image = {};
+    if (!sta_targa_read_from_file_rgba(&image, image_names[i % 5]))
+    {
+      exit(1);
+    }
+    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data);
+    GLenum error = glGetError();
+  }
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+  return texture_id;
+}
+
+void test_cubemap(InputState input_state)
+{
+
+  float skyboxVertices[] = {// positions
+                            -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, 1.0f, -1.0f,
+                            -1.0f, -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, 1.0f,  1.0f, 1.0f,
+                            1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  -1.0f, 1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  1.0f, 1.0f,
+                            1.0f,  -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, 1.0f,  -1.0f, 1.0f,  1.0f,  -1.0f, 1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  -1.0f, 1.0f,  1.0f, -1.0f,
+                            1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, 1.0f};
+
+  // skybox VAO
+  unsigned int skyboxVAO, skyboxVBO;
+  glGenVertexArrays(1, &skyboxVAO);
+  glGenBuffers(1, &skyboxVBO);
+  glBindVertexArray(skyboxVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+
+  u32         cubemapTexture = load_cubemap();
+  ShaderType  types[2]       = {SHADER_TYPE_VERT, SHADER_TYPE_FRAG};
+  const char* locations[2]   = {
+      "./shaders/skybox.vert",
+      "./shaders/skybox.frag",
+  };
+  Shader shader(types, locations, 2, "skybox");
+
+  shader.use();
+  GLuint location = sta_glGetUniformLocation(shader.id, "skybox");
+  sta_glUniform1i(location, 0);
+  glActiveTexture(GL_TEXTURE0);
+  sta_glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+
+  f32 x = 0;
+  while (true)
+  {
+    input_state.update();
+    if (input_state.should_quit())
+    {
+      exit(1);
+    }
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glDepthFunc(GL_LEQUAL);
+    shader.use();
+    x -= 0.1f;
+    Mat44 view = Mat44::identity().scale(0.2f).rotate_x(x).rotate_y(x).rotate_z(x);
+
+    shader.set_mat4("view", view);
+    shader.set_mat4("projection", Mat44::identity());
+
+    glBindVertexArray(skyboxVAO);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glBindVertexArray(0);
+    glDepthFunc(GL_LESS); // set depth function back to default
+
+    SDL_GL_SwapWindow(game_state.renderer.window);
+  }
+
+  exit(1);
+}
+
+void bench_cube_shadows(u32 map_buffer, u32 map_texture, Vector3 light_position, u32 frames)
+{
+  const u32 warmup_frames = 10;
+  Renderer* renderer      = &game_state.renderer;
+
+  // fill the map with a wave worth of animated casters
+  for (u32 i = 0; i < 24; i++)
+  {
+    spawn((EnemyType)(i % 3), 0);
+  }
+  update_animations(0);
+
+  u64 cpu_freq = EstimateCPUTimerFreq();
+  printf("%-20s %-8s %12s %12s\n", "mode", "cached", "ms/frame", "culled/frame");
+  for (u32 mode = 0; mode < CUBE_SHADOW_MODE_COUNT; mode++)
+  {
+    if (!renderer->set_cube_shadow_mode((CubeShadowMode)mode))
+    {
+      printf("%-20s skipped, not supported\n", cube_shadow_mode_name((CubeShadowMode)mode));
+      continue;
+    }
+    for (u32 cached = 0; cached < 2; cached++)
+    {
+      if (cached && !renderer->shadow_cache.cube_framebuffer)
+      {
+        continue;
+      }
+      renderer->shadow_caching = cached;
+      renderer->invalidate_shadow_cache();
+
+      u64 elapsed = 0, culled = 0;
+      for (u32 frame = 0; frame < warmup_frames + frames; frame++)
+      {
+        push_render_items(map_buffer, 0, map_texture, 1.0f);
+        glFinish();
+        u64 start = ReadCPUTimer();
+        renderer->render_to_depth_texture_cube(light_position);
+        glFinish();
+        if (frame >= warmup_frames)
+        {
+          elapsed += ReadCPUTimer() - start;
+          culled += renderer->cube_shadow_culled;
+        }
+        renderer->render_queue_static_count   = 0;
+        renderer->render_queue_animated_count = 0;
+      }
+      printf("%-20s %-8s %12.4f %12.2f\n", cube_shadow_mode_name((CubeShadowMode)mode), cached ? "yes" : "no", 1000.0 * elapsed / (f64)cpu_freq / frames, culled / (f64)frames);
+    }
+  }
+}
+
+// Tokenizes a file the way the .obj/.anim loaders do, numbers go through parse_float and
+// anything else is skipped a byte at a time
+static f64 parse_all_numbers(Buffer* file, u64* number_count)
+{
+  f64 sum     = 0;
+  file->index = 0;
+  while (!file->is_out_of_bounds())
+  {
+    char c = file->current_char();
+    if (isdigit(c) || c == '-' || c == '.')
+    {
+      sum += file->parse_float();
+      (*number_count)++;
+    }
+    else
+    {
+      file->advance();
+    }
+    file->skip_whitespace();
+  }
+  return sum;
+}
+
+static f64 strtof_all_numbers(Buffer* file)
+{
+  f64   sum = 0;
+  char* end = file->buffer + file->len;
+  for (char* curr = file->buffer; curr < end;)
+  {
+    char* next;
+    sum += strtof(curr, &next);
+    curr = next == curr ? curr + 1 : next;
+  }
+  return sum;
+}
+
+// Every number that strtof reads the same extent of has to come out bit identical
+static u64 count_parse_mismatches(Buffer* file)
+{
+  u64 mismatches = 0;
+  file->index    = 0;
+  while (!file->is_out_of_bounds())
+  {
+    char c = file->current_char();
+    if (isdigit(c) || c == '-' || c == '.')
+    {
+      char* start = file->current_address();
+      char* end;
+      f32   expected = strtof(start, &end);
+      f32   value    = file->parse_float();
+      if (end == file->current_address() && memcmp(&expected, &value, sizeof(f32)) != 0)
+      {
+        mismatches++;
+      }
+    }
+    else
+    {
+      file->advance();
+    }
+    file->skip_whitespace();
+  }
+  return mismatches;
+}
+
+void bench_parse_numbers(char** filenames, u32 file_count, u32 iterations)
+{
+  u64 cpu_freq = EstimateCPUTimerFreq();
+  printf("%-36s %8s %10s %12s %12s %10s\n", "file", "MB", "numbers", "parse MB/s", "strtof MB/s", "mismatch");
+  for (u32 i = 0; i < file_count; i++)
+  {
+    Buffer file = {};
+    if (!sta_map_file(&file, filenames[i]))
+    {
+      printf("%-36s couldn't be read\n", filenames[i]);
+      continue;
+    }
+
+    u64 number_count = 0;
+    f64 checksum     = 0;
+    u64 start        = ReadCPUTimer();
+    for (u32 j = 0; j < iterations; j++)
+    {
+      number_count = 0;
+      checksum += parse_all_numbers(&file, &number_count);
+    }
+    u64 parse_cycles = ReadCPUTimer() - start;
+
+    start            = ReadCPUTimer();
+    for (u32 j = 0; j < iterations; j++)
+    {
+      checksum += strtof_all_numbers(&file);
+    }
+    u64 strtof_cycles = ReadCPUTimer() - start;
+
+    f64 megabytes     = file.len / (1024.0 * 1024.0);
+    f64 total         = megabytes * iterations * cpu_freq;
+    printf("%-36s %8.3f %10lu %12.1f %12.1f %10lu\n", filenames[i], megabytes, number_count, total / parse_cycles, total / strtof_cycles, count_parse_mismatches(&file));
+    logger.info("checksum %f", checksum);
+    sta_unmap_file(&file);
+  }
+}
+
+void bench_decode_targa(char** filenames, u32 file_count, u32 iterations)
+{
+  u64 cpu_freq = EstimateCPUTimerFreq();
+  printf("%-40s %6s %8s %10s %12s %12s\n", "file", "type", "MB", "pixels", "input MB/s", "Mpixels/s");
+  for (u32 i = 0; i < file_count; i++)
+  {
+    // decoded from memory so the numbers don't include the disk
+    Buffer file = {};
+    if (!sta_read_file(&file, filenames[i]))
+    {
+      printf("%-40s couldn't be read\n", filenames[i]);
+      continue;
+    }
+
+    TargaImage image  = {};
+    u64        cycles = 0;
+    bool       ok     = true;
+    for (u32 j = 0; j < iterations && ok; j++)
+    {
+      file.index = 0;
+      u64 start  = ReadCPUTimer();
+      ok         = sta_targa_decode_rgba(&image, &file);
+      cycles += ReadCPUTimer() - start;
+      if (ok)
+      {
+        sta_deallocate(image.data, (u64)image.width * image.height * 4);
+      }
+    }
+    if (!ok)
+    {
+      printf("%-40s couldn't be decoded\n", filenames[i]);
+      sta_deallocate(file.buffer, file.len + 1);
+      continue;
+    }
+
+    u8  type      = ((TargaHeader*)file.buffer)->imageType;
+    u8  bits      = ((TargaHeader*)file.buffer)->imagePixelSize;
+    u64 pixels    = (u64)image.width * image.height;
+    f64 megabytes = file.len / (1024.0 * 1024.0);
+    f64 seconds   = (f64)cycles / cpu_freq;
+    printf("%-40s %3s %2u %8.3f %10lu %12.1f %12.1f\n", filenames[i], type == 10 ? "rle" : "raw", bits, megabytes, pixels, megabytes * iterations / seconds,
+           pixels * iterations / seconds / 1000000.0);
+    sta_deallocate(file.buffer, file.len + 1);
+  }
+}
+
+static f32 polygon_area(Vector2* points, u32 count)
+{
+  f32 area = 0;
+  for (u32 i = 0, j = count - 1; i < count; j = i++)
+  {
+    area += (points[j].x + points[i].x) * (points[j].y - points[i].y);
+  }
+  return area * 0.5f;
+}
+
+// Jagged clockwise outer ring with counter clockwise octagon pillars on a grid inside it, like a big arena
+static void generate_bench_arena(Random* random, Vector2** rings, u32* counts, u32 outer_count, u32 hole_count)
+{
+  counts[0] = outer_count;
+  rings[0]  = sta_allocate_struct(Vector2, outer_count);
+  for (u32 i = 0; i < outer_count; i++)
+  {
+    f32 angle   = -2.0f * PI * i / outer_count;
+    // jagged on the scale of an edge so bigger rings get more detailed rather than spikier
+    f32 radius  = 100.0f + random->range(0, 2.0f * PI * 100.0f / outer_count);
+    rings[0][i] = Vector2(cosf(angle) * radius, sinf(angle) * radius);
+  }
+
+  u32 side = (u32)ceilf(sqrtf(hole_count));
+  f32 step = 120.0f / side;
+  for (u32 i = 0; i < hole_count; i++)
+  {
+    Vector2 center = Vector2(-60.0f + step * (i % side + 0.5f), -60.0f + step * (i / side + 0.5f));
+    f32     radius = step * (0.2f + random->range(0, 0.15f));
+    counts[i + 1]  = 8;
+    rings[i + 1]   = sta_allocate_struct(Vector2, 8);
+    for (u32 j = 0; j < 8; j++)
+    {
+      f32 angle       = 2.0f * PI * j / 8;
+      rings[i + 1][j] = Vector2(center.x + cosf(angle) * radius, center.y + sinf(angle) * radius);
+    }
+  }
+}
+
+static f64 triangles_area(Triangle* triangles, u32 count)
+{
+  f64 area = 0;
+  for (u32 i = 0; i < count; i++)
+  {
+    area += std::abs(polygon_area(triangles[i].points, 3));
+  }
+  return area;
+}
+
+static f64 bench_time_earcut(Vector2** rings, u32* counts, u32 ring_count, u32* triangle_count, f32* area_error, u64 cpu_freq)
+{
+  f64 expected_area = std::abs(polygon_area(rings[0], counts[0]));
+  u32 total_count   = 0;
+  for (u32 i = 0; i < ring_count; i++)
+  {
+    expected_area -= i > 0 ? std::abs(polygon_area(rings[i], counts[i])) : 0;
+    total_count += counts[i];
+  }
+
+  Triangle* triangles;
+  u64       start = ReadCPUTimer();
+  triangulate_polygon_with_holes(&triangles, *triangle_count, rings, counts, ring_count);
+  f64 ms      = (ReadCPUTimer() - start) * 1000.0 / cpu_freq;
+  *area_error = std::abs(triangles_area(triangles, *triangle_count) - expected_area) / expected_area;
+  sta_deallocate(triangles, sizeof(Triangle) * (total_count + ring_count * 2));
+  return ms;
+}
+
+// Times the z-order ear clipper against the old one on the outer ring alone, then with the pillars cut out.
+// The old path only bridges a single hole reliably so it isn't timed on those.
+// The covered area has to match the polygon's for a triangulation to count
+void bench_triangulate()
+{
+  u64    cpu_freq  = EstimateCPUTimerFreq();
+  u32    sizes[]   = {256, 1024, 4096, 16384, 65536};
+  // the old clipper is quadratic, past this it takes too long to be worth waiting for
+  u32    old_limit = 16384;
+  Random random;
+  random.seed(7);
+
+  printf("%8s %12s %12s %12s | %6s %10s %12s %12s\n", "outer", "earcut ms", "old ms", "area error", "holes", "triangles", "earcut ms", "area error");
+  for (u32 s = 0; s < ArrayCount(sizes); s++)
+  {
+    u32      outer_count = sizes[s];
+    u32      hole_count  = outer_count / 32;
+    u32      ring_count  = hole_count + 1;
+    Vector2* rings[ring_count];
+    u32      counts[ring_count];
+    generate_bench_arena(&random, rings, counts, outer_count, hole_count);
+
+    u32 ring_triangles;
+    f32 ring_error;
+    f64 ring_ms = bench_time_earcut(rings, counts, 1, &ring_triangles, &ring_error, cpu_freq);
+
+    f64 old_ms  = 0;
+    if (outer_count <= old_limit)
+    {
+      Triangle* old_triangles      = sta_allocate_struct(Triangle, outer_count);
+      u32       old_triangle_count = 0;
+      u64       start              = ReadCPUTimer();
+      triangulate_earclipping(old_triangles, old_triangle_count, rings, counts, 1, outer_count);
+      old_ms = (ReadCPUTimer() - start) * 1000.0 / cpu_freq;
+      sta_deallocate(old_triangles, sizeof(Triangle) * outer_count);
+    }
+
+    u32 arena_triangles;
+    f32 arena_error;
+    f64 arena_ms = bench_time_earcut(rings, counts, ring_count, &arena_triangles, &arena_error, cpu_freq);
+
+    char old_column[32] = "-";
+    if (old_ms != 0)
+    {
+      snprintf(old_column, ArrayCount(old_column), "%.3f", old_ms);
+    }
+    printf("%8u %12.3f %12s %12.6f | %6u %10u %12.3f %12.6f\n", outer_count, ring_ms, old_column, ring_error, hole_count, arena_triangles, arena_ms, arena_error);
+
+    for (u32 i = 0; i < ring_count; i++)
+    {
+      sta_deallocate(rings[i], sizeof(Vector2) * counts[i]);
+    }
+  }
+}
+
+// Open square grid with random horizontal and vertical walls over it, every chunk is on the floor
+static void generate_bench_grid(Random* random, MapGrid* grid, u32 tiles)
+{
+  grid->min      = Vector2(-1, -1);
+  grid->max      = Vector2(1, 1);
+  grid->tiles_x  = tiles;
+  grid->tiles_y  = tiles;
+  grid->chunks_x = (tiles + WALKABLE_CHUNK_SIZE - 1) / WALKABLE_CHUNK_SIZE;
+  grid->chunks_y = grid->chunks_x;
+  grid->chunks   = sta_allocate_struct(WalkableChunk*, grid->chunks_x * grid->chunks_y);
+  for (u32 i = 0; i < grid->chunks_x * grid->chunks_y; i++)
+  {
+    grid->chunks[i] = sta_allocate_struct(WalkableChunk, 1);
+    memset(grid->chunks[i]->on_floor, 0xff, sizeof(grid->chunks[i]->on_floor));
+  }
+  u32 wall_count = tiles * tiles / 64;
+  for (u32 i = 0; i < wall_count; i++)
+  {
+    u32  x          = random->next_u64() % tiles;
+    u32  y          = random->next_u64() % tiles;
+    u32  length     = 2 + random->next_u64() % 16;
+    bool horizontal = random->next_u64() % 2;
+    for (u32 j = 0; j < length && x < tiles && y < tiles; j++)
+    {
+      WalkableChunk* chunk = grid->chunks[(y / WALKABLE_CHUNK_SIZE) * grid->chunks_x + x / WALKABLE_CHUNK_SIZE];
+      u32            idx   = (y % WALKABLE_CHUNK_SIZE) * WALKABLE_CHUNK_SIZE + x % WALKABLE_CHUNK_SIZE;
+      chunk->on_floor[idx / 64] &= ~(1ULL << (idx % 64));
+      x += horizontal;
+      y += !horizontal;
+    }
+  }
+}
+
+// Full A* against the cluster graph between the same random pairs of tiles that can reach each
+// other, on growing grids. Expanded is tiles for A* and tiles plus nodes for the cluster graph
+void bench_hpa()
+{
+  u64    cpu_freq    = EstimateCPUTimerFreq();
+  u32    sizes[]     = {64, 128, 256, 512, 1024};
+  u32    query_count = 200;
+  Random random;
+  random.seed(7);
+
+  printf("%6s %8s %8s %10s | %12s %12s | %12s %12s %8s\n", "tiles", "nodes", "edges", "build ms", "A* us", "A* expanded", "hpa us", "hpa expanded", "failed");
+  for (u32 s = 0; s < ArrayCount(sizes); s++)
+  {
+    u32 tiles = sizes[s];
+    generate_bench_grid(&random, &map.grid, tiles);
+    MapGrid* grid  = &map.grid;
+
+    // the pairs come out of whatever the first open tile can get to
+    u32*     reachable       = sta_allocate_struct(u32, grid->tile_count());
+    u8*      visited         = sta_allocate_struct(u8, grid->tile_count());
+    u32      reachable_count = 0;
+    u32      first           = 0;
+    while (!grid->is_walkable(first % tiles, first / tiles, 0))
+    {
+      first++;
+    }
+    visited[first]               = 1;
+    reachable[reachable_count++] = first;
+    for (u32 i = 0; i < reachable_count; i++)
+    {
+      i32 tile_x = reachable[i] % tiles;
+      i32 tile_y = reachable[i] / tiles;
+      for (i32 y = MAX(tile_y - 1, 0); y < MIN(tile_y + 2, (i32)tiles); y++)
+      {
+        for (i32 x = MAX(tile_x - 1, 0); x < MIN(tile_x + 2, (i32)tiles); x++)
+        {
+          if (!visited[y * tiles + x] && grid->is_walkable(x, y, 0))
+          {
+            visited[y * tiles + x]       = 1;
+            reachable[reachable_count++] = y * tiles + x;
+          }
+        }
+      }
+    }
+
+    HpaGraph graph;
+    u64      start    = ReadCPUTimer();
+    build_hpa_graph(&graph, grid, 0);
+    f64      build_ms = (ReadCPUTimer() - start) * 1000.0 / cpu_freq;
+
+    HpaQuery query;
+    init_hpa_query(&query, &graph, 1);
+    GridSearch search;
+    init_grid_search(&search, grid);
+    Path path;
+    init_path(&path);
+
+    u64 astar_cycles = 0, hpa_cycles = 0, astar_expanded = 0, hpa_expanded = 0;
+    u32 failed = 0;
+    for (u32 i = 0; i < query_count; i++)
+    {
+      u32     source_tile = reachable[random.next_u64() % reachable_count];
+      u32     needle_tile = reachable[random.next_u64() % reachable_count];
+      Vector2 source      = tile_position_to_game(source_tile % tiles, source_tile / tiles);
+      Vector2 needle      = tile_position_to_game(needle_tile % tiles, needle_tile / tiles);
+
+      u32     budget      = ~0u;
+      start               = ReadCPUTimer();
+      begin_path_search(&search, needle, source, 0);
+      step_path_search(&search, &path, budget);
+      astar_cycles += ReadCPUTimer() - start;
+      astar_expanded += ~0u - budget;
+
+      start = ReadCPUTimer();
+      failed += !hpa_find_path(&graph, &query, &path, needle, source);
+      hpa_cycles += ReadCPUTimer() - start;
+      hpa_expanded += query.expanded;
+    }
+    printf("%6u %8u %8u %10.3f | %12.2f %12.1f | %12.2f %12.1f %8u\n", tiles, graph.node_count, graph.edge_count, build_ms, astar_cycles * 1000000.0 / cpu_freq / query_count,
+           astar_expanded / (f64)query_count, hpa_cycles * 1000000.0 / cpu_freq / query_count, hpa_expanded / (f64)query_count, failed);
+
+    sta_deallocate(reachable, sizeof(u32) * grid->tile_count());
+    sta_deallocate(visited, sizeof(u8) * grid->tile_count());
+    for (u32 i = 0; i < grid->chunks_x * grid->chunks_y; i++)
+    {
+      sta_deallocate(grid->chunks[i], sizeof(WalkableChunk));
+    }
+    sta_deallocate(grid->chunks, sizeof(WalkableChunk*) * grid->chunks_x * grid->chunks_y);
+  }
+}
+
+// Separation on random crowds packed as tight as a wave closing in on the player, the time per agent
+// should stay flat as the crowd grows. Overlaps are counted on the first and the last update
+void bench_crowd()
+{
+  u64    cpu_freq  = EstimateCPUTimerFreq();
+  u32    sizes[]   = {256, 1024, 4096, 16384, 65536};
+  u32    updates   = 30;
+  Crowd  agents    = {};
+  Random random;
+  random.seed(7);
+
+  printf("%8s %12s %12s %12s %12s\n", "agents", "us", "ns/agent", "overlaps", "after");
+  for (u32 s = 0; s < ArrayCount(sizes); s++)
+  {
+    u32 count = sizes[s];
+    f32 side  = sqrtf((f32)count) * 0.15f;
+    reserve_crowd(&agents, count);
+    agents.count = count;
+    for (u32 i = 0; i < count; i++)
+    {
+      agents.x[i]         = random.range(0, side);
+      agents.y[i]         = random.range(0, side);
+      agents.r[i]         = 0.05f;
+      agents.max_speed[i] = 0.005f;
+    }
+
+    u64 cycles         = 0;
+    u64 first_overlaps = 0;
+    u64 last_overlaps  = 0;
+    for (u32 update = 0; update < updates; update++)
+    {
+      memset(agents.vx, 0, sizeof(f32) * count);
+      memset(agents.vy, 0, sizeof(f32) * count);
+      u64 overlaps = agents.overlaps_total;
+      u64 start    = ReadCPUTimer();
+      separate_crowd(&agents);
+      cycles += ReadCPUTimer() - start;
+      last_overlaps  = agents.overlaps_total - overlaps;
+      first_overlaps = update == 0 ? last_overlaps : first_overlaps;
+      for (u32 i = 0; i < count; i++)
+      {
+        agents.x[i] += agents.vx[i];
+        agents.y[i] += agents.vy[i];
+      }
+    }
+    f64 us = cycles * 1000000.0 / cpu_freq / updates;
+    printf("%8u %12.2f %12.2f %12lu %12lu\n", count, us, us * 1000.0 / count, first_overlaps, last_overlaps);
+  }
+}
+
+// Writes a pre-mipmapped, block compressed .stex next to every targa in the texture list,
+// the renderer picks those up instead of decoding the targa
+bool cook_textures(const char* file_location)
+{
+  Json json = {};
+  if (!sta_json_deserialize_from_file(&json, file_location))
+  {
+    logger.error("Failed to read textures from '%s'", file_location);
+    return false;
+  }
+  assert(json.headType == JSON_OBJECT && "Expected head to be object");
+  JsonObject* head     = &json.obj;
+  u32         cooked   = 0;
+  u64         cpu_freq = EstimateCPUTimerFreq();
+  for (u32 i = 0; i < head->size; i++)
+  {
+    JsonObject* texture_json = head->values[i].obj;
+    char*       location     = sta_json_c_string(&json, &texture_json->lookup_value("location")->string);
+    JsonValue*  normal_map   = texture_json->lookup_value("normal_map");
+    char        output[512];
+    sta_cooked_texture_location(output, ArrayCount(output), location);
+
+    u64 start = ReadCPUTimer();
+    if (!sta_cook_texture(location, output, normal_map && normal_map->b))
+    {
+      printf("%-48s couldn't be cooked\n", location);
+      continue;
+    }
+    printf("%-48s -> %s in %.1f ms\n", location, output, (ReadCPUTimer() - start) * 1000.0 / cpu_freq);
+    cooked++;
+  }
+  printf("Cooked %u of %lu textures\n", cooked, head->size);
+  sta_json_free(&json);
+  return true;
+}
+
+struct HeadlessOptions
+{
+  u32         max_ticks;
+  u32         until_wave;
+  u32         timestep_ms;
+  u64         seed;
+  bool        god;
+  const char* stats_file;
+  const char* replay_file;
+};
+
+struct SimulationStats
+{
+  u64  update_count;
+  u64  update_cycles_total;
+  u64  update_cycles_max;
+  u64  wall_cycles;
+  u32  simulated_ms;
+  u32  peak_enemies_alive;
+  u32  peak_entities;
+  bool player_died;
+};
+
+bool parse_headless_options(HeadlessOptions* options, i32 argc, char** argv)
+{
+  bool headless        = false;
+  options->max_ticks   = 0;
+  options->until_wave  = 0;
+  options->timestep_ms = SIMULATION_TIMESTEP_MS;
+  options->seed        = 1;
+  options->god         = false;
+  options->stats_file  = 0;
+  options->replay_file = 0;
+  for (i32 i = 1; i < argc; i++)
+  {
+    const char* arg      = argv[i];
+    bool        has_next = i + 1 < argc;
+    if (compare_strings(arg, "--headless"))
+    {
+      headless = true;
+    }
+    else if (compare_strings(arg, "--ticks") && has_next)
+    {
+      options->max_ticks = atoi(argv[++i]);
+    }
+    else if (compare_strings(arg, "--until-wave") && has_next)
+    {
+      options->until_wave = atoi(argv[++i]);
+    }
+    else if (compare_strings(arg, "--timestep") && has_next)
+    {
+      options->timestep_ms = MAX(atoi(argv[++i]), 1);
+    }
+    else if (compare_strings(arg, "--seed") && has_next)
+    {
+      options->seed = strtoull(argv[++i], 0, 10);
+    }
+    else if (compare_strings(arg, "--stats") && has_next)
+    {
+      options->stats_file = argv[++i];
+    }
+    else if (compare_strings(arg, "--replay") && has_next)
+    {
+      options->replay_file = argv[++i];
+    }
+    else if (compare_strings(arg, "--god"))
+    {
+      options->god = true;
+    }
+  }
+  if (headless && options->max_ticks == 0 && options->until_wave == 0 && !options->replay_file)
+  {
+    // never run an unbounded simulation on a build agent
+    options->max_ticks = 60 * 60 * 5;
+  }
+  return headless;
+}
+
+void init_waves()
+{
+  enemy_capacity                      = 16;
+  enemies                             = sta_allocate_struct(Enemy, enemy_capacity);
+  enemy_count                         = 0;
+  // requests of the previous run, anything in flight is freed once it comes back
+  if (path_scheduler.active)
+  {
+    free_path_request(path_scheduler.active);
+  }
+  for (u32 i = 0; i < path_scheduler.pending_count; i++)
+  {
+    free_path_request(path_scheduler.pending[i]);
+  }
+  for (u32 i = 0; i < path_scheduler.in_flight_count; i++)
+  {
+    path_scheduler.in_flight[i]->cancelled = true;
+  }
+  path_scheduler.pending_count        = 0;
+  path_scheduler.active               = 0;
+  game_state.wave                     = 0;
+  game_state.enemies_spawned          = 0;
+  CommandUpdateWave* update_wave_data = sta_allocate_struct(CommandUpdateWave, 1);
+  update_wave_data->number_of_enemies = 4;
+  add_command(CMD_UPDATE_WAVE, (void*)update_wave_data, 0);
+}
+
+void record_update_stats(SimulationStats* stats, u64 update_cycles)
+{
+  stats->update_count++;
+  stats->update_cycles_total += update_cycles;
+  stats->update_cycles_max = MAX(stats->update_cycles_max, update_cycles);
+  stats->peak_entities     = MAX(stats->peak_entities, game_state.entity_count);
+  u32 alive                = 0;
+  for (u32 i = 0; i < enemy_count; i++)
+  {
+    alive += game_state.entities[enemies[i].entity].hp > 0;
   }
+  stats->peak_enemies_alive = MAX(stats->peak_enemies_alive, alive);
+}
 
-  for (u32 i = 0; i < game_state.entity_count; i++)
+// Writes to stdout without a filename, GPU pass timings are only there when a GL context was used
+bool write_simulation_stats(const char* filename, u32 timestep_ms, SimulationStats* stats)
+{
+  FILE* file = stdout;
+  if (filename)
   {
-    Entity* entity = &game_state.entities[i];
-    if (entity->visible)
+    file = fopen(filename, "w");
+    if (!file)
     {
-      EntityRenderData* render_data = entity->render_data;
-      Mat44             m           = render_data->get_model_matrix();
-
-      m                             = m.rotate_z(RADIANS_TO_DEGREES(entity->angle) + 90);
-      m                             = m.translate(Vector3(entity->position.x, entity->position.y, 0.0f));
-      if (render_data->animation_controller)
-      {
-        renderer->push_render_item_animated(render_data->buffer_id, m, render_data->animation_controller->transforms, render_data->animation_controller->animation_data->skeleton.joint_count,
-                                            render_data->texture, render_data->normal_map);
-      }
-      else
-      {
-        renderer->push_render_item_static(render_data->buffer_id, m, render_data->texture);
-      }
+      logger.error("Failed to open stats file '%s'", filename);
+      return false;
     }
   }
-  EffectNode* node = effects.head;
-  EffectNode* prev = 0;
-  while (node)
-  {
 
-    Effect            effect      = node->effect;
-    EntityRenderData* render_data = &effect.render_data;
-    Mat44             m           = render_data->get_model_matrix();
-    m                             = m.rotate_z(RADIANS_TO_DEGREES(effect.angle) + 90);
-    m                             = m.translate(Vector3(effect.position.x, effect.position.y, 0.0f));
-    renderer->push_render_item_static(render_data->buffer_id, m, render_data->texture);
+  u64 cpu_freq     = EstimateCPUTimerFreq();
+  f64 cycles_to_us = 1000000.0 / (f64)cpu_freq;
+  u32 alive        = 0;
+  for (u32 i = 0; i < enemy_count; i++)
+  {
+    alive += game_state.entities[enemies[i].entity].hp > 0;
+  }
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"timestep_ms\": %u,\n", timestep_ms);
+  fprintf(file, "  \"seed\": %lu,\n", game_state.seed);
+  fprintf(file, "  \"updates\": %lu,\n", stats->update_count);
+  fprintf(file, "  \"simulated_ms\": %u,\n", stats->simulated_ms);
+  fprintf(file, "  \"wall_ms\": %.3f,\n", stats->wall_cycles * cycles_to_us / 1000.0);
+  fprintf(file, "  \"update_us_avg\": %.3f,\n", stats->update_count ? stats->update_cycles_total * cycles_to_us / stats->update_count : 0.0);
+  fprintf(file, "  \"update_us_max\": %.3f,\n", stats->update_cycles_max * cycles_to_us);
+  fprintf(file, "  \"updates_per_second\": %.1f,\n", stats->update_cycles_total ? stats->update_count / (stats->update_cycles_total / (f64)cpu_freq) : 0.0);
+  fprintf(file, "  \"wave\": %u,\n", game_state.wave);
+  fprintf(file, "  \"enemies_spawned\": %u,\n", game_state.enemies_spawned);
+  fprintf(file, "  \"enemies_alive\": %u,\n", alive);
+  fprintf(file, "  \"peak_enemies_alive\": %u,\n", stats->peak_enemies_alive);
+  fprintf(file, "  \"peak_entities\": %u,\n", stats->peak_entities);
+  fprintf(file, "  \"paths_completed\": %u,\n", path_scheduler.completed);
+  fprintf(file, "  \"paths_coalesced\": %u,\n", path_scheduler.coalesced);
+  fprintf(file, "  \"pathfinding_us_avg\": %.3f,\n", path_scheduler.run_count ? path_scheduler.cycles_total * cycles_to_us / path_scheduler.run_count : 0.0);
+  fprintf(file, "  \"pathfinding_us_max\": %.3f,\n", path_scheduler.cycles_max * cycles_to_us);
+  fprintf(file, "  \"crowd_us_avg\": %.3f,\n", crowd.run_count ? crowd.cycles_total * cycles_to_us / crowd.run_count : 0.0);
+  fprintf(file, "  \"crowd_us_max\": %.3f,\n", crowd.cycles_max * cycles_to_us);
+  fprintf(file, "  \"overlapping_enemies_avg\": %.3f,\n", crowd.run_count ? crowd.overlaps_total / (f64)crowd.run_count : 0.0);
+  fprintf(file, "  \"overlapping_enemies_max\": %u,\n", crowd.overlaps_max);
+  fprintf(file, "  \"score\": %u,\n", game_state.score);
+  fprintf(file, "  \"player_hp\": %d,\n", game_state.entities[game_state.player.entity].hp);
+  fprintf(file, "  \"player_died\": %s,\n", stats->player_died ? "true" : "false");
+  GpuTimers* gpu_timers = &game_state.renderer.gpu_timers;
+  if (gpu_timers->enabled)
+  {
+    fprintf(file, "  \"gpu_ms\": {\n");
+    for (u32 pass = 0; pass < GPU_PASS_COUNT; pass++)
+    {
+      f64 avg = gpu_timers->sample_count[pass] ? gpu_timers->total_ms[pass] / gpu_timers->sample_count[pass] : 0.0;
+      fprintf(file, "    \"%s\": {\"avg\": %.4f, \"last\": %.4f, \"samples\": %lu},\n", gpu_pass_name((GpuPass)pass), avg, gpu_timers->last_ms[pass],
+              gpu_timers->sample_count[pass]);
+    }
+    fprintf(file, "    \"missed\": %lu\n", gpu_timers->missed);
+    fprintf(file, "  },\n");
+  }
+  fprintf(file, "  \"state_hash\": \"%08x\"\n", hash_simulation_state());
+  fprintf(file, "}\n");
 
-    node = node->next;
+  if (file != stdout)
+  {
+    fclose(file);
   }
+  return true;
 }
 
-u32 load_cubemap()
+// Runs the simulation without a window or GL context, only the CPU side of load_data is done
+int run_headless(HeadlessOptions* options)
 {
-  u32 texture_id;
-  glGenTextures(1, &texture_id);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
+  game_state.renderer = Renderer(&logger);
+  InputState input_state(0);
+  input_state.mouse_wheel_direction = 0;
 
-  const char* image_names[6] = {
-      "./data/textures/red.tga", "./data/textures/green.tga", "./data/textures/black.tga", "./data/textures/white.tga", "./data/textures/blue.tga",
-  };
+  if (!load_data())
+  {
+    return 1;
+  }
+  game_state.projection.perspective(45.0f, 620 / 480.0f, 0.01f, 100.0f);
 
-  for (unsigned int i = 0; i < 6; i++)
+  // a replay brings its own seed and timestep and runs until the log ends
+  InputReplay replay;
+  if (options->replay_file)
   {
-    TargaImage image = {};
-    if (!sta_targa_read_from_file_rgba(&image, image_names[i % 5]))
+    if (!replay.load(options->replay_file))
     {
-      exit(1);
+      return 1;
+    }
+    options->seed        = replay.header.seed;
+    options->timestep_ms = replay.header.timestep_ms;
+    if (options->max_ticks == 0 || options->max_ticks > replay.header.tick_count)
+    {
+      options->max_ticks = replay.header.tick_count;
     }
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data);
-    GLenum error = glGetError();
   }
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  seed_simulation(options->seed);
+  init_player(&game_state.player);
+  init_waves();
+  game_state.god = options->god;
 
-  return texture_id;
-}
+  SimulationStats stats              = {};
+  u32             game_running_ticks = 0;
+  u64             start              = ReadCPUTimer();
+  while (options->max_ticks == 0 || stats.update_count < options->max_ticks)
+  {
+    if (options->until_wave && game_state.wave >= options->until_wave)
+    {
+      break;
+    }
 
-void test_cubemap(InputState input_state)
-{
+    if (options->replay_file && !replay.next(&input_state))
+    {
+      break;
+    }
 
-  float skyboxVertices[] = {// positions
-                            -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, 1.0f, -1.0f,
-                            -1.0f, -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, 1.0f,  1.0f, 1.0f,
-                            1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  -1.0f, 1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  1.0f, 1.0f,
-                            1.0f,  -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, 1.0f,  -1.0f, 1.0f,  1.0f,  -1.0f, 1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  -1.0f, 1.0f,  1.0f, -1.0f,
-                            1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, 1.0f};
+    u64 update_start = ReadCPUTimer();
+    game_running_ticks += options->timestep_ms;
+    update(game_state.camera, &input_state, game_running_ticks, options->timestep_ms);
+    record_update_stats(&stats, ReadCPUTimer() - update_start);
 
-  // skybox VAO
-  unsigned int skyboxVAO, skyboxVBO;
-  glGenVertexArrays(1, &skyboxVAO);
-  glGenBuffers(1, &skyboxVBO);
-  glBindVertexArray(skyboxVAO);
-  glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    if (game_state.entities[game_state.player.entity].hp == 0)
+    {
+      logger.info("Game over player died at tick %u", game_running_ticks);
+      stats.player_died = true;
+      break;
+    }
+  }
+  stats.wall_cycles  = ReadCPUTimer() - start;
+  stats.simulated_ms = game_running_ticks;
 
-  u32         cubemapTexture = load_cubemap();
-  ShaderType  types[2]       = {SHADER_TYPE_VERT, SHADER_TYPE_FRAG};
-  const char* locations[2]   = {
-      "./shaders/skybox.vert",
-      "./shaders/skybox.frag",
-  };
-  Shader shader(types, locations, 2, "skybox");
+  return write_simulation_stats(options->stats_file, options->timestep_ms, &stats) ? 0 : 1;
+}
 
-  shader.use();
-  GLuint location = sta_glGetUniformLocation(shader.id, "skybox");
-  sta_glUniform1i(location, 0);
-  glActiveTexture(GL_TEXTURE0);
-  sta_glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+struct SessionOutputs
+{
+  InputRecorder   recorder;
+  const char*     trace_file;
+  const char*     stats_file;
+  SimulationStats stats;
+  u64             start;
+};
 
-  f32 x = 0;
-  while (true)
+// The hash lets a later --replay of the log be checked against the original run
+void finish_session(SessionOutputs* outputs, u32 tick)
+{
+  InputRecorder* recorder   = &outputs->recorder;
+  const char*    trace_file = outputs->trace_file;
+  if (recorder->is_recording())
   {
-    input_state.update();
-    if (input_state.should_quit())
+    logger.info("Simulation state %08x at tick %u", hash_simulation_state(), tick);
+    recorder->end();
+  }
+  if (trace_file)
+  {
+    if (exportChromeTrace(trace_file, PROFILER_FRAME_COUNT))
     {
-      exit(1);
+      logger.info("Wrote the last %u frames to %s", getProfiledFrameCount(), trace_file);
+    }
+    else
+    {
+      logger.error("Failed to write trace to %s", trace_file);
     }
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    glDepthFunc(GL_LEQUAL);
-    shader.use();
-    x -= 0.1f;
-    Mat44 view = Mat44::identity().scale(0.2f).rotate_x(x).rotate_y(x).rotate_z(x);
-
-    shader.set_mat4("view", view);
-    shader.set_mat4("projection", Mat44::identity());
-
-    glBindVertexArray(skyboxVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-    glDepthFunc(GL_LESS); // set depth function back to default
-
-    SDL_GL_SwapWindow(game_state.renderer.window);
   }
-
-  exit(1);
+  if (outputs->stats_file)
+  {
+    outputs->stats.wall_cycles  = ReadCPUTimer() - outputs->start;
+    outputs->stats.simulated_ms = tick;
+    outputs->stats.player_died  = game_state.entities[game_state.player.entity].hp == 0;
+    write_simulation_stats(outputs->stats_file, SIMULATION_TIMESTEP_MS, &outputs->stats);
+  }
 }
 
-int main()
+int main(int argc, char** argv)
 {
 
   game_state.no_spawn                   = false;
@@ -3168,6 +5564,89 @@ int main()
   game_state.entity_capacity = 2;
   game_state.entities        = (Entity*)sta_allocate_struct(Entity, game_state.entity_capacity);
 
+  for (i32 i = 1; i + 1 < argc; i++)
+  {
+    if (compare_strings(argv[i], "--log-level") && !parse_logging_level(&logger.level, argv[i + 1]))
+    {
+      logger.error("Unknown log level '%s', expected info, warning or error", argv[i + 1]);
+      return 1;
+    }
+  }
+  logger.start_async();
+
+  u32 path_budget  = DEFAULT_PATH_BUDGET;
+  u32 path_threads = MIN(get_worker_thread_count(), DEFAULT_PATH_THREADS);
+  for (i32 i = 1; i < argc; i++)
+  {
+    // enemies walk funnelled navmesh paths instead of tile by tile, in both modes
+    if (compare_strings(argv[i], "--navmesh"))
+    {
+      game_state.navmesh_paths = true;
+    }
+    // search the cluster graph before the tiles, maps big enough turn this on by themselves
+    else if (compare_strings(argv[i], "--hpa"))
+    {
+      game_state.hierarchical_paths = true;
+    }
+    // enemies walk through each other like they used to
+    else if (compare_strings(argv[i], "--no-crowd"))
+    {
+      game_state.no_crowd = true;
+    }
+    // tiles the grid search may expand per update, spread over however many paths that covers
+    else if (compare_strings(argv[i], "--path-budget") && i + 1 < argc)
+    {
+      i32 budget  = atoi(argv[++i]);
+      path_budget = MAX(budget, 1);
+    }
+    // 0 keeps every search on the main thread, spread out by the budget above
+    else if (compare_strings(argv[i], "--path-threads") && i + 1 < argc)
+    {
+      i32 threads  = atoi(argv[++i]);
+      path_threads = CLAMP(threads, 0, WORK_QUEUE_MAX_THREADS);
+    }
+  }
+  init_path_scheduler(path_budget, path_threads);
+
+  for (i32 i = 1; i < argc; i++)
+  {
+    if (compare_strings(argv[i], "--bench-parse"))
+    {
+      bench_parse_numbers(&argv[i + 1], argc - i - 1, 20);
+      return 0;
+    }
+    if (compare_strings(argv[i], "--bench-targa"))
+    {
+      bench_decode_targa(&argv[i + 1], argc - i - 1, 50);
+      return 0;
+    }
+    if (compare_strings(argv[i], "--bench-triangulate"))
+    {
+      bench_triangulate();
+      return 0;
+    }
+    if (compare_strings(argv[i], "--bench-hpa"))
+    {
+      bench_hpa();
+      return 0;
+    }
+    if (compare_strings(argv[i], "--bench-crowd"))
+    {
+      bench_crowd();
+      return 0;
+    }
+    if (compare_strings(argv[i], "--cook-textures"))
+    {
+      return cook_textures("./data/formats/textures.json") ? 0 : 1;
+    }
+  }
+
+  HeadlessOptions headless_options;
+  if (parse_headless_options(&headless_options, argc, argv))
+  {
+    return run_headless(&headless_options);
+  }
+
   const int screen_width = 620, screen_height = 480;
   game_state.renderer = Renderer(screen_width, screen_height, &logger, true);
 
@@ -3179,6 +5658,7 @@ int main()
   }
 
   game_state.renderer.init_depth_texture();
+  game_state.renderer.init_gpu_timers();
   game_state.projection.perspective(45.0f, screen_width / (f32)screen_height, 0.01f, 100.0f);
 
   init_imgui(game_state.renderer.window, game_state.renderer.context);
@@ -3189,6 +5669,58 @@ int main()
   u32     map_texture = game_state.renderer.get_texture("dirt_texture");
 
   Vector3 point_light_position;
+  u64         seed        = sta_read_monotonic_ns();
+  const char*    record_file = 0;
+  const char*    replay_file = 0;
+  SessionOutputs outputs     = {};
+  for (i32 i = 1; i + 1 < argc; i++)
+  {
+    if (compare_strings(argv[i], "--seed"))
+    {
+      seed = strtoull(argv[i + 1], 0, 10);
+    }
+    else if (compare_strings(argv[i], "--record"))
+    {
+      record_file = argv[i + 1];
+    }
+    else if (compare_strings(argv[i], "--replay"))
+    {
+      replay_file = argv[i + 1];
+    }
+    else if (compare_strings(argv[i], "--trace"))
+    {
+      outputs.trace_file = argv[i + 1];
+    }
+    else if (compare_strings(argv[i], "--stats"))
+    {
+      outputs.stats_file = argv[i + 1];
+    }
+    else if (compare_strings(argv[i], "--font"))
+    {
+      game_state.renderer.init_text(argv[i + 1]);
+    }
+  }
+
+  InputReplay replay;
+  if (replay_file)
+  {
+    if (!replay.load(replay_file))
+    {
+      return 1;
+    }
+    if (replay.header.timestep_ms != SIMULATION_TIMESTEP_MS)
+    {
+      logger.error("Replay was recorded with a %ums timestep, this build steps at %ums", replay.header.timestep_ms, SIMULATION_TIMESTEP_MS);
+      return 1;
+    }
+    seed = replay.header.seed;
+  }
+  if (record_file && !outputs.recorder.begin(record_file, seed, SIMULATION_TIMESTEP_MS))
+  {
+    return 1;
+  }
+  seed_simulation(seed);
+  logger.info("Simulation seed %lu", seed);
   init_player(&game_state.player);
 
   // Wave wave = {};
@@ -3198,9 +5730,8 @@ int main()
   //   return 1;
   // }
 
-  u32      ticks        = 0;
-  u32      render_ticks = 0, update_ticks = 0, build_ui_ticks = 0, ms = 0, game_running_ticks = 0, clear_tick = 0, render_ui_tick = 0;
-  f32      fps      = 0.0f;
+  u32      ticks              = 0;
+  u32      game_running_ticks = 0;
 
   UI_State ui_state = UI_STATE_GAME_RUNNING;
   bool     console = false, render_circle_on_mouse = false;
@@ -3223,55 +5754,65 @@ int main()
 
   // light direction
   //
-  u32 depth_cubemap;
-  glGenTextures(1, &depth_cubemap);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, depth_cubemap);
-  for (u32 i = 0; i < 6; ++i)
-  {
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, 1024, 1024, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
-  }
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-  u32 depthMapFBO;
-  glGenFramebuffers(1, &depthMapFBO);
-  glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-  glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth_cubemap, 0);
-  glDrawBuffer(GL_NONE);
-  glReadBuffer(GL_NONE);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-  depth_cubemap = game_state.renderer.add_texture(depth_cubemap);
+  game_state.renderer.init_depth_cube_texture();
+  game_state.renderer.init_shadow_cache();
+  u32 depth_cubemap = game_state.renderer.depth_cube_texture;
 
   // Figure out where you want to place both lights, one directional and one point light
   Vector3 directional_light(-0.5, 0, -0.5);
 
-  enemy_capacity                      = 16;
-  enemies                             = sta_allocate_struct(Enemy, enemy_capacity);
-  enemy_count                         = 0;
-  CommandUpdateWave* update_wave_data = sta_allocate_struct(CommandUpdateWave, 1);
-  update_wave_data->number_of_enemies = 4;
-  add_command(CMD_UPDATE_WAVE, (void*)update_wave_data, 0);
+  init_waves();
 
+  for (i32 i = 1; i < argc; i++)
+  {
+    if (compare_strings(argv[i], "--bench-cube-shadows"))
+    {
+      u32 frames = i + 1 < argc ? atoi(argv[i + 1]) : 200;
+      bench_cube_shadows(map_buffer, map_texture, point_light_position, MAX(frames, 1));
+      return 0;
+    }
+  }
+
+  initProfiler();
+  outputs.start         = ReadCPUTimer();
+  u64 previous_frame_ns = sta_read_monotonic_ns();
+  u64 accumulator_ns    = 0;
   while (true)
   {
 
     if (ticks + 1 < SDL_GetTicks())
     {
+      beginProfileFrame();
+      game_state.renderer.begin_gpu_frame();
+      TimeBlock(input);
+
+      u64 now_ns        = sta_read_monotonic_ns();
+      u64 frame_ns      = now_ns - previous_frame_ns;
+      previous_frame_ns = now_ns;
+      if (ui_state == UI_STATE_GAME_RUNNING)
+      {
+        accumulator_ns += MIN(frame_ns, SIMULATION_TIMESTEP_NS * MAX_SIMULATION_STEPS_PER_FRAME);
+      }
+      else
+      {
+        accumulator_ns = 0;
+      }
 
-      u32 tick_difference = SDL_GetTicks() - ticks;
-      input_state.update();
+      // Only poll when a step will consume the events, SDL keeps them queued in the meantime
+      if (ui_state != UI_STATE_GAME_RUNNING || accumulator_ns >= SIMULATION_TIMESTEP_NS)
+      {
+        input_state.update();
+      }
+      else
+      {
+        input_state.clear_transient_events();
+      }
       if (input_state.should_quit())
       {
+        finish_session(&outputs, game_running_ticks);
         break;
       }
 
-      game_state.camera.z += input_state.mouse_wheel_direction * 0.1f;
-      game_state.camera.z = MAX(MIN(-1.5, game_state.camera.z), -4.5);
       if (input_state.is_key_pressed('q'))
       {
         game_state.renderer.reload_shaders();
@@ -3281,6 +5822,7 @@ int main()
       {
         // ToDo Game over
         logger.info("Game over player died");
+        finish_session(&outputs, game_running_ticks);
         return 1;
       }
       if (input_state.is_key_released('b'))
@@ -3288,6 +5830,21 @@ int main()
 
         debug_render = !debug_render;
       }
+      if (input_state.is_key_released('m'))
+      {
+        CubeShadowMode mode = (CubeShadowMode)((game_state.renderer.cube_shadow_mode + 1) % CUBE_SHADOW_MODE_COUNT);
+        if (!game_state.renderer.set_cube_shadow_mode(mode))
+        {
+          mode = (CubeShadowMode)((mode + 1) % CUBE_SHADOW_MODE_COUNT);
+          game_state.renderer.set_cube_shadow_mode(mode);
+        }
+        logger.info("Cube shadows: %s", cube_shadow_mode_name(game_state.renderer.cube_shadow_mode));
+      }
+      if (input_state.is_key_released('n') && game_state.renderer.shadow_cache.directional_framebuffer)
+      {
+        game_state.renderer.shadow_caching = !game_state.renderer.shadow_caching;
+        game_state.renderer.invalidate_shadow_cache();
+      }
       if (input_state.is_key_pressed('h'))
       {
         point_light_position.y -= 0.01f;
@@ -3297,34 +5854,74 @@ int main()
         point_light_position.y += 0.01f;
       }
 
-      u32 start_tick = SDL_GetTicks();
+      ExitBlock(input);
+
       if (ui_state == UI_STATE_GAME_RUNNING && input_state.is_key_pressed('p'))
       {
         ui_state = UI_STATE_OPTIONS_MENU;
+        endProfileFrame();
         continue;
       }
 
+      TimeBlock(clear);
       game_state.renderer.clear_framebuffer();
-      clear_tick             = SDL_GetTicks() - start_tick;
-      ui_state               = render_ui(ui_state, &game_state.player, ms, fps, update_ticks, render_ticks, game_running_ticks, screen_height, clear_tick, render_ui_tick);
-      render_ui_tick         = SDL_GetTicks() - start_tick - clear_tick;
+      ExitBlock(clear);
+
+      TimeBlock(build_ui);
+      ui_state = render_ui(ui_state, &game_state.player, game_running_ticks, screen_height);
+      ExitBlock(build_ui);
 
-      u32 prior_render_ticks = 0;
       if (ui_state == UI_STATE_GAME_RUNNING)
       {
 
-        assert(SDL_GetTicks() - ticks > 0 && "How is this possible?");
-        game_running_ticks += SDL_GetTicks() - ticks;
-
-        update(game_state.camera, &input_state, game_running_ticks, tick_difference);
+        u32 steps = 0;
+        while (accumulator_ns >= SIMULATION_TIMESTEP_NS)
+        {
+          if (steps > 0)
+          {
+            // clicks and releases belong to the first step only, held keys carry over
+            input_state.clear_transient_events();
+          }
+          if (replay_file && !replay.next(&input_state))
+          {
+            logger.info("Replay finished at tick %u, simulation state %08x", game_running_ticks, hash_simulation_state());
+            finish_session(&outputs, game_running_ticks);
+            return 0;
+          }
+          if (outputs.recorder.is_recording())
+          {
+            outputs.recorder.record(&input_state);
+          }
+          TimeBlock(simulation_step);
+          u64 update_start = ReadCPUTimer();
+          game_running_ticks += SIMULATION_TIMESTEP_MS;
+          update(game_state.camera, &input_state, game_running_ticks, SIMULATION_TIMESTEP_MS);
+          record_update_stats(&outputs.stats, ReadCPUTimer() - update_start);
+          accumulator_ns -= SIMULATION_TIMESTEP_NS;
+          steps++;
+          ExitBlock(simulation_step);
+        }
+        f32 alpha = accumulator_ns / (f32)SIMULATION_TIMESTEP_NS;
 
-        update_ticks          = SDL_GetTicks() - start_tick;
-        prior_render_ticks    = SDL_GetTicks();
+        // The camera follows the interpolated player for this frame only, the simulation reads its own translation next step
+        Vector3 simulated_translation = game_state.camera.translation;
+        Vector3 player_position       = get_interpolated_position(game_state.player.entity, alpha);
+        game_state.camera.translation = Vector3(-player_position.x, -player_position.y, 0.0f);
 
         Vector3 view_position = Vector3(-game_state.camera.translation.x, -game_state.camera.translation.y, -game_state.camera.z);
-        push_render_items(map_buffer, game_running_ticks, map_texture);
+        TimeBlock(queue_render_items);
+        push_render_items(map_buffer, game_running_ticks, map_texture, alpha);
+        ExitBlock(queue_render_items);
+
+        TimeBlock(shadows_directional);
         game_state.renderer.render_to_depth_texture_directional(directional_light);
-        game_state.renderer.render_to_depth_texture_cube(point_light_position, depthMapFBO);
+        ExitBlock(shadows_directional);
+
+        TimeBlock(shadows_cube);
+        game_state.renderer.render_to_depth_texture_cube(point_light_position);
+        ExitBlock(shadows_cube);
+
+        TimeBlock(render_scene);
 
         point_light_shader->use();
         point_light_m = Mat44::identity().scale(0.1f).translate(point_light_position);
@@ -3335,6 +5932,7 @@ int main()
         game_state.renderer.render_buffer(sphere_buffer);
 
         game_state.renderer.render_queues(game_state.camera.get_view_matrix(), view_position, game_state.projection, point_light_position, depth_cubemap, directional_light);
+        ExitBlock(render_scene);
 
         if (render_circle_on_mouse)
         {
@@ -3352,6 +5950,7 @@ int main()
           // debug_render_depth_texture();
           debug_render_depth_texture_cube(depth_cubemap);
         }
+        game_state.camera.translation = simulated_translation;
       }
 
       if (console)
@@ -3359,14 +5958,24 @@ int main()
         render_console(&game_state.player, &input_state, console_buf, ArrayCount(console_buf), game_running_ticks);
       }
 
+      TimeBlock(draw_ui);
+      game_state.renderer.begin_gpu_pass(GPU_PASS_UI);
+      if (ui_state == UI_STATE_GAME_RUNNING)
+      {
+        char score[32];
+        u32  score_length = snprintf(score, ArrayCount(score), "%d", (i32)game_state.score);
+        game_state.renderer.render_text(score, score_length, 0.95f, 0.95f, TextAlignment_End_At, TextAlignment_Start_At, WHITE, 24.0f);
+      }
+      game_state.renderer.flush_text();
       render_ui_frame();
-      render_ticks = SDL_GetTicks() - prior_render_ticks;
+      game_state.renderer.end_gpu_pass();
+      ExitBlock(draw_ui);
 
-      // since last frame
-      ms    = SDL_GetTicks() - ticks;
-      fps   = 1 / (f32)MAX(ms, 0.0001);
       ticks = SDL_GetTicks();
+      TimeBlock(swap_buffers);
       game_state.renderer.swap_buffers();
+      ExitBlock(swap_buffers);
+      endProfileFrame();
     }
   }
 }
@@ -0,0 +1,821 @@
+#include "navmesh.h"
+
+// positions closer than this are the same vertex
+#define NAVMESH_WELD_SCALE    10000.0f
+#define NAVMESH_MAX_CELLS     64
+
+static inline f32 navmesh_cross(Vector2 o, Vector2 a, Vector2 b)
+{
+  return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+// either winding, points on an edge count as inside
+static inline bool navmesh_point_in_triangle(Vector2 a, Vector2 b, Vector2 c, Vector2 p)
+{
+  f32 d0 = navmesh_cross(a, b, p);
+  f32 d1 = navmesh_cross(b, c, p);
+  f32 d2 = navmesh_cross(c, a, p);
+  return !((d0 < 0 || d1 < 0 || d2 < 0) && (d0 > 0 || d1 > 0 || d2 > 0));
+}
+
+static inline bool navmesh_same_point(Vector2 a, Vector2 b)
+{
+  return a.x == b.x && a.y == b.y;
+}
+
+static inline f32 navmesh_distance(Vector2 a, Vector2 b)
+{
+  return sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+
+struct NavMeshWeld
+{
+  u32*     slots;
+  u32      mask;
+  i32*     keys;
+  Vector2* positions;
+  u32      count;
+};
+
+static void init_navmesh_weld(NavMeshWeld* weld, u32 capacity)
+{
+  u32 slot_count = 16;
+  while (slot_count < capacity * 2)
+  {
+    slot_count *= 2;
+  }
+  weld->slots     = sta_allocate_struct(u32, slot_count);
+  weld->mask      = slot_count - 1;
+  weld->keys      = sta_allocate_struct(i32, capacity * 2);
+  weld->positions = sta_allocate_struct(Vector2, capacity);
+  weld->count     = 0;
+}
+
+static void free_navmesh_weld(NavMeshWeld* weld, u32 capacity)
+{
+  sta_deallocate(weld->slots, sizeof(u32) * (weld->mask + 1));
+  sta_deallocate(weld->keys, sizeof(i32) * capacity * 2);
+}
+
+static u32 weld_navmesh_vertex(NavMeshWeld* weld, Vector2 p)
+{
+  i32    key[2] = {(i32)lroundf(p.x * NAVMESH_WELD_SCALE), (i32)lroundf(p.y * NAVMESH_WELD_SCALE)};
+  String key_string((char*)key, sizeof(key));
+  u32    slot = sta_hash_string_fnv(&key_string) & weld->mask;
+  while (weld->slots[slot] != 0)
+  {
+    u32 index = weld->slots[slot] - 1;
+    if (weld->keys[index * 2] == key[0] && weld->keys[index * 2 + 1] == key[1])
+    {
+      return index;
+    }
+    slot = (slot + 1) & weld->mask;
+  }
+  u32 index                 = weld->count++;
+  weld->keys[index * 2]     = key[0];
+  weld->keys[index * 2 + 1] = key[1];
+  weld->positions[index]    = p;
+  weld->slots[slot]         = index + 1;
+  return index;
+}
+
+// Undirected edge -> the first directed edge (triangle * 3 + corner) that used it
+struct NavMeshEdgeTable
+{
+  u64* keys;
+  u32* values;
+  u32  mask;
+};
+
+static void init_navmesh_edge_table(NavMeshEdgeTable* table, u32 edge_count)
+{
+  u32 slot_count = 16;
+  while (slot_count < edge_count * 2)
+  {
+    slot_count *= 2;
+  }
+  table->keys   = sta_allocate_struct(u64, slot_count);
+  table->values = sta_allocate_struct(u32, slot_count);
+  table->mask   = slot_count - 1;
+}
+
+static void free_navmesh_edge_table(NavMeshEdgeTable* table)
+{
+  sta_deallocate(table->keys, sizeof(u64) * (table->mask + 1));
+  sta_deallocate(table->values, sizeof(u32) * (table->mask + 1));
+}
+
+// Returns the slot for the edge a-b, values is 0 if nobody has used it yet
+static u32 find_navmesh_edge(NavMeshEdgeTable* table, u32 a, u32 b)
+{
+  u64    key = ((u64)MIN(a, b) << 32) | MAX(a, b);
+  String key_string((char*)&key, sizeof(key));
+  u32    slot = sta_hash_string_fnv(&key_string) & table->mask;
+  while (table->values[slot] != 0 && table->keys[slot] != key)
+  {
+    slot = (slot + 1) & table->mask;
+  }
+  table->keys[slot] = key;
+  return slot;
+}
+
+static int compare_navmesh_points(const void* _a, const void* _b)
+{
+  Vector2* a = (Vector2*)_a;
+  Vector2* b = (Vector2*)_b;
+  if (a->x != b->x)
+  {
+    return a->x < b->x ? -1 : 1;
+  }
+  return a->y < b->y ? -1 : a->y > b->y ? 1 : 0;
+}
+
+// Monotone chain, sorts points in place and writes the hull counter clockwise into hull
+static u32 convex_hull(Vector2* points, u32 count, Vector2* hull)
+{
+  qsort(points, count, sizeof(Vector2), compare_navmesh_points);
+  u32 k = 0;
+  for (u32 i = 0; i < count; i++)
+  {
+    while (k >= 2 && navmesh_cross(hull[k - 2], hull[k - 1], points[i]) <= 0)
+    {
+      k--;
+    }
+    hull[k++] = points[i];
+  }
+  for (i32 i = count - 2, lower = k + 1; i >= 0; i--)
+  {
+    while ((i32)k >= lower && navmesh_cross(hull[k - 2], hull[k - 1], points[i]) <= 0)
+    {
+      k--;
+    }
+    hull[k++] = points[i];
+  }
+  // the last point is the first one again
+  return k > 0 ? k - 1 : 0;
+}
+
+static bool is_on_floor(Vector2* vertices, u32* triangles, u32 triangle_count, Vector2 p)
+{
+  for (u32 i = 0; i < triangle_count; i++)
+  {
+    if (navmesh_point_in_triangle(vertices[triangles[i * 3]], vertices[triangles[i * 3 + 1]], vertices[triangles[i * 3 + 2]], p))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static f32 ring_area(Vector2* points, u32 count)
+{
+  f32 area = 0;
+  for (u32 i = 0, j = count - 1; i < count; j = i++)
+  {
+    area += (points[j].x + points[i].x) * (points[j].y - points[i].y);
+  }
+  return area * 0.5f;
+}
+
+// Boundary edges of the floor are the ones only a single triangle uses, following them gives the
+// outline and the holes already in the map
+static u32 get_floor_outlines(Vector2*** out_rings, u32** out_counts, Vector2* vertices, u32 vertex_count, u32* triangles, u32 triangle_count)
+{
+  NavMeshEdgeTable edges;
+  init_navmesh_edge_table(&edges, triangle_count * 3);
+  u32* uses = sta_allocate_struct(u32, triangle_count * 3);
+  for (u32 i = 0; i < triangle_count * 3; i++)
+  {
+    u32 a    = triangles[i];
+    u32 b    = triangles[i % 3 == 2 ? i - 2 : i + 1];
+    u32 slot = find_navmesh_edge(&edges, a, b);
+    if (edges.values[slot] == 0)
+    {
+      edges.values[slot] = i + 1;
+    }
+    uses[edges.values[slot] - 1]++;
+  }
+
+  i32* next = sta_allocate_struct(i32, vertex_count);
+  memset(next, -1, sizeof(i32) * vertex_count);
+  u32 boundary_count = 0;
+  for (u32 i = 0; i < triangle_count * 3; i++)
+  {
+    u32 a    = triangles[i];
+    u32 b    = triangles[i % 3 == 2 ? i - 2 : i + 1];
+    u32 slot = find_navmesh_edge(&edges, a, b);
+    if (uses[edges.values[slot] - 1] == 1)
+    {
+      next[a] = b;
+      boundary_count++;
+    }
+  }
+
+  // every ring takes at least three boundary edges
+  Vector2** rings      = sta_allocate_struct(Vector2*, triangle_count + 1);
+  u32*      counts     = sta_allocate_struct(u32, triangle_count + 1);
+  u32       ring_count = 0;
+  Vector2*  ring       = sta_allocate_struct(Vector2, boundary_count);
+  for (u32 start = 0; start < vertex_count; start++)
+  {
+    if (next[start] < 0)
+    {
+      continue;
+    }
+    u32 count = 0;
+    i32 v     = start;
+    while (next[v] >= 0 && count < boundary_count)
+    {
+      ring[count++] = vertices[v];
+      i32 following = next[v];
+      next[v]       = -1;
+      v             = following;
+    }
+    if (count >= 3)
+    {
+      rings[ring_count] = sta_allocate_struct(Vector2, count);
+      memcpy(rings[ring_count], ring, sizeof(Vector2) * count);
+      counts[ring_count++] = count;
+    }
+  }
+  sta_deallocate(ring, sizeof(Vector2) * boundary_count);
+
+  // the largest one is the outline, triangulate_polygon_with_holes wants it first
+  for (u32 i = 1; i < ring_count; i++)
+  {
+    if (std::abs(ring_area(rings[i], counts[i])) > std::abs(ring_area(rings[0], counts[0])))
+    {
+      Vector2* ring = rings[0];
+      u32      c    = counts[0];
+      rings[0]      = rings[i];
+      counts[0]     = counts[i];
+      rings[i]      = ring;
+      counts[i]     = c;
+    }
+  }
+
+  sta_deallocate(next, sizeof(i32) * vertex_count);
+  sta_deallocate(uses, sizeof(u32) * triangle_count * 3);
+  free_navmesh_edge_table(&edges);
+
+  *out_rings  = rings;
+  *out_counts = counts;
+  return ring_count;
+}
+
+static void build_navmesh_grid(NavMesh* mesh)
+{
+  mesh->min = mesh->vertices[0];
+  mesh->max = mesh->vertices[0];
+  for (u32 i = 1; i < mesh->vertex_count; i++)
+  {
+    mesh->min.x = MIN(mesh->min.x, mesh->vertices[i].x);
+    mesh->min.y = MIN(mesh->min.y, mesh->vertices[i].y);
+    mesh->max.x = MAX(mesh->max.x, mesh->vertices[i].x);
+    mesh->max.y = MAX(mesh->max.y, mesh->vertices[i].y);
+  }
+  mesh->cells_per_row   = CLAMP((u32)sqrtf(mesh->triangle_count), 1, NAVMESH_MAX_CELLS);
+  mesh->inv_cell_width  = mesh->cells_per_row / MAX(mesh->max.x - mesh->min.x, 1e-6f);
+  mesh->inv_cell_height = mesh->cells_per_row / MAX(mesh->max.y - mesh->min.y, 1e-6f);
+
+  // counted first so every cell's triangles end up next to each other
+  u32 cell_count        = mesh->cells_per_row * mesh->cells_per_row;
+  mesh->cell_offsets    = sta_allocate_struct(u32, cell_count + 1);
+  u32 total             = 0;
+  for (u32 pass = 0; pass < 2; pass++)
+  {
+    for (u32 t = 0; t < mesh->triangle_count; t++)
+    {
+      Vector2 a      = mesh->vertices[mesh->indices[t * 3]];
+      Vector2 b      = mesh->vertices[mesh->indices[t * 3 + 1]];
+      Vector2 c      = mesh->vertices[mesh->indices[t * 3 + 2]];
+      u32     min_cx = CLAMP((i32)((MIN(MIN(a.x, b.x), c.x) - mesh->min.x) * mesh->inv_cell_width), 0, (i32)mesh->cells_per_row - 1);
+      u32     max_cx = CLAMP((i32)((MAX(MAX(a.x, b.x), c.x) - mesh->min.x) * mesh->inv_cell_width), 0, (i32)mesh->cells_per_row - 1);
+      u32     min_cy = CLAMP((i32)((MIN(MIN(a.y, b.y), c.y) - mesh->min.y) * mesh->inv_cell_height), 0, (i32)mesh->cells_per_row - 1);
+      u32     max_cy = CLAMP((i32)((MAX(MAX(a.y, b.y), c.y) - mesh->min.y) * mesh->inv_cell_height), 0, (i32)mesh->cells_per_row - 1);
+      for (u32 cy = min_cy; cy <= max_cy; cy++)
+      {
+        for (u32 cx = min_cx; cx <= max_cx; cx++)
+        {
+          u32 cell = cy * mesh->cells_per_row + cx;
+          if (pass == 0)
+          {
+            mesh->cell_offsets[cell + 1]++;
+            total++;
+          }
+          else
+          {
+            mesh->cell_triangles[mesh->cell_offsets[cell]++] = t;
+          }
+        }
+      }
+    }
+    if (pass == 0)
+    {
+      for (u32 i = 0; i < cell_count; i++)
+      {
+        mesh->cell_offsets[i + 1] += mesh->cell_offsets[i];
+      }
+      mesh->cell_triangles = sta_allocate_struct(u32, total);
+    }
+  }
+  // filling moved every offset to the start of the next cell
+  for (u32 i = cell_count; i > 0; i--)
+  {
+    mesh->cell_offsets[i] = mesh->cell_offsets[i - 1];
+  }
+  mesh->cell_offsets[0] = 0;
+}
+
+// The triangulator drops collinear points, so a vertex can end up in the middle of another triangle's
+// edge where the hole bridges were. Those edges never match up, splitting the triangle at the vertex
+// gives both sides the same edges again
+static void split_t_junctions(Vector2* vertices, u32 vertex_count, u32*& indices, u32& triangle_count, u32& index_capacity)
+{
+  bool split = true;
+  while (split)
+  {
+    split = false;
+    NavMeshEdgeTable edges;
+    init_navmesh_edge_table(&edges, triangle_count * 3);
+    for (u32 i = 0; i < triangle_count * 3; i++)
+    {
+      u32 slot = find_navmesh_edge(&edges, indices[i], indices[i % 3 == 2 ? i - 2 : i + 1]);
+      edges.values[slot]++;
+    }
+
+    u32 count = triangle_count;
+    for (u32 t = 0; t < count; t++)
+    {
+      bool split_this = false;
+      for (u32 e = 0; e < 3 && !split_this; e++)
+      {
+        u32 a = indices[t * 3 + e];
+        u32 b = indices[t * 3 + (e + 1) % 3];
+        if (edges.values[find_navmesh_edge(&edges, a, b)] != 1)
+        {
+          continue;
+        }
+        Vector2 p      = vertices[a];
+        Vector2 q      = vertices[b];
+        f32     length = navmesh_distance(p, q);
+        for (u32 v = 0; v < vertex_count; v++)
+        {
+          if (v == a || v == b)
+          {
+            continue;
+          }
+          f32 along = ((vertices[v].x - p.x) * (q.x - p.x) + (vertices[v].y - p.y) * (q.y - p.y)) / (length * length);
+          if (along <= 0.0f || along >= 1.0f || std::abs(navmesh_cross(p, q, vertices[v])) > 1e-5f * length)
+          {
+            continue;
+          }
+          // (a, b, c) becomes (a, v, c) and (v, b, c)
+          RESIZE_ARRAY(indices, u32, triangle_count * 3 + 3, index_capacity);
+          u32 c                             = indices[t * 3 + (e + 2) % 3];
+          indices[t * 3 + (e + 1) % 3]      = v;
+          indices[triangle_count * 3]       = v;
+          indices[triangle_count * 3 + 1]   = b;
+          indices[triangle_count * 3 + 2]   = c;
+          triangle_count++;
+          split      = true;
+          split_this = true;
+          break;
+        }
+      }
+    }
+    free_navmesh_edge_table(&edges);
+  }
+}
+
+bool build_navmesh(NavMesh* mesh, Vector2* vertices, u32* indices, u32 index_count, Vector2** obstacles, u32* obstacle_counts, u32 obstacle_count)
+{
+  *mesh = {};
+
+  // the floor's vertices are split wherever normals or uvs differ, only positions matter here
+  NavMeshWeld weld;
+  init_navmesh_weld(&weld, index_count);
+  u32* floor_triangles = sta_allocate_struct(u32, index_count);
+  u32  floor_count     = 0;
+  for (u32 i = 0; i + 2 < index_count; i += 3)
+  {
+    u32 a = weld_navmesh_vertex(&weld, vertices[indices[i]]);
+    u32 b = weld_navmesh_vertex(&weld, vertices[indices[i + 1]]);
+    u32 c = weld_navmesh_vertex(&weld, vertices[indices[i + 2]]);
+    if (a == b || b == c || a == c || navmesh_cross(weld.positions[a], weld.positions[b], weld.positions[c]) == 0)
+    {
+      continue;
+    }
+    floor_triangles[floor_count * 3]     = a;
+    floor_triangles[floor_count * 3 + 1] = b;
+    floor_triangles[floor_count * 3 + 2] = c;
+    floor_count++;
+  }
+  free_navmesh_weld(&weld, index_count);
+
+  Vector2** outlines;
+  u32*      outline_counts;
+  u32       outline_count    = get_floor_outlines(&outlines, &outline_counts, weld.positions, weld.count, floor_triangles, floor_count);
+  u32       outline_capacity = floor_count + 1;
+  if (outline_count == 0)
+  {
+    sta_deallocate(outlines, sizeof(Vector2*) * outline_capacity);
+    sta_deallocate(outline_counts, sizeof(u32) * outline_capacity);
+    sta_deallocate(floor_triangles, sizeof(u32) * index_count);
+    sta_deallocate(weld.positions, sizeof(Vector2) * index_count);
+    return false;
+  }
+
+  u32       ring_count = outline_count;
+  Vector2** rings      = sta_allocate_struct(Vector2*, outline_count + obstacle_count);
+  u32*      counts     = sta_allocate_struct(u32, outline_count + obstacle_count);
+  for (u32 i = 0; i < outline_count; i++)
+  {
+    rings[i]  = outlines[i];
+    counts[i] = outline_counts[i];
+  }
+  for (u32 i = 0; i < obstacle_count; i++)
+  {
+    Vector2* points = sta_allocate_struct(Vector2, obstacle_counts[i]);
+    Vector2* hull   = sta_allocate_struct(Vector2, obstacle_counts[i] + 1);
+    memcpy(points, obstacles[i], sizeof(Vector2) * obstacle_counts[i]);
+    u32  hull_count = convex_hull(points, obstacle_counts[i], hull);
+    sta_deallocate(points, sizeof(Vector2) * obstacle_counts[i]);
+
+    // cutting out something that overlaps the outline or another hole would need polygon clipping
+    bool on_floor = hull_count >= 3;
+    for (u32 j = 0; j < hull_count && on_floor; j++)
+    {
+      on_floor = is_on_floor(weld.positions, floor_triangles, floor_count, hull[j]);
+    }
+    if (!on_floor)
+    {
+      mesh->skipped_obstacles++;
+      sta_deallocate(hull, sizeof(Vector2) * (obstacle_counts[i] + 1));
+      continue;
+    }
+    rings[ring_count] = sta_allocate_struct(Vector2, hull_count);
+    memcpy(rings[ring_count], hull, sizeof(Vector2) * hull_count);
+    counts[ring_count++] = hull_count;
+    sta_deallocate(hull, sizeof(Vector2) * (obstacle_counts[i] + 1));
+  }
+
+  Triangle* triangles;
+  u32       triangle_count;
+  triangulate_polygon_with_holes(&triangles, triangle_count, rings, counts, ring_count);
+
+  // corners are exact copies of the ring points so welding them gives shared indices back
+  NavMeshWeld mesh_weld;
+  init_navmesh_weld(&mesh_weld, triangle_count * 3);
+  u32  index_capacity = triangle_count * 3;
+  u32* corners        = sta_allocate_struct(u32, index_capacity);
+  for (u32 t = 0; t < triangle_count; t++)
+  {
+    for (u32 corner = 0; corner < 3; corner++)
+    {
+      corners[t * 3 + corner] = weld_navmesh_vertex(&mesh_weld, triangles[t].points[corner]);
+    }
+  }
+  free_navmesh_weld(&mesh_weld, triangle_count * 3);
+  mesh->vertices     = mesh_weld.positions;
+  mesh->vertex_count = mesh_weld.count;
+  split_t_junctions(mesh->vertices, mesh->vertex_count, corners, triangle_count, index_capacity);
+
+  mesh->triangle_count = triangle_count;
+  mesh->indices        = corners;
+  mesh->neighbours     = sta_allocate_struct(i32, triangle_count * 3);
+  mesh->centers        = sta_allocate_struct(Vector2, triangle_count);
+  for (u32 t = 0; t < triangle_count; t++)
+  {
+    Vector2 a        = mesh->vertices[corners[t * 3]];
+    Vector2 b        = mesh->vertices[corners[t * 3 + 1]];
+    Vector2 c        = mesh->vertices[corners[t * 3 + 2]];
+    mesh->centers[t] = Vector2((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f);
+  }
+
+  NavMeshEdgeTable edges;
+  init_navmesh_edge_table(&edges, triangle_count * 3);
+  for (u32 i = 0; i < triangle_count * 3; i++)
+  {
+    mesh->neighbours[i] = -1;
+    u32 slot            = find_navmesh_edge(&edges, corners[i], corners[i % 3 == 2 ? i - 2 : i + 1]);
+    if (edges.values[slot] == 0)
+    {
+      edges.values[slot] = i + 1;
+    }
+    else
+    {
+      u32 other               = edges.values[slot] - 1;
+      mesh->neighbours[i]     = other / 3;
+      mesh->neighbours[other] = i / 3;
+    }
+  }
+  free_navmesh_edge_table(&edges);
+
+  build_navmesh_grid(mesh);
+
+  u32 total_count = 0;
+  for (u32 i = 0; i < ring_count; i++)
+  {
+    total_count += counts[i];
+  }
+  sta_deallocate(triangles, sizeof(Triangle) * (total_count + ring_count * 2));
+  for (u32 i = 0; i < ring_count; i++)
+  {
+    sta_deallocate(rings[i], sizeof(Vector2) * counts[i]);
+  }
+  sta_deallocate(outlines, sizeof(Vector2*) * outline_capacity);
+  sta_deallocate(outline_counts, sizeof(u32) * outline_capacity);
+  sta_deallocate(rings, sizeof(Vector2*) * (outline_count + obstacle_count));
+  sta_deallocate(counts, sizeof(u32) * (outline_count + obstacle_count));
+  sta_deallocate(floor_triangles, sizeof(u32) * index_count);
+  sta_deallocate(weld.positions, sizeof(Vector2) * index_count);
+  return true;
+}
+
+void init_navmesh_query(NavMeshQuery* query, NavMesh* mesh)
+{
+  u32 count            = mesh->triangle_count;
+  query->costs         = sta_allocate_struct(f32, count);
+  query->parents       = sta_allocate_struct(i32, count);
+  query->entries       = sta_allocate_struct(Vector2, count);
+  query->generations   = sta_allocate_struct(u32, count);
+  query->generation    = 0;
+  // triangles get pushed again whenever a cheaper way in turns up, grows past this when needed
+  query->heap_capacity = count * 3 + 1;
+  query->heap          = sta_allocate_struct(NavMeshHeapEntry, query->heap_capacity);
+  query->heap_count    = 0;
+  query->corridor      = sta_allocate_struct(u32, count);
+  query->portals       = sta_allocate_struct(Vector2, (count + 1) * 2);
+  query->capacity      = count;
+}
+
+i32 navmesh_find_triangle(NavMesh* mesh, Vector2 position)
+{
+  i32 cx = (i32)((position.x - mesh->min.x) * mesh->inv_cell_width);
+  i32 cy = (i32)((position.y - mesh->min.y) * mesh->inv_cell_height);
+  if (cx >= 0 && cy >= 0 && cx < (i32)mesh->cells_per_row && cy < (i32)mesh->cells_per_row)
+  {
+    u32 cell = cy * mesh->cells_per_row + cx;
+    for (u32 i = mesh->cell_offsets[cell]; i < mesh->cell_offsets[cell + 1]; i++)
+    {
+      u32 t = mesh->cell_triangles[i];
+      if (navmesh_point_in_triangle(mesh->vertices[mesh->indices[t * 3]], mesh->vertices[mesh->indices[t * 3 + 1]], mesh->vertices[mesh->indices[t * 3 + 2]], position))
+      {
+        return t;
+      }
+    }
+  }
+
+  // off the mesh, usually pushed into a wall by a collision, go from the closest triangle instead
+  i32 closest          = -1;
+  f32 closest_distance = FLT_MAX;
+  for (u32 t = 0; t < mesh->triangle_count; t++)
+  {
+    f32 distance = navmesh_distance(mesh->centers[t], position);
+    if (distance < closest_distance)
+    {
+      closest          = t;
+      closest_distance = distance;
+    }
+  }
+  return closest;
+}
+
+static void navmesh_heap_push(NavMeshQuery* query, NavMeshHeapEntry entry)
+{
+  RESIZE_ARRAY(query->heap, NavMeshHeapEntry, query->heap_count, query->heap_capacity);
+  u32 idx = query->heap_count++;
+  while (idx > 0)
+  {
+    u32 parent = (idx - 1) / 2;
+    if (query->heap[parent].estimate <= entry.estimate)
+    {
+      break;
+    }
+    query->heap[idx] = query->heap[parent];
+    idx              = parent;
+  }
+  query->heap[idx] = entry;
+}
+
+static NavMeshHeapEntry navmesh_heap_pop(NavMeshQuery* query)
+{
+  NavMeshHeapEntry out  = query->heap[0];
+  NavMeshHeapEntry last = query->heap[--query->heap_count];
+  u32              idx  = 0;
+  while (true)
+  {
+    u32 child = idx * 2 + 1;
+    if (child >= query->heap_count)
+    {
+      break;
+    }
+    if (child + 1 < query->heap_count && query->heap[child + 1].estimate < query->heap[child].estimate)
+    {
+      child++;
+    }
+    if (last.estimate <= query->heap[child].estimate)
+    {
+      break;
+    }
+    query->heap[idx] = query->heap[child];
+    idx              = child;
+  }
+  if (query->heap_count > 0)
+  {
+    query->heap[idx] = last;
+  }
+  return out;
+}
+
+// Triangle corridor from start to goal, going between edge midpoints rather than centers keeps long
+// thin triangles from looking like detours
+static u32 navmesh_find_corridor(NavMesh* mesh, NavMeshQuery* query, i32 start, i32 goal, Vector2 start_position, Vector2 goal_position, f32 r)
+{
+  query->generation++;
+  if (query->generation == 0)
+  {
+    memset(query->generations, 0, sizeof(u32) * mesh->triangle_count);
+    query->generation = 1;
+  }
+  u32 generation                = query->generation;
+  query->heap_count             = 0;
+  query->costs[start]           = 0;
+  query->parents[start]         = -1;
+  query->entries[start]         = start_position;
+  query->generations[start]     = generation;
+  navmesh_heap_push(query, {navmesh_distance(start_position, goal_position), 0, (u32)start});
+
+  f32 min_width = 2.0f * r;
+  while (query->heap_count > 0)
+  {
+    NavMeshHeapEntry current = navmesh_heap_pop(query);
+    u32              t       = current.triangle;
+    if (current.cost > query->costs[t])
+    {
+      // a cheaper way here was pushed after this one
+      continue;
+    }
+    if ((i32)t == goal)
+    {
+      u32 count = 0;
+      for (i32 at = goal; at != -1; at = query->parents[at])
+      {
+        query->corridor[count++] = at;
+      }
+      for (u32 i = 0; i < count / 2; i++)
+      {
+        u32 tmp                          = query->corridor[i];
+        query->corridor[i]               = query->corridor[count - 1 - i];
+        query->corridor[count - 1 - i]   = tmp;
+      }
+      return count;
+    }
+
+    for (u32 e = 0; e < 3; e++)
+    {
+      i32 n = mesh->neighbours[t * 3 + e];
+      if (n < 0)
+      {
+        continue;
+      }
+      Vector2 a = mesh->vertices[mesh->indices[t * 3 + e]];
+      Vector2 b = mesh->vertices[mesh->indices[t * 3 + (e + 1) % 3]];
+      if (navmesh_distance(a, b) < min_width)
+      {
+        continue;
+      }
+      Vector2 entry = Vector2((a.x + b.x) * 0.5f, (a.y + b.y) * 0.5f);
+      f32     cost  = query->costs[t] + navmesh_distance(query->entries[t], entry);
+      if (query->generations[n] != generation || cost < query->costs[n])
+      {
+        query->generations[n] = generation;
+        query->costs[n]       = cost;
+        query->parents[n]     = t;
+        query->entries[n]     = entry;
+        navmesh_heap_push(query, {cost + navmesh_distance(entry, goal_position), cost, (u32)n});
+      }
+    }
+  }
+  return 0;
+}
+
+bool navmesh_find_path(NavMesh* mesh, NavMeshQuery* query, Vector2 start, Vector2 goal, f32 r, Vector2* points, u32& point_count, u32 point_capacity)
+{
+  point_count = 0;
+  i32 start_triangle = navmesh_find_triangle(mesh, start);
+  i32 goal_triangle  = navmesh_find_triangle(mesh, goal);
+  if (start_triangle < 0 || goal_triangle < 0 || point_capacity < 2)
+  {
+    return false;
+  }
+
+  u32 corridor_count = navmesh_find_corridor(mesh, query, start_triangle, goal_triangle, start, goal, r);
+  if (corridor_count == 0)
+  {
+    return false;
+  }
+
+  // the shared edge between each pair of triangles, seen from the first one a clockwise edge
+  // has its first corner on the left. Pulled in by r from both ends so the path clears the corners
+  Vector2* portals      = query->portals;
+  u32      portal_count = 0;
+  portals[0]            = start;
+  portals[1]            = start;
+  portal_count++;
+  for (u32 i = 0; i + 1 < corridor_count; i++)
+  {
+    u32 t = query->corridor[i];
+    u32 e = 0;
+    while (mesh->neighbours[t * 3 + e] != (i32)query->corridor[i + 1])
+    {
+      e++;
+    }
+    Vector2 left  = mesh->vertices[mesh->indices[t * 3 + e]];
+    Vector2 right = mesh->vertices[mesh->indices[t * 3 + (e + 1) % 3]];
+    f32     width = navmesh_distance(left, right);
+    f32     pull  = MIN(r / width, 0.5f);
+    Vector2 edge  = Vector2(right.x - left.x, right.y - left.y);
+    portals[portal_count * 2]     = Vector2(left.x + edge.x * pull, left.y + edge.y * pull);
+    portals[portal_count * 2 + 1] = Vector2(right.x - edge.x * pull, right.y - edge.y * pull);
+    portal_count++;
+  }
+  portals[portal_count * 2]     = goal;
+  portals[portal_count * 2 + 1] = goal;
+  portal_count++;
+
+  // Simple stupid funnel: keep narrowing the left and right sides, once one crosses the other
+  // the corner it crossed becomes a point on the path and the funnel restarts from there
+  Vector2 apex       = start;
+  Vector2 left       = portals[0];
+  Vector2 right      = portals[1];
+  u32     left_idx   = 0;
+  u32     right_idx  = 0;
+  points[point_count++] = start;
+  for (u32 i = 1; i < portal_count; i++)
+  {
+    Vector2 portal_left  = portals[i * 2];
+    Vector2 portal_right = portals[i * 2 + 1];
+
+    if (navmesh_cross(apex, right, portal_right) >= 0)
+    {
+      bool at_apex = navmesh_same_point(apex, right);
+      if (at_apex || navmesh_cross(apex, left, portal_right) < 0)
+      {
+        right     = portal_right;
+        right_idx = i;
+      }
+      else
+      {
+        if (point_count >= point_capacity - 1)
+        {
+          return false;
+        }
+        if (!navmesh_same_point(points[point_count - 1], left))
+        {
+          points[point_count++] = left;
+        }
+        apex                  = left;
+        right                 = apex;
+        right_idx             = left_idx;
+        i                     = left_idx;
+        continue;
+      }
+    }
+
+    if (navmesh_cross(apex, left, portal_left) <= 0)
+    {
+      bool at_apex = navmesh_same_point(apex, left);
+      if (at_apex || navmesh_cross(apex, right, portal_left) > 0)
+      {
+        left     = portal_left;
+        left_idx = i;
+      }
+      else
+      {
+        if (point_count >= point_capacity - 1)
+        {
+          return false;
+        }
+        if (!navmesh_same_point(points[point_count - 1], right))
+        {
+          points[point_count++] = right;
+        }
+        apex                  = right;
+        left                  = apex;
+        left_idx              = right_idx;
+        i                     = right_idx;
+        continue;
+      }
+    }
+  }
+  if (!navmesh_same_point(points[point_count - 1], goal))
+  {
+    points[point_count++] = goal;
+  }
+  return true;
+}
+
+#undef NAVMESH_MAX_CELLS
+#undef NAVMESH_WELD_SCALE
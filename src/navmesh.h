@@ -0,0 +1,64 @@
+#ifndef NAVMESH_H
+#define NAVMESH_H
+
+#include "collision.h"
+#include "common.h"
+#include "vector.h"
+
+// Walkable area as clockwise triangles, the map's floor with the static geometry footprints cut out.
+// neighbours[t * 3 + e] is the triangle across the edge from corner e to corner e + 1, -1 for a wall
+struct NavMesh
+{
+  Vector2* vertices;
+  u32      vertex_count;
+  u32*     indices;
+  i32*     neighbours;
+  Vector2* centers;
+  u32      triangle_count;
+
+  // uniform grid over the bounds, cell c lists cell_triangles[cell_offsets[c]..cell_offsets[c + 1]]
+  Vector2  min;
+  Vector2  max;
+  u32      cells_per_row;
+  f32      inv_cell_width, inv_cell_height;
+  u32*     cell_offsets;
+  u32*     cell_triangles;
+
+  // footprints that weren't fully on the floor and got left out
+  u32      skipped_obstacles;
+};
+
+struct NavMeshHeapEntry
+{
+  f32 estimate;
+  f32 cost;
+  u32 triangle;
+};
+
+// Scratch for one path query, costs, parents and entries are only valid where generations matches
+// generation so nothing has to be cleared between queries
+struct NavMeshQuery
+{
+  f32*              costs;
+  i32*              parents;
+  // middle of the edge the search came in through, costs are measured between these
+  Vector2*          entries;
+  u32*              generations;
+  u32               generation;
+  NavMeshHeapEntry* heap;
+  u32               heap_count;
+  u32               heap_capacity;
+  u32*              corridor;
+  Vector2*          portals;
+  u32               capacity;
+};
+
+// obstacles are point clouds, their convex hulls are cut out of the floor
+bool build_navmesh(NavMesh* mesh, Vector2* vertices, u32* indices, u32 index_count, Vector2** obstacles, u32* obstacle_counts, u32 obstacle_count);
+void init_navmesh_query(NavMeshQuery* query, NavMesh* mesh);
+i32  navmesh_find_triangle(NavMesh* mesh, Vector2 position);
+// A* over the triangles followed by the funnel algorithm, edges narrower than 2r aren't passable and
+// the path keeps r away from the corners it turns around. points starts with start and ends with goal
+bool navmesh_find_path(NavMesh* mesh, NavMeshQuery* query, Vector2 start, Vector2 goal, f32 r, Vector2* points, u32& point_count, u32 point_capacity);
+
+#endif
@@ -8,6 +8,17 @@
 #define sta_allocate_struct(strukt, size) (strukt*)linux_allocate(sizeof(strukt) * size)
 #define sta_deallocate(ptr, size) linux_deallocate(ptr, size);
 #define sta_reallocate(ptr, size, new_size) linux_reallocate(ptr, size, new_size);
+#define sta_read_monotonic_ns() linux_read_monotonic_ns()
+#define sta_sleep_ns(ns) linux_sleep_ns(ns)
+#define sta_create_thread(thread, entry, data) linux_create_thread(thread, entry, data)
+#define sta_join_thread(thread) linux_join_thread(thread)
+#define sta_get_processor_count() linux_get_processor_count()
+#define sta_create_semaphore(initial_count) linux_create_semaphore(initial_count)
+#define sta_destroy_semaphore(semaphore) linux_destroy_semaphore(semaphore)
+#define sta_wait_semaphore(semaphore) linux_wait_semaphore(semaphore)
+#define sta_post_semaphore(semaphore, count) linux_post_semaphore(semaphore, count)
+#define sta_map_file_memory(filename, size) linux_map_file(filename, size)
+#define sta_unmap_file_memory(ptr, size) linux_unmap_file(ptr, size)
 #endif
 
 
@@ -1,7 +1,13 @@
 #include "platform_linux.h"
 #include <cstdio>
 #include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 void* linux_reallocate(void* ptr, long prev_size, long new_size)
 {
@@ -30,3 +36,115 @@ bool linux_deallocate(void* ptr, long size)
 {
   return munmap(ptr, size);
 }
+
+unsigned long long linux_read_monotonic_ns()
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (unsigned long long)time.tv_sec * 1000000000ull + (unsigned long long)time.tv_nsec;
+}
+
+void linux_sleep_ns(unsigned long long ns)
+{
+  struct timespec time;
+  time.tv_sec  = ns / 1000000000ull;
+  time.tv_nsec = ns % 1000000000ull;
+  nanosleep(&time, 0);
+}
+
+bool linux_create_thread(unsigned long* thread, void* (*entry)(void*), void* data)
+{
+  pthread_t handle;
+  if (pthread_create(&handle, 0, entry, data) != 0)
+  {
+    return false;
+  }
+  *thread = (unsigned long)handle;
+  return true;
+}
+
+bool linux_join_thread(unsigned long thread)
+{
+  return pthread_join((pthread_t)thread, 0) == 0;
+}
+
+unsigned int linux_get_processor_count()
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? count : 1;
+}
+
+void* linux_create_semaphore(unsigned int initial_count)
+{
+  sem_t* semaphore = (sem_t*)linux_allocate(sizeof(sem_t));
+  sem_init(semaphore, 0, initial_count);
+  return semaphore;
+}
+
+void linux_destroy_semaphore(void* semaphore)
+{
+  sem_destroy((sem_t*)semaphore);
+  linux_deallocate(semaphore, sizeof(sem_t));
+}
+
+void linux_wait_semaphore(void* semaphore)
+{
+  while (sem_wait((sem_t*)semaphore) != 0)
+  {
+  }
+}
+
+void linux_post_semaphore(void* semaphore, unsigned int count)
+{
+  for (unsigned int i = 0; i < count; i++)
+  {
+    sem_post((sem_t*)semaphore);
+  }
+}
+
+// Reserves one page more than the file so the byte after the last one always reads as 0,
+// the parsers that scan for a terminator can then run straight over the mapping
+void* linux_map_file(const char* filename, unsigned long long* size)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+  {
+    return 0;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0)
+  {
+    close(fd);
+    return 0;
+  }
+
+  long long page_size   = sysconf(_SC_PAGESIZE);
+  long long file_size   = file_stat.st_size;
+  long long mapped_size = (file_size / page_size + 1) * page_size;
+  void*     res         = mmap(0, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (res == MAP_FAILED)
+  {
+    close(fd);
+    return 0;
+  }
+  if (file_size > 0)
+  {
+    if (mmap(res, file_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+      munmap(res, mapped_size);
+      close(fd);
+      return 0;
+    }
+    madvise(res, file_size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  *size = file_size;
+  return res;
+}
+
+bool linux_unmap_file(void* ptr, unsigned long long size)
+{
+  long long page_size = sysconf(_SC_PAGESIZE);
+  return munmap(ptr, (size / page_size + 1) * page_size) == 0;
+}
@@ -4,5 +4,16 @@
 void * linux_allocate(long size);
 bool linux_deallocate(void * ptr, long size);
 void * linux_reallocate(void * ptr, long prev_size, long new_size);
+unsigned long long linux_read_monotonic_ns();
+void linux_sleep_ns(unsigned long long ns);
+bool linux_create_thread(unsigned long * thread, void * (*entry)(void *), void * data);
+bool linux_join_thread(unsigned long thread);
+unsigned int linux_get_processor_count();
+void * linux_create_semaphore(unsigned int initial_count);
+void linux_destroy_semaphore(void * semaphore);
+void linux_wait_semaphore(void * semaphore);
+void linux_post_semaphore(void * semaphore, unsigned int count);
+void * linux_map_file(const char * filename, unsigned long long * size);
+bool linux_unmap_file(void * ptr, unsigned long long size);
 
 #endif
@@ -11,9 +11,11 @@
 void Renderer::push_render_item_static(u32 buffer, Mat44 m, u32 texture)
 {
   RenderQueueItemStatic item;
-  item.m       = m;
-  item.buffer  = buffer;
-  item.texture = texture;
+  item.m             = m;
+  item.buffer        = buffer;
+  item.texture       = texture;
+  item.static_caster = false;
+  item.effect        = false;
   RESIZE_ARRAY(this->render_queue_static_buffers, RenderQueueItemStatic, this->render_queue_static_count, this->render_queue_static_capacity);
   this->render_queue_static_buffers[this->render_queue_static_count++] = item;
 }
@@ -30,8 +32,351 @@ void Renderer::push_render_item_animated(u32 buffer, Mat44 m, Mat44* transforms,
   this->render_queue_animated_buffers[this->render_queue_animated_count++] = item;
 }
 
-void Renderer::render_to_depth_texture_cube(Vector3 light_position, u32 buffer)
+void Renderer::push_render_item_static_caster(u32 buffer, Mat44 m, u32 texture)
 {
+  this->push_render_item_static(buffer, m, texture);
+  this->render_queue_static_buffers[this->render_queue_static_count - 1].static_caster = true;
+}
+
+// Drawn after everything else in its own pass, still casts shadows like any static item
+void Renderer::push_render_item_effect(u32 buffer, Mat44 m, u32 texture)
+{
+  this->push_render_item_static(buffer, m, texture);
+  this->render_queue_static_buffers[this->render_queue_static_count - 1].effect = true;
+}
+
+u32 Renderer::hash_static_casters()
+{
+  u32 hash = 2166136261u;
+  for (u32 i = 0; i < this->render_queue_static_count; i++)
+  {
+    RenderQueueItemStatic* item = &this->render_queue_static_buffers[i];
+    if (!item->static_caster)
+    {
+      continue;
+    }
+    u8* bytes = (u8*)&item->m.m[0];
+    for (u32 j = 0; j < sizeof(item->m.m); j++)
+    {
+      hash ^= bytes[j];
+      hash *= 16777619;
+    }
+    hash ^= item->buffer;
+    hash *= 16777619;
+  }
+  return hash;
+}
+
+void Renderer::render_depth_queue_static(Shader* depth_shader, ShadowCasterFilter filter)
+{
+  for (u32 i = 0; i < this->render_queue_static_count; i++)
+  {
+    RenderQueueItemStatic item = this->render_queue_static_buffers[i];
+    if ((filter == SHADOW_CASTERS_STATIC && !item.static_caster) || (filter == SHADOW_CASTERS_DYNAMIC && item.static_caster))
+    {
+      continue;
+    }
+    depth_shader->set_mat4("model", item.m);
+    this->render_buffer(item.buffer);
+  }
+}
+
+void Renderer::render_depth_queue_animated(Shader* depth_shader)
+{
+  for (u32 i = 0; i < this->render_queue_animated_count; i++)
+  {
+    RenderQueueItemAnimated item = this->render_queue_animated_buffers[i];
+    depth_shader->set_mat4("model", item.m);
+    depth_shader->set_mat4("jointTransforms", item.transforms, item.joint_count);
+
+    this->render_buffer(item.buffer);
+  }
+}
+
+void Renderer::invalidate_shadow_cache()
+{
+  this->shadow_cache.directional_valid = false;
+  this->shadow_cache.cube_valid        = false;
+}
+
+const char* cube_shadow_mode_name(CubeShadowMode mode)
+{
+  const char* names[CUBE_SHADOW_MODE_COUNT] = {
+      "geometry shader",
+      "per face",
+      "layered instanced",
+  };
+  return names[mode];
+}
+
+const char* gpu_pass_name(GpuPass pass)
+{
+  const char* names[GPU_PASS_COUNT] = {
+      "depth_directional", "depth_cube", "static", "animated", "effects", "ui",
+  };
+  return names[pass];
+}
+
+void Renderer::init_gpu_timers()
+{
+  GpuTimers* timers   = &this->gpu_timers;
+  *timers             = {};
+  timers->active_pass = -1;
+  timers->enabled     = sta_gl_has_timer_query();
+  if (!timers->enabled)
+  {
+    this->logger->warning("No timer queries, GPU pass timings are disabled");
+    return;
+  }
+  sta_glGenQueries(GPU_TIMER_LATENCY * GPU_PASS_COUNT, &timers->queries[0][0]);
+}
+
+// Collects whatever finished from the oldest slot and reuses it for this frame,
+// results that aren't available yet are dropped rather than waited on
+void Renderer::begin_gpu_frame()
+{
+  GpuTimers* timers = &this->gpu_timers;
+  if (!timers->enabled)
+  {
+    return;
+  }
+  timers->slot = (timers->slot + 1) % GPU_TIMER_LATENCY;
+  for (u32 pass = 0; pass < GPU_PASS_COUNT; pass++)
+  {
+    if (!timers->issued[timers->slot][pass])
+    {
+      continue;
+    }
+    GLuint query     = timers->queries[timers->slot][pass];
+    GLint  available = 0;
+    sta_glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+    {
+      timers->missed++;
+      continue;
+    }
+    GLuint64 ns = 0;
+    sta_glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+    timers->last_ms[pass] = ns / 1000000.0;
+    timers->total_ms[pass] += timers->last_ms[pass];
+    timers->sample_count[pass]++;
+  }
+  memset(timers->issued[timers->slot], 0, sizeof(timers->issued[timers->slot]));
+}
+
+// GL_TIME_ELAPSED queries can't nest, so a pass started while another is active is skipped
+void Renderer::begin_gpu_pass(GpuPass pass)
+{
+  GpuTimers* timers = &this->gpu_timers;
+  if (!timers->enabled || timers->active_pass != -1 || timers->issued[timers->slot][pass])
+  {
+    return;
+  }
+  sta_glBeginQuery(GL_TIME_ELAPSED, timers->queries[timers->slot][pass]);
+  timers->issued[timers->slot][pass] = true;
+  timers->active_pass                = pass;
+}
+
+void Renderer::end_gpu_pass()
+{
+  GpuTimers* timers = &this->gpu_timers;
+  if (!timers->enabled || timers->active_pass == -1)
+  {
+    return;
+  }
+  sta_glEndQuery(GL_TIME_ELAPSED);
+  timers->active_pass = -1;
+}
+
+bool Renderer::set_cube_shadow_mode(CubeShadowMode mode)
+{
+  if (mode == CUBE_SHADOW_LAYERED_INSTANCED && !this->supports_vertex_layer)
+  {
+    this->logger->warning("Can't use '%s' cube shadows, missing GL_ARB_shader_viewport_layer_array", cube_shadow_mode_name(mode));
+    return false;
+  }
+  this->cube_shadow_mode = mode;
+  this->invalidate_shadow_cache();
+  return true;
+}
+
+// Conservative bounding sphere test against the 90 degree frustum of a cube face,
+// faces are ordered +X, -X, +Y, -Y, +Z, -Z as in the shadow transforms
+bool Renderer::is_in_cube_face(u32 buffer, Mat44 m, f32 bounds_scale, Vector3 light_position, u32 face, f32 far_plane)
+{
+  GLBufferIndex* index  = &this->index_buffers[buffer];
+  Vector3        c      = index->bounds_center;
+  Vector3        center = Vector3(m.rc[0][0] * c.x + m.rc[0][1] * c.y + m.rc[0][2] * c.z + m.rc[0][3], //
+                                  m.rc[1][0] * c.x + m.rc[1][1] * c.y + m.rc[1][2] * c.z + m.rc[1][3], //
+                                  m.rc[2][0] * c.x + m.rc[2][1] * c.y + m.rc[2][2] * c.z + m.rc[2][3])
+                         .sub(light_position);
+
+  f32 scale = 0.0f;
+  for (u32 i = 0; i < 3; i++)
+  {
+    scale = MAX(scale, Vector3(m.rc[0][i], m.rc[1][i], m.rc[2][i]).len());
+  }
+  f32 radius = index->bounds_radius * scale * bounds_scale;
+
+  u32 axis   = face / 2;
+  f32 major  = (face & 1) ? -center.v[axis] : center.v[axis];
+  if (major < -radius || major - radius > far_plane)
+  {
+    return false;
+  }
+
+  // side planes are major = +-minor, their normals have length sqrt(2)
+  f32 side_radius = radius * 1.41421356f;
+  for (u32 i = 0; i < 3; i++)
+  {
+    if (i == axis)
+    {
+      continue;
+    }
+    f32 minor = center.v[i];
+    if (major - minor < -side_radius || major + minor < -side_radius)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Renderer::render_depth_cube(GLuint framebuffer, GLuint* face_framebuffers, Mat44* shadow_transforms, Vector3 light_position, f32 far_plane, ShadowCasterFilter filter, bool clear)
+{
+  bool render_animated = filter != SHADOW_CASTERS_STATIC;
+  switch (this->cube_shadow_mode)
+  {
+  case CUBE_SHADOW_GEOMETRY_SHADER:
+  {
+    sta_glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (clear)
+    {
+      glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    Shader* depth_shader = this->get_shader_by_index(this->get_shader_by_name("depth_cube"));
+    depth_shader->use();
+    depth_shader->set_vec3("lightPos", light_position);
+    depth_shader->set_mat4("shadowMatrices", shadow_transforms, 6);
+    depth_shader->set_float("far_plane", far_plane);
+    this->render_depth_queue_static(depth_shader, filter);
+
+    if (render_animated)
+    {
+      Shader* depth_animation_shader = this->get_shader_by_index(this->get_shader_by_name("depth_animation_cube"));
+      depth_animation_shader->use();
+      depth_animation_shader->set_vec3("lightPos", light_position);
+      depth_animation_shader->set_mat4("shadowMatrices", shadow_transforms, 6);
+      depth_animation_shader->set_float("far_plane", far_plane);
+      this->render_depth_queue_animated(depth_animation_shader);
+    }
+    break;
+  }
+  case CUBE_SHADOW_LAYERED_INSTANCED:
+  {
+    sta_glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (clear)
+    {
+      glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    Shader* depth_shader = this->get_shader_by_index(this->get_shader_by_name("depth_cube_layered"));
+    depth_shader->use();
+    depth_shader->set_vec3("lightPos", light_position);
+    depth_shader->set_mat4("shadowMatrices", shadow_transforms, 6);
+    depth_shader->set_float("far_plane", far_plane);
+    for (u32 i = 0; i < this->render_queue_static_count; i++)
+    {
+      RenderQueueItemStatic item = this->render_queue_static_buffers[i];
+      if ((filter == SHADOW_CASTERS_STATIC && !item.static_caster) || (filter == SHADOW_CASTERS_DYNAMIC && item.static_caster))
+      {
+        continue;
+      }
+      depth_shader->set_mat4("model", item.m);
+      this->render_buffer_instanced(item.buffer, 6);
+    }
+
+    if (render_animated)
+    {
+      Shader* depth_animation_shader = this->get_shader_by_index(this->get_shader_by_name("depth_animation_cube_layered"));
+      depth_animation_shader->use();
+      depth_animation_shader->set_vec3("lightPos", light_position);
+      depth_animation_shader->set_mat4("shadowMatrices", shadow_transforms, 6);
+      depth_animation_shader->set_float("far_plane", far_plane);
+      for (u32 i = 0; i < this->render_queue_animated_count; i++)
+      {
+        RenderQueueItemAnimated item = this->render_queue_animated_buffers[i];
+        depth_animation_shader->set_mat4("model", item.m);
+        depth_animation_shader->set_mat4("jointTransforms", item.transforms, item.joint_count);
+        this->render_buffer_instanced(item.buffer, 6);
+      }
+    }
+    break;
+  }
+  case CUBE_SHADOW_PER_FACE:
+  {
+    // skinned vertices can leave the bind pose bounds, so give them some slack
+    const f32 animated_bounds_scale  = 1.5f;
+    Shader*   depth_shader           = this->get_shader_by_index(this->get_shader_by_name("depth_cube_face"));
+    Shader*   depth_animation_shader = this->get_shader_by_index(this->get_shader_by_name("depth_animation_cube_face"));
+    for (u32 face = 0; face < 6; face++)
+    {
+      sta_glBindFramebuffer(GL_FRAMEBUFFER, face_framebuffers[face]);
+      if (clear)
+      {
+        glClear(GL_DEPTH_BUFFER_BIT);
+      }
+      depth_shader->use();
+      depth_shader->set_vec3("lightPos", light_position);
+      depth_shader->set_mat4("shadowMatrix", shadow_transforms[face]);
+      depth_shader->set_float("far_plane", far_plane);
+      for (u32 i = 0; i < this->render_queue_static_count; i++)
+      {
+        RenderQueueItemStatic item = this->render_queue_static_buffers[i];
+        if ((filter == SHADOW_CASTERS_STATIC && !item.static_caster) || (filter == SHADOW_CASTERS_DYNAMIC && item.static_caster))
+        {
+          continue;
+        }
+        if (!this->is_in_cube_face(item.buffer, item.m, 1.0f, light_position, face, far_plane))
+        {
+          this->cube_shadow_culled++;
+          continue;
+        }
+        depth_shader->set_mat4("model", item.m);
+        this->render_buffer(item.buffer);
+      }
+
+      if (render_animated)
+      {
+        depth_animation_shader->use();
+        depth_animation_shader->set_vec3("lightPos", light_position);
+        depth_animation_shader->set_mat4("shadowMatrix", shadow_transforms[face]);
+        depth_animation_shader->set_float("far_plane", far_plane);
+        for (u32 i = 0; i < this->render_queue_animated_count; i++)
+        {
+          RenderQueueItemAnimated item = this->render_queue_animated_buffers[i];
+          if (!this->is_in_cube_face(item.buffer, item.m, animated_bounds_scale, light_position, face, far_plane))
+          {
+            this->cube_shadow_culled++;
+            continue;
+          }
+          depth_animation_shader->set_mat4("model", item.m);
+          depth_animation_shader->set_mat4("jointTransforms", item.transforms, item.joint_count);
+          this->render_buffer(item.buffer);
+        }
+      }
+    }
+    break;
+  }
+  default:
+  {
+    assert(!"Unknown cube shadow mode!");
+  }
+  }
+}
+
+void Renderer::render_to_depth_texture_cube(Vector3 light_position)
+{
+  this->begin_gpu_pass(GPU_PASS_DEPTH_CUBE);
 
   Mat44 perspective = Mat44::identity();
   float far_plane   = 25.0f;
@@ -46,81 +391,90 @@ void Renderer::render_to_depth_texture_cube(Vector3 light_position, u32 buffer)
   shadow_transforms[5] = shadow_transforms[5].look_at(light_position, light_position.add(Vector3(0, 0, -1)), Vector3(0, -1, 0)).mul(perspective);
 
   this->change_viewport(this->shadow_width, this->shadow_height);
-  sta_glBindFramebuffer(GL_FRAMEBUFFER, buffer);
-  glClear(GL_DEPTH_BUFFER_BIT);
+  this->cube_shadow_culled = 0;
 
-  Shader depth_shader = *this->get_shader_by_index(this->get_shader_by_name("depth_cube"));
-  depth_shader.use();
-  depth_shader.set_vec3("lightPos", light_position);
-  depth_shader.set_mat4("shadowMatrices", shadow_transforms, 6);
-  depth_shader.set_float("far_plane", far_plane);
-
-  for (u32 i = 0; i < this->render_queue_static_count; i++)
+  if (this->shadow_caching)
   {
-    RenderQueueItemStatic item = this->render_queue_static_buffers[i];
-    depth_shader.set_mat4("model", item.m);
-    this->render_buffer(item.buffer);
-  }
+    ShadowCache* cache       = &this->shadow_cache;
+    u32          static_hash = this->hash_static_casters();
+    if (!cache->cube_valid || cache->cube_static_hash != static_hash || memcmp(&cache->point_light, &light_position, sizeof(Vector3)) != 0)
+    {
+      this->render_depth_cube(cache->cube_framebuffer, cache->cube_face_framebuffers, shadow_transforms, light_position, far_plane, SHADOW_CASTERS_STATIC, true);
 
-  Shader depth_animation_shader = *this->get_shader_by_index(this->get_shader_by_name("depth_animation_cube"));
-  depth_animation_shader.use();
-  depth_shader.set_vec3("lightPos", light_position);
-  depth_shader.set_mat4("shadowMatrices", shadow_transforms, 6);
-  depth_shader.set_float("far_plane", far_plane);
-  for (u32 i = 0; i < this->render_queue_animated_count; i++)
+      cache->point_light      = light_position;
+      cache->cube_static_hash = static_hash;
+      cache->cube_valid       = true;
+    }
+    sta_glCopyImageSubData(cache->cube_texture, GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0, this->textures[this->depth_cube_texture].id, GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0, this->shadow_width,
+                           this->shadow_height, 6);
+    this->render_depth_cube(this->shadow_cube_framebuffer, this->shadow_cube_face_framebuffers, shadow_transforms, light_position, far_plane, SHADOW_CASTERS_DYNAMIC, false);
+  }
+  else
   {
-    RenderQueueItemAnimated item = this->render_queue_animated_buffers[i];
-    depth_animation_shader.set_mat4("model", item.m);
-    depth_animation_shader.set_mat4("jointTransforms", item.transforms, item.joint_count);
-
-    this->render_buffer(item.buffer);
+    this->render_depth_cube(this->shadow_cube_framebuffer, this->shadow_cube_face_framebuffers, shadow_transforms, light_position, far_plane, SHADOW_CASTERS_ALL, true);
   }
 
   sta_glBindFramebuffer(GL_FRAMEBUFFER, 0);
   this->reset_viewport_to_screen_size();
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  this->end_gpu_pass();
 }
 
 void Renderer::render_to_depth_texture_directional(Vector3 light_direction)
 {
+  this->begin_gpu_pass(GPU_PASS_DEPTH_DIRECTIONAL);
 
   glCullFace(GL_FRONT);
   this->change_viewport(this->shadow_width, this->shadow_height);
-  sta_glBindFramebuffer(GL_FRAMEBUFFER, this->shadow_map_framebuffer);
-  glClear(GL_DEPTH_BUFFER_BIT);
 
-  light_direction.scale(-10);
-  Mat44 l                  = Mat44::look_at(light_direction, Vector3(0, 0, 0), Vector3(0, 1, 0));
+  Vector3 light_position = light_direction;
+  light_position.scale(-10);
+  Mat44 l                  = Mat44::look_at(light_position, Vector3(0, 0, 0), Vector3(0, 1, 0));
   Mat44 o                  = Mat44::orthographic(-5.0f, 5.0f, -5.0f, 5.0f, 1.0f, 7.5f);
   this->light_space_matrix = l.mul(o);
 
-  Shader depth_shader      = *this->get_shader_by_index(this->get_shader_by_name("depth"));
-  depth_shader.use();
-  depth_shader.set_mat4("lightSpaceMatrix", this->light_space_matrix);
-
-  for (u32 i = 0; i < this->render_queue_static_count; i++)
+  Shader*            depth_shader = this->get_shader_by_index(this->get_shader_by_name("depth"));
+  ShadowCasterFilter filter       = SHADOW_CASTERS_ALL;
+  if (this->shadow_caching)
   {
-    RenderQueueItemStatic item = this->render_queue_static_buffers[i];
-    depth_shader.set_mat4("model", item.m);
-    this->render_buffer(item.buffer);
+    ShadowCache* cache       = &this->shadow_cache;
+    u32          static_hash = this->hash_static_casters();
+    if (!cache->directional_valid || cache->directional_static_hash != static_hash || memcmp(&cache->directional_light, &light_direction, sizeof(Vector3)) != 0)
+    {
+      sta_glBindFramebuffer(GL_FRAMEBUFFER, cache->directional_framebuffer);
+      glClear(GL_DEPTH_BUFFER_BIT);
+      depth_shader->use();
+      depth_shader->set_mat4("lightSpaceMatrix", this->light_space_matrix);
+      this->render_depth_queue_static(depth_shader, SHADOW_CASTERS_STATIC);
+
+      cache->directional_light       = light_direction;
+      cache->directional_static_hash = static_hash;
+      cache->directional_valid       = true;
+    }
+    sta_glCopyImageSubData(cache->directional_texture, GL_TEXTURE_2D, 0, 0, 0, 0, this->textures[this->depth_texture].id, GL_TEXTURE_2D, 0, 0, 0, 0, this->shadow_width, this->shadow_height, 1);
+    sta_glBindFramebuffer(GL_FRAMEBUFFER, this->shadow_map_framebuffer);
+    filter = SHADOW_CASTERS_DYNAMIC;
   }
-
-  Shader depth_animation_shader = *this->get_shader_by_index(this->get_shader_by_name("depth_animation"));
-  depth_animation_shader.use();
-  depth_animation_shader.set_mat4("lightSpaceMatrix", this->light_space_matrix);
-  for (u32 i = 0; i < this->render_queue_animated_count; i++)
+  else
   {
-    RenderQueueItemAnimated item = this->render_queue_animated_buffers[i];
-    depth_animation_shader.set_mat4("model", item.m);
-    depth_animation_shader.set_mat4("jointTransforms", item.transforms, item.joint_count);
-
-    this->render_buffer(item.buffer);
+    sta_glBindFramebuffer(GL_FRAMEBUFFER, this->shadow_map_framebuffer);
+    glClear(GL_DEPTH_BUFFER_BIT);
   }
 
+  depth_shader->use();
+  depth_shader->set_mat4("lightSpaceMatrix", this->light_space_matrix);
+  this->render_depth_queue_static(depth_shader, filter);
+
+  Shader* depth_animation_shader = this->get_shader_by_index(this->get_shader_by_name("depth_animation"));
+  depth_animation_shader->use();
+  depth_animation_shader->set_mat4("lightSpaceMatrix", this->light_space_matrix);
+  this->render_depth_queue_animated(depth_animation_shader);
+
   sta_glBindFramebuffer(GL_FRAMEBUFFER, 0);
   this->reset_viewport_to_screen_size();
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glCullFace(GL_BACK);
+  this->end_gpu_pass();
 }
 
 void Renderer::render_queues(Mat44 view, Vector3 view_position, Mat44 projection, Vector3 light_position, u32 cube_texture, Vector3 directional_light_direction)
@@ -139,15 +493,22 @@ void Renderer::render_queues(Mat44 view, Vector3 view_position, Mat44 projection
   shader->set_vec3("directional_light_direction", directional_light_direction);
   shader->set_mat4("projection", projection);
   shader->set_mat4("light_space_matrix", this->light_space_matrix);
+  this->begin_gpu_pass(GPU_PASS_STATIC);
   for (u32 i = 0; i < this->render_queue_static_count; i++)
   {
     RenderQueueItemStatic item = this->render_queue_static_buffers[i];
+    if (item.effect)
+    {
+      continue;
+    }
     this->bind_texture(*shader, "texture1", item.texture);
     shader->set_mat4("model", item.m);
     this->render_buffer(item.buffer);
   }
+  this->end_gpu_pass();
 
-  shader = this->get_shader_by_index(this->get_shader_by_name("animation"));
+  Shader* static_shader = shader;
+  shader                = this->get_shader_by_index(this->get_shader_by_name("animation"));
   shader->use();
   this->bind_texture(*shader, "shadow_map", this->depth_texture);
   shader->set_vec3("ambient_lighting", ambient_lighting);
@@ -156,6 +517,7 @@ void Renderer::render_queues(Mat44 view, Vector3 view_position, Mat44 projection
   shader->set_vec3("light_position", light_position);
   shader->set_mat4("projection", projection);
   shader->set_mat4("light_space_matrix", this->light_space_matrix);
+  this->begin_gpu_pass(GPU_PASS_ANIMATED);
   for (u32 i = 0; i < this->render_queue_animated_count; i++)
   {
     RenderQueueItemAnimated item = this->render_queue_animated_buffers[i];
@@ -165,6 +527,26 @@ void Renderer::render_queues(Mat44 view, Vector3 view_position, Mat44 projection
     shader->set_mat4("jointTransforms", item.transforms, item.joint_count);
     this->render_buffer(item.buffer);
   }
+  this->end_gpu_pass();
+
+  // uniforms are kept per program so only the texture units need rebinding
+  shader = static_shader;
+  shader->use();
+  this->begin_gpu_pass(GPU_PASS_EFFECTS);
+  this->bind_cube_texture(*shader, "shadow_map_cube", cube_texture);
+  this->bind_texture(*shader, "shadow_map", this->depth_texture);
+  for (u32 i = 0; i < this->render_queue_static_count; i++)
+  {
+    RenderQueueItemStatic item = this->render_queue_static_buffers[i];
+    if (!item.effect)
+    {
+      continue;
+    }
+    this->bind_texture(*shader, "texture1", item.texture);
+    shader->set_mat4("model", item.m);
+    this->render_buffer(item.buffer);
+  }
+  this->end_gpu_pass();
 
   this->render_queue_static_count   = 0;
   this->render_queue_animated_count = 0;
@@ -196,27 +578,113 @@ void Renderer::reset_viewport_to_screen_size()
   glViewport(0, 0, screen_width, screen_height);
 }
 
-void Renderer::init_depth_texture()
+static GLuint create_depth_texture_2d(u32 width, u32 height)
 {
-  shadow_width = 1024, shadow_height = 1024;
-  sta_glGenFramebuffers(1, &this->shadow_map_framebuffer);
-
   GLuint depth_texture;
   glGenTextures(1, &depth_texture);
   glBindTexture(GL_TEXTURE_2D, depth_texture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, shadow_width, shadow_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
   float borderColor[] = {1.0, 1.0, 1.0, 1.0};
   glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-  sta_glBindFramebuffer(GL_FRAMEBUFFER, this->shadow_map_framebuffer);
+  return depth_texture;
+}
+
+static GLuint create_depth_texture_cube(u32 width, u32 height)
+{
+  GLuint depth_cubemap;
+  glGenTextures(1, &depth_cubemap);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, depth_cubemap);
+  for (u32 i = 0; i < 6; ++i)
+  {
+    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+  }
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  return depth_cubemap;
+}
+
+static GLuint create_depth_framebuffer_2d(GLuint depth_texture)
+{
+  GLuint framebuffer;
+  sta_glGenFramebuffers(1, &framebuffer);
+  sta_glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
   sta_glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth_texture, 0);
   glDrawBuffer(GL_NONE);
   glReadBuffer(GL_NONE);
   sta_glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  this->depth_texture = this->add_texture(depth_texture);
+  return framebuffer;
+}
+
+static GLuint create_depth_framebuffer_cube_face(GLuint depth_cubemap, u32 face)
+{
+  GLuint framebuffer;
+  sta_glGenFramebuffers(1, &framebuffer);
+  sta_glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  sta_glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, depth_cubemap, 0);
+  glDrawBuffer(GL_NONE);
+  glReadBuffer(GL_NONE);
+  sta_glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return framebuffer;
+}
+
+static GLuint create_depth_framebuffer_cube(GLuint depth_cubemap)
+{
+  GLuint framebuffer;
+  sta_glGenFramebuffers(1, &framebuffer);
+  sta_glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  sta_glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth_cubemap, 0);
+  glDrawBuffer(GL_NONE);
+  glReadBuffer(GL_NONE);
+  sta_glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return framebuffer;
+}
+
+void Renderer::init_depth_texture()
+{
+  shadow_width = 1024, shadow_height = 1024;
+  GLuint depth_texture         = create_depth_texture_2d(shadow_width, shadow_height);
+  this->shadow_map_framebuffer = create_depth_framebuffer_2d(depth_texture);
+  this->depth_texture          = this->add_texture(depth_texture);
+}
+
+void Renderer::init_depth_cube_texture()
+{
+  GLuint depth_cubemap          = create_depth_texture_cube(shadow_width, shadow_height);
+  this->shadow_cube_framebuffer = create_depth_framebuffer_cube(depth_cubemap);
+  for (u32 face = 0; face < 6; face++)
+  {
+    this->shadow_cube_face_framebuffers[face] = create_depth_framebuffer_cube_face(depth_cubemap, face);
+  }
+  this->depth_cube_texture      = this->add_texture(depth_cubemap);
+}
+
+void Renderer::init_shadow_cache()
+{
+  // copying the cached depth into the live maps needs ARB_copy_image (4.3)
+  if (!sta_gl_has_copy_image())
+  {
+    this->logger->warning("glCopyImageSubData not available, disabling shadow caching");
+    this->shadow_caching = false;
+    return;
+  }
+  ShadowCache* cache             = &this->shadow_cache;
+  cache->directional_texture     = create_depth_texture_2d(shadow_width, shadow_height);
+  cache->directional_framebuffer = create_depth_framebuffer_2d(cache->directional_texture);
+  cache->cube_texture            = create_depth_texture_cube(shadow_width, shadow_height);
+  cache->cube_framebuffer        = create_depth_framebuffer_cube(cache->cube_texture);
+  for (u32 face = 0; face < 6; face++)
+  {
+    cache->cube_face_framebuffers[face] = create_depth_framebuffer_cube_face(cache->cube_texture, face);
+  }
+  this->invalidate_shadow_cache();
 }
 
 void Renderer::change_screen_size(u32 screen_width, u32 screen_height)
@@ -322,70 +790,543 @@ void Renderer::draw_circle(Vector2 position, f32 radius, f32 thickness, Color co
   glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
   this->disable_2d_rendering();
 }
-void Renderer::bind_cube_texture(Shader shader, const char* uniform_name, u32 texture_index)
+bool Renderer::init_text(const char* font_filename)
 {
-  Texture texture = this->textures[texture_index];
-  if (texture.unit == -1)
+  if (this->headless)
   {
-    texture.unit = this->get_free_texture_unit();
+    return false;
   }
-
-  shader.use();
-  GLuint location = sta_glGetUniformLocation(shader.id, uniform_name);
-  sta_glUniform1i(location, texture.unit);
-  glActiveTexture(GL_TEXTURE0 + texture.unit);
-  sta_glBindTexture(GL_TEXTURE_CUBE_MAP, texture.id);
-}
-
-void Renderer::bind_texture(Shader shader, const char* uniform_name, u32 texture_index)
-{
-  Texture texture = this->textures[texture_index];
-  if (texture.unit == -1)
+  this->font = {};
+  if (!this->font.parse_ttf(font_filename))
   {
-    texture.unit = this->get_free_texture_unit();
+    this->logger->warning("Couldn't load font %s, text won't be rendered", font_filename);
+    return false;
   }
 
-  shader.use();
-  GLuint location = sta_glGetUniformLocation(shader.id, uniform_name);
-  sta_glUniform1i(location, texture.unit);
-  glActiveTexture(GL_TEXTURE0 + texture.unit);
-  sta_glBindTexture(GL_TEXTURE_2D, texture.id);
-}
-
-u32 Renderer::add_texture(u32 texture_id)
-{
-  RESIZE_ARRAY(this->textures, Texture, texture_count, texture_capacity);
-  u32      out     = texture_count++;
-  Texture* texture = &this->textures[out];
-  texture->id      = texture_id;
-  texture->unit    = this->get_free_texture_unit();
-  return out;
-}
-
-u32 Renderer::create_texture(u32 width, u32 height, void* data)
-{
-
+  sta_glyph_atlas_init(&this->glyph_atlas, GLYPH_ATLAS_SIZE, GLYPH_ATLAS_SIZE);
   u32 texture;
   sta_glGenTextures(1, &texture);
   sta_glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  sta_glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, GLYPH_ATLAS_SIZE, GLYPH_ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, this->glyph_atlas.pixels);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  this->glyph_atlas_texture = this->add_texture(texture);
+
+  sta_glGenVertexArrays(1, &this->text_vao);
+  sta_glGenBuffers(1, &this->text_vbo);
+  sta_glBindVertexArray(this->text_vao);
+  sta_glBindBuffer(GL_ARRAY_BUFFER, this->text_vbo);
+  sta_glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)(0));
+  sta_glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)(2 * sizeof(f32)));
+  sta_glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), (void*)(4 * sizeof(f32)));
+  sta_glEnableVertexAttribArray(0);
+  sta_glEnableVertexAttribArray(1);
+  sta_glEnableVertexAttribArray(2);
+  sta_glBindVertexArray(0);
 
-  sta_glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-  sta_glGenerateMipmap(GL_TEXTURE_2D);
+  this->text_vertex_count    = 0;
+  this->text_vertex_capacity = 6 * 256;
+  this->text_vertices        = sta_allocate_struct(TextVertex, this->text_vertex_capacity);
 
-  return texture;
+  ShaderType  types[2] = {SHADER_TYPE_VERT, SHADER_TYPE_FRAG};
+  const char* names[2] = {"./shaders/text.vert", "./shaders/text.frag"};
+  this->text_shader    = Shader(types, names, ArrayCount(types), "text");
+  this->text_enabled   = true;
+  return true;
 }
 
-void Renderer::swap_buffers()
+static u32 decode_utf8(const char* string, u32 string_length, u32* index)
 {
-  sta_gl_render(this->window);
+  u8  c     = string[(*index)++];
+  u32 extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+  u32 code  = extra == 0 ? c : c & (0x3F >> extra);
+  for (u32 i = 0; i < extra && *index < string_length; i++)
+  {
+    code = (code << 6) | (string[(*index)++] & 0x3F);
+  }
+  return code;
 }
 
-u32 Renderer::create_buffer_from_model(Model* model, BufferAttributes* attributes, u32 attribute_count)
+void Renderer::render_text(const char* string, u32 string_length, f32 x, f32 y, TextAlignment alignment_x, TextAlignment alignment_y, Color color, f32 font_size)
 {
-  this->logger->info("%s: %d", model->name, model->vertex_data_size * model->vertex_count);
-  return this->create_buffer_indices(model->vertex_data_size * model->vertex_count, model->vertex_data, model->index_count, model->indices, attributes, attribute_count);
-}
-
+  if (!this->text_enabled)
+  {
+    return;
+  }
+
+  u32 pixel_size = (u32)(font_size + 0.5f);
+  f32 scale      = pixel_size * this->font.scale;
+  f32 width      = 0.0f;
+  for (u32 i = 0; i < string_length;)
+  {
+    width += sta_glyph_atlas_get(&this->glyph_atlas, &this->font, decode_utf8(string, string_length, &i), pixel_size)->advance;
+  }
+  f32 ascent  = this->font.ascent * scale;
+  f32 descent = -this->font.descent * scale;
+
+  // laid out in pixels from the bottom left of the screen, the pen starts on a whole pixel so glyphs stay sharp
+  f32 pen_x   = (x + 1.0f) * 0.5f * this->screen_width;
+  f32 top     = (y + 1.0f) * 0.5f * this->screen_height;
+  if (alignment_x == TextAlignment_End_At)
+  {
+    pen_x -= width;
+  }
+  else if (alignment_x == TextAlignment_Centered)
+  {
+    pen_x -= width * 0.5f;
+  }
+  if (alignment_y == TextAlignment_End_At)
+  {
+    top += ascent + descent;
+  }
+  else if (alignment_y == TextAlignment_Centered)
+  {
+    top += (ascent + descent) * 0.5f;
+  }
+  pen_x        = floorf(pen_x + 0.5f);
+  f32 baseline = floorf(top - ascent + 0.5f);
+
+  f32 to_ndc_x = 2.0f / this->screen_width;
+  f32 to_ndc_y = 2.0f / this->screen_height;
+  f32 to_uv    = 1.0f / GLYPH_ATLAS_SIZE;
+  u8  r = color.r * 255.0f, g = color.g * 255.0f, b = color.b * 255.0f, a = color.a * 255.0f;
+  for (u32 i = 0; i < string_length;)
+  {
+    GlyphAtlasEntry* glyph = sta_glyph_atlas_get(&this->glyph_atlas, &this->font, decode_utf8(string, string_length, &i), pixel_size);
+    if (glyph->w != 0)
+    {
+      f32 min_x = (pen_x + glyph->bearing_x) * to_ndc_x - 1.0f;
+      f32 max_x = (pen_x + glyph->bearing_x + glyph->w) * to_ndc_x - 1.0f;
+      f32 max_y = (baseline - glyph->bearing_y) * to_ndc_y - 1.0f;
+      f32 min_y = (baseline - glyph->bearing_y - glyph->h) * to_ndc_y - 1.0f;
+      f32 min_u = glyph->x * to_uv, max_u = (glyph->x + glyph->w) * to_uv;
+      f32 min_v = glyph->y * to_uv, max_v = (glyph->y + glyph->h) * to_uv;
+
+      // capacity stays a multiple of 6 so a full batch is exactly count == capacity
+      RESIZE_ARRAY(this->text_vertices, TextVertex, this->text_vertex_count, this->text_vertex_capacity);
+      TextVertex* v = &this->text_vertices[this->text_vertex_count];
+      v[0]          = {max_x, max_y, max_u, min_v, r, g, b, a};
+      v[1]          = {max_x, min_y, max_u, max_v, r, g, b, a};
+      v[2]          = {min_x, max_y, min_u, min_v, r, g, b, a};
+      v[3]          = {max_x, min_y, max_u, max_v, r, g, b, a};
+      v[4]          = {min_x, min_y, min_u, max_v, r, g, b, a};
+      v[5]          = {min_x, max_y, min_u, min_v, r, g, b, a};
+      this->text_vertex_count += 6;
+    }
+    pen_x += glyph->advance;
+  }
+}
+
+// Uploads the atlas rows rasterized since the last flush and draws every queued glyph in one call
+void Renderer::flush_text()
+{
+  if (!this->text_enabled || this->text_vertex_count == 0)
+  {
+    return;
+  }
+
+  GlyphAtlas* atlas = &this->glyph_atlas;
+  if (atlas->dirty_min_y < atlas->dirty_max_y)
+  {
+    sta_glBindTexture(GL_TEXTURE_2D, this->textures[this->glyph_atlas_texture].id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, atlas->dirty_min_y, atlas->width, atlas->dirty_max_y - atlas->dirty_min_y, GL_RED, GL_UNSIGNED_BYTE,
+                    &atlas->pixels[atlas->dirty_min_y * atlas->width]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    atlas->dirty_min_y = atlas->height;
+    atlas->dirty_max_y = 0;
+  }
+
+  this->enable_2d_rendering();
+  this->text_shader.use();
+  this->bind_texture(this->text_shader, "atlas", this->glyph_atlas_texture);
+  sta_glBindVertexArray(this->text_vao);
+  sta_glBindBuffer(GL_ARRAY_BUFFER, this->text_vbo);
+  sta_glBufferData(GL_ARRAY_BUFFER, sizeof(TextVertex) * this->text_vertex_count, this->text_vertices, GL_STREAM_DRAW);
+  glDrawArrays(GL_TRIANGLES, 0, this->text_vertex_count);
+  sta_glBindVertexArray(0);
+  this->disable_2d_rendering();
+
+  this->text_vertex_count = 0;
+}
+
+void Renderer::bind_cube_texture(Shader shader, const char* uniform_name, u32 texture_index)
+{
+  Texture texture = this->textures[texture_index];
+  if (texture.unit == -1)
+  {
+    texture.unit = this->get_free_texture_unit();
+  }
+
+  shader.use();
+  GLuint location = sta_glGetUniformLocation(shader.id, uniform_name);
+  sta_glUniform1i(location, texture.unit);
+  glActiveTexture(GL_TEXTURE0 + texture.unit);
+  sta_glBindTexture(GL_TEXTURE_CUBE_MAP, texture.id);
+}
+
+void Renderer::bind_texture(Shader shader, const char* uniform_name, u32 texture_index)
+{
+  Texture texture = this->textures[texture_index];
+  if (texture.unit == -1)
+  {
+    texture.unit = this->get_free_texture_unit();
+  }
+
+  shader.use();
+  GLuint location = sta_glGetUniformLocation(shader.id, uniform_name);
+  sta_glUniform1i(location, texture.unit);
+  glActiveTexture(GL_TEXTURE0 + texture.unit);
+  sta_glBindTexture(GL_TEXTURE_2D, texture.id);
+}
+
+u32 Renderer::add_texture(u32 texture_id)
+{
+  RESIZE_ARRAY(this->textures, Texture, texture_count, texture_capacity);
+  u32      out     = texture_count++;
+  Texture* texture = &this->textures[out];
+  texture->id      = texture_id;
+  texture->unit    = this->get_free_texture_unit();
+  return out;
+}
+
+u32 Renderer::create_texture(u32 width, u32 height, void* data)
+{
+  if (this->headless)
+  {
+    return 0;
+  }
+
+  u32 texture;
+  sta_glGenTextures(1, &texture);
+  sta_glBindTexture(GL_TEXTURE_2D, texture);
+
+  sta_glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+  sta_glGenerateMipmap(GL_TEXTURE_2D);
+
+  return texture;
+}
+
+void Renderer::init_texture_upload_ring()
+{
+  TextureUploadRing* ring = &this->texture_upload_ring;
+  sta_glGenBuffers(TEXTURE_UPLOAD_RING_SIZE, ring->buffers);
+  for (u32 i = 0; i < TEXTURE_UPLOAD_RING_SIZE; i++)
+  {
+    sta_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring->buffers[i]);
+    sta_glBufferData(GL_PIXEL_UNPACK_BUFFER, TEXTURE_UPLOAD_SLOT_BYTES, 0, GL_STREAM_DRAW);
+    ring->fences[i] = 0;
+  }
+  sta_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  ring->slot    = 0;
+  ring->enabled = true;
+}
+
+// Goes through the next ring slot so the copy into the texture happens on the GPU's time,
+// mips that don't fit a slot are uploaded straight from memory
+void Renderer::upload_compressed_mip(GLenum format, u32 level, u32 width, u32 height, void* data, u32 size)
+{
+  TextureUploadRing* ring = &this->texture_upload_ring;
+  if (!ring->enabled || size > TEXTURE_UPLOAD_SLOT_BYTES)
+  {
+    sta_glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, size, data);
+    return;
+  }
+
+  u32 slot   = ring->slot;
+  ring->slot = (slot + 1) % TEXTURE_UPLOAD_RING_SIZE;
+  if (ring->fences[slot])
+  {
+    sta_glClientWaitSync(ring->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    sta_glDeleteSync(ring->fences[slot]);
+    ring->fences[slot] = 0;
+  }
+
+  sta_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring->buffers[slot]);
+  void* mapped = sta_glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+  if (mapped)
+  {
+    memcpy(mapped, data, size);
+    sta_glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    sta_glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, size, 0);
+    ring->fences[slot] = sta_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    sta_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  else
+  {
+    sta_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    sta_glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, size, data);
+  }
+}
+
+u32 Renderer::create_compressed_texture(CookedTexture* cooked)
+{
+  if (this->headless)
+  {
+    return 0;
+  }
+
+  CookedTextureHeader* header = cooked->header;
+  GLenum               format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  if (header->format == COOKED_TEXTURE_BC3)
+  {
+    format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  }
+  else if (header->format == COOKED_TEXTURE_BC5)
+  {
+    format = GL_COMPRESSED_RG_RGTC2;
+  }
+
+  u32 texture;
+  sta_glGenTextures(1, &texture);
+  sta_glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header->mip_count - 1);
+
+  u32 width  = header->width;
+  u32 height = header->height;
+  for (u32 i = 0; i < header->mip_count; i++)
+  {
+    this->upload_compressed_mip(format, i, width, height, (u8*)header + header->mip_offsets[i], header->mip_sizes[i]);
+    width  = MAX(width / 2, 1);
+    height = MAX(height / 2, 1);
+  }
+
+  return texture;
+}
+
+void Renderer::swap_buffers()
+{
+  sta_gl_render(this->window);
+}
+
+static u32 buffer_attribute_size(BufferAttributes attribute)
+{
+  switch (attribute.type)
+  {
+  case BUFFER_ATTRIBUTE_FLOAT:
+  case BUFFER_ATTRIBUTE_INT:
+  {
+    return attribute.count * 4;
+  }
+  case BUFFER_ATTRIBUTE_HALF:
+  {
+    // keeps the next attribute 4 byte aligned
+    return (attribute.count * 2 + 3) & ~3;
+  }
+  case BUFFER_ATTRIBUTE_SNORM_10_10_10_2:
+  case BUFFER_ATTRIBUTE_WEIGHTS_U8:
+  case BUFFER_ATTRIBUTE_U8:
+  {
+    return 4;
+  }
+  }
+  return 0;
+}
+
+static u32 buffer_attributes_stride(BufferAttributes* attributes, u32 attribute_count)
+{
+  u32 stride = 0;
+  for (u32 i = 0; i < attribute_count; i++)
+  {
+    stride += buffer_attribute_size(attributes[i]);
+  }
+  return stride;
+}
+
+static u16 f32_to_f16(f32 value)
+{
+  u32 bits;
+  memcpy(&bits, &value, sizeof(u32));
+  u32 sign     = (bits >> 16) & 0x8000;
+  i32 exponent = (i32)((bits >> 23) & 0xFF) - 127 + 15;
+  u32 mantissa = bits & 0x7FFFFF;
+  if (exponent <= 0)
+  {
+    if (exponent < -10)
+    {
+      return sign;
+    }
+    mantissa |= 0x800000;
+    u32 shift     = 14 - exponent;
+    u32 half      = mantissa >> shift;
+    u32 remainder = mantissa & ((1 << shift) - 1);
+    u32 halfway   = 1 << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1)))
+    {
+      half++;
+    }
+    return sign | half;
+  }
+  if (exponent >= 31)
+  {
+    return sign | 0x7C00;
+  }
+  // round to nearest even, a carry out of the mantissa correctly bumps the exponent
+  u32 half      = sign | (exponent << 10) | (mantissa >> 13);
+  u32 remainder = mantissa & 0x1FFF;
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+  {
+    half++;
+  }
+  return half;
+}
+
+static void pack_vertex_attribute(u8* output, u32* source, BufferAttributes attribute)
+{
+  f32* values = (f32*)source;
+  switch (attribute.type)
+  {
+  case BUFFER_ATTRIBUTE_FLOAT:
+  case BUFFER_ATTRIBUTE_INT:
+  {
+    memcpy(output, source, attribute.count * 4);
+    break;
+  }
+  case BUFFER_ATTRIBUTE_HALF:
+  {
+    u16* half = (u16*)output;
+    for (u32 i = 0; i < attribute.count; i++)
+    {
+      half[i] = f32_to_f16(values[i]);
+    }
+    break;
+  }
+  case BUFFER_ATTRIBUTE_SNORM_10_10_10_2:
+  {
+    assert(attribute.count <= 3 && "Can only pack 3 components as 10:10:10:2");
+    u32 packed = 0;
+    for (u32 i = 0; i < attribute.count; i++)
+    {
+      i32 quantized = (i32)roundf(CLAMP(values[i], -1.0f, 1.0f) * 511.0f);
+      packed |= ((u32)quantized & 0x3FF) << (i * 10);
+    }
+    memcpy(output, &packed, sizeof(u32));
+    break;
+  }
+  case BUFFER_ATTRIBUTE_WEIGHTS_U8:
+  {
+    assert(attribute.count <= 4 && "Can only pack 4 weights as bytes");
+    // rounding error goes to the largest weight so the skinning still sums to 1
+    i32 sum = 0, largest = 0;
+    for (u32 i = 0; i < attribute.count; i++)
+    {
+      output[i] = (u8)roundf(CLAMP(values[i], 0.0f, 1.0f) * 255.0f);
+      sum += output[i];
+      if (output[i] > output[largest])
+      {
+        largest = i;
+      }
+    }
+    if (sum != 0)
+    {
+      output[largest] += 255 - sum;
+    }
+    break;
+  }
+  case BUFFER_ATTRIBUTE_U8:
+  {
+    assert(attribute.count <= 4 && "Can only pack 4 bytes");
+    for (u32 i = 0; i < attribute.count; i++)
+    {
+      assert(source[i] < 256 && "Value doesn't fit in a byte");
+      output[i] = (u8)source[i];
+    }
+    break;
+  }
+  }
+}
+
+// Source components are read in order from the start of each vertex,
+// whatever is left at the end of it (like the skinned bitangent) is dropped
+static void pack_vertices(u8* output, u32 stride, Model* model, BufferAttributes* attributes, u32 attribute_count)
+{
+  for (u32 i = 0; i < model->vertex_count; i++)
+  {
+    u32* source = (u32*)((u8*)model->vertex_data + (u64)i * model->vertex_data_size);
+    u8*  vertex = &output[(u64)i * stride];
+    for (u32 j = 0; j < attribute_count; j++)
+    {
+      pack_vertex_attribute(vertex, source, attributes[j]);
+      vertex += buffer_attribute_size(attributes[j]);
+      source += attributes[j].count;
+    }
+  }
+}
+
+static void enable_vertex_attributes(BufferAttributes* attributes, u32 attribute_count)
+{
+  u32 stride = buffer_attributes_stride(attributes, attribute_count);
+  u64 offset = 0;
+  for (u32 i = 0; i < attribute_count; i++)
+  {
+    BufferAttributes attribute = attributes[i];
+    switch (attribute.type)
+    {
+    case BUFFER_ATTRIBUTE_FLOAT:
+    {
+      sta_glVertexAttribPointer(i, attribute.count, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+      break;
+    }
+    case BUFFER_ATTRIBUTE_INT:
+    {
+      sta_glVertexAttribIPointer(i, attribute.count, GL_INT, stride, (void*)offset);
+      break;
+    }
+    case BUFFER_ATTRIBUTE_HALF:
+    {
+      sta_glVertexAttribPointer(i, attribute.count, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offset);
+      break;
+    }
+    case BUFFER_ATTRIBUTE_SNORM_10_10_10_2:
+    {
+      sta_glVertexAttribPointer(i, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+      break;
+    }
+    case BUFFER_ATTRIBUTE_WEIGHTS_U8:
+    {
+      sta_glVertexAttribPointer(i, attribute.count, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offset);
+      break;
+    }
+    case BUFFER_ATTRIBUTE_U8:
+    {
+      sta_glVertexAttribIPointer(i, attribute.count, GL_UNSIGNED_BYTE, stride, (void*)offset);
+      break;
+    }
+    }
+    offset += buffer_attribute_size(attribute);
+    sta_glEnableVertexAttribArray(i);
+  }
+}
+
+u32 Renderer::create_buffer_from_model(Model* model, BufferAttributes* attributes, u32 attribute_count)
+{
+  u32 stride = buffer_attributes_stride(attributes, attribute_count);
+  u64 size   = (u64)stride * model->vertex_count;
+  this->logger->info("%s: %lu bytes, %d per vertex (%d unpacked)", model->name, size, stride, model->vertex_data_size);
+  // the model's vertex data is already laid out like this only if nothing needs packing, a packed
+  // layout can add up to the same size with different types
+  bool unpacked = stride == model->vertex_data_size;
+  for (u32 i = 0; i < attribute_count && unpacked; i++)
+  {
+    unpacked = attributes[i].type == BUFFER_ATTRIBUTE_FLOAT || attributes[i].type == BUFFER_ATTRIBUTE_INT;
+  }
+  if (unpacked)
+  {
+    return this->create_buffer_indices(size, model->vertex_data, model->index_count, model->indices, attributes, attribute_count);
+  }
+
+  u8* packed = sta_allocate_struct(u8, size);
+  pack_vertices(packed, stride, model, attributes, attribute_count);
+  u32 buffer = this->create_buffer_indices(size, packed, model->index_count, model->indices, attributes, attribute_count);
+  sta_deallocate(packed, size);
+
+  return buffer;
+}
+
 void Renderer::toggle_vsync()
 {
   this->vsync = !this->vsync;
@@ -427,6 +1368,7 @@ Shader* Renderer::get_shader_by_index(u32 index)
 
 void Renderer::reload_shaders()
 {
+  this->invalidate_shadow_cache();
   for (u32 i = 0; i < shader_count; i++)
   {
     Shader* shader = &shaders[i];
@@ -452,16 +1394,11 @@ u32 Renderer::get_shader_by_name(const char* name)
 
 bool Renderer::load_shaders_from_files(const char* file_location)
 {
-  Buffer buffer = {};
-  if (!sta_read_file(&buffer, file_location))
-  {
-    return false;
-  }
   Json json = {};
-  if (!sta_json_deserialize_from_string(&buffer, &json))
+  if (!sta_json_deserialize_from_file(&json, file_location))
   {
     return false;
-  };
+  }
   assert(json.headType == JSON_OBJECT && "Expected head to be object");
   JsonObject* head    = &json.obj;
 
@@ -472,7 +1409,7 @@ bool Renderer::load_shaders_from_files(const char* file_location)
   for (u32 i = 0; i < count; i++)
   {
     u64         log_index = 0;
-    const char* name      = head->keys[i];
+    const char* name      = head->keys[i].copy();
     assert(head->values[i].type == JSON_ARRAY && "Expected shader to be an array!");
     JsonArray* shaders_json = head->values[i].arr;
     u32        shader_count = shaders_json->arraySize;
@@ -483,104 +1420,119 @@ bool Renderer::load_shaders_from_files(const char* file_location)
     {
       JsonObject* shader  = shaders_json->values[j].obj;
       types[j]            = (ShaderType)shader->lookup_value("type")->number;
-      shader_locations[j] = shader->lookup_value("location")->string;
+      shader_locations[j] = shader->lookup_value("location")->string.copy();
     }
 
+    if (this->headless)
+    {
+      shaders[i]      = Shader();
+      shaders[i].name = name;
+      shaders[i].id   = 0;
+      continue;
+    }
     shaders[i] = Shader(types, (const char**)shader_locations, shader_count, name);
   }
   this->shaders      = shaders;
   this->shader_count = count;
+  sta_json_free(&json);
   return true;
 }
 
-bool Renderer::load_textures_from_files(const char* file_location)
+// Only reads the texture list, the targa files are decoded by the queue
+bool Renderer::queue_textures_from_files(const char* file_location, WorkQueue* queue)
 {
 
-  Buffer buffer = {};
-  if (!sta_read_file(&buffer, file_location))
-  {
-    return false;
-  }
   Json json = {};
-  if (!sta_json_deserialize_from_string(&buffer, &json))
+  if (!sta_json_deserialize_from_file(&json, file_location))
   {
     return false;
-  };
+  }
   assert(json.headType == JSON_OBJECT && "Expected head to be object");
-  JsonObject* head       = &json.obj;
+  JsonObject* head        = &json.obj;
 
-  this->texture_count    = head->size;
-  this->textures         = sta_allocate_struct(Texture, texture_count);
-  this->texture_capacity = this->texture_count;
+  this->texture_count     = head->size;
+  this->textures          = sta_allocate_struct(Texture, texture_count);
+  this->texture_capacity  = this->texture_count;
+  this->texture_loads     = sta_allocate_struct(TextureLoad, this->texture_count);
+  this->textures_uploaded = 0;
 
   for (u32 i = 0; i < this->texture_count; i++)
   {
-    Texture    texture = {};
-    TargaImage image   = {};
-    texture.name       = head->keys[i];
+    Texture* texture = &this->textures[i];
+    texture->name    = head->keys[i].copy();
+    texture->id      = 0;
+    texture->unit    = -1;
 
-    char* targa_file   = head->values[i].obj->lookup_value("location")->string;
-    if (!sta_targa_read_from_file_rgba(&image, targa_file))
+    TextureLoad* load      = &this->texture_loads[i];
+    load->location         = head->values[i].obj->lookup_value("location")->string.copy();
+    load->allow_compressed = this->supports_compressed_textures;
+    if (this->headless)
     {
-      // ToDo load token texture
-      this->logger->error("Failed to read targa from '%s'", targa_file);
+      load->done = true;
+      continue;
     }
-    texture.id   = this->create_texture(image.width, image.height, image.data);
-    texture.unit = this->get_free_texture_unit();
-    sta_deallocate(image.data, image.width * image.height * 4);
-
-    this->textures[i] = texture;
+    queue->push(sta_texture_read_job, load);
   }
-
-  logger->info("Found %d textures", this->texture_count);
-  for (u32 i = 0; i < this->texture_count; i++)
-  {
-    Texture texture = this->textures[i];
-    logger->info("texture: '%s' id:%d, unit:%d", texture.name, texture.id, texture.unit);
-  }
-
-  // ToDo free the line memory in every load x
+  sta_json_free(&json);
   return true;
 }
 
-u32 Renderer::create_buffer(u64 buffer_size, void* buffer_data, BufferAttributes* attributes, u64 attribute_count)
+// Uploads in the order the textures are listed so texture units come out the same as a sequential load,
+// returns how many are still waiting on their decode
+u32 Renderer::upload_loaded_textures()
 {
-  GLBufferIndex buffer = {};
-  sta_glGenVertexArrays(1, &buffer.vao);
-  sta_glGenBuffers(1, &buffer.vbo);
-
-  sta_glBindVertexArray(buffer.vao);
-  sta_glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
-  sta_glBufferData(GL_ARRAY_BUFFER, buffer_size, buffer_data, GL_STATIC_DRAW);
-
-  u32 size = 0;
-  for (u32 i = 0; i < attribute_count; i++)
+  if (!this->texture_loads)
   {
-    size += attributes[i].count;
+    return 0;
   }
-  size *= 4;
-  u32 stride = 0;
-  for (u32 i = 0; i < attribute_count; i++)
+  u64 uploaded_bytes = 0;
+  for (; this->textures_uploaded < this->texture_count; this->textures_uploaded++)
   {
-
-    BufferAttributes attribute = attributes[i];
-    switch (attribute.type)
+    TextureLoad* load = &this->texture_loads[this->textures_uploaded];
+    if (!__atomic_load_n(&load->done, __ATOMIC_ACQUIRE) || (this->texture_upload_budget != 0 && uploaded_bytes >= this->texture_upload_budget))
     {
-    case BUFFER_ATTRIBUTE_FLOAT:
+      return this->texture_count - this->textures_uploaded;
+    }
+    if (this->headless)
     {
-      sta_glVertexAttribPointer(i, attribute.count, GL_FLOAT, GL_FALSE, size, (void*)(stride * sizeof(int)));
-      break;
+      continue;
     }
-    case BUFFER_ATTRIBUTE_INT:
+    if (!load->ok)
     {
-      sta_glVertexAttribIPointer(i, attribute.count, GL_INT, size, (void*)(stride * sizeof(int)));
-      break;
+      // ToDo load token texture
+      this->logger->error("Failed to read targa from '%s'", load->location);
     }
+    Texture* texture = &this->textures[this->textures_uploaded];
+    if (load->compressed)
+    {
+      texture->id = this->create_compressed_texture(&load->cooked);
+      uploaded_bytes += load->cooked.file.len;
+      sta_cooked_texture_free(&load->cooked);
     }
-    stride += attribute.count;
-    sta_glEnableVertexAttribArray(i);
+    else
+    {
+      texture->id = this->create_texture(load->image.width, load->image.height, load->image.data);
+      uploaded_bytes += load->image.width * load->image.height * 4;
+      sta_deallocate(load->image.data, load->image.width * load->image.height * 4);
+    }
+    texture->unit = this->get_free_texture_unit();
   }
 
+  sta_deallocate(this->texture_loads, sizeof(TextureLoad) * this->texture_count);
+  this->texture_loads = 0;
+  logger->info("Found %d textures", this->texture_count);
+  for (u32 i = 0; i < this->texture_count; i++)
+  {
+    Texture texture = this->textures[i];
+    logger->info("texture: '%s' id:%d, unit:%d", texture.name, texture.id, texture.unit);
+  }
+
+  // ToDo free the line memory in every load x
+  return 0;
+}
+
+u32 Renderer::add_index_buffer(GLBufferIndex buffer)
+{
   if (this->index_buffers_cap == 0)
   {
     this->index_buffers_count = 1;
@@ -594,10 +1546,69 @@ u32 Renderer::create_buffer(u64 buffer_size, void* buffer_data, BufferAttributes
   return this->index_buffers_count++;
 }
 
+static void calculate_buffer_bounds(GLBufferIndex* buffer, u64 buffer_size, void* buffer_data, BufferAttributes* attributes, u32 attribute_count)
+{
+  buffer->bounds_center = Vector3(0, 0, 0);
+  buffer->bounds_radius = 0.0f;
+  if (attribute_count == 0 || attributes[0].type != BUFFER_ATTRIBUTE_FLOAT || attributes[0].count < 3)
+  {
+    return;
+  }
+  u32 stride       = buffer_attributes_stride(attributes, attribute_count);
+  u64 vertex_count = buffer_size / stride;
+  if (vertex_count == 0)
+  {
+    return;
+  }
+
+  u8*     data = (u8*)buffer_data;
+  Vector3 min(FLT_MAX, FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  for (u64 i = 0; i < vertex_count; i++)
+  {
+    f32* position = (f32*)&data[i * stride];
+    for (u32 j = 0; j < 3; j++)
+    {
+      min.v[j] = MIN(min.v[j], position[j]);
+      max.v[j] = MAX(max.v[j], position[j]);
+    }
+  }
+  buffer->bounds_center = Vector3((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+  for (u64 i = 0; i < vertex_count; i++)
+  {
+    f32* position         = (f32*)&data[i * stride];
+    buffer->bounds_radius = MAX(buffer->bounds_radius, Vector3(position[0], position[1], position[2]).sub(buffer->bounds_center).len());
+  }
+}
+
+u32 Renderer::create_buffer(u64 buffer_size, void* buffer_data, BufferAttributes* attributes, u64 attribute_count)
+{
+  GLBufferIndex buffer = {};
+  calculate_buffer_bounds(&buffer, buffer_size, buffer_data, attributes, attribute_count);
+  if (this->headless)
+  {
+    return this->add_index_buffer(buffer);
+  }
+  sta_glGenVertexArrays(1, &buffer.vao);
+  sta_glGenBuffers(1, &buffer.vbo);
+
+  sta_glBindVertexArray(buffer.vao);
+  sta_glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+  sta_glBufferData(GL_ARRAY_BUFFER, buffer_size, buffer_data, GL_STATIC_DRAW);
+
+  enable_vertex_attributes(attributes, attribute_count);
+
+  return this->add_index_buffer(buffer);
+}
+
 u32 Renderer::create_buffer_indices(u64 buffer_size, void* buffer_data, u64 index_count, u32* indices, BufferAttributes* attributes, u32 attribute_count)
 {
   GLBufferIndex buffer = {};
   buffer.index_count   = index_count;
+  calculate_buffer_bounds(&buffer, buffer_size, buffer_data, attributes, attribute_count);
+  if (this->headless)
+  {
+    return this->add_index_buffer(buffer);
+  }
   sta_glGenVertexArrays(1, &buffer.vao);
   sta_glGenBuffers(1, &buffer.vbo);
   sta_glGenBuffers(1, &buffer.ebo);
@@ -609,45 +1620,9 @@ u32 Renderer::create_buffer_indices(u64 buffer_size, void* buffer_data, u64 inde
   sta_glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.ebo);
   sta_glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32) * index_count, indices, GL_STATIC_DRAW);
 
-  u32 size = 0;
-  for (u32 i = 0; i < attribute_count; i++)
-  {
-    size += attributes[i].count;
-  }
-  size *= 4;
-  u32 stride = 0;
-  for (u32 i = 0; i < attribute_count; i++)
-  {
+  enable_vertex_attributes(attributes, attribute_count);
 
-    BufferAttributes attribute = attributes[i];
-    switch (attribute.type)
-    {
-    case BUFFER_ATTRIBUTE_FLOAT:
-    {
-      sta_glVertexAttribPointer(i, attribute.count, GL_FLOAT, GL_FALSE, size, (void*)(stride * sizeof(int)));
-      break;
-    }
-    case BUFFER_ATTRIBUTE_INT:
-    {
-      sta_glVertexAttribIPointer(i, attribute.count, GL_INT, size, (void*)(stride * sizeof(int)));
-      break;
-    }
-    }
-    stride += attribute.count;
-    sta_glEnableVertexAttribArray(i);
-  }
-
-  if (this->index_buffers_cap == 0)
-  {
-    this->index_buffers_count = 1;
-    this->index_buffers_cap   = 1;
-    this->index_buffers       = (GLBufferIndex*)sta_allocate_struct(GLBufferIndex, 1);
-    this->index_buffers[0]    = buffer;
-    return 0;
-  }
-  RESIZE_ARRAY(this->index_buffers, GLBufferIndex, this->index_buffers_count, this->index_buffers_cap);
-  this->index_buffers[this->index_buffers_count] = buffer;
-  return this->index_buffers_count++;
+  return this->add_index_buffer(buffer);
 }
 void Renderer::render_buffer(u32 buffer_id)
 {
@@ -655,6 +1630,12 @@ void Renderer::render_buffer(u32 buffer_id)
   glDrawElements(GL_TRIANGLES, this->index_buffers[buffer_id].index_count, GL_UNSIGNED_INT, 0);
   sta_glBindVertexArray(0);
 }
+void Renderer::render_buffer_instanced(u32 buffer_id, u32 instance_count)
+{
+  sta_glBindVertexArray(this->index_buffers[buffer_id].vao);
+  sta_glDrawElementsInstanced(GL_TRIANGLES, this->index_buffers[buffer_id].index_count, GL_UNSIGNED_INT, 0, instance_count);
+  sta_glBindVertexArray(0);
+}
 
 void Renderer::clear_framebuffer()
 {
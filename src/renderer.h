@@ -6,6 +6,7 @@
 #include "common.h"
 #include "files.h"
 #include "font.h"
+#include "jobs.h"
 #include "platform.h"
 #include "sdl.h"
 #include "shader.h"
@@ -54,10 +55,20 @@ enum TextAlignment
   TextAlignment_Centered
 };
 
+// count is always the number of 4 byte components the attribute takes in the model's vertex data,
+// anything but FLOAT and INT is packed from them when the buffer is created
 enum BufferAttributeType
 {
   BUFFER_ATTRIBUTE_FLOAT,
   BUFFER_ATTRIBUTE_INT,
+  // half floats
+  BUFFER_ATTRIBUTE_HALF,
+  // up to 3 floats in [-1, 1] as signed normalized 10:10:10:2, for normals and tangents
+  BUFFER_ATTRIBUTE_SNORM_10_10_10_2,
+  // 4 joint weights as normalized bytes that still sum to 1
+  BUFFER_ATTRIBUTE_WEIGHTS_U8,
+  // integers below 256, for joint indices
+  BUFFER_ATTRIBUTE_U8,
 };
 
 struct BufferAttributes
@@ -69,8 +80,10 @@ struct BufferAttributes
 
 struct GLBufferIndex
 {
-  GLuint vao, vbo, ebo;
-  GLuint index_count;
+  GLuint  vao, vbo, ebo;
+  GLuint  index_count;
+  Vector3 bounds_center;
+  f32     bounds_radius;
 };
 
 struct Texture
@@ -94,6 +107,94 @@ struct RenderQueueItemStatic
   u32   buffer;
   Mat44 m;
   u32 texture;
+  bool  static_caster;
+  bool  effect;
+};
+
+enum ShadowCasterFilter
+{
+  SHADOW_CASTERS_ALL,
+  SHADOW_CASTERS_STATIC,
+  SHADOW_CASTERS_DYNAMIC,
+};
+
+enum CubeShadowMode
+{
+  CUBE_SHADOW_GEOMETRY_SHADER,
+  CUBE_SHADOW_PER_FACE,
+  CUBE_SHADOW_LAYERED_INSTANCED,
+  CUBE_SHADOW_MODE_COUNT,
+};
+
+const char* cube_shadow_mode_name(CubeShadowMode mode);
+
+enum GpuPass
+{
+  GPU_PASS_DEPTH_DIRECTIONAL,
+  GPU_PASS_DEPTH_CUBE,
+  GPU_PASS_STATIC,
+  GPU_PASS_ANIMATED,
+  GPU_PASS_EFFECTS,
+  GPU_PASS_UI,
+  GPU_PASS_COUNT,
+};
+
+const char* gpu_pass_name(GpuPass pass);
+
+// GL_TIME_ELAPSED per pass, a slot is only read back GPU_TIMER_LATENCY frames after
+// it was issued so the CPU never waits on the GPU
+#define GPU_TIMER_LATENCY 4
+struct GpuTimers
+{
+  GLuint queries[GPU_TIMER_LATENCY][GPU_PASS_COUNT];
+  bool   issued[GPU_TIMER_LATENCY][GPU_PASS_COUNT];
+  u32    slot;
+  i32    active_pass;
+  f64    last_ms[GPU_PASS_COUNT];
+  f64    total_ms[GPU_PASS_COUNT];
+  u64    sample_count[GPU_PASS_COUNT];
+  // results that still weren't ready when their slot came around again
+  u64    missed;
+  bool   enabled;
+};
+
+// Depth of everything that never moves (map + static geometry),
+// rendered once per light/static set and copied into the live shadow maps each frame
+struct ShadowCache
+{
+  GLuint  directional_framebuffer;
+  GLuint  directional_texture;
+  GLuint  cube_framebuffer;
+  GLuint  cube_face_framebuffers[6];
+  GLuint  cube_texture;
+  Vector3 directional_light;
+  Vector3 point_light;
+  u32     directional_static_hash;
+  u32     cube_static_hash;
+  bool    directional_valid;
+  bool    cube_valid;
+};
+
+// One corner of a glyph quad, position in NDC and the color as normalized bytes
+struct TextVertex
+{
+  f32 x, y;
+  f32 u, v;
+  u8  r, g, b, a;
+};
+
+#define GLYPH_ATLAS_SIZE 512
+
+// Staging buffers the cooked texture mips are copied through, a slot is only written again
+// once the fence of the upload that last used it has signaled
+#define TEXTURE_UPLOAD_RING_SIZE  4
+#define TEXTURE_UPLOAD_SLOT_BYTES (4 * 1024 * 1024)
+struct TextureUploadRing
+{
+  GLuint buffers[TEXTURE_UPLOAD_RING_SIZE];
+  GLsync fences[TEXTURE_UPLOAD_RING_SIZE];
+  u32    slot;
+  bool   enabled;
 };
 
 struct Renderer
@@ -111,18 +212,39 @@ public:
 
   void                     push_render_item_animated(u32 buffer, Mat44 m, Mat44* transforms, u32 joint_count, u32 texture, u32 normal_map);
   void                     push_render_item_static(u32 buffer, Mat44 m, u32 texture);
+  void                     push_render_item_static_caster(u32 buffer, Mat44 m, u32 texture);
+  void                     push_render_item_effect(u32 buffer, Mat44 m, u32 texture);
   void                     render_to_depth_texture_directional(Vector3 light_direction);
-  void                     render_to_depth_texture_cube(Vector3 light_position, u32 buffer);
+  void                     render_to_depth_texture_cube(Vector3 light_position);
   void                     render_queues(Mat44 view, Vector3 view_position, Mat44 projection, Vector3 light_position, u32 cube_map, Vector3 directional_light_direction);
 
   u32                      line_vao, line_vbo;
   u32                      shadow_width, shadow_height;
   GLuint                   shadow_map_framebuffer;
   u32                      depth_texture;
+  GLuint                   shadow_cube_framebuffer;
+  GLuint                   shadow_cube_face_framebuffers[6];
+  u32                      depth_cube_texture;
+
+  CubeShadowMode           cube_shadow_mode;
+  bool                     supports_vertex_layer;
+  u32                      cube_shadow_culled;
+
+  bool                     shadow_caching;
+  ShadowCache              shadow_cache;
+
+  GpuTimers                gpu_timers;
 
   Texture*                 textures;
   u32                      texture_count;
   u32                      texture_capacity;
+  // decoded on workers, uploaded in order by upload_loaded_textures
+  TextureLoad*             texture_loads;
+  u32                      textures_uploaded;
+  // bytes a single upload_loaded_textures call uploads before handing back, 0 uploads everything that is ready
+  u64                      texture_upload_budget;
+  bool                     supports_compressed_textures;
+  TextureUploadRing        texture_upload_ring;
   RenderBuffer*            buffers;
   u32                      buffer_count;
   Shader*                  shaders;
@@ -131,6 +253,17 @@ public:
   Shader                   circle_shader;
   u64                      used_texture_units;
 
+  // glyphs are rasterized once into the atlas, render_text only queues quads and flush_text draws all of them
+  AFont                    font;
+  GlyphAtlas               glyph_atlas;
+  u32                      glyph_atlas_texture;
+  GLuint                   text_vao, text_vbo;
+  Shader                   text_shader;
+  TextVertex*              text_vertices;
+  u32                      text_vertex_count;
+  u32                      text_vertex_capacity;
+  bool                     text_enabled;
+
   GLBufferIndex            circle_buffer;
   GLBufferIndex*           index_buffers;
   u32                      index_buffers_count;
@@ -140,23 +273,63 @@ public:
 
   u32                      screen_width, screen_height;
   bool                     vsync;
+  bool                     headless;
   SDL_Window*              window;
   SDL_GLContext            context;
   Renderer()
   {
   }
+  // headless renderer, never touches SDL/GL but still hands out
+  // buffer, texture and shader handles so the game data can be loaded
+  Renderer(Logger* logger)
+  {
+    this->headless                       = true;
+    this->logger                         = logger;
+    this->window                         = 0;
+    this->context                        = 0;
+    this->screen_width                   = 0;
+    this->screen_height                  = 0;
+    this->index_buffers_cap              = 0;
+    this->index_buffers_count            = 0;
+    this->texture_count                  = 0;
+    this->texture_loads                  = 0;
+    this->textures_uploaded              = 0;
+    this->texture_upload_budget          = 0;
+    this->supports_compressed_textures   = false;
+    this->texture_upload_ring            = {};
+    this->used_texture_units             = 0;
+    this->render_queue_static_count      = 0;
+    this->render_queue_static_capacity   = 2;
+    this->render_queue_static_buffers    = sta_allocate_struct(RenderQueueItemStatic, this->render_queue_static_capacity);
+    this->render_queue_animated_count    = 0;
+    this->render_queue_animated_capacity = 2;
+    this->render_queue_animated_buffers  = sta_allocate_struct(RenderQueueItemAnimated, this->render_queue_animated_capacity);
+    this->shadow_caching                 = false;
+    this->shadow_cache                   = {};
+    this->gpu_timers                     = {};
+    this->cube_shadow_mode               = CUBE_SHADOW_GEOMETRY_SHADER;
+    this->supports_vertex_layer          = false;
+    this->text_enabled                   = false;
+    this->text_vertex_count              = 0;
+  }
   Renderer(u32 screen_width, u32 screen_height, Logger* logger, bool vsync)
   {
-    this->vsync  = !vsync;
-    this->logger = logger;
+    this->headless = false;
+    this->vsync    = !vsync;
+    this->logger   = logger;
     sta_init_sdl_gl(&window, &context, screen_width, screen_height, this->vsync);
     this->screen_width  = screen_width;
     this->screen_height = screen_height;
     this->init_circle_buffer();
     this->init_line_buffer();
+    this->init_texture_upload_ring();
     this->index_buffers_cap              = 0;
     this->index_buffers_count            = 0;
     this->texture_count                  = 0;
+    this->texture_loads                  = 0;
+    this->textures_uploaded              = 0;
+    this->texture_upload_budget          = 16 * 1024 * 1024;
+    this->supports_compressed_textures   = sta_gl_has_extension("GL_EXT_texture_compression_s3tc");
     this->used_texture_units             = 0;
     this->render_queue_static_count      = 0;
     this->render_queue_static_capacity   = 2;
@@ -164,18 +337,36 @@ public:
     this->render_queue_animated_count    = 0;
     this->render_queue_animated_capacity = 2;
     this->render_queue_animated_buffers  = sta_allocate_struct(RenderQueueItemAnimated, this->render_queue_animated_capacity);
+    this->shadow_caching                 = true;
+    this->cube_shadow_mode               = CUBE_SHADOW_GEOMETRY_SHADER;
+    this->supports_vertex_layer          = sta_gl_has_extension("GL_ARB_shader_viewport_layer_array");
+    this->shadow_cache                   = {};
+    this->gpu_timers                     = {};
+    this->text_enabled                   = false;
+    this->text_vertex_count              = 0;
   }
 
   // manage some buffer
   void    init_depth_texture();
+  void    init_depth_cube_texture();
+  void    init_shadow_cache();
+  void    invalidate_shadow_cache();
+  bool    set_cube_shadow_mode(CubeShadowMode mode);
+  void    init_gpu_timers();
+  void    begin_gpu_frame();
+  void    begin_gpu_pass(GpuPass pass);
+  void    end_gpu_pass();
   u32     create_buffer_indices(u64 buffer_size, void* buffer_data, u64 index_count, u32* indices, BufferAttributes* attributes, u32 attribute_count);
   u32     create_buffer(u64 buffer_size, void* buffer_data, BufferAttributes* attributes, u64 attribute_count);
   u32     create_texture(u32 width, u32 height, void* data);
+  u32     create_compressed_texture(CookedTexture* texture);
+  void    init_texture_upload_ring();
   void    bind_texture(Shader shader, const char* uniform_name, u32 texture_index);
   void    bind_cube_texture(Shader shader, const char* uniform_name, u32 texture_index);
   u32     create_buffer_from_model(Model* model, BufferAttributes* attributes, u32 attribute_count);
   bool    load_shaders_from_files(const char* file_location);
-  bool    load_textures_from_files(const char* file_location);
+  bool    queue_textures_from_files(const char* file_location, WorkQueue* queue);
+  u32     upload_loaded_textures();
   u32     add_texture(u32 texture_id);
   void    reload_shaders();
   void    draw_line(f32 x1, f32 y1, f32 x2, f32 y2, u32 line_width, Color color);
@@ -187,7 +378,12 @@ public:
 
   // render some buffer
   void render_buffer(u32 buffer_id);
+  void render_buffer_instanced(u32 buffer_id, u32 instance_count);
+  // x/y in NDC, alignment_x picks whether x is the left edge, right edge or center of the line and
+  // alignment_y whether y is its top, bottom or middle, font_size is in pixels. Only queues the quads
+  bool init_text(const char* font_filename);
   void render_text(const char* string, u32 string_length, f32 x, f32 y, TextAlignment alignment_x, TextAlignment alignment_y, Color color, f32 font_size);
+  void flush_text();
 
   // change some context
   void toggle_wireframe_on();
@@ -207,6 +403,13 @@ public:
 private:
   void init_circle_buffer();
   u32  get_free_texture_unit();
+  u32  add_index_buffer(GLBufferIndex buffer);
+  void upload_compressed_mip(GLenum format, u32 level, u32 width, u32 height, void* data, u32 size);
+  u32  hash_static_casters();
+  void render_depth_queue_static(Shader* depth_shader, ShadowCasterFilter filter);
+  void render_depth_queue_animated(Shader* depth_shader);
+  void render_depth_cube(GLuint framebuffer, GLuint* face_framebuffers, Mat44* shadow_transforms, Vector3 light_position, f32 far_plane, ShadowCasterFilter filter, bool clear);
+  bool is_in_cube_face(u32 buffer, Mat44 m, f32 bounds_scale, Vector3 light_position, u32 face, f32 far_plane);
 };
 
 #endif
@@ -0,0 +1,176 @@
+#include "replay.h"
+
+bool InputRecorder::begin(const char* filename, u64 seed, u32 timestep_ms)
+{
+  this->file = fopen(filename, "wb");
+  if (!this->file)
+  {
+    logger.error("Failed to open input log '%s'", filename);
+    return false;
+  }
+  this->header.magic               = INPUT_LOG_MAGIC;
+  this->header.version             = INPUT_LOG_VERSION;
+  this->header.seed                = seed;
+  this->header.timestep_ms         = timestep_ms;
+  this->header.tick_count          = 0;
+  this->previous_event_count       = 0;
+  this->previous_mouse_position[0] = FLT_MAX;
+  this->previous_mouse_position[1] = FLT_MAX;
+
+  // tick count is patched in by end
+  fwrite(&this->header, sizeof(InputLogHeader), 1, this->file);
+  return true;
+}
+
+void InputRecorder::record(InputState* input)
+{
+  u8 flags = 0;
+  if (input->event_count != this->previous_event_count || memcmp(input->events, this->previous_events, sizeof(InputEvent) * input->event_count) != 0)
+  {
+    flags |= INPUT_LOG_EVENTS_CHANGED;
+  }
+  if (memcmp(input->mouse_position, this->previous_mouse_position, sizeof(f32) * 2) != 0)
+  {
+    flags |= INPUT_LOG_MOUSE_CHANGED;
+  }
+  if (input->mouse_wheel_direction != 0)
+  {
+    flags |= INPUT_LOG_WHEEL;
+  }
+
+  fwrite(&flags, sizeof(u8), 1, this->file);
+  if (flags & INPUT_LOG_EVENTS_CHANGED)
+  {
+    u8 count = input->event_count;
+    fwrite(&count, sizeof(u8), 1, this->file);
+    for (u32 i = 0; i < input->event_count; i++)
+    {
+      u8 state = input->events[i].state;
+      fwrite(&state, sizeof(u8), 1, this->file);
+      fwrite(&input->events[i].key, sizeof(u32), 1, this->file);
+    }
+    memcpy(this->previous_events, input->events, sizeof(InputEvent) * input->event_count);
+    this->previous_event_count = input->event_count;
+  }
+  if (flags & INPUT_LOG_MOUSE_CHANGED)
+  {
+    fwrite(input->mouse_position, sizeof(f32), 2, this->file);
+    this->previous_mouse_position[0] = input->mouse_position[0];
+    this->previous_mouse_position[1] = input->mouse_position[1];
+  }
+  if (flags & INPUT_LOG_WHEEL)
+  {
+    fwrite(&input->mouse_wheel_direction, sizeof(f32), 1, this->file);
+  }
+  this->header.tick_count++;
+}
+
+bool InputRecorder::end()
+{
+  if (!this->file)
+  {
+    return false;
+  }
+  fseek(this->file, 0, SEEK_SET);
+  fwrite(&this->header, sizeof(InputLogHeader), 1, this->file);
+  bool ok    = fclose(this->file) == 0;
+  this->file = 0;
+  logger.info("Recorded %u ticks of input", this->header.tick_count);
+  return ok;
+}
+
+bool InputReplay::load(const char* filename)
+{
+  if (!sta_map_file(&this->buffer, filename))
+  {
+    logger.error("Failed to read input log '%s'", filename);
+    return false;
+  }
+  if (this->buffer.len < sizeof(InputLogHeader))
+  {
+    logger.error("Input log '%s' is truncated", filename);
+    return false;
+  }
+  this->header = *(InputLogHeader*)this->buffer.read(sizeof(InputLogHeader));
+  if (this->header.magic != INPUT_LOG_MAGIC || this->header.version != INPUT_LOG_VERSION)
+  {
+    logger.error("'%s' is not an input log or has the wrong version", filename);
+    return false;
+  }
+  this->tick              = 0;
+  this->event_count       = 0;
+  this->mouse_position[0] = FLT_MAX;
+  this->mouse_position[1] = FLT_MAX;
+  return true;
+}
+
+// Copies the next size bytes out of the log, false if the log ends before that
+bool InputReplay::read(void* out, u64 size)
+{
+  if (this->buffer.len - this->buffer.index < size)
+  {
+    return false;
+  }
+  memcpy(out, this->buffer.read(size), size);
+  return true;
+}
+
+// Overwrites the input with what was recorded for the next tick, returns false once the log runs out
+// or a record is cut short
+bool InputReplay::next(InputState* input)
+{
+  if (this->is_finished() || this->buffer.is_out_of_bounds())
+  {
+    return false;
+  }
+
+  u8 flags = 0;
+  if (!this->read(&flags, sizeof(u8)))
+  {
+    return false;
+  }
+  if (flags & INPUT_LOG_EVENTS_CHANGED)
+  {
+    u8 event_count = 0;
+    if (!this->read(&event_count, sizeof(u8)))
+    {
+      return false;
+    }
+    // a corrupt count past what the input holds still has its events skipped so the next tick lines up
+    this->event_count = MIN((u32)event_count, (u32)ArrayCount(this->events));
+    for (u32 i = 0; i < event_count; i++)
+    {
+      u8  state;
+      u32 key;
+      if (!this->read(&state, sizeof(u8)) || !this->read(&key, sizeof(u32)))
+      {
+        logger.warning("Input log is cut short at tick %u", this->tick);
+        this->event_count = 0;
+        return false;
+      }
+      if (i < this->event_count)
+      {
+        this->events[i].state = (InputEventType)state;
+        this->events[i].key   = key;
+      }
+    }
+  }
+  input->mouse_wheel_direction = 0;
+  if (((flags & INPUT_LOG_MOUSE_CHANGED) && !this->read(this->mouse_position, sizeof(f32) * 2)) ||
+      ((flags & INPUT_LOG_WHEEL) && !this->read(&input->mouse_wheel_direction, sizeof(f32))))
+  {
+    logger.warning("Input log is cut short at tick %u", this->tick);
+    return false;
+  }
+
+  memcpy(input->events, this->events, sizeof(InputEvent) * this->event_count);
+  input->event_count       = this->event_count;
+  input->mouse_position[0] = this->mouse_position[0];
+  input->mouse_position[1] = this->mouse_position[1];
+  for (u32 i = 0; i < input->sequence_count; i++)
+  {
+    input->sequences[i].update(input->events, input->event_count);
+  }
+  this->tick++;
+  return true;
+}
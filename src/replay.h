@@ -0,0 +1,76 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "common.h"
+#include "files.h"
+#include "input.h"
+
+// "MPRP"
+#define INPUT_LOG_MAGIC   0x5052504D
+#define INPUT_LOG_VERSION 1
+
+// Every tick starts with a flags byte, anything that didn't change since the previous tick is left out
+enum InputLogFlags
+{
+  INPUT_LOG_EVENTS_CHANGED = 1 << 0,
+  INPUT_LOG_MOUSE_CHANGED  = 1 << 1,
+  INPUT_LOG_WHEEL          = 1 << 2,
+};
+
+struct InputLogHeader
+{
+  u32 magic;
+  u32 version;
+  u64 seed;
+  u32 timestep_ms;
+  u32 tick_count;
+};
+
+struct InputRecorder
+{
+public:
+  InputRecorder()
+  {
+    this->file = 0;
+  }
+  bool begin(const char* filename, u64 seed, u32 timestep_ms);
+  void record(InputState* input);
+  bool end();
+  bool is_recording()
+  {
+    return this->file != 0;
+  }
+
+private:
+  FILE*          file;
+  InputLogHeader header;
+  InputEvent     previous_events[ArrayCount(InputState::events)];
+  u32            previous_event_count;
+  f32            previous_mouse_position[2];
+};
+
+struct InputReplay
+{
+public:
+  InputReplay()
+  {
+    this->tick = 0;
+  }
+  bool           load(const char* filename);
+  bool           next(InputState* input);
+  bool           is_finished()
+  {
+    return this->tick >= this->header.tick_count;
+  }
+  InputLogHeader header;
+
+private:
+  bool       read(void* out, u64 size);
+  Buffer     buffer;
+  u32        tick;
+  InputEvent events[ArrayCount(InputState::events)];
+  u32        event_count;
+  f32        mouse_position[2];
+};
+
+#endif
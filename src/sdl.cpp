@@ -67,6 +67,18 @@ PFNGLGETATTRIBLOCATIONPROC        glGetAttribLocation        = NULL;
 PFNGLISPROGRAMPROC                glIsProgram                = NULL;
 PFNGLDRAWELEMENTSBASEVERTEXPROC   glDrawElementsBaseVertex   = NULL;
 PFNGLFRAMEBUFFERTEXTUREPROC       glFramebufferTexture       = NULL;
+PFNGLCOPYIMAGESUBDATAPROC         glCopyImageSubData         = NULL;
+PFNGLDRAWELEMENTSINSTANCEDPROC    glDrawElementsInstanced    = NULL;
+PFNGLGENQUERIESPROC               glGenQueries               = NULL;
+PFNGLDELETEQUERIESPROC            glDeleteQueries            = NULL;
+PFNGLBEGINQUERYPROC               glBeginQuery               = NULL;
+PFNGLENDQUERYPROC                 glEndQuery                 = NULL;
+PFNGLGETQUERYOBJECTIVPROC         glGetQueryObjectiv         = NULL;
+PFNGLGETQUERYOBJECTUI64VPROC      glGetQueryObjectui64v      = NULL;
+PFNGLMAPBUFFERRANGEPROC           glMapBufferRange           = NULL;
+PFNGLFENCESYNCPROC                glFenceSync                = NULL;
+PFNGLCLIENTWAITSYNCPROC           glClientWaitSync           = NULL;
+PFNGLDELETESYNCPROC               glDeleteSync               = NULL;
 
 void                              loadExtensions()
 {
@@ -136,6 +148,18 @@ void                              loadExtensions()
   glEnableVertexArrayAttrib  = (PFNGLENABLEVERTEXARRAYATTRIBPROC)SDL_GL_GetProcAddress("glEnableVertexArrayAttrib");
   glVertexArrayAttribFormat  = (PFNGLVERTEXARRAYATTRIBFORMATPROC)SDL_GL_GetProcAddress("glVertexArrayAttribFormat");
   glVertexArrayAttribBinding = (PFNGLVERTEXARRAYATTRIBBINDINGPROC)SDL_GL_GetProcAddress("glVertexArrayAttribBinding");
+  glCopyImageSubData         = (PFNGLCOPYIMAGESUBDATAPROC)SDL_GL_GetProcAddress("glCopyImageSubData");
+  glDrawElementsInstanced    = (PFNGLDRAWELEMENTSINSTANCEDPROC)SDL_GL_GetProcAddress("glDrawElementsInstanced");
+  glGenQueries               = (PFNGLGENQUERIESPROC)SDL_GL_GetProcAddress("glGenQueries");
+  glDeleteQueries            = (PFNGLDELETEQUERIESPROC)SDL_GL_GetProcAddress("glDeleteQueries");
+  glBeginQuery               = (PFNGLBEGINQUERYPROC)SDL_GL_GetProcAddress("glBeginQuery");
+  glEndQuery                 = (PFNGLENDQUERYPROC)SDL_GL_GetProcAddress("glEndQuery");
+  glGetQueryObjectiv         = (PFNGLGETQUERYOBJECTIVPROC)SDL_GL_GetProcAddress("glGetQueryObjectiv");
+  glGetQueryObjectui64v      = (PFNGLGETQUERYOBJECTUI64VPROC)SDL_GL_GetProcAddress("glGetQueryObjectui64v");
+  glMapBufferRange           = (PFNGLMAPBUFFERRANGEPROC)SDL_GL_GetProcAddress("glMapBufferRange");
+  glFenceSync                = (PFNGLFENCESYNCPROC)SDL_GL_GetProcAddress("glFenceSync");
+  glClientWaitSync           = (PFNGLCLIENTWAITSYNCPROC)SDL_GL_GetProcAddress("glClientWaitSync");
+  glDeleteSync               = (PFNGLDELETESYNCPROC)SDL_GL_GetProcAddress("glDeleteSync");
 }
 void sta_glCreateVertexArrays(GLsizei n, GLuint* arrays)
 {
@@ -340,6 +364,86 @@ void sta_glFramebufferTexture(GLenum target, GLenum attachment, GLuint texture,
 {
   glFramebufferTexture(target, attachment, texture, level);
 }
+void sta_glCopyImageSubData(GLuint src_name, GLenum src_target, GLint src_level, GLint src_x, GLint src_y, GLint src_z, GLuint dst_name, GLenum dst_target, GLint dst_level, GLint dst_x,
+                            GLint dst_y, GLint dst_z, GLsizei width, GLsizei height, GLsizei depth)
+{
+  glCopyImageSubData(src_name, src_target, src_level, src_x, src_y, src_z, dst_name, dst_target, dst_level, dst_x, dst_y, dst_z, width, height, depth);
+}
+bool sta_gl_has_copy_image()
+{
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  return glCopyImageSubData != NULL && (major > 4 || (major == 4 && minor >= 3));
+}
+bool sta_gl_has_extension(const char* name)
+{
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; i++)
+  {
+    if (compare_strings(name, (const char*)glGetStringi(GL_EXTENSIONS, i)))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+void sta_glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instance_count)
+{
+  glDrawElementsInstanced(mode, count, type, indices, instance_count);
+}
+bool sta_gl_has_timer_query()
+{
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  return glGetQueryObjectui64v != NULL && (major > 3 || (major == 3 && minor >= 3) || sta_gl_has_extension("GL_ARB_timer_query"));
+}
+void sta_glGenQueries(GLsizei n, GLuint* ids)
+{
+  glGenQueries(n, ids);
+}
+void sta_glDeleteQueries(GLsizei n, const GLuint* ids)
+{
+  glDeleteQueries(n, ids);
+}
+void sta_glBeginQuery(GLenum target, GLuint id)
+{
+  glBeginQuery(target, id);
+}
+void sta_glEndQuery(GLenum target)
+{
+  glEndQuery(target);
+}
+void sta_glGetQueryObjectiv(GLuint id, GLenum pname, GLint* params)
+{
+  glGetQueryObjectiv(id, pname, params);
+}
+void sta_glGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params)
+{
+  glGetQueryObjectui64v(id, pname, params);
+}
+void sta_glCompressedTexImage2D(GLenum target, GLint level, GLenum internal_format, GLsizei width, GLsizei height, GLint border, GLsizei image_size, const void* data)
+{
+  glCompressedTexImage2D(target, level, internal_format, width, height, border, image_size, data);
+}
+void* sta_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+  return glMapBufferRange(target, offset, length, access);
+}
+GLsync sta_glFenceSync(GLenum condition, GLbitfield flags)
+{
+  return glFenceSync(condition, flags);
+}
+GLenum sta_glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout)
+{
+  return glClientWaitSync(sync, flags, timeout);
+}
+void sta_glDeleteSync(GLsync sync)
+{
+  glDeleteSync(sync);
+}
 void sta_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level)
 {
   glFramebufferTexture2D(target, attachment, textarget, texture, level);
@@ -133,6 +133,23 @@ void      sta_glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers);
 void      sta_glBindFramebuffer(GLenum target, GLuint framebuffer);
 void      sta_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
 void      sta_glFramebufferTexture(GLenum target, GLenum attachment, GLuint texture, GLint level);
+void      sta_glCopyImageSubData(GLuint src_name, GLenum src_target, GLint src_level, GLint src_x, GLint src_y, GLint src_z, GLuint dst_name, GLenum dst_target, GLint dst_level, GLint dst_x,
+                                 GLint dst_y, GLint dst_z, GLsizei width, GLsizei height, GLsizei depth);
+bool      sta_gl_has_copy_image();
+bool      sta_gl_has_extension(const char* name);
+void      sta_glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instance_count);
+bool      sta_gl_has_timer_query();
+void      sta_glGenQueries(GLsizei n, GLuint* ids);
+void      sta_glDeleteQueries(GLsizei n, const GLuint* ids);
+void      sta_glBeginQuery(GLenum target, GLuint id);
+void      sta_glEndQuery(GLenum target);
+void      sta_glGetQueryObjectiv(GLuint id, GLenum pname, GLint* params);
+void      sta_glGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params);
+void      sta_glCompressedTexImage2D(GLenum target, GLint level, GLenum internal_format, GLsizei width, GLsizei height, GLint border, GLsizei image_size, const void* data);
+void*     sta_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+GLsync    sta_glFenceSync(GLenum condition, GLbitfield flags);
+GLenum    sta_glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout);
+void      sta_glDeleteSync(GLsync sync);
 void      sta_glGenRenderbuffers(GLsizei n, GLuint* renderbuffers);
 void      sta_glBindRenderbuffer(GLenum target, GLuint renderbuffer);
 void      sta_glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
@@ -94,7 +94,7 @@ GLuint compile_shader(const char* path, GLint shader_type)
 {
 
   Buffer buffer = {};
-  if (!sta_read_file(&buffer, path))
+  if (!sta_map_file(&buffer, path))
   {
     logger.error("Failed to read shader from '%s'\n", path, shader_type);
     return -1;
@@ -103,6 +103,7 @@ GLuint compile_shader(const char* path, GLint shader_type)
   unsigned int vertex         = sta_glCreateShader(shader_type);
   sta_glShaderSource(vertex, 1, &vertex_content, 0);
   sta_glCompileShader(vertex);
+  sta_unmap_file(&buffer);
 
   if (!test_shader_compilation(vertex))
   {
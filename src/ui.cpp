@@ -16,18 +16,195 @@ void init_imgui(SDL_Window* window, SDL_GLContext context)
   ImGui_ImplOpenGL3_Init();
 }
 
-void render_game_running_ui(Hero* player, u32 ms, f32 fps, u32 update_ticks, u32 render_ticks, u32 game_running_ticks, u32 screen_height, u32 clear_ticks, u32 render_ui_ticks)
+static bool show_profiler           = false;
+// frames ago, only valid while the profiler is paused
+static u32  profiler_selected_frame = 0;
+
+static ImU32 get_profile_label_color(const char* label)
+{
+  String s((char*)label, strlen(label));
+  u32    hash = sta_hash_string_fnv(&s);
+  return IM_COL32(90 + hash % 140, 90 + (hash >> 8) % 140, 90 + (hash >> 16) % 140, 255);
+}
+
+static void render_profiler_ui()
 {
+  u32 frame_count = getProfiledFrameCount();
+  ImGui::SetNextWindowSize(ImVec2(600, 320), ImGuiCond_Appearing);
+  ImGui::Begin("Profiler", &show_profiler);
+  if (ImGui::Checkbox("Paused", &frameProfiler.paused))
+  {
+    profiler_selected_frame = 0;
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Export trace"))
+  {
+    const char* filename = "profile_trace.json";
+    if (exportChromeTrace(filename, frame_count))
+    {
+      logger.info("Wrote %u frames to %s", frame_count, filename);
+    }
+    else
+    {
+      logger.error("Failed to write %s", filename);
+    }
+  }
+  if (frame_count == 0)
+  {
+    ImGui::End();
+    return;
+  }
+  if (!frameProfiler.paused)
+  {
+    profiler_selected_frame = 0;
+  }
+  profiler_selected_frame = MIN(profiler_selected_frame, frame_count - 1);
+
+  // frame history, oldest to the left, click a bar to pause on that frame
+  ImDrawList* draw_list = ImGui::GetWindowDrawList();
+  ImVec2      origin    = ImGui::GetCursorScreenPos();
+  f32         width     = ImGui::GetContentRegionAvail().x;
+  f32         height    = 60.0f;
+  f32         bar_width = width / (f32)(PROFILER_FRAME_COUNT - 1);
+  f64         budget_ms = 1000.0 / 60.0;
+  ImGui::InvisibleButton("##frames", ImVec2(width, height));
+  bool hovered = ImGui::IsItemHovered();
+  for (u32 i = 0; i < frame_count; i++)
+  {
+    ProfileFrame* frame = getProfiledFrame(i);
+    f64           ms    = profilerCyclesToMs(frame->end - frame->start);
+    f32           x     = origin.x + width - (i + 1) * bar_width;
+    f32           h     = MIN(ms / (2 * budget_ms), 1.0) * height;
+    ImU32         color = i == profiler_selected_frame ? IM_COL32(255, 255, 255, 255) : ms > budget_ms ? IM_COL32(220, 80, 60, 255) : IM_COL32(80, 180, 90, 255);
+    draw_list->AddRectFilled(ImVec2(x, origin.y + height - h), ImVec2(x + bar_width - 1, origin.y + height), color);
+    if (hovered && ImGui::GetMousePos().x >= x && ImGui::GetMousePos().x < x + bar_width)
+    {
+      ImGui::SetTooltip("%.3f ms", ms);
+      if (ImGui::IsMouseClicked(0))
+      {
+        frameProfiler.paused    = true;
+        profiler_selected_frame = i;
+      }
+    }
+  }
+  f32 budget_y = origin.y + height * 0.5f;
+  draw_list->AddLine(ImVec2(origin.x, budget_y), ImVec2(origin.x + width, budget_y), IM_COL32(255, 255, 255, 80));
+
+  // flame view of the selected frame, one lane per thread and one row per depth within it
+  ProfileFrame* frame    = getProfiledFrame(profiler_selected_frame);
+  f64           frame_ms = profilerCyclesToMs(frame->end - frame->start);
+  ImGui::Text("Frame %.3f ms, %u blocks%s", frame_ms, frame->eventCount, frame->droppedEvents ? " (dropped some)" : "");
 
+  u32 lane_rows[PROFILER_MAX_THREADS] = {};
+  u32 lane_start[PROFILER_MAX_THREADS];
+  for (u32 i = 0; i < frame->eventCount; i++)
+  {
+    ProfileEvent* event        = &frame->events[i];
+    lane_rows[event->threadId] = MAX(lane_rows[event->threadId], event->depth + 1);
+  }
+  u32 total_rows = 0;
+  for (u32 i = 0; i < PROFILER_MAX_THREADS; i++)
+  {
+    lane_start[i] = total_rows;
+    total_rows += lane_rows[i];
+  }
+  f32 row_height = ImGui::GetTextLineHeight() + 4.0f;
+  origin         = ImGui::GetCursorScreenPos();
+  ImGui::InvisibleButton("##flame", ImVec2(width, row_height * MAX(total_rows, 1)));
+  hovered      = ImGui::IsItemHovered();
+  f64 to_width = width / (f64)(frame->end - frame->start);
+  for (u32 i = 1; i < PROFILER_MAX_THREADS; i++)
+  {
+    if (lane_rows[i])
+    {
+      f32 y = origin.y + lane_start[i] * row_height - 1;
+      draw_list->AddLine(ImVec2(origin.x, y), ImVec2(origin.x + width, y), IM_COL32(255, 255, 255, 120));
+    }
+  }
+  for (u32 i = 0; i < frame->eventCount; i++)
+  {
+    ProfileEvent* event = &frame->events[i];
+    // worker blocks can start before or end after the frame
+    f32           start = CLAMP((i64)(event->start - frame->start) * to_width, 0, width);
+    f32           end   = CLAMP((i64)(event->end - frame->start) * to_width, 0, width);
+    ImVec2        min(origin.x + start, origin.y + (lane_start[event->threadId] + event->depth) * row_height);
+    ImVec2        max(origin.x + end, min.y + row_height - 1);
+    max.x = MAX(max.x, min.x + 1);
+    draw_list->AddRectFilled(min, max, get_profile_label_color(event->label));
+    draw_list->PushClipRect(min, max, true);
+    draw_list->AddText(ImVec2(min.x + 2, min.y + 2), IM_COL32(0, 0, 0, 255), event->label);
+    draw_list->PopClipRect();
+
+    ImVec2 mouse = ImGui::GetMousePos();
+    if (hovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y)
+    {
+      ProfilerThread* thread = frameProfiler.threads[event->threadId];
+      ImGui::SetTooltip("%s: %.3f ms (%s %u)", event->label, profilerCyclesToMs(event->end - event->start), thread->name, event->threadId);
+    }
+  }
+  ImGui::End();
+}
+
+void render_frame_times_ui()
+{
   ImGui::Begin("Frame times");
-  ImGui::Text("Update:     %d", update_ticks);
-  ImGui::Text("Rendering : %d", render_ticks);
-  ImGui::Text("Clear: %d", clear_ticks);
-  ImGui::Text("Render ui: %d", render_ui_ticks);
-  ImGui::Text("MS: %d", ms);
-  ImGui::Text("FPS: %f", fps * 1000);
+  if (getProfiledFrameCount() > 0)
+  {
+    ProfileFrame* frame = getProfiledFrame(0);
+    f64           ms    = profilerCyclesToMs(frame->end - frame->start);
+    // sum top level blocks by label since update can run several times a frame
+    for (u32 i = 0; i < frame->eventCount; i++)
+    {
+      ProfileEvent* event = &frame->events[i];
+      bool          seen  = false;
+      for (u32 j = 0; j < i && !seen; j++)
+      {
+        seen = frame->events[j].depth == 0 && frame->events[j].threadId == 0 && frame->events[j].label == event->label;
+      }
+      if (event->depth != 0 || event->threadId != 0 || seen)
+      {
+        continue;
+      }
+      u64 total = 0;
+      for (u32 j = i; j < frame->eventCount; j++)
+      {
+        if (frame->events[j].depth == 0 && frame->events[j].threadId == 0 && frame->events[j].label == event->label)
+        {
+          total += frame->events[j].end - frame->events[j].start;
+        }
+      }
+      ImGui::Text("%-16s %7.3f ms", event->label, profilerCyclesToMs(total));
+    }
+    ImGui::Text("MS:  %.3f", ms);
+    ImGui::Text("FPS: %.1f", 1000.0 / ms);
+  }
+  // a few frames old, see GPU_TIMER_LATENCY
+  GpuTimers* gpu_timers = &game_state.renderer.gpu_timers;
+  if (gpu_timers->enabled)
+  {
+    ImGui::Separator();
+    f64 gpu_total = 0;
+    for (u32 pass = 0; pass < GPU_PASS_COUNT; pass++)
+    {
+      ImGui::Text("gpu %-12s %7.3f ms", gpu_pass_name((GpuPass)pass), gpu_timers->last_ms[pass]);
+      gpu_total += gpu_timers->last_ms[pass];
+    }
+    ImGui::Text("GPU: %.3f", gpu_total);
+  }
+  ImGui::Checkbox("Profiler", &show_profiler);
   ImGui::End();
 
+  if (show_profiler)
+  {
+    render_profiler_ui();
+  }
+}
+
+void render_game_running_ui(Hero* player, u32 game_running_ticks, u32 screen_height)
+{
+
+  render_frame_times_ui();
+
   ImVec2 center = ImGui::GetMainViewport()->GetCenter();
   ImGui::SetNextWindowSize(ImVec2(center.x, center.y));
 
@@ -64,14 +241,14 @@ void render_game_running_ui(Hero* player, u32 ms, f32 fps, u32 update_ticks, u32
   ImGui::End();
 }
 
-UI_State render_ui(UI_State state, Hero* player, u32 ms, f32 fps, u32 update_ticks, u32 render_ticks, u32 game_running_ticks, u32 screen_height, u32 clear_ticks, u32 render_ui_ticks)
+UI_State render_ui(UI_State state, Hero* player, u32 game_running_ticks, u32 screen_height)
 {
   init_new_ui_frame();
   switch (state)
   {
   case UI_STATE_GAME_RUNNING:
   {
-    render_game_running_ui(player, ms, fps, update_ticks, render_ticks, game_running_ticks, screen_height, clear_ticks, render_ui_ticks);
+    render_game_running_ui(player, game_running_ticks, screen_height);
     return UI_STATE_GAME_RUNNING;
   }
   case UI_STATE_MAIN_MENU: